@@ -9,15 +9,204 @@ static char help[] = "Driver for heat";
 
 #include "petscksp.h"
 
+#include "sys.h"
+#include "TreeNode.h"
+#include "genPts_par.h"
+#include "sfcSort.h"
+#include "oda.h"
+#include "omg.h"
+
 #include "timeInfo.h"
 
 #include "massMatrix.h"
 #include "parabolic.h"
 #include "stiffnessMatrix.h"
+#include "feMatrixSum.h"
 
 // #include "VecIO.h"
 #include "rhs.h"
 
+/**
+ *	@brief Heat equation on an octree mesh (-octree). Each step solves (Mass - dt*Stiffness) u = Mass u_prev
+ *        with the Krylov solver of the finest level of a DAMG, preconditioned by the V-cycle and started from
+ *        the solution of the previous step. The hierarchy and the operators of all levels are built once.
+ *        If the coarsest level is on fewer processors, its operator is assembled there, gathered on the first
+ *        of them and solved by the private solver (PC_KSP_Shell, LU by default, "private_" options).
+ *        With HILBERT_ORDERING there is no V-cycle, the DAMG has only the finest level.
+ *        Options: -numPts, -maxDepth (octree from gaussian points), -nlevels (multigrid levels).
+ **/
+int octreeHeat(timeInfo &ti, unsigned int dof)
+{
+  MPI_Comm comm = PETSC_COMM_WORLD;
+  int rank;
+  MPI_Comm_rank(comm, &rank);
+
+  PetscInt numPts = 10000;
+  PetscInt maxDepth = 8;
+  PetscInt nlevels = 3;
+  CHKERRQ ( PetscOptionsGetInt(PETSC_NULL, 0, "-numPts", &numPts, 0) );
+  CHKERRQ ( PetscOptionsGetInt(PETSC_NULL, 0, "-maxDepth", &maxDepth, 0) );
+  CHKERRQ ( PetscOptionsGetInt(PETSC_NULL, 0, "-nlevels", &nlevels, 0) );
+
+#ifdef HILBERT_ORDERING
+  // the intergrid transfers of the DAMG (ot::dummyRestrictMatVecType1 ...) only support the Morton ordering, a
+  // single level has none.
+  if (nlevels > 1) {
+    if (!rank) {
+      std::cout << "HILBERT_ORDERING: the octree multigrid needs the Morton ordering, using -nlevels 1." << std::endl;
+    }
+    nlevels = 1;
+  }
+#endif
+
+  unsigned int dim = 3;
+  _InitializeHcurve(dim);
+
+  // balanced octree of the finest level ...
+  std::vector<double> pts;
+  genGauss(0.1, numPts, dim, pts);
+
+  std::vector<ot::TreeNode> tmpNodes;
+  pts2Octants(tmpNodes, &(*(pts.begin())), pts.size(), dim, maxDepth);
+  pts.clear();
+
+  std::vector<ot::TreeNode> tmpSorted, tmpConstruct, balOct;
+  ot::TreeNode root(0, 0, 0, 0, dim, maxDepth);
+  SFC::parSort::SFC_treeSort(tmpNodes, tmpSorted, tmpConstruct, balOct, 0.1, maxDepth, root, ROOT_ROTATION, 1,
+                             TS_BALANCE_OCTREE, NUM_NPES_THRESHOLD, comm);
+  tmpNodes.clear();
+  tmpSorted.clear();
+  tmpConstruct.clear();
+
+  int nlev = nlevels;
+  ot::DAMG *damg;
+  CHKERRQ ( ot::DAMGCreateAndSetDA(comm, nlev, NULL, &damg, balOct, dof, 1.5, false, true) );
+
+#ifdef HILBERT_ORDERING
+  // the element loops of a Hilbert DA need the rotations of the elements ...
+  for (int i = 0; i < nlev; i++) {
+    if (damg[i]->da->iAmActive())
+      damg[i]->da->computeHilbertRotations();
+  }
+#endif
+
+  // operators of all the levels, Mass - dt*Stiffness in a single traversal ...
+  std::vector<massMatrix*> Mass(nlev);
+  std::vector<stiffnessMatrix*> Stiffness(nlev);
+  std::vector<feMatrixSum*> Jacobian(nlev);
+  std::vector<timeStepper::MGJacData> jacData(nlev);
+  std::vector<Vec> rho(nlev);
+  for (int i = 0; i < nlev; i++) {
+    ot::DA *da = damg[i]->da;
+    da->createVector(rho[i], false, false, dof);
+    VecSet(rho[i], 1.0);
+
+    Mass[i] = new massMatrix(feMat::OCT);
+    Mass[i]->setProblemDimensions(1.0, 1.0, 1.0);
+    Mass[i]->setDA(da);
+    Mass[i]->setDof(dof);
+
+    Stiffness[i] = new stiffnessMatrix(feMat::OCT);
+    Stiffness[i]->setProblemDimensions(1.0, 1.0, 1.0);
+    Stiffness[i]->setDA(da);
+    Stiffness[i]->setDof(dof);
+    Stiffness[i]->setNuVec(rho[i]);
+
+    Jacobian[i] = new feMatrixSum(feMat::OCT);
+    Jacobian[i]->addTerm(Mass[i], 1.0);
+    Jacobian[i]->addTerm(Stiffness[i], -ti.step);
+    Jacobian[i]->setProblemDimensions(1.0, 1.0, 1.0);
+    Jacobian[i]->setDA(da);
+    Jacobian[i]->setDof(dof);
+
+    jacData[i].Jac = Jacobian[i];
+    damg[i]->user = &(jacData[i]);
+  }
+
+  // a coarsest level on fewer processors is solved with its assembled operator on the active processors ...
+  ot::getPrivateMatricesForKSP_Shell = timeStepper::MGGetPrivateMatrices;
+
+  // initial conditions on the finest level, from the anchors of the elements ...
+  ot::DA *da = DAMGGetDA(damg);
+  Vec initialTemperature;
+  da->createVector(initialTemperature, false, false, dof);
+  VecZeroEntries(initialTemperature);
+
+  if (da->iAmActive()) {
+    PetscScalar *icArray;
+    da->vecGetBuffer(initialTemperature, icArray, false, false, false, dof);
+
+    unsigned int maxD = da->getMaxDepth();
+    double xFac = 1.0/((double)(1u << (maxD - 1)));
+    unsigned int idx[8];
+    for (da->init<ot::DA_FLAGS::ALL>(); da->curr() < da->end<ot::DA_FLAGS::ALL>(); da->next<ot::DA_FLAGS::ALL>()) {
+      Point pt = da->getCurrentOffset();
+      double h = xFac*(1u << (maxD - da->getLevel(da->curr())));
+      unsigned char hnMask = da->getHangingNodeIndex(da->curr());
+      da->getNodeIndices(idx);
+      for (unsigned int v = 0; v < 8; v++) {
+        // hanging nodes get their value from the elements they are a vertex of.
+        if ((hnMask >> v) & 1u)
+          continue;
+        double coords[3] = { pt.x()*xFac + ((v & 1u) ? h : 0.0),
+                             pt.y()*xFac + ((v & 2u) ? h : 0.0),
+                             pt.z()*xFac + ((v & 4u) ? h : 0.0) };
+        double ic = sin(M_PI * coords[0]) * sin(M_PI * coords[1]) * sin(M_PI * coords[2]);
+        for (unsigned int d = 0; d < dof; d++)
+          icArray[dof*idx[v] + d] = ic;
+      }
+    }
+
+    da->vecRestoreBuffer(initialTemperature, icArray, false, false, false, dof);
+  }
+
+  // the right hand side Mass*u_prev uses the same (batched) element loop as the Jacobian ...
+  feMatrixSum* RHSMass = new feMatrixSum(feMat::OCT);
+  RHSMass->addTerm(Mass[nlev - 1], 1.0);
+  RHSMass->setProblemDimensions(1.0, 1.0, 1.0);
+  RHSMass->setDA(da);
+  RHSMass->setDof(dof);
+
+  parabolic *ts = new parabolic;
+
+  ts->setMassMatrix(RHSMass);
+  ts->setStiffnessMatrix(Stiffness[nlev - 1]);
+  ts->setJacobianMatrix(Jacobian[nlev - 1]);
+  ts->setDAMG(damg);
+  ts->setTimeFrames(0);
+
+  ts->setInitialTemperature(initialTemperature);
+
+  ts->setTimeInfo(&ti);
+  ts->setAdjoint(false);
+
+  if (!rank)
+    std::cout << "Initializing parabolic with " << nlev << " multigrid levels" << std::endl;
+
+  double itime = MPI_Wtime();
+  CHKERRQ ( ts->init() );
+  double stime = MPI_Wtime();
+  CHKERRQ ( ts->solve() );
+  double etime = MPI_Wtime();
+  if (!rank) {
+    std::cout << "Total time for init is " << stime - itime << std::endl;
+    std::cout << "Total time for solve is " << etime - stime << std::endl;
+  }
+
+  delete ts;
+  delete RHSMass;
+  VecDestroy(&initialTemperature);
+  for (int i = 0; i < nlev; i++) {
+    delete Jacobian[i];
+    delete Mass[i];
+    delete Stiffness[i];
+    VecDestroy(&rho[i]);
+  }
+  CHKERRQ ( ot::DAMGDestroy(damg) );
+
+  return(0);
+}
+
 int main(int argc, char **argv)
 {       
   PetscInitialize(&argc, &argv, "heat.opt", help);
@@ -67,6 +256,21 @@ int main(int argc, char **argv)
   ti.stop  = t1;
   ti.step  = dt;
 
+  PetscBool octree = PETSC_FALSE;
+  CHKERRQ ( PetscOptionsGetBool(PETSC_NULL, 0, "-octree", &octree, 0) );
+  if (octree == PETSC_TRUE) {
+    ot::RegisterEvents();
+    ot::DA_Initialize(MPI_COMM_WORLD);
+    ot::DAMG_Initialize(MPI_COMM_WORLD);
+
+    CHKERRQ ( octreeHeat(ti, dof) );
+
+    ot::DAMG_Finalize();
+    ot::DA_Finalize();
+    PetscFinalize();
+    return 0;
+  }
+
   if (!rank) {
     std::cout << "Grid size is " << Ns+1 << " and NT is " << (int)ceil(1.0/dt) << std::endl;
   }
@@ -173,6 +377,14 @@ int main(int argc, char **argv)
   Stiffness->setDof(dof);
   Stiffness->setNuVec(rho);
 
+  // Jacobian of the implicit step, Mass - dt*Stiffness in a single traversal ...
+  feMatrixSum* Jacobian = new feMatrixSum(feMat::PETSC);
+  Jacobian->addTerm(Mass, 1.0);
+  Jacobian->addTerm(Stiffness, -ti.step);
+  Jacobian->setProblemDimensions(1.0, 1.0, 1.0);
+  Jacobian->setDA(da);
+  Jacobian->setDof(dof);
+
   Force->setProblemDimensions(1.0, 1.0, 1.0);
   Force->setDA(da);
   Force->setDof(dof);
@@ -182,6 +394,7 @@ int main(int argc, char **argv)
 
   ts->setMassMatrix(Mass);
   ts->setStiffnessMatrix(Stiffness);
+  ts->setJacobianMatrix(Jacobian);
   ts->setForceVector(Force);
   ts->setTimeFrames(1);
 
@@ -40,8 +40,6 @@ class parabolic : public timeStepper //<parabolic>
 	**/
   virtual void jacobianMatMult(Vec In, Vec Out);
   virtual void jacobianGetDiagonal(Vec diag) {};
-
-  virtual void mgjacobianMatMult(DM da, Vec In, Vec Out);
   /**
 	*	@brief Sets the right hand side vector given the current solution
 	*  @param m_vecCurrentSolution PETSC Vec, current solution
@@ -60,6 +58,7 @@ class parabolic : public timeStepper //<parabolic>
   // set time frames for monitor
   int setTimeFrames(int mon){
 	 m_iMon = mon;
+	 return(0);
   }
 
   // monitor routine which saves solution
@@ -87,6 +86,11 @@ class parabolic : public timeStepper //<parabolic>
  * @return bool true if successful, false otherwise
  * Matrix of shell type is created which does only a matvec.
  * This requires the mass matrix, stiffness matrix, damping matrix to do the matvec			 
+ * If a DAMG is set, the KSP of its finest level (preconditioned by the V-cycle) and its finest
+ * level matrix are used instead. They are set up once here and reused by every time step.
+ * The user context of every level must be a timeStepper::MGJacData. If not all the processors
+ * are active on the coarsest level, ot::getPrivateMatricesForKSP_Shell must be set to
+ * timeStepper::MGGetPrivateMatrices.
  **/
 int parabolic::init()
 {
@@ -98,6 +102,15 @@ int parabolic::init()
   ierr = VecDuplicate(m_vecInitialSolution,&m_vecSolution); CHKERRQ(ierr);
   ierr = VecDuplicate(m_vecInitialSolution,&m_vecRHS); CHKERRQ(ierr);
 
+  if (m_damg != NULL) {
+    ierr = DAMGSetKSP(m_damg, CreateMGJacobian, ComputeMGJacobian, NULL); CHKERRQ(ierr);
+
+    m_matJacobian = DAMGGetJ(m_damg);
+    m_ksp = DAMGGetKSP(m_damg);
+
+    return(0);
+  }
+
   ierr = VecGetLocalSize(m_vecInitialSolution,&matsize); CHKERRQ(ierr);
 
   ierr = MatCreateShell(PETSC_COMM_WORLD,matsize,matsize,PETSC_DETERMINE,PETSC_DETERMINE,this,&m_matJacobian); CHKERRQ(ierr);
@@ -195,17 +208,19 @@ int parabolic::solve()
 void parabolic::jacobianMatMult(Vec In, Vec Out)
 {
   VecZeroEntries(Out); /* Clear to zeros*/
+  if (m_Jacobian != NULL) {
+    m_Jacobian->MatVec(In, Out); /* Mass - dt*Stiffness in one traversal*/
+    return;
+  }
   //m_Damping->MatVec(In, Out); /* Matvec */
   m_Mass->MatVec(In, Out);
   m_Stiffness->MatVec(In, Out, -m_ti->step); /* -dt factor for stiffness*/
   //m_Qtype->MatVec(In,Out,m_ti->step); /* dt factor for qtype matrix*/
 }
 
-void parabolic::mgjacobianMatMult(DM da, Vec In, Vec Out){
-  assert(false);
-}
 /**
  *	@brief Set right hand side used in stepping at every time step
+ * Without a force vector the right hand side is Mass*(previous solution)
  * @return true if successful, false otherwise
  **/
 
@@ -213,6 +228,11 @@ bool parabolic::setRHS()
 {
   VecZeroEntries(m_vecRHS);
 
+  if (m_Force == NULL) {
+    m_Mass->MatVec(m_vecSolution, m_vecRHS);
+    return true;
+  }
+
   ((forceVector*)m_Force)->setPrevTS(m_vecSolution);
   m_Force->addVec(m_vecRHS);
   //m_Damping->MatVec(m_vecSolution,m_vecRHS); /* Set right hand side*/
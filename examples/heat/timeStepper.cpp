@@ -9,6 +9,8 @@ timeStepper::timeStepper()
   m_Mass = NULL;
   m_Damping = NULL;
   m_Stiffness = NULL;
+  m_Jacobian = NULL;
+  m_Force = NULL;
 
   // Set initial displacement and velocity to null
   m_vecInitialSolution = NULL;
@@ -22,6 +24,7 @@ timeStepper::timeStepper()
 
   // Linear Solver
   m_ksp = NULL;
+  m_damg = NULL;
 
   // Adjoint flag false
   m_bIsAdjoint = false;
@@ -85,6 +88,18 @@ int timeStepper::setStiffnessMatrix(feMat* Stiffness)
   return(0);
 }
 
+/**
+ *	@brief This function sets the operator of the implicit step, e.g. a feMatrixSum of the
+ *         Mass and the Stiffness Matrix. If set, it is used instead of the individual matrices.
+ * @param Jacobian operator
+ * @return bool true if successful, false otherwise
+ **/
+int timeStepper::setJacobianMatrix(feMat* Jacobian)
+{
+  m_Jacobian = Jacobian;
+  return(0);
+}
+
 /**
  *	@brief This function sets the Qtype Matrix
  * @param Qtype operator
@@ -107,6 +122,19 @@ int timeStepper::setForceVector(feVec* Force)
   return(0);
 }
 
+/**
+ *	@brief This function sets the octree multigrid used to solve the implicit step. The user context
+ *         of every level must be the operator of the step on the DA of the level (feMat*). The
+ *         hierarchy and the level operators are reused by all the time steps.
+ * @param damg the multigrid object
+ * @return bool true if successful, false otherwise
+ **/
+int timeStepper::setDAMG(ot::DAMG* damg)
+{
+  m_damg = damg;
+  return(0);
+}
+
 /**
  *	@brief This function sets the Reaction term
  * @param Reaction vector
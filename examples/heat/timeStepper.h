@@ -10,8 +10,7 @@
 #include "feMat.h"
 #include "feVec.h"
 #include "timeInfo.h"
-//#include "stsdamgHeader.h"
-//#include "rpHeader.h"
+#include "omg.h"
 
 class timeStepper {
   public:
@@ -34,8 +33,12 @@ class timeStepper {
 
   int setQtypeMatrix(feMat* Qtype);
 
+  int setJacobianMatrix(feMat* Jacobian);
+
   int setForceVector(feVec* Force);
 
+  int setDAMG(ot::DAMG* damg);
+
   int setReaction(feVec* Reaction);
   
   /*
@@ -71,8 +74,6 @@ class timeStepper {
   virtual void  jacobianMatMult(Vec _in, Vec _out)= 0;
   virtual void jacobianGetDiagonal(Vec diag) = 0;
 
-  virtual void  mgjacobianMatMult(DM _da, Vec _in, Vec _out)= 0;
-
   virtual bool  setRHSFunction(Vec _in, Vec _out) = 0;
   /**
 	*	@brief The set right hand side function using the stiffness etc
@@ -113,56 +114,134 @@ class timeStepper {
 	 return(0);
   }
 
-/*  static void MGMatMult(Mat M, Vec In, Vec Out){
-	 stsDMMG *contxt;
-	 MatShellGetContext(M,(void**)&contxt);
+  /**
+	*	@brief The user context of a multigrid level (damg->user). Jac is the operator of the level, e.g.
+	*         Mass - dt*Stiffness on the DA of the level. If not all the processors are active on the coarsest
+	*         level, Jmat_private is Jac assembled on the active processors, it is used by the private solver
+	*         of the coarsest level (PC_KSP_Shell, see ot::DAMGSetKSP) and inTmp, outTmp wrap the level vectors.
+	**/
+  struct MGJacData {
+	 MGJacData() : Jac(NULL), Jmat_private(NULL), inTmp(NULL), outTmp(NULL) { }
 
-	 DM da = (DM)(((stsDMMG)contxt)->dm);
+	 feMat* Jac;
+	 Mat Jmat_private;
+	 Vec inTmp;
+	 Vec outTmp;
+  };
 
-	 ((timeStepper*)(((stsDMMG)contxt)->user))->mgjacobianMatMult(da,In,Out);
-  }*/
+  /**
+	*	@brief The matvec of the shell matrix of a multigrid level. The context of the shell is the level.
+	**/
+  static PetscErrorCode MGMatMult(Mat M, Vec In, Vec Out){
+	 ot::DAMG damg;
+	 MatShellGetContext(M, (void**)&damg);
 
-  
-/*  static PetscErrorCode CreateJacobian(stsDMMG dmmg, Mat *J){
-	 DM da = (DM)(dmmg->dm);
-	 int m,n,xm,ym,zm;
-	 int ierr;
-	 DALocalInfo info;
+	 VecZeroEntries(Out);
+	 ((MGJacData*)(damg->user))->Jac->MatVec(In, Out);
+	 return(0);
+  }
 
-	 ierr = DAGetLocalInfo(da,&info); CHKERRQ(ierr);
-	 ierr = DAGetCorners(da,0,0,0,&xm,&ym,&zm); CHKERRQ(ierr);
-	 m=n=xm*ym*zm;
+  static PetscErrorCode MGMatGetDiagonal(Mat M, Vec diag){
+	 ot::DAMG damg;
+	 MatShellGetContext(M, (void**)&damg);
 
-	 std::cout << "size @ level = "<< m << std::endl;
-	 ierr = MatCreateShell(PETSC_COMM_WORLD,m*info.dof,n*info.dof,PETSC_DETERMINE,PETSC_DETERMINE,dmmg,J); CHKERRQ(ierr);
-	 ierr = MatShellSetOperation(*J,MATOP_MULT,(void(*)(void))MGMatMult); CHKERRQ(ierr);
-								  
+	 VecZeroEntries(diag);
+	 ((MGJacData*)(damg->user))->Jac->MatGetDiagonal(diag);
 	 return(0);
   }
 
-  static PetscErrorCode ComputeJacobian(stsDMMG dmmg, Mat A, Mat B){
+  /**
+	*	@brief The matvec of the shell matrix of a coarsest level with inactive processors, the active
+	*         processors multiply with the private matrix.
+	**/
+  static PetscErrorCode MGShellMatMult(Mat M, Vec In, Vec Out){
+	 ot::DAMG damg;
+	 MatShellGetContext(M, (void**)&damg);
+
+	 MGJacData* data = (MGJacData*)(damg->user);
+	 if (damg->da->iAmActive()) {
+		PetscScalar *inArray, *outArray;
+		VecGetArray(In, &inArray);
+		VecGetArray(Out, &outArray);
 
+		VecPlaceArray(data->inTmp, inArray);
+		VecPlaceArray(data->outTmp, outArray);
+
+		::MatMult(data->Jmat_private, data->inTmp, data->outTmp);
+
+		VecResetArray(data->inTmp);
+		VecResetArray(data->outTmp);
+
+		VecRestoreArray(In, &inArray);
+		VecRestoreArray(Out, &outArray);
+	 }
 	 return(0);
   }
 
-  static PetscErrorCode ComputeRHS(stsDMMG dmmg, Vec b){
+  static PetscErrorCode MGShellMatDestroy(Mat M){
+	 ot::DAMG damg;
+	 MatShellGetContext(M, (void**)&damg);
 
-	 // int ierr;
-	 // int size;
-
-	 VecCopy(((timeStepper*)dmmg->user)->m_vecRHS,b);
+	 MGJacData* data = (MGJacData*)(damg->user);
+	 if (data->Jmat_private) {
+		MatDestroy(&(data->Jmat_private));
+		VecDestroy(&(data->inTmp));
+		VecDestroy(&(data->outTmp));
+	 }
 	 return(0);
   }
 
-  static PetscErrorCode FormInitialGuess(stsDMMG dmmg, Vec X){
+  /**
+	*	@brief Passes the private matrix of the coarsest level to PC_KSP_Shell (ot::getPrivateMatricesForKSP_Shell)
+	**/
+  static void MGGetPrivateMatrices(Mat M, Mat *AmatPrivate, Mat *PmatPrivate, MatStructure* pFlag){
+	 ot::DAMG damg;
+	 MatShellGetContext(M, (void**)&damg);
+
+	 MGJacData* data = (MGJacData*)(damg->user);
+	 *AmatPrivate = data->Jmat_private;
+	 *PmatPrivate = data->Jmat_private;
+	 *pFlag = SAME_NONZERO_PATTERN;
+  }
+
+  /**
+	*	@brief Creates the shell matrix of a multigrid level (passed to DAMGSetKSP). If not all the processors
+	*         are active on the coarsest level, its operator is also assembled on the active processors.
+	**/
+  static PetscErrorCode CreateMGJacobian(ot::DAMG damg, Mat *J){
+	 int ierr;
+	 ot::DA* da = damg->da;
+	 PetscInt n = 0;
+	 if (da->iAmActive()) {
+		n = (damg->dof)*(da->getNodeSize());
+	 }
+
+	 ierr = MatCreateShell(damg->comm, n, n, PETSC_DETERMINE, PETSC_DETERMINE, damg, J); CHKERRQ(ierr);
+
+	 bool requirePrivateMats = ( (damg->nlevels == damg->totalLevels) && (da->getNpesActive() != da->getNpesAll()) );
+	 if (requirePrivateMats) {
+		MGJacData* data = (MGJacData*)(damg->user);
+		data->Jac->GetAssembledMatrix(&(data->Jmat_private), MATAIJ);
+		if (da->iAmActive()) {
+		  ierr = MatCreateVecs(data->Jmat_private, &(data->inTmp), &(data->outTmp)); CHKERRQ(ierr);
+		}
+		ierr = MatShellSetOperation(*J, MATOP_MULT, (void(*)(void))MGShellMatMult); CHKERRQ(ierr);
+		ierr = MatShellSetOperation(*J, MATOP_DESTROY, (void(*)(void))MGShellMatDestroy); CHKERRQ(ierr);
+	 } else {
+		ierr = MatShellSetOperation(*J, MATOP_MULT, (void(*)(void))MGMatMult); CHKERRQ(ierr);
+		ierr = MatShellSetOperation(*J, MATOP_GET_DIAGONAL, (void(*)(void))MGMatGetDiagonal); CHKERRQ(ierr);
+	 }
 
-	 VecCopy(((timeStepper*)dmmg->user)->m_vecSolution,X);
+	 return(0);
+  }
 
-	 double norm;
-	 VecNorm(X,NORM_INFINITY,&norm);
-	 std::cout << " InitialGuess norm " << norm << std::endl;
+  /**
+	*	@brief The level operators (and the private matrix of the coarsest level) do not change between the time
+	*         steps, nothing to compute.
+	**/
+  static PetscErrorCode ComputeMGJacobian(ot::DAMG damg, Mat A, Mat B){
 	 return(0);
-  }*/
+  }
 
   /**
 	*	@brief return the force vector (this is for static vector)
@@ -204,6 +283,9 @@ class timeStepper {
 
   feMat* m_Qtype;
 
+  // fused operator of the implicit step (optional)
+  feMat* m_Jacobian;
+
   feVec* m_Force;
 
   feVec* m_Reaction;
@@ -231,8 +313,8 @@ class timeStepper {
   // Linear Solver
   KSP				m_ksp;
 
-  // stsDMMG Multigrid
-  //stsDMMG      *m_dmmg;
+  // Octree multigrid (optional), the KSP and the Jacobian of the finest level are used
+  ot::DAMG     *m_damg;
   
   // Time info
   timeInfo     *m_ti;
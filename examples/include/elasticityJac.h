@@ -7,6 +7,9 @@
 #ifndef __ELASTICITY_JAC_H
 #define __ELASTICITY_JAC_H
 
+//Number of element types (GET_ETYPE_BLOCK) of the type-2 stencils
+#define ELASTICITY_NUM_ELEM_TYPES 18
+
 //Stuff for the case where the material properties on the coarser grids are
 //constructed by averaging the material properties of the immediately finer
 //grid 
@@ -14,12 +17,21 @@ struct ElasticityData {
   unsigned char* bdyArr;
   PetscReal mu;
   PetscReal lambda;
+  //The 24x24 (8 nodes x 3 dof) element matrix mu*Laplacian + (mu+lambda)*GradDiv
+  //for each (childNum, elemType), stored contiguously and column major:
+  //entry (row, col) of (c, t) is at [(((c*ELASTICITY_NUM_ELEM_TYPES) + t)*576) + (24*col) + row]
+  double* elemStencil;
+  //Bit k is set if vertex k of the element is a Dirichlet node, indexed by DA::curr()
+  unsigned char* elemBdyMask;
   Mat Jmat_private;
   Vec inTmp;
   Vec outTmp;
 };
 
 void SetElasticityContexts(ot::DAMG* damg);
+//Builds ctx->elemStencil from LaplacianType2Stencil and GradDivType2Stencil,
+//which must be created before.
+void createElasticityElemStencil(ElasticityData* ctx);
 void DestroyElasticityContexts(ot::DAMG* damg);
 
 PetscErrorCode CreateElasticityMat(ot::DAMG damg,Mat *B);
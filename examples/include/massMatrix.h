@@ -46,6 +46,7 @@ class massMatrix : public feMatrix<massMatrix>
     **/ 
     inline bool ElementalMatVec(int i, int j, int k, PetscScalar ***in, PetscScalar ***out, double scale);
     inline bool ElementalMatVec(unsigned int idx, PetscScalar *in, PetscScalar *out, double scale);
+    inline bool ElementalMatVec(const ot::ElementLoop & loop, unsigned int pos, PetscScalar *in, PetscScalar *out, double scale);
 
     inline bool GetElementalMatrix(int i, int j, int k, PetscScalar *mat);
     inline bool GetElementalMatrix(unsigned int idx, std::vector<ot::MatRecord> &records);
@@ -55,6 +56,7 @@ class massMatrix : public feMatrix<massMatrix>
 
   
     inline bool ElementalMatVec(PetscScalar* in_local, PetscScalar* out_local, PetscScalar* coords, double scale);
+    inline bool ElementalMatVecBatch(PetscScalar* in_local, PetscScalar* out_local, PetscScalar* coords, unsigned int numElems, double scale);
 
     inline bool initStencils();
 
@@ -70,6 +72,7 @@ class massMatrix : public feMatrix<massMatrix>
     Vec                 nuvec;     
 
     double 		m_dHx;
+    double    m_dStencil[64]; /* the regular (Type-0) stencil, row major */
     
     double xFac, yFac, zFac;
     unsigned int maxD;
@@ -115,6 +118,11 @@ bool massMatrix::initStencils() {
       }//end k
     }//end j
     m_stencil = Ajk;
+    for (int j=0;j<8;j++) {
+      for (int k=0;k<8;k++) {
+        m_dStencil[8*j + k] = Bjk[j][k];
+      }//end k
+    }//end j
   } else {
     int Bijk[8][8][8] = {
       //Type-0:No Hanging
@@ -209,6 +217,11 @@ bool massMatrix::initStencils() {
       }//end j
     }//end i
     m_stencil = Aijk;
+    for (int j=0;j<8;j++) {
+      for (int k=0;k<8;k++) {
+        m_dStencil[8*j + k] = Bijk[0][j][k];
+      }//end k
+    }//end j
   }
   return true;
 }
@@ -236,6 +249,18 @@ bool massMatrix::preMatVec() {
         zFac = 1.0/((double)(1<<(maxD-1)));
       }
     }
+
+    // The stencils scaled by h^3/1728 for each level. They only depend on maxD.
+    if (!isStencilCacheValid()) {
+      std::vector<double> levelFactors(maxD + 1, 0.0);
+      for (unsigned int lev = 1; lev <= maxD; lev++) {
+        double hx = xFac*(1<<(maxD - lev));
+        double hy = yFac*(1<<(maxD - lev));
+        double hz = zFac*(1<<(maxD - lev));
+        levelFactors[lev] = hx*hy*hz/1728.0;
+      }
+      initStencilCache(8, levelFactors);
+    }
   }
 
   return true;
@@ -243,29 +268,47 @@ bool massMatrix::preMatVec() {
 
 bool massMatrix::ElementalMatVec(unsigned int i, PetscScalar *in, PetscScalar *out, double scale) {
   unsigned int lev = m_octDA->getLevel(i);
-  double hx = xFac*(1<<(maxD - lev));
-  double hy = yFac*(1<<(maxD - lev));
-  double hz = zFac*(1<<(maxD - lev));
 
-  double fac = scale*hx*hy*hz/1728.0;
-  
   stdElemType elemType;
   unsigned int idx[8];
-  
-  int ***Aijk = (int ***)m_stencil;
-  
+
   alignElementAndVertices(m_octDA, elemType, idx);       
-  
+
+  // h^3/1728 * Aijk[elemType]
+  const double *S = getCachedStencil(elemType, lev);
 
   for (int k = 0;k < 8;k++) {
+    double val = 0.0;
     for (int j=0;j<8;j++) {
-      out[m_uiDof*idx[k]] += fac*(Aijk[elemType][k][j])*in[m_uiDof*idx[j]];
+      val += S[8*k + j]*in[m_uiDof*idx[j]];
 	}//end for j
+    out[m_uiDof*idx[k]] += scale*val;
   }//end for k
   
   return true;
 }
 
+bool massMatrix::ElementalMatVec(const ot::ElementLoop & loop, unsigned int pos, PetscScalar *in, PetscScalar *out, double scale) {
+  unsigned int lev = m_octDA->getLevel(loop.getElement(pos));
+
+  stdElemType elemType;
+  unsigned int idx[8];
+
+  alignElementAndVertices(m_octDA, loop, pos, elemType, idx);
+
+  const double *S = getCachedStencil(elemType, lev);
+
+  for (int k = 0;k < 8;k++) {
+    double val = 0.0;
+    for (int j=0;j<8;j++) {
+      val += S[8*k + j]*in[m_uiDof*idx[j]];
+    }//end for j
+    out[m_uiDof*idx[k]] += scale*val;
+  }//end for k
+
+  return true;
+}
+
 bool massMatrix::ElementalMatVec(int i, int j, int k, PetscScalar ***in, PetscScalar ***out, double scale){
   int dof= m_uiDof;
   int idx[8][3]={
@@ -315,21 +358,16 @@ bool massMatrix::postMatVec() {
 
 bool massMatrix::ElementalMatGetDiagonal(unsigned int i, PetscScalar *diag, double scale) {
   unsigned int lev = m_octDA->getLevel(i);
-  double hx = xFac*(1<<(maxD - lev));
-  double hy = yFac*(1<<(maxD - lev));
-  double hz = zFac*(1<<(maxD - lev));
 
-  double fac = scale*hx*hy*hz/1728.0;
-  
   stdElemType elemType;
   unsigned int idx[8];
-  
-  int ***Aijk = (int ***)m_stencil;
-  
+
   alignElementAndVertices(m_octDA, elemType, idx);       
-  
+
+  const double *S = getCachedStencil(elemType, lev);
+
   for (int k = 0;k < 8;k++) {
-      diag[m_uiDof*idx[k]] += fac*(Aijk[elemType][k][k]);
+      diag[m_uiDof*idx[k]] += scale*S[9*k];
 	}//end for k
   
   return true;
@@ -359,9 +397,39 @@ bool massMatrix::ElementalMatGetDiagonal(int i, int j, int k, PetscScalar ***dia
 }
 
 bool massMatrix::ElementalMatVec(PetscScalar* in_local, PetscScalar* out_local, PetscScalar* coords, double scale) {
+  // the element is regular, the vertices are in the order of coords.
+  double hx = coords[3] - coords[0];
+  double hy = coords[7] - coords[1];
+  double hz = coords[14] - coords[2];
+
+  double fac = scale*hx*hy*hz/1728.0;
+
+  for (int k = 0;k < 8;k++) {
+    for (int j=0;j<8;j++) {
+      for (unsigned int d = 0; d < m_uiDof; d++) {
+        out_local[m_uiDof*k + d] += fac*m_dStencil[8*k + j]*in_local[m_uiDof*j + d];
+      }
+    }//end for j
+  }//end for k
+
   return true;
 }
 
 
+bool massMatrix::ElementalMatVecBatch(PetscScalar* in_local, PetscScalar* out_local, PetscScalar* coords, unsigned int numElems, double scale) {
+  // structure of arrays, the elements of the batch are the SIMD lanes.
+  double fac[FE_ELEMENT_BATCH_SIZE];
+  for (unsigned int e = 0; e < numElems; e++) {
+    double hx = coords[3*FE_ELEMENT_BATCH_SIZE + e] - coords[e];
+    double hy = coords[7*FE_ELEMENT_BATCH_SIZE + e] - coords[FE_ELEMENT_BATCH_SIZE + e];
+    double hz = coords[14*FE_ELEMENT_BATCH_SIZE + e] - coords[2*FE_ELEMENT_BATCH_SIZE + e];
+    fac[e] = scale*hx*hy*hz/1728.0;
+  }
+
+  ot::stencilMatVecBatch(m_dStencil, fac, in_local, out_local, m_uiDof, numElems, FE_ELEMENT_BATCH_SIZE);
+
+  return true;
+}
+
 #endif /*_MASSMATRIX_H_*/
 
@@ -46,6 +46,7 @@ class stiffnessMatrix : public feMatrix<stiffnessMatrix>
      **/ 
     inline bool ElementalMatVec(int i, int j, int k, PetscScalar ***in, PetscScalar ***out, double scale);
     inline bool ElementalMatVec(unsigned int idx, PetscScalar *in, PetscScalar *out, double scale);
+    inline bool ElementalMatVec(const ot::ElementLoop & loop, unsigned int pos, PetscScalar *in, PetscScalar *out, double scale);
 
     inline bool GetElementalMatrix(int i, int j, int k, PetscScalar *mat);
     inline bool GetElementalMatrix(unsigned int idx, std::vector<ot::MatRecord>& records);
@@ -54,14 +55,33 @@ class stiffnessMatrix : public feMatrix<stiffnessMatrix>
     inline bool ElementalMatGetDiagonal(unsigned int idx, PetscScalar *diag, double scale);
     
     inline bool ElementalMatVec(PetscScalar* in_local, PetscScalar* out_local, PetscScalar* coords, double scale);
+    inline bool ElementalMatVecBatch(PetscScalar* in_local, PetscScalar* out_local, PetscScalar* coords, unsigned int numElems, double scale);
     
     inline bool initStencils();
 
     bool preMatVec();
     bool postMatVec();
 
+    /**
+     *  @brief	Sets the diffusion coefficient nv (one value per node). Collective, nv is scanned once here for
+     *  		its maximum and minimum, so setNuVec() must be called again if the values of nv change.
+     *  		The local kernels of MatVec_new() and feMatrixSum need a constant nu, see
+     *  		localKernelsSupported().
+     **/
     void setNuVec(Vec nv) {
       nuvec = nv;
+      double nuMin;
+      VecMax(nuvec, PETSC_NULL, &m_nuval);
+      VecMin(nuvec, PETSC_NULL, &nuMin);
+      m_bConstantNu = (nuMin == m_nuval);
+    }
+
+    /**
+     *  @brief	true if nu is constant. The local kernels do not carry the node indices, so they can not
+     *  		apply nu per node as ElementalMatVec(idx, ...) does.
+     **/
+    bool localKernelsSupported() {
+      return m_bConstantNu;
     }
 
    private:
@@ -69,7 +89,9 @@ class stiffnessMatrix : public feMatrix<stiffnessMatrix>
     Vec                 nuvec;     
 
     double 		m_dHx;
+    double    m_dStencil[64]; /* the regular (Type-0) stencil, row major */
 	 double     m_nuval;
+    bool       m_bConstantNu; /* nuvec is constant, required by the local (batched) kernels */
     double xFac, yFac, zFac;
     unsigned int maxD;
 
@@ -83,6 +105,8 @@ stiffnessMatrix::stiffnessMatrix(daType da) {
   m_DA 		= NULL;
   m_octDA 	= NULL;
   m_stencil	= NULL;
+  m_nuval = 0.0;
+  m_bConstantNu = false;
 
   // initialize the stencils ...
   initStencils();
@@ -114,6 +138,11 @@ bool stiffnessMatrix::initStencils() {
       }//end k
     }//end j
     m_stencil = Ajk;
+    for (int j=0;j<8;j++) {
+      for (int k=0;k<8;k++) {
+        m_dStencil[8*j + k] = Bjk[j][k];
+      }//end k
+    }//end j
 
   } else {
     int Bijk[8][8][8] = {
@@ -201,18 +230,22 @@ bool stiffnessMatrix::initStencils() {
       }//end j
     }//end i
     m_stencil = Aijk;
+    for (int j=0;j<8;j++) {
+      for (int k=0;k<8;k++) {
+        m_dStencil[8*j + k] = Bijk[0][j][k];
+      }//end k
+    }//end j
   }
   return true;
 }
 
 bool stiffnessMatrix::preMatVec() {
   // nuVec should be set directly into matrix outside the loop ...
+  int ierr;
   if (m_daType == PETSC) {
     PetscScalar ***nuarray; //
-	 // int ierr;
-	 // ierr = VecNorm(nuvec,NORM_INFINITY,&m_nuval); CHKERRQ(ierr);
 
-    int ierr = DMDAVecGetArray(m_DA, nuvec, &nuarray);
+    ierr = DMDAVecGetArray(m_DA, nuvec, &nuarray);
 
     m_nuarray = nuarray;
     // compute Hx
@@ -243,6 +276,16 @@ bool stiffnessMatrix::preMatVec() {
         zFac = 1.0/((double)(1<<(maxD-1)));
       }
     }
+
+    // The stencils scaled by -h/192 for each level. nu is applied per row in
+    // ElementalMatVec(), so the cache does not change with nuvec.
+    if (!isStencilCacheValid()) {
+      std::vector<double> levelFactors(maxD + 1, 0.0);
+      for (unsigned int lev = 1; lev <= maxD; lev++) {
+        levelFactors[lev] = -(xFac*(1<<(maxD - lev)))/192.0;
+      }
+      initStencilCache(8, levelFactors);
+    }
   }
 
   return true;
@@ -250,31 +293,44 @@ bool stiffnessMatrix::preMatVec() {
 
 bool stiffnessMatrix::ElementalMatVec(unsigned int i, PetscScalar *in, PetscScalar *out, double scale) {
   unsigned int lev = m_octDA->getLevel(i);
-  double hx = xFac*(1<<(maxD - lev));
-  // double hy = yFac*(1<<(maxD - lev));
-  // double hz = zFac*(1<<(maxD - lev));
 
-  double fac11 = -hx*scale/192.0;
-  
   stdElemType elemType;
   unsigned int idx[8];
 
-  // unsigned char hangingMask = m_octDA->getHangingNodeIndex(i);    //  alignElementAndVertices(m_octDA, elemType, idx);       
-  int ***Aijk = (int ***)m_stencil;
-  
   alignElementAndVertices(m_octDA, elemType, idx);       
 
+  // -h/192 * Aijk[elemType]
+  const double *S = getCachedStencil(elemType, lev);
+
   PetscScalar *nuarray = (PetscScalar *)m_nuarray;
   for (int k = 0;k < 8;k++) {
+    double val = 0.0;
     for (int j=0;j<8;j++) {
-		double fac1 = nuarray[idx[k]]*fac11;
-      out[m_uiDof*idx[k]] +=  (fac1*(Aijk[elemType][k][j]))*in[m_uiDof*idx[j]];
-		
-      // if(hangingMask) std::cout << fac1*Aijk[elemType][k][j] << " " ;
+      val += S[8*k + j]*in[m_uiDof*idx[j]];
     }//end for j
-	 //	 if(hangingMask) std::cout << std::endl;
+    out[m_uiDof*idx[k]] += (nuarray[idx[k]]*scale)*val;
+  }//end for k
+  return true;
+}
+
+bool stiffnessMatrix::ElementalMatVec(const ot::ElementLoop & loop, unsigned int pos, PetscScalar *in, PetscScalar *out, double scale) {
+  unsigned int lev = m_octDA->getLevel(loop.getElement(pos));
+
+  stdElemType elemType;
+  unsigned int idx[8];
+
+  alignElementAndVertices(m_octDA, loop, pos, elemType, idx);
+
+  const double *S = getCachedStencil(elemType, lev);
+
+  PetscScalar *nuarray = (PetscScalar *)m_nuarray;
+  for (int k = 0;k < 8;k++) {
+    double val = 0.0;
+    for (int j=0;j<8;j++) {
+      val += S[8*k + j]*in[m_uiDof*idx[j]];
+    }//end for j
+    out[m_uiDof*idx[k]] += (nuarray[idx[k]]*scale)*val;
   }//end for k
-  //  if(hangingMask) std::cout << " /* ********************************************************************** */" << std::endl;
   return true;
 }
 
@@ -371,30 +427,55 @@ bool stiffnessMatrix::ElementalMatGetDiagonal(int i, int j, int k, PetscScalar *
 
 bool stiffnessMatrix::ElementalMatGetDiagonal(unsigned int i, PetscScalar *diag, double scale) {
   unsigned int lev = m_octDA->getLevel(i);
-  double hx = xFac*(1<<(maxD - lev));
-  //double hy = yFac*(1<<(maxD - lev));
-  //double hz = zFac*(1<<(maxD - lev));
 
-  double fac11 = -hx*scale/192.0;
-  
   stdElemType elemType;
   unsigned int idx[8];
 
-  // unsigned char hangingMask = m_octDA->getHangingNodeIndex(i);    //  alignElementAndVertices(m_octDA, elemType, idx);       
-  int ***Aijk = (int ***)m_stencil;
-  
   alignElementAndVertices(m_octDA, elemType, idx);       
 
+  const double *S = getCachedStencil(elemType, lev);
+
   PetscScalar *nuarray = (PetscScalar *)m_nuarray;
   for (int k = 0;k < 8;k++) {
-    double fac1 = nuarray[idx[k]]*fac11;
-    diag[m_uiDof*idx[k]] +=  (fac1*(Aijk[elemType][k][k]));
+    diag[m_uiDof*idx[k]] += (nuarray[idx[k]]*scale)*S[9*k];
   }//end for k
 
   return true;
 }
 
 bool stiffnessMatrix::ElementalMatVec(PetscScalar* in_local, PetscScalar* out_local, PetscScalar* coords, double scale) {
+  // the element is regular, the vertices are in the order of coords.
+  // The local values do not carry the node indices, so nu can not be applied
+  // per node as in the octree ElementalMatVec(). Only a constant nu is supported,
+  // the callers check localKernelsSupported().
+  assert(m_bConstantNu);
+  double hx = coords[3] - coords[0];
+
+  double fac = -m_nuval*hx*scale/192.0;
+
+  for (int k = 0;k < 8;k++) {
+    for (int j=0;j<8;j++) {
+      for (unsigned int d = 0; d < m_uiDof; d++) {
+        out_local[m_uiDof*k + d] += fac*m_dStencil[8*k + j]*in_local[m_uiDof*j + d];
+      }
+    }//end for j
+  }//end for k
+
+  return true;
+}
+
+bool stiffnessMatrix::ElementalMatVecBatch(PetscScalar* in_local, PetscScalar* out_local, PetscScalar* coords, unsigned int numElems, double scale) {
+  // structure of arrays, the elements of the batch are the SIMD lanes.
+  // nu must be constant, see ElementalMatVec(in_local, ...).
+  assert(m_bConstantNu);
+  double fac[FE_ELEMENT_BATCH_SIZE];
+  for (unsigned int e = 0; e < numElems; e++) {
+    double hx = coords[3*FE_ELEMENT_BATCH_SIZE + e] - coords[e];
+    fac[e] = -m_nuval*hx*scale/192.0;
+  }
+
+  ot::stencilMatVecBatch(m_dStencil, fac, in_local, out_local, m_uiDof, numElems, FE_ELEMENT_BATCH_SIZE);
+
   return true;
 }
 
@@ -0,0 +1,94 @@
+/*
+ * @author: Milinda Fernando
+ * School of Computing, University of Utah
+ *
+ * Checks the balanced octree of the sequential tree sort (TS_BALANCE_OCTREE, which uses
+ * SFC::seqSort::SFC_bottomUpBalance) against ot::balanceOctree on the constructed octree and reports the time of the
+ * auxiliary octant creation (SFC::seqSort::SFC_bottomUpBalOctantCreation) and of both balancing approaches.
+ *
+ * usage: tstBalOctantCreation numPts maxDepth
+ *
+ * */
+
+#include "mpi.h"
+#include <iostream>
+#include <vector>
+#include <omp.h>
+
+#include "TreeNode.h"
+#include "genPts_par.h"
+#include "sfcSort.h"
+#include "octUtils.h"
+#include "colors.h"
+#include "externVars.h"
+
+
+int main(int argc, char **argv) {
+
+    MPI_Init(&argc, &argv);
+
+    if (argc < 3) {
+        std::cerr << "Usage: " << argv[0] << " numPts maxDepth" << std::endl;
+        MPI_Finalize();
+        return -1;
+    }
+
+    DendroIntL numPts = atol(argv[1]);
+    unsigned int maxDepth = atoi(argv[2]);
+    unsigned int dim = m_uiDim;
+
+    _InitializeHcurve(dim);
+
+    std::vector<double> pts;
+    genGauss(0.1, numPts, dim, pts);
+
+    std::vector<ot::TreeNode> input;
+    pts2Octants(input, &(*(pts.begin())), pts.size(), dim, maxDepth);
+    pts.clear();
+
+    ot::TreeNode root(0, 0, 0, 0, dim, maxDepth);
+
+    std::vector<ot::TreeNode> tmpNodes = input;
+    std::vector<ot::TreeNode> tmpSorted, construct, tmpBalanced;
+    SFC::seqSort::SFC_treeSort(&(*(tmpNodes.begin())), tmpNodes.size(), tmpSorted, construct, tmpBalanced,
+                               maxDepth, maxDepth, root, ROOT_ROTATION, 1, TS_CONSTRUCT_OCTREE);
+    tmpNodes.clear();
+    tmpSorted.clear();
+    tmpBalanced.clear();
+
+    // auxiliary octants of the constructed octree
+    std::vector<ot::TreeNode> auxOct = construct;
+    double t_aux = omp_get_wtime();
+    SFC::seqSort::SFC_bottomUpBalOctantCreation(auxOct);
+    t_aux = omp_get_wtime() - t_aux;
+
+    std::vector<ot::TreeNode> sfcSorted, sfcConstruct, sfcBalanced;
+    tmpNodes = input;
+    double t_sfc = omp_get_wtime();
+    SFC::seqSort::SFC_treeSort(&(*(tmpNodes.begin())), tmpNodes.size(), sfcSorted, sfcConstruct, sfcBalanced,
+                               maxDepth, maxDepth, root, ROOT_ROTATION, 1, TS_BALANCE_OCTREE);
+    t_sfc = omp_get_wtime() - t_sfc;
+    tmpNodes.clear();
+
+    std::vector<ot::TreeNode> balanced;
+    double t_bal = omp_get_wtime();
+    ot::balanceOctree(construct, balanced, dim, maxDepth, true, MPI_COMM_SELF, NULL, NULL);
+    t_bal = omp_get_wtime() - t_bal;
+
+    bool state = (sfcBalanced.size() == balanced.size());
+    for (unsigned int i = 0; state && (i < balanced.size()); i++)
+        state = (sfcBalanced[i] == balanced[i]);
+
+    std::cout << " number of octants: " << input.size() << " threads: " << omp_get_max_threads()
+              << " octants with auxiliary: " << auxOct.size() << " balanced: " << balanced.size() << std::endl;
+    if (state)
+        std::cout << GRN << " balance : PASSED " << NRM;
+    else
+        std::cout << RED << " balance : FAILED " << NRM;
+    std::cout << " aux octants (s): " << t_aux << " treeSort balance (s): " << t_sfc << " balanceOctree (s): " << t_bal
+              << std::endl;
+
+    MPI_Finalize();
+    return (state) ? 0 : 1;
+
+}
@@ -0,0 +1,139 @@
+/*
+ * @author: Milinda Fernando
+ * School of Computing, University of Utah
+ *
+ * Builds ot::DA twice from the same octree, once with the binary search and once with the hashed positive search in
+ * DA::buildNodeList (see ot::DA_setHashNodeList), compares the element to node maps and the hanging node masks of
+ * the ALL loop and prints the time of both DA constructions (most of it is DA::buildNodeList).
+ *
+ * usage: tstBuildNlist numPts maxDepth
+ *
+ * */
+
+#include "mpi.h"
+#include "petsc.h"
+#include "sys.h"
+#include <iostream>
+#include <vector>
+
+#include "TreeNode.h"
+#include "genPts_par.h"
+#include "sfcSort.h"
+#include "oda.h"
+#include "colors.h"
+#include "externVars.h"
+#include "dendro.h"
+
+
+int main(int argc, char **argv) {
+
+    PetscInitialize(&argc, &argv, "options", NULL);
+    ot::RegisterEvents();
+    ot::DA_Initialize(MPI_COMM_WORLD);
+
+    int rank, npes;
+    MPI_Comm comm = MPI_COMM_WORLD;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &npes);
+
+    if (argc < 3) {
+        if (!rank)
+            std::cerr << "Usage: " << argv[0] << " numPts maxDepth" << std::endl;
+        ot::DA_Finalize();
+        PetscFinalize();
+        return -1;
+    }
+
+    DendroIntL numPts = atol(argv[1]);
+    unsigned int maxDepth = atoi(argv[2]);
+    unsigned int dim = m_uiDim;
+
+    _InitializeHcurve(dim);
+
+    std::vector<double> pts;
+    genGauss(0.1, numPts, dim, pts);
+
+    std::vector<ot::TreeNode> tmpNodes;
+    pts2Octants(tmpNodes, &(*(pts.begin())), pts.size(), dim, maxDepth);
+    pts.clear();
+
+    std::vector<ot::TreeNode> tmpSorted, tmpConstruct, balOct;
+    ot::TreeNode root(0, 0, 0, 0, dim, maxDepth);
+    SFC::parSort::SFC_treeSort(tmpNodes, tmpSorted, tmpConstruct, balOct, 0.1, maxDepth, root, ROOT_ROTATION, 1,
+                               TS_BALANCE_OCTREE, NUM_NPES_THRESHOLD, comm);
+    tmpNodes.clear();
+    tmpSorted.clear();
+    tmpConstruct.clear();
+
+    DendroIntL localSz = balOct.size(), globalSz;
+    par::Mpi_Allreduce(&localSz, &globalSz, 1, MPI_SUM, comm);
+
+    // the DA constructor modifies its input ...
+    std::vector<ot::TreeNode> balOctHash(balOct);
+
+    MPI_Barrier(comm);
+    double t[2];
+    t[0] = MPI_Wtime();
+    ot::DA_setHashNodeList(false);
+    ot::DA daSearch(balOct, comm, comm, false);
+    t[0] = MPI_Wtime() - t[0];
+    balOct.clear();
+
+    MPI_Barrier(comm);
+    t[1] = MPI_Wtime();
+    ot::DA_setHashNodeList(true);
+    ot::DA daHash(balOctHash, comm, comm, false);
+    t[1] = MPI_Wtime() - t[1];
+    balOctHash.clear();
+
+    // the element to node maps (the DAs are not compressed) and the masks of the elements of this processor
+    DendroIntL numElems = 0, numDiffs = 0;
+    if (daSearch.iAmActive() != daHash.iAmActive()) {
+        numDiffs++;
+    } else if (daSearch.iAmActive()) {
+#ifdef HILBERT_ORDERING
+        daSearch.computeHilbertRotations();
+        daHash.computeHilbertRotations();
+#endif
+        if ((daSearch.getLocalBufferSize() != daHash.getLocalBufferSize()) ||
+            (daSearch.getElementSize() != daHash.getElementSize())) {
+            numDiffs++;
+        }
+        daHash.init<ot::DA_FLAGS::ALL>();
+        for (daSearch.init<ot::DA_FLAGS::ALL>(); (daSearch.curr() < daSearch.end<ot::DA_FLAGS::ALL>()) &&
+             (daHash.curr() < daHash.end<ot::DA_FLAGS::ALL>());
+             daSearch.next<ot::DA_FLAGS::ALL>(), daHash.next<ot::DA_FLAGS::ALL>()) {
+            unsigned int idxSearch[8], idxHash[8];
+            daSearch.getNodeIndices(idxSearch);
+            daHash.getNodeIndices(idxHash);
+            bool same = (daSearch.curr() == daHash.curr()) &&
+                        (daSearch.getHangingNodeIndex(daSearch.curr()) == daHash.getHangingNodeIndex(daHash.curr()));
+            for (unsigned int j = 0; j < 8; j++)
+                same = same && (idxSearch[j] == idxHash[j]);
+            if (!same) numDiffs++;
+            numElems++;
+        }
+        if ((daSearch.curr() < daSearch.end<ot::DA_FLAGS::ALL>()) || (daHash.curr() < daHash.end<ot::DA_FLAGS::ALL>()))
+            numDiffs++;
+    }
+
+    DendroIntL local[2] = {numElems, numDiffs}, global[2];
+    double tMax[2];
+    par::Mpi_Reduce<DendroIntL>(local, global, 2, MPI_SUM, 0, comm);
+    par::Mpi_Reduce<double>(t, tMax, 2, MPI_MAX, 0, comm);
+
+    if (!rank) {
+        if (global[1]) {
+            std::cout << RED << " buildNodeList : FAILED " << NRM;
+        } else {
+            std::cout << GRN << " buildNodeList : PASSED " << NRM;
+        }
+        std::cout << " octants: " << globalSz << " elements: " << global[0] << " differences: " << global[1]
+                  << " DA construction (s) binary search: " << tMax[0] << " hash: " << tMax[1] << std::endl;
+    }
+
+    ot::DA_Finalize();
+    PetscFinalize();
+    return 0;
+
+}
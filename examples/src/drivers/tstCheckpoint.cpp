@@ -0,0 +1,136 @@
+/*
+ * @author: Milinda Fernando
+ * School of Computing, University of Utah
+ *
+ * Checks the binary octree checkpoint (writeNodesToCheckpoint, readNodesFromCheckpoint). The balanced octree is
+ * written with collective MPI-IO and read back with mmap on all the processors (the partition of the writer must
+ * be restored) and on about half of them (restart on a different number of processors, the slices must be
+ * globally sorted and hold all the octants). Reports the time of the write and the read.
+ *
+ * usage: tstCheckpoint numPts maxDepth fileName
+ *
+ * */
+
+#include "mpi.h"
+#include "petsc.h"
+#include "sys.h"
+#include <iostream>
+#include <vector>
+
+#include "TreeNode.h"
+#include "genPts_par.h"
+#include "sfcSort.h"
+#include "octUtils.h"
+#include "testUtils.h"
+#include "colors.h"
+#include "externVars.h"
+#include "dendro.h"
+
+
+// Order independent checksum of the octants of all the processors of comm.
+unsigned long long checksum(const std::vector<ot::TreeNode> &nodes, MPI_Comm comm)
+{
+    unsigned long long local = 0, global;
+    for (unsigned int i = 0; i < nodes.size(); i++) {
+        unsigned long long h = nodes[i].getX();
+        h = h * 1000003ull + nodes[i].getY();
+        h = h * 1000003ull + nodes[i].getZ();
+        h = h * 1000003ull + nodes[i].getFlag();
+        local += h * 0x9E3779B97F4A7C15ull;
+    }
+    MPI_Allreduce(&local, &global, 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM, comm);
+    return global;
+}
+
+int main(int argc, char **argv) {
+
+    PetscInitialize(&argc, &argv, "options", NULL);
+    ot::RegisterEvents();
+
+    int rank, npes;
+    MPI_Comm comm = MPI_COMM_WORLD;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &npes);
+
+    if (argc < 4) {
+        if (!rank)
+            std::cerr << "Usage: " << argv[0] << " numPts maxDepth fileName" << std::endl;
+        PetscFinalize();
+        return -1;
+    }
+
+    DendroIntL numPts = atol(argv[1]);
+    unsigned int maxDepth = atoi(argv[2]);
+    const char *fileName = argv[3];
+    unsigned int dim = m_uiDim;
+
+    _InitializeHcurve(dim);
+
+    std::vector<double> pts;
+    genGauss(0.1, numPts, dim, pts);
+
+    std::vector<ot::TreeNode> tmpNodes;
+    pts2Octants(tmpNodes, &(*(pts.begin())), pts.size(), dim, maxDepth);
+    pts.clear();
+
+    std::vector<ot::TreeNode> tmpSorted, tmpConstruct, balOct;
+    ot::TreeNode root(0, 0, 0, 0, dim, maxDepth);
+    SFC::parSort::SFC_treeSort(tmpNodes, tmpSorted, tmpConstruct, balOct, 0.1, maxDepth, root, ROOT_ROTATION, 1,
+                               TS_BALANCE_OCTREE, NUM_NPES_THRESHOLD, comm);
+    tmpNodes.clear();
+    tmpSorted.clear();
+    tmpConstruct.clear();
+
+    DendroIntL localSz = balOct.size(), globalSz;
+    par::Mpi_Allreduce(&localSz, &globalSz, 1, MPI_SUM, comm);
+    const unsigned long long sum = checksum(balOct, comm);
+
+    double t[3];
+    MPI_Barrier(comm);
+    t[0] = MPI_Wtime();
+    int err = ot::writeNodesToCheckpoint(fileName, balOct, comm);
+    MPI_Barrier(comm);
+    t[0] = MPI_Wtime() - t[0];
+
+    // same number of processors: the partition of the writer
+    std::vector<ot::TreeNode> readOct;
+    t[1] = MPI_Wtime();
+    err = ot::readNodesFromCheckpoint(fileName, readOct, comm) || err;
+    t[1] = MPI_Wtime() - t[1];
+
+    bool state = (!err) && (readOct == balOct);
+    bool sameState;
+    MPI_Allreduce(&state, &sameState, 1, MPI_CXX_BOOL, MPI_LAND, comm);
+
+    // restart on the first (npes+1)/2 processors
+    MPI_Comm subComm;
+    const int color = (rank < (npes + 1) / 2) ? 0 : 1;
+    MPI_Comm_split(comm, color, rank, &subComm);
+    bool restartState = true;
+    if (!color) {
+        int subNpes;
+        MPI_Comm_size(subComm, &subNpes);
+        t[2] = MPI_Wtime();
+        err = ot::readNodesFromCheckpoint(fileName, readOct, subComm);
+        t[2] = MPI_Wtime() - t[2];
+
+        DendroIntL readSz = readOct.size(), readGlobalSz;
+        par::Mpi_Allreduce(&readSz, &readGlobalSz, 1, MPI_SUM, subComm);
+        restartState = (!err) && (readGlobalSz == globalSz) && (checksum(readOct, subComm) == sum) &&
+                       par::test::isUniqueAndSorted(readOct, subComm);
+
+        if (!rank) {
+            std::cout << (sameState ? GRN : RED) << " same npes : " << (sameState ? "PASSED " : "FAILED ") << NRM
+                      << " octants: " << globalSz << " write (s): " << t[0] << " read (s): " << t[1] << std::endl;
+            std::cout << (restartState ? GRN : RED) << " restart on " << subNpes << " of " << npes << " : "
+                      << (restartState ? "PASSED " : "FAILED ") << NRM << " read (s): " << t[2] << std::endl;
+        }
+    }
+    MPI_Comm_free(&subComm);
+
+    MPI_Bcast(&restartState, 1, MPI_CXX_BOOL, 0, comm);
+
+    PetscFinalize();
+    return (sameState && restartState) ? 0 : 1;
+
+}
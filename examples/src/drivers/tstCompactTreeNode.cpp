@@ -0,0 +1,136 @@
+/*
+ * @author: Milinda Fernando
+ * School of Computing, University of Utah
+ *
+ * Runs the parallel SFC_treeSort (sort, remove duplicates, construction, balancing) and SFC_PartitionW on
+ * ot::TreeNode and on the 16 byte ot::CompactTreeNode and checks that both give the same octants.
+ * Reports the times and the memory per octant.
+ *
+ * usage: tstCompactTreeNode numPts maxDepth loadFlexibility
+ *
+ * */
+
+#include "mpi.h"
+#include <iostream>
+#include <vector>
+
+#include "TreeNode.h"
+#include "compactTreeNode.h"
+#include "genPts_par.h"
+#include "sfcSort.h"
+#include "colors.h"
+#include "externVars.h"
+
+
+bool compareOctants(const std::vector<ot::TreeNode> &a, const std::vector<ot::CompactTreeNode> &b, MPI_Comm comm)
+{
+    bool state = (a.size() == b.size());
+    for (unsigned int i = 0; state && i < a.size(); i++)
+        state = (a[i] == b[i].toTreeNode());
+
+    bool state_g;
+    MPI_Allreduce(&state, &state_g, 1, MPI_CXX_BOOL, MPI_LAND, comm);
+    return state_g;
+}
+
+int main(int argc, char **argv) {
+
+    MPI_Init(&argc, &argv);
+
+    int rank, npes;
+    MPI_Comm comm = MPI_COMM_WORLD;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &npes);
+
+    if (argc < 3) {
+        if (!rank)
+            std::cerr << "Usage: " << argv[0] << " numPts maxDepth loadFlexibility(optional)" << std::endl;
+        MPI_Finalize();
+        return -1;
+    }
+
+    DendroIntL numPts = atol(argv[1]);
+    unsigned int maxDepth = atoi(argv[2]);
+    double loadFlexibility = 0.1;
+    if (argc > 3) loadFlexibility = atof(argv[3]);
+    unsigned int dim = m_uiDim;
+
+    _InitializeHcurve(dim);
+
+    std::vector<double> pts;
+    genGauss(0.1, numPts, dim, pts);
+
+    std::vector<ot::TreeNode> input;
+    pts2Octants(input, &(*(pts.begin())), pts.size(), dim, maxDepth);
+    pts.clear();
+
+    std::vector<ot::CompactTreeNode> compactInput;
+    ot::toCompactTreeNodes(input, compactInput);
+
+    if (!rank)
+        std::cout << " sizeof(TreeNode): " << sizeof(ot::TreeNode) << " sizeof(CompactTreeNode): "
+                  << sizeof(ot::CompactTreeNode) << std::endl;
+
+    ot::TreeNode root(0, 0, 0, 0, dim, maxDepth);
+    ot::CompactTreeNode compactRoot(0, 0, 0, 0, dim, maxDepth);
+    const unsigned int options[] = {TS_SORT_ONLY, TS_REMOVE_DUPLICATES, TS_CONSTRUCT_OCTREE, TS_BALANCE_OCTREE};
+    const char *optionNames[] = {"sort", "removeDuplicates", "construct", "balance"};
+    bool allPassed = true;
+
+    for (unsigned int w = 0; w < 4; w++) {
+
+        std::vector<ot::TreeNode> nodes = input;
+        std::vector<ot::TreeNode> sorted, construct, balanced;
+        std::vector<ot::CompactTreeNode> cNodes = compactInput;
+        std::vector<ot::CompactTreeNode> cSorted, cConstruct, cBalanced;
+
+        MPI_Barrier(comm);
+        double t_tn = MPI_Wtime();
+        SFC::parSort::SFC_treeSort(nodes, sorted, construct, balanced, loadFlexibility, maxDepth, root,
+                                   ROOT_ROTATION, 1, options[w], NUM_NPES_THRESHOLD, comm);
+        t_tn = MPI_Wtime() - t_tn;
+
+        MPI_Barrier(comm);
+        double t_cn = MPI_Wtime();
+        SFC::parSort::SFC_treeSort(cNodes, cSorted, cConstruct, cBalanced, loadFlexibility, maxDepth, compactRoot,
+                                   ROOT_ROTATION, 1, options[w], NUM_NPES_THRESHOLD, comm);
+        t_cn = MPI_Wtime() - t_cn;
+
+        bool state = compareOctants(sorted, cSorted, comm) && compareOctants(construct, cConstruct, comm) &&
+                     compareOctants(balanced, cBalanced, comm);
+        allPassed = allPassed && state;
+
+        double t_max[2], t_loc[2] = {t_tn, t_cn};
+        MPI_Reduce(t_loc, t_max, 2, MPI_DOUBLE, MPI_MAX, 0, comm);
+
+        if (!rank) {
+            if (state)
+                std::cout << GRN << " " << optionNames[w] << " : PASSED " << NRM;
+            else
+                std::cout << RED << " " << optionNames[w] << " : FAILED " << NRM;
+            std::cout << " TreeNode (s): " << t_max[0] << " CompactTreeNode (s): " << t_max[1] << std::endl;
+        }
+
+    }
+
+#ifdef SPLITTER_SELECTION_FIX
+    {
+        std::vector<ot::TreeNode> nodes = input;
+        std::vector<ot::CompactTreeNode> cNodes = compactInput;
+        SFC::parSort::SFC_PartitionW(nodes, loadFlexibility, maxDepth, comm);
+        SFC::parSort::SFC_PartitionW(cNodes, loadFlexibility, maxDepth, comm);
+        bool state = compareOctants(nodes, cNodes, comm);
+        allPassed = allPassed && state;
+        if (!rank) {
+            if (state)
+                std::cout << GRN << " partitionW : PASSED " << NRM << std::endl;
+            else
+                std::cout << RED << " partitionW : FAILED " << NRM << std::endl;
+        }
+    }
+#endif
+
+    MPI_Finalize();
+    return (allPassed) ? 0 : 1;
+
+}
@@ -0,0 +1,241 @@
+/*
+ * @author: Milinda Fernando
+ * School of Computing, University of Utah
+ *
+ * Checks the thread-safe element loops of ot::DA (DA::getElementLoop). The snapshot must visit the same
+ * elements as the serial init/next loop, chunks of the same color must not share nodes, and a threaded
+ * element-to-node scatter over the colored chunks must match the serial one. Reports the time of both scatters.
+ * Building a snapshot in the middle of a serial loop must not change the rest of that loop.
+ *
+ * usage: tstElementLoop numPts maxDepth chunkSize numIterations
+ *
+ * */
+
+#include "mpi.h"
+#include "petsc.h"
+#include "sys.h"
+#include <iostream>
+#include <vector>
+#include <omp.h>
+
+#include "TreeNode.h"
+#include "genPts_par.h"
+#include "sfcSort.h"
+#include "oda.h"
+#include "colors.h"
+#include "externVars.h"
+#include "dendro.h"
+
+
+// Element-to-node scatter with integer weights, so that the result does not depend on the summation order.
+inline void scatterElement(unsigned int elem, unsigned char level, const unsigned int *idx, const double *in, double *out)
+{
+    for (unsigned int k = 0; k < 8; k++)
+        for (unsigned int j = 0; j < 8; j++)
+            out[idx[k]] += ((k + 1) * (j + 1) + level + (elem & 7)) * in[idx[j]];
+}
+
+template<ot::DA_FLAGS::loopType type>
+bool checkLoop(ot::DA &da, const char *name, unsigned int chunkSize, unsigned int numIter, int rank)
+{
+    MPI_Comm comm = da.getCommActive();
+    const unsigned int sz = da.getLocalBufferSize();
+
+    std::vector<double> in(sz), outSerial(sz, 0.0), outThreaded(sz, 0.0);
+    for (unsigned int i = 0; i < sz; i++)
+        in[i] = (i % 13);
+
+    const ot::ElementLoop &loop = da.getElementLoop<type>(chunkSize);
+
+    // the snapshot visits the same elements as the serial loop
+    bool snapshotState = true;
+    unsigned int pos = 0;
+    unsigned int idx[8], sIdx[8];
+    for (da.init<type>(); da.curr() < da.end<type>(); da.next<type>(), pos++) {
+        if ((pos >= loop.getNumElements()) || (loop.getElement(pos) != da.curr()) ||
+            (loop.getChildNumber(pos) != da.getChildNumber())) {
+            snapshotState = false;
+            break;
+        }
+        da.getNodeIndices(idx);
+        loop.getNodeIndices(pos, sIdx);
+        for (unsigned int j = 0; j < 8; j++)
+            snapshotState = snapshotState && (idx[j] == sIdx[j]);
+    }
+    snapshotState = snapshotState && (pos == loop.getNumElements());
+
+    // chunks of the same color do not share nodes
+    bool colorState = true;
+    std::vector<unsigned int> owner(sz, (unsigned int) (-1));
+    for (unsigned int color = 0; color < loop.getNumColors(); color++) {
+        for (unsigned int c = loop.colorOffsets[color]; c < loop.colorOffsets[color + 1]; c++) {
+            const unsigned int chunk = loop.colorChunks[c];
+            for (unsigned int p = loop.chunkBegin(chunk); p < loop.chunkEnd(chunk); p++) {
+                loop.getNodeIndices(p, idx);
+                for (unsigned int j = 0; j < 8; j++) {
+                    if ((owner[idx[j]] != (unsigned int) (-1)) && (owner[idx[j]] != chunk))
+                        colorState = false;
+                    owner[idx[j]] = chunk;
+                }
+            }
+        }
+        owner.assign(sz, (unsigned int) (-1));
+    }
+
+    double t[2];
+    MPI_Barrier(comm);
+    t[0] = MPI_Wtime();
+    for (unsigned int it = 0; it < numIter; it++) {
+        for (da.init<type>(); da.curr() < da.end<type>(); da.next<type>()) {
+            da.getNodeIndices(idx);
+            scatterElement(da.curr(), da.getLevel(da.curr()), idx, &(*(in.begin())), &(*(outSerial.begin())));
+        }
+    }
+    t[0] = (MPI_Wtime() - t[0]) / numIter;
+
+    MPI_Barrier(comm);
+    t[1] = MPI_Wtime();
+    for (unsigned int it = 0; it < numIter; it++) {
+        for (unsigned int color = 0; color < loop.getNumColors(); color++) {
+            const int cBegin = loop.colorOffsets[color];
+            const int cEnd = loop.colorOffsets[color + 1];
+#pragma omp parallel for schedule(dynamic)
+            for (int c = cBegin; c < cEnd; c++) {
+                const unsigned int chunk = loop.colorChunks[c];
+                unsigned int tIdx[8];
+                for (unsigned int p = loop.chunkBegin(chunk); p < loop.chunkEnd(chunk); p++) {
+                    loop.getNodeIndices(p, tIdx);
+                    scatterElement(loop.getElement(p), da.getLevel(loop.getElement(p)), tIdx, &(*(in.begin())),
+                                   &(*(outThreaded.begin())));
+                }
+            }
+        }
+    }
+    t[1] = (MPI_Wtime() - t[1]) / numIter;
+
+    bool scatterState = (outSerial == outThreaded);
+
+    bool state = snapshotState && colorState && scatterState;
+    bool state_g;
+    MPI_Allreduce(&state, &state_g, 1, MPI_CXX_BOOL, MPI_LAND, comm);
+
+    double t_max[2];
+    MPI_Reduce(t, t_max, 2, MPI_DOUBLE, MPI_MAX, 0, comm);
+
+    if (!rank) {
+        std::cout << (state_g ? GRN : RED) << " " << name << " : " << (state_g ? "PASSED " : "FAILED ") << NRM
+                  << " elements: " << loop.getNumElements() << " chunks: " << loop.getNumChunks() << " colors: "
+                  << loop.getNumColors() << " serial (s): " << t_max[0] << " threaded (s): " << t_max[1]
+                  << std::endl;
+    }
+
+    return state_g;
+}
+
+// Builds the W_DEPENDENT snapshot halfway through an ALL loop, the remaining elements of the ALL loop (index,
+// child number and anchor) must be the same as without the snapshot.
+bool checkSnapshotInLoop(ot::DA &da, unsigned int chunkSize, int rank)
+{
+    std::vector<unsigned int> ref;
+    for (da.init<ot::DA_FLAGS::ALL>(); da.curr() < da.end<ot::DA_FLAGS::ALL>(); da.next<ot::DA_FLAGS::ALL>()) {
+        Point pt = da.getCurrentOffset();
+        ref.push_back(da.curr());
+        ref.push_back(da.getChildNumber());
+        ref.push_back(pt.xint());
+        ref.push_back(pt.yint());
+        ref.push_back(pt.zint());
+    }
+
+    bool state = true;
+    unsigned int pos = 0;
+    const unsigned int half = (ref.size() / 5) / 2;
+    for (da.init<ot::DA_FLAGS::ALL>(); da.curr() < da.end<ot::DA_FLAGS::ALL>(); da.next<ot::DA_FLAGS::ALL>(), pos++) {
+        if (pos == half)
+            da.getElementLoop<ot::DA_FLAGS::W_DEPENDENT>(chunkSize);
+        Point pt = da.getCurrentOffset();
+        if ((5 * pos + 4 >= ref.size()) || (ref[5 * pos] != da.curr()) ||
+            (ref[5 * pos + 1] != da.getChildNumber()) || (ref[5 * pos + 2] != pt.xint()) ||
+            (ref[5 * pos + 3] != pt.yint()) || (ref[5 * pos + 4] != pt.zint())) {
+            state = false;
+            break;
+        }
+    }
+    state = state && (5 * pos == ref.size());
+
+    bool state_g;
+    MPI_Allreduce(&state, &state_g, 1, MPI_CXX_BOOL, MPI_LAND, da.getCommActive());
+    if (!rank)
+        std::cout << (state_g ? GRN : RED) << " snapshot inside a loop : " << (state_g ? "PASSED " : "FAILED ") << NRM
+                  << std::endl;
+    return state_g;
+}
+
+int main(int argc, char **argv) {
+
+    PetscInitialize(&argc, &argv, "options", NULL);
+    ot::RegisterEvents();
+    ot::DA_Initialize(MPI_COMM_WORLD);
+
+    int rank, npes;
+    MPI_Comm comm = MPI_COMM_WORLD;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &npes);
+
+    if (argc < 3) {
+        if (!rank)
+            std::cerr << "Usage: " << argv[0] << " numPts maxDepth chunkSize(optional) numIterations(optional)"
+                      << std::endl;
+        ot::DA_Finalize();
+        PetscFinalize();
+        return -1;
+    }
+
+    DendroIntL numPts = atol(argv[1]);
+    unsigned int maxDepth = atoi(argv[2]);
+    unsigned int chunkSize = DA_ELEMENT_LOOP_CHUNK_SIZE;
+    unsigned int numIter = 10;
+    if (argc > 3) chunkSize = atoi(argv[3]);
+    if (argc > 4) numIter = atoi(argv[4]);
+    unsigned int dim = m_uiDim;
+
+    _InitializeHcurve(dim);
+
+    std::vector<double> pts;
+    genGauss(0.1, numPts, dim, pts);
+
+    std::vector<ot::TreeNode> tmpNodes;
+    pts2Octants(tmpNodes, &(*(pts.begin())), pts.size(), dim, maxDepth);
+    pts.clear();
+
+    std::vector<ot::TreeNode> tmpSorted, tmpConstruct, balOct;
+    ot::TreeNode root(0, 0, 0, 0, dim, maxDepth);
+    SFC::parSort::SFC_treeSort(tmpNodes, tmpSorted, tmpConstruct, balOct, 0.1, maxDepth, root, ROOT_ROTATION, 1,
+                               TS_BALANCE_OCTREE, NUM_NPES_THRESHOLD, comm);
+    tmpNodes.clear();
+    tmpSorted.clear();
+    tmpConstruct.clear();
+
+    ot::DA da(balOct, comm, comm, false);
+    balOct.clear();
+
+    bool allPassed = true;
+
+    if (da.iAmActive()) {
+#ifdef HILBERT_ORDERING
+        da.computeHilbertRotations();
+#endif
+        if (!rank)
+            std::cout << " threads: " << omp_get_max_threads() << " chunkSize: " << chunkSize << std::endl;
+
+        allPassed = checkLoop<ot::DA_FLAGS::INDEPENDENT>(da, "INDEPENDENT", chunkSize, numIter, rank) && allPassed;
+        allPassed = checkLoop<ot::DA_FLAGS::DEPENDENT>(da, "DEPENDENT", chunkSize, numIter, rank) && allPassed;
+        allPassed = checkLoop<ot::DA_FLAGS::WRITABLE>(da, "WRITABLE", chunkSize, numIter, rank) && allPassed;
+        allPassed = checkLoop<ot::DA_FLAGS::ALL>(da, "ALL", chunkSize, numIter, rank) && allPassed;
+        allPassed = checkSnapshotInLoop(da, chunkSize, rank) && allPassed;
+    }
+
+    ot::DA_Finalize();
+    PetscFinalize();
+    return (allPassed) ? 0 : 1;
+
+}
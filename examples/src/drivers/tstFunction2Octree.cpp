@@ -0,0 +1,140 @@
+/*
+ * @author: Milinda Fernando
+ * School of Computing, University of Utah
+ *
+ * Checks the distributed function2Octree with the distance function of a sphere. The octree must match the one of
+ * a sequential level by level refinement (evaluating fx at the 8 corners of every octant), it must be globally
+ * sorted, and it reports the number of evaluations of fx (with and without the corner cache) and the load balance.
+ *
+ * usage: tstFunction2Octree maxDepth radius rejectInterior
+ *
+ * */
+
+#include "mpi.h"
+#include "petsc.h"
+#include "sys.h"
+#include <iostream>
+#include <vector>
+#include <cmath>
+
+#include "TreeNode.h"
+#include "octUtils.h"
+#include "testUtils.h"
+#include "colors.h"
+#include "externVars.h"
+#include "dendro.h"
+
+
+// Order independent checksum of the octants of all the processors of comm.
+unsigned long long checksum(const std::vector<ot::TreeNode> &nodes, MPI_Comm comm)
+{
+    unsigned long long local = 0, global;
+    for (unsigned int i = 0; i < nodes.size(); i++) {
+        unsigned long long h = nodes[i].getX();
+        h = h * 1000003ull + nodes[i].getY();
+        h = h * 1000003ull + nodes[i].getZ();
+        h = h * 1000003ull + nodes[i].getLevel();
+        local += h * 0x9E3779B97F4A7C15ull;
+    }
+    MPI_Allreduce(&local, &global, 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM, comm);
+    return global;
+}
+
+// The sequential level by level refinement, fx is evaluated at all the corners of every octant.
+void referenceOctree(std::function<double(double, double, double)> fx, std::vector<ot::TreeNode> &nodes,
+                     unsigned int d_max, bool reject_interior, unsigned long long &numEvals)
+{
+    const unsigned int maxDepth = 30;
+    const double h = 1.0 / (1 << maxDepth);
+    std::vector<ot::TreeNode> front, next, siblings;
+    ot::TreeNode(3, maxDepth).addChildren(front);
+    numEvals = 0;
+    nodes.clear();
+    for (unsigned int depth = 1; (!front.empty()) && (depth < d_max); depth++) {
+        next.clear();
+        for (unsigned int i = 0; i < front.size(); i++) {
+            const double h1 = h * (1 << (maxDepth - depth));
+            unsigned int numInside = 0;
+            for (unsigned int j = 0; j < 8; j++)
+                numInside += (fx(front[i].getX() * h + ((j & 1u) ? h1 : 0.0), front[i].getY() * h + ((j & 2u) ? h1 : 0.0),
+                                 front[i].getZ() * h + ((j & 4u) ? h1 : 0.0)) < 0.0);
+            numEvals += 8;
+            if ((numInside == 0) || ((numInside == 8) && !reject_interior))
+                nodes.push_back(front[i]);
+            else if (numInside != 8) {
+                // addChildren sorts the whole vector with HILBERT_ORDERING
+                siblings.clear();
+                front[i].addChildren(siblings);
+                next.insert(next.end(), siblings.begin(), siblings.end());
+            }
+        }
+        std::swap(front, next);
+    }
+    nodes.insert(nodes.end(), front.begin(), front.end());
+}
+
+int main(int argc, char **argv) {
+
+    PetscInitialize(&argc, &argv, "options", NULL);
+    ot::RegisterEvents();
+
+    int rank, npes;
+    MPI_Comm comm = MPI_COMM_WORLD;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &npes);
+
+    if (argc < 2) {
+        if (!rank)
+            std::cerr << "Usage: " << argv[0] << " maxDepth radius(optional) rejectInterior(optional)" << std::endl;
+        PetscFinalize();
+        return -1;
+    }
+
+    unsigned int maxDepth = atoi(argv[1]);
+    double r = 0.3;
+    bool rejectInterior = false;
+    if (argc > 2) r = atof(argv[2]);
+    if (argc > 3) rejectInterior = (atoi(argv[3]) != 0);
+
+    _InitializeHcurve(3);
+
+    unsigned long long numEvals = 0;
+    auto fx = [r, &numEvals](double x, double y, double z) -> double {
+#pragma omp atomic
+        numEvals++;
+        return sqrt((x - 0.5) * (x - 0.5) + (y - 0.4) * (y - 0.4) + (z - 0.45) * (z - 0.45)) - r;
+    };
+
+    std::vector<ot::TreeNode> nodes;
+    MPI_Barrier(comm);
+    double t = MPI_Wtime();
+    ot::function2Octree(fx, nodes, maxDepth, rejectInterior, comm);
+    t = MPI_Wtime() - t;
+
+    unsigned long long evals_g;
+    MPI_Reduce(&numEvals, &evals_g, 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM, 0, comm);
+
+    DendroIntL localSz = nodes.size(), globalSz, maxSz;
+    par::Mpi_Allreduce(&localSz, &globalSz, 1, MPI_SUM, comm);
+    par::Mpi_Allreduce(&localSz, &maxSz, 1, MPI_MAX, comm);
+    const unsigned long long sum = checksum(nodes, comm);
+    const bool sorted = par::test::isUniqueAndSorted(nodes, comm);
+
+    bool state = true;
+    if (!rank) {
+        std::vector<ot::TreeNode> refNodes;
+        unsigned long long refEvals;
+        referenceOctree(fx, refNodes, maxDepth, rejectInterior, refEvals);
+        state = sorted && ((DendroIntL) refNodes.size() == globalSz) && (checksum(refNodes, MPI_COMM_SELF) == sum);
+
+        std::cout << (state ? GRN : RED) << " function2Octree : " << (state ? "PASSED " : "FAILED ") << NRM
+                  << " octants: " << globalSz << " (reference: " << refNodes.size() << ") fx evaluations: "
+                  << evals_g << " (reference: " << refEvals << ") max/avg octants: "
+                  << (maxSz * npes) / (double) globalSz << " time (s): " << t << std::endl;
+    }
+    MPI_Bcast(&state, 1, MPI_CXX_BOOL, 0, comm);
+
+    PetscFinalize();
+    return (state) ? 0 : 1;
+
+}
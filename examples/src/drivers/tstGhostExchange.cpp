@@ -0,0 +1,156 @@
+/*
+ * @author: Milinda Fernando
+ * School of Computing, University of Utah
+ *
+ * Checks the persistent ghost exchange of ot::DA (DA::setPersistentGhostExchange) against the default
+ * exchange for ReadFromGhosts and WriteToGhosts and reports the time per ghost update.
+ *
+ * usage: tstGhostExchange numPts maxDepth dof numIterations
+ *
+ * */
+
+#include "mpi.h"
+#include "petsc.h"
+#include "sys.h"
+#include <iostream>
+#include <vector>
+
+#include "TreeNode.h"
+#include "genPts_par.h"
+#include "sfcSort.h"
+#include "oda.h"
+#include "colors.h"
+#include "externVars.h"
+#include "dendro.h"
+
+
+template<typename T>
+bool compareArrays(const std::vector<T> &a, const std::vector<T> &b, MPI_Comm comm)
+{
+    bool state = (a.size() == b.size());
+    for (unsigned int i = 0; state && i < a.size(); i++)
+        state = (a[i] == b[i]);
+
+    bool state_g;
+    MPI_Allreduce(&state, &state_g, 1, MPI_CXX_BOOL, MPI_LAND, comm);
+    return state_g;
+}
+
+int main(int argc, char **argv) {
+
+    PetscInitialize(&argc, &argv, "options", NULL);
+    ot::RegisterEvents();
+    ot::DA_Initialize(MPI_COMM_WORLD);
+
+    int rank, npes;
+    MPI_Comm comm = MPI_COMM_WORLD;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &npes);
+
+    if (argc < 3) {
+        if (!rank)
+            std::cerr << "Usage: " << argv[0] << " numPts maxDepth dof(optional) numIterations(optional)" << std::endl;
+        ot::DA_Finalize();
+        PetscFinalize();
+        return -1;
+    }
+
+    DendroIntL numPts = atol(argv[1]);
+    unsigned int maxDepth = atoi(argv[2]);
+    unsigned int dof = 1;
+    unsigned int numIter = 100;
+    if (argc > 3) dof = atoi(argv[3]);
+    if (argc > 4) numIter = atoi(argv[4]);
+    unsigned int dim = m_uiDim;
+
+    _InitializeHcurve(dim);
+
+    std::vector<double> pts;
+    genGauss(0.1, numPts, dim, pts);
+
+    std::vector<ot::TreeNode> tmpNodes;
+    pts2Octants(tmpNodes, &(*(pts.begin())), pts.size(), dim, maxDepth);
+    pts.clear();
+
+    std::vector<ot::TreeNode> tmpSorted, tmpConstruct, balOct;
+    ot::TreeNode root(0, 0, 0, 0, dim, maxDepth);
+    SFC::parSort::SFC_treeSort(tmpNodes, tmpSorted, tmpConstruct, balOct, 0.1, maxDepth, root, ROOT_ROTATION, 1,
+                               TS_BALANCE_OCTREE, NUM_NPES_THRESHOLD, comm);
+    tmpNodes.clear();
+    tmpSorted.clear();
+    tmpConstruct.clear();
+
+    ot::DA da(balOct, comm, comm, false);
+    balOct.clear();
+
+    bool allPassed = true;
+
+    if (da.iAmActive()) {
+
+        MPI_Comm activeComm = da.getCommActive();
+
+        // ghosted nodal buffer (same layout as vecGetBuffer)
+        std::vector<double> init(dof * da.getLocalBufferSize());
+        for (unsigned int i = 0; i < init.size(); i++)
+            init[i] = rank * 1000000.0 + i;
+
+        const std::vector<double> fresh = init;
+        std::vector<double> readDefault = init, writeDefault = init;
+        double t[2];
+
+        // default exchange
+        da.setPersistentGhostExchange(false);
+        da.ReadFromGhostsBegin<double>(&(*(readDefault.begin())), dof);
+        da.ReadFromGhostsEnd<double>(&(*(readDefault.begin())));
+        da.WriteToGhostsBegin<double>(&(*(writeDefault.begin())), dof);
+        da.WriteToGhostsEnd<double>(&(*(writeDefault.begin())), dof);
+
+        MPI_Barrier(activeComm);
+        t[0] = MPI_Wtime();
+        for (unsigned int it = 0; it < numIter; it++) {
+            da.ReadFromGhostsBegin<double>(&(*(init.begin())), dof);
+            da.ReadFromGhostsEnd<double>(&(*(init.begin())));
+        }
+        t[0] = (MPI_Wtime() - t[0]) / numIter;
+
+        // persistent exchange (the second call reuses the requests and buffers of the first)
+        da.setPersistentGhostExchange(true);
+        std::vector<double> readPersistent, writePersistent;
+        for (unsigned int it = 0; it < 2; it++) {
+            readPersistent = fresh;
+            da.ReadFromGhostsBegin<double>(&(*(readPersistent.begin())), dof);
+            da.ReadFromGhostsEnd<double>(&(*(readPersistent.begin())));
+            writePersistent = fresh;
+            da.WriteToGhostsBegin<double>(&(*(writePersistent.begin())), dof);
+            da.WriteToGhostsEnd<double>(&(*(writePersistent.begin())), dof);
+        }
+
+        MPI_Barrier(activeComm);
+        t[1] = MPI_Wtime();
+        for (unsigned int it = 0; it < numIter; it++) {
+            da.ReadFromGhostsBegin<double>(&(*(init.begin())), dof);
+            da.ReadFromGhostsEnd<double>(&(*(init.begin())));
+        }
+        t[1] = (MPI_Wtime() - t[1]) / numIter;
+
+        bool readState = compareArrays(readDefault, readPersistent, activeComm);
+        bool writeState = compareArrays(writeDefault, writePersistent, activeComm);
+        allPassed = readState && writeState;
+
+        double t_max[2];
+        MPI_Reduce(t, t_max, 2, MPI_DOUBLE, MPI_MAX, 0, activeComm);
+
+        if (!rank) {
+            std::cout << (readState ? GRN : RED) << " ReadFromGhosts : " << (readState ? "PASSED " : "FAILED ") << NRM << std::endl;
+            std::cout << (writeState ? GRN : RED) << " WriteToGhosts : " << (writeState ? "PASSED " : "FAILED ") << NRM << std::endl;
+            std::cout << " ghost read (s) default: " << t_max[0] << " persistent: " << t_max[1] << std::endl;
+        }
+
+        da.setPersistentGhostExchange(false);
+    }
+
+    ot::DA_Finalize();
+    PetscFinalize();
+    return (allPassed) ? 0 : 1;
+
+}
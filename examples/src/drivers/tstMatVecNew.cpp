@@ -0,0 +1,384 @@
+/*
+ * @author: Milinda Fernando
+ * School of Computing, University of Utah
+ *
+ * Checks the gather-compute-scatter octree MatVec (feMatrix::MatVec_new) for the mass and the stiffness (constant
+ * coefficient) matrices with patch tests and reports the time of MatVec and MatVec_new. The fused operator M - dt*K
+ * (feMatrixSum) is compared against the two separate MatVec_new calls and its diagonal against the MatVec of unit
+ * vectors. The times are the best of numIterations applications, after one untimed application.
+ *
+ * usage: tstMatVecNew numPts maxDepth dof numIterations
+ *
+ * */
+
+#include "mpi.h"
+#include "petsc.h"
+#include "sys.h"
+#include <iostream>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+#include "TreeNode.h"
+#include "genPts_par.h"
+#include "sfcSort.h"
+#include "oda.h"
+#include "colors.h"
+#include "externVars.h"
+#include "dendro.h"
+#include "massMatrix.h"
+#include "stiffnessMatrix.h"
+#include "feMatrixSum.h"
+
+
+// Nodal coordinates (3 per node of the ghosted buffer) from the anchors of the elements, -1 if the node is not a
+// vertex of any element of the ALL loop.
+void getNodeCoordinates(ot::DA &da, std::vector<double> &X)
+{
+    const unsigned int maxD = da.getMaxDepth();
+    const double xFac = 1.0 / ((double) (1 << (maxD - 1)));
+    const ot::ElementLoop &loop = da.getElementLoop<ot::DA_FLAGS::ALL>();
+
+    X.assign(3 * da.getLocalBufferSize(), -1.0);
+    unsigned int idx[8];
+    for (unsigned int pos = 0; pos < loop.getNumElements(); pos++) {
+        const unsigned int elem = loop.getElement(pos);
+        const unsigned char hnMask = da.getHangingNodeIndex(elem);
+        const double h = xFac * (1 << (maxD - da.getLevel(elem)));
+        Point pt = loop.getAnchor(pos);
+        const unsigned char c = loop.getChildNumber(pos);
+        loop.getNodeIndices(pos, idx);
+        for (unsigned int v = 0; v < 8; v++) {
+            if (!((hnMask >> v) & 1u)) {
+                X[3 * idx[v]] = pt.x() * xFac + ((v & 1u) ? h : 0.0);
+                X[3 * idx[v] + 1] = pt.y() * xFac + ((v & 2u) ? h : 0.0);
+                X[3 * idx[v] + 2] = pt.z() * xFac + ((v & 4u) ? h : 0.0);
+            } else {
+                // the node of a hanging vertex is the vertex v of the parent
+                X[3 * idx[v]] = pt.x() * xFac - ((c & 1u) ? h : 0.0) + ((v & 1u) ? 2.0 * h : 0.0);
+                X[3 * idx[v] + 1] = pt.y() * xFac - ((c & 2u) ? h : 0.0) + ((v & 2u) ? 2.0 * h : 0.0);
+                X[3 * idx[v] + 2] = pt.z() * xFac - ((c & 4u) ? h : 0.0) + ((v & 4u) ? 2.0 * h : 0.0);
+            }
+        }
+    }
+}
+
+// Patch tests on the unit cube with the linear field u = x + 2y + 3z (for all dof): u^T M u must be the integral
+// of u^2 (14/3 + 11/2 = 61/6 per dof) and K u must vanish at the interior nodes. Reports the error of MatVec and
+// MatVec_new, only MatVec_new is checked since the hanging stencils of MatVec are not exact for linear fields (and
+// MatVec only applies to the first dof).
+// One untimed application first (it builds the element loops and the stencil caches), then the best time of
+// numIter applications.
+template<typename T>
+void applyMatVec(T &mat, Vec in, Vec out, bool useNew, unsigned int numIter, MPI_Comm comm, double &t)
+{
+    t = 1e30;
+    for (unsigned int it = 0; it <= numIter; it++) {
+        MPI_Barrier(comm);
+        const double t0 = MPI_Wtime();
+        VecZeroEntries(out);
+        if (useNew)
+            mat.MatVec_new(in, out);
+        else
+            mat.MatVec(in, out);
+        if (it)
+            t = std::min(t, MPI_Wtime() - t0);
+    }
+}
+
+template<typename T>
+bool checkMatVec(T &mat, const char *name, bool isStiffness, ot::DA &da, unsigned int dof, unsigned int numIter,
+                 int rank)
+{
+    MPI_Comm comm = da.getCommActive();
+
+    std::vector<double> X;
+    getNodeCoordinates(da, X);
+
+    Vec in, out, interior;
+    da.createVector(in, false, false, dof);
+    da.createVector(out, false, false, dof);
+    da.createVector(interior, false, false, dof);
+
+    PetscScalar *inArray, *interiorArray;
+    da.vecGetBuffer(in, inArray, false, false, false, dof);
+    da.vecGetBuffer(interior, interiorArray, false, false, false, dof);
+    for (unsigned int i = 0; i < da.getLocalBufferSize(); i++) {
+        bool isInterior = true;
+        for (unsigned int d = 0; d < 3; d++)
+            isInterior = isInterior && (X[3 * i + d] > 0.0) && (X[3 * i + d] < 1.0);
+        for (unsigned int d = 0; d < dof; d++) {
+            inArray[dof * i + d] = (X[3 * i] < 0.0) ? 0.0 : (X[3 * i] + 2.0 * X[3 * i + 1] + 3.0 * X[3 * i + 2]);
+            interiorArray[dof * i + d] = isInterior ? 1.0 : 0.0;
+        }
+    }
+    da.vecRestoreBuffer(in, inArray, false, false, false, dof);
+    da.vecRestoreBuffer(interior, interiorArray, false, false, false, dof);
+
+    double t[2], err[2];
+    for (unsigned int useNew = 0; useNew < 2; useNew++) {
+        applyMatVec(mat, in, out, (useNew != 0), numIter, comm, t[useNew]);
+
+        PetscScalar *outArray;
+        PetscInt n;
+        VecGetLocalSize(out, &n);
+        VecGetArray(in, &inArray);
+        VecGetArray(out, &outArray);
+        VecGetArray(interior, &interiorArray);
+        double local = 0.0;
+        for (PetscInt i = 0; i < n; i++) {
+            if (isStiffness)
+                local = std::max(local, interiorArray[i] * fabs(outArray[i]));
+            else
+                local += inArray[i] * outArray[i];
+        }
+        VecRestoreArray(in, &inArray);
+        VecRestoreArray(out, &outArray);
+        VecRestoreArray(interior, &interiorArray);
+
+        double global;
+        MPI_Allreduce(&local, &global, 1, MPI_DOUBLE, (isStiffness ? MPI_MAX : MPI_SUM), comm);
+        err[useNew] = isStiffness ? global : fabs(global - dof * 61.0 / 6.0);
+    }
+
+    bool state = (err[1] <= 1e-10);
+
+    double t_max[2];
+    MPI_Reduce(t, t_max, 2, MPI_DOUBLE, MPI_MAX, 0, comm);
+
+    if (!rank) {
+        std::cout << (state ? GRN : RED) << " " << name << " : " << (state ? "PASSED " : "FAILED ") << NRM
+                  << " patch test error MatVec: " << err[0] << " MatVec_new: " << err[1] << " MatVec (s): "
+                  << t_max[0] << " MatVec_new (s): " << t_max[1] << std::endl;
+    }
+
+    VecDestroy(&in);
+    VecDestroy(&out);
+    VecDestroy(&interior);
+
+    return state;
+}
+
+// The diagonal of the sum must be the diagonal of the operator applied by feMatrixSum::MatVec, it is compared with
+// sum.MatVec of the unit vectors of numProbes entries spread over the global vector.
+bool checkMatVecSumDiagonal(feMatrixSum &sum, ot::DA &da, unsigned int dof, int rank)
+{
+    MPI_Comm comm = da.getCommActive();
+    const unsigned int numProbes = 64;
+
+    Vec diag, e, out;
+    da.createVector(diag, false, false, dof);
+    da.createVector(e, false, false, dof);
+    da.createVector(out, false, false, dof);
+    VecZeroEntries(diag);
+    sum.MatGetDiagonal(diag);
+
+    PetscInt n;
+    VecGetLocalSize(diag, &n);
+    DendroIntL localSz = n, offset = 0, globalSz = 0;
+    par::Mpi_Scan<DendroIntL>(&localSz, &offset, 1, MPI_SUM, comm);
+    offset -= localSz;
+    par::Mpi_Allreduce<DendroIntL>(&localSz, &globalSz, 1, MPI_SUM, comm);
+
+    double err = 0.0;
+    PetscScalar *diagArray, *eArray, *outArray;
+    for (unsigned int p = 0; p < numProbes; p++) {
+        const DendroIntL g = (p * globalSz) / numProbes;
+        const bool isMine = (g >= offset) && (g < offset + localSz);
+        VecZeroEntries(e);
+        VecZeroEntries(out);
+        if (isMine) {
+            VecGetArray(e, &eArray);
+            eArray[g - offset] = 1.0;
+            VecRestoreArray(e, &eArray);
+        }
+        sum.MatVec(e, out);
+        if (isMine) {
+            VecGetArray(diag, &diagArray);
+            VecGetArray(out, &outArray);
+            err = std::max(err, fabs(diagArray[g - offset] - outArray[g - offset]) /
+                                std::max(1e-12, fabs(outArray[g - offset])));
+            VecRestoreArray(diag, &diagArray);
+            VecRestoreArray(out, &outArray);
+        }
+    }
+
+    double globalErr;
+    MPI_Allreduce(&err, &globalErr, 1, MPI_DOUBLE, MPI_MAX, comm);
+    const bool state = (globalErr <= 1e-10);
+
+    if (!rank) {
+        std::cout << (state ? GRN : RED) << " feMatrixSum diagonal : " << (state ? "PASSED " : "FAILED ") << NRM
+                  << " relative error (" << numProbes << " probes): " << globalErr << std::endl;
+    }
+
+    VecDestroy(&diag);
+    VecDestroy(&e);
+    VecDestroy(&out);
+
+    return state;
+}
+
+// (M - dt*K) x with the fused feMatrixSum and with two MatVec_new calls, the results must agree up to round-off.
+bool checkMatVecSum(massMatrix &mass, stiffnessMatrix &stiff, ot::DA &da, unsigned int dof, unsigned int numIter,
+                    int rank)
+{
+    MPI_Comm comm = da.getCommActive();
+    const double dt = 0.01;
+
+    feMatrixSum sum(feMat::OCT);
+    sum.setDA(&da);
+    sum.setProblemDimensions(1.0, 1.0, 1.0);
+    sum.setDof(dof);
+    sum.addTerm(&mass, 1.0);
+    sum.addTerm(&stiff, -dt);
+
+    Vec in, outSep, outSum;
+    da.createVector(in, false, false, dof);
+    da.createVector(outSep, false, false, dof);
+    da.createVector(outSum, false, false, dof);
+
+    PetscScalar *inArray;
+    PetscInt n;
+    VecGetLocalSize(in, &n);
+    VecGetArray(in, &inArray);
+    for (PetscInt i = 0; i < n; i++)
+        inArray[i] = sin(0.37 * i + rank);
+    VecRestoreArray(in, &inArray);
+
+    double t[2] = {1e30, 1e30};
+    for (unsigned int it = 0; it <= numIter; it++) {
+        MPI_Barrier(comm);
+        double t0 = MPI_Wtime();
+        VecZeroEntries(outSep);
+        mass.MatVec_new(in, outSep);
+        stiff.MatVec_new(in, outSep, -dt);
+        if (it)
+            t[0] = std::min(t[0], MPI_Wtime() - t0);
+
+        MPI_Barrier(comm);
+        t0 = MPI_Wtime();
+        VecZeroEntries(outSum);
+        sum.MatVec(in, outSum);
+        if (it)
+            t[1] = std::min(t[1], MPI_Wtime() - t0);
+    }
+
+    double errNorm, refNorm;
+    VecNorm(outSep, NORM_INFINITY, &refNorm);
+    VecAXPY(outSum, -1.0, outSep);
+    VecNorm(outSum, NORM_INFINITY, &errNorm);
+    const double err = errNorm / std::max(1.0, refNorm);
+    const bool state = (err <= 1e-12);
+
+    double t_max[2];
+    MPI_Reduce(t, t_max, 2, MPI_DOUBLE, MPI_MAX, 0, comm);
+
+    if (!rank) {
+        std::cout << (state ? GRN : RED) << " feMatrixSum : " << (state ? "PASSED " : "FAILED ") << NRM
+                  << " error (M - dt*K): " << err << " 2 x MatVec_new (s): " << t_max[0] << " fused (s): "
+                  << t_max[1] << std::endl;
+    }
+
+    VecDestroy(&in);
+    VecDestroy(&outSep);
+    VecDestroy(&outSum);
+
+    return checkMatVecSumDiagonal(sum, da, dof, rank) && state;
+}
+
+int main(int argc, char **argv) {
+
+    PetscInitialize(&argc, &argv, "options", NULL);
+    ot::RegisterEvents();
+    ot::DA_Initialize(MPI_COMM_WORLD);
+
+    int rank, npes;
+    MPI_Comm comm = MPI_COMM_WORLD;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &npes);
+
+    if (argc < 3) {
+        if (!rank)
+            std::cerr << "Usage: " << argv[0] << " numPts maxDepth dof(optional) numIterations(optional)"
+                      << std::endl;
+        ot::DA_Finalize();
+        PetscFinalize();
+        return -1;
+    }
+
+    DendroIntL numPts = atol(argv[1]);
+    unsigned int maxDepth = atoi(argv[2]);
+    unsigned int dof = 1;
+    unsigned int numIter = 10;
+    if (argc > 3) dof = atoi(argv[3]);
+    if (argc > 4) numIter = atoi(argv[4]);
+    unsigned int dim = m_uiDim;
+
+    _InitializeHcurve(dim);
+
+    std::vector<double> pts;
+    genGauss(0.1, numPts, dim, pts);
+
+    std::vector<ot::TreeNode> tmpNodes;
+    pts2Octants(tmpNodes, &(*(pts.begin())), pts.size(), dim, maxDepth);
+    pts.clear();
+
+    std::vector<ot::TreeNode> tmpSorted, tmpConstruct, balOct;
+    ot::TreeNode root(0, 0, 0, 0, dim, maxDepth);
+    SFC::parSort::SFC_treeSort(tmpNodes, tmpSorted, tmpConstruct, balOct, 0.1, maxDepth, root, ROOT_ROTATION, 1,
+                               TS_BALANCE_OCTREE, NUM_NPES_THRESHOLD, comm);
+    tmpNodes.clear();
+    tmpSorted.clear();
+    tmpConstruct.clear();
+
+    ot::DA da(balOct, comm, comm, false);
+    balOct.clear();
+
+    bool allPassed = true;
+
+    if (da.iAmActive()) {
+#ifdef HILBERT_ORDERING
+        da.computeHilbertRotations();
+#endif
+
+        massMatrix mass(feMat::OCT);
+        mass.setDA(&da);
+        mass.setProblemDimensions(1.0, 1.0, 1.0);
+        mass.setDof(dof);
+        allPassed = checkMatVec(mass, "massMatrix", false, da, dof, numIter, rank) && allPassed;
+
+        // the stiffness matrix reads nu with the dof of the matrix.
+        Vec nu;
+        da.createVector(nu, false, false, dof);
+        VecSet(nu, 1.0);
+
+        stiffnessMatrix stiff(feMat::OCT);
+        stiff.setDA(&da);
+        stiff.setProblemDimensions(1.0, 1.0, 1.0);
+        stiff.setDof(dof);
+        stiff.setNuVec(nu);
+        allPassed = checkMatVec(stiff, "stiffnessMatrix", true, da, dof, numIter, rank) && allPassed;
+        allPassed = checkMatVecSum(mass, stiff, da, dof, numIter, rank) && allPassed;
+
+        // only MatVec() applies nu per node, the local kernels must refuse a variable nu.
+        PetscScalar *nuArray;
+        VecGetArray(nu, &nuArray);
+        if (!rank) nuArray[0] = 2.0;
+        VecRestoreArray(nu, &nuArray);
+        stiff.setNuVec(nu);
+        const bool refused = !(stiff.localKernelsSupported());
+        if (!rank) {
+            std::cout << (refused ? GRN : RED) << " stiffnessMatrix variable nu : " << (refused ? "PASSED " : "FAILED ")
+                      << NRM << " refused by the local kernels" << std::endl;
+        }
+        allPassed = refused && allPassed;
+
+        VecDestroy(&nu);
+    }
+
+    ot::DA_Finalize();
+    PetscFinalize();
+    return (allPassed) ? 0 : 1;
+
+}
@@ -0,0 +1,98 @@
+/*
+ * @author: Milinda Fernando
+ * School of Computing, University of Utah
+ *
+ * Compares the OpenMP task parallel SFC::seqSort::SFC_treeSort_omp against the sequential SFC::seqSort::SFC_treeSort
+ * for sort, remove duplicates, construction and balancing and reports the local sort times.
+ *
+ * usage: tstOmpTreeSort numPts maxDepth taskThreshold
+ *
+ * */
+
+#include "mpi.h"
+#include <iostream>
+#include <vector>
+#include <omp.h>
+
+#include "TreeNode.h"
+#include "genPts_par.h"
+#include "sfcSort.h"
+#include "colors.h"
+#include "externVars.h"
+
+
+bool compareOctants(const std::vector<ot::TreeNode> & a, const std::vector<ot::TreeNode> & b)
+{
+    if(a.size()!=b.size()) return false;
+    for(unsigned int i=0;i<a.size();i++)
+        if(a[i]!=b[i]) return false;
+
+    return true;
+}
+
+int main(int argc, char **argv) {
+
+    MPI_Init(&argc, &argv);
+
+    if (argc < 3) {
+        std::cerr << "Usage: " << argv[0] << " numPts maxDepth taskThreshold(optional)" << std::endl;
+        MPI_Finalize();
+        return -1;
+    }
+
+    DendroIntL numPts = atol(argv[1]);
+    unsigned int maxDepth = atoi(argv[2]);
+    DendroIntL taskThreshold = OMP_TREE_SORT_TASK_THRESHOLD;
+    if (argc > 3) taskThreshold = atol(argv[3]);
+    unsigned int dim = m_uiDim;
+
+    _InitializeHcurve(dim);
+
+    std::vector<double> pts;
+    genGauss(0.1, numPts, dim, pts);
+
+    std::vector<ot::TreeNode> input;
+    pts2Octants(input, &(*(pts.begin())), pts.size(), dim, maxDepth);
+    pts.clear();
+
+    ot::TreeNode root(0, 0, 0, 0, dim, maxDepth);
+    const unsigned int options[] = {TS_SORT_ONLY, TS_REMOVE_DUPLICATES, TS_CONSTRUCT_OCTREE, TS_BALANCE_OCTREE};
+    const char *optionNames[] = {"sort", "removeDuplicates", "construct", "balance"};
+    bool allPassed = true;
+
+    std::cout << " number of octants: " << input.size() << " threads: " << omp_get_max_threads()
+              << " task threshold: " << taskThreshold << std::endl;
+
+    for (unsigned int w = 0; w < 4; w++) {
+
+        std::vector<ot::TreeNode> seqNodes = input;
+        std::vector<ot::TreeNode> seqSorted, seqConstruct, seqBalanced;
+        std::vector<ot::TreeNode> ompNodes = input;
+        std::vector<ot::TreeNode> ompSorted, ompConstruct, ompBalanced;
+
+        double t_seq = omp_get_wtime();
+        SFC::seqSort::SFC_treeSort(&(*(seqNodes.begin())), seqNodes.size(), seqSorted, seqConstruct, seqBalanced,
+                                   maxDepth, maxDepth, root, ROOT_ROTATION, 1, options[w]);
+        t_seq = omp_get_wtime() - t_seq;
+
+        double t_omp = omp_get_wtime();
+        SFC::seqSort::SFC_treeSort_omp(&(*(ompNodes.begin())), ompNodes.size(), ompSorted, ompConstruct, ompBalanced,
+                                       maxDepth, maxDepth, root, ROOT_ROTATION, 1, options[w], taskThreshold);
+        t_omp = omp_get_wtime() - t_omp;
+
+        bool state = compareOctants(seqNodes, ompNodes) && compareOctants(seqSorted, ompSorted) &&
+                     compareOctants(seqConstruct, ompConstruct) && compareOctants(seqBalanced, ompBalanced);
+        allPassed = allPassed && state;
+
+        if (state)
+            std::cout << GRN << " " << optionNames[w] << " : PASSED " << NRM;
+        else
+            std::cout << RED << " " << optionNames[w] << " : FAILED " << NRM;
+        std::cout << " seq (s): " << t_seq << " omp (s): " << t_omp << " speedup: " << (t_seq / t_omp) << std::endl;
+
+    }
+
+    MPI_Finalize();
+    return (allPassed) ? 0 : 1;
+
+}
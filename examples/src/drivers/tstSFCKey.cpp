@@ -0,0 +1,146 @@
+/*
+ * @author: Milinda Fernando
+ * School of Computing, University of Utah
+ *
+ * Microbenchmark for the precomputed SFC keys (ot::KeyedTreeNode) against the TreeNode::operator< table walk.
+ * Checks that both give the same ordering and reports the times for std::sort, std::lower_bound and
+ * seq::maxLowerBound.
+ *
+ * usage: tstSFCKey numPts maxDepth numSearch
+ *
+ * */
+
+#include "mpi.h"
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <omp.h>
+
+#include "TreeNode.h"
+#include "keyedTreeNode.h"
+#include "genPts_par.h"
+#include "seqUtils.h"
+#include "colors.h"
+#include "externVars.h"
+
+
+int main(int argc, char **argv) {
+
+    MPI_Init(&argc, &argv);
+
+    if (argc < 3) {
+        std::cerr << "Usage: " << argv[0] << " numPts maxDepth numSearch(optional)" << std::endl;
+        MPI_Finalize();
+        return -1;
+    }
+
+    DendroIntL numPts = atol(argv[1]);
+    unsigned int maxDepth = atoi(argv[2]);
+    DendroIntL numSearch = numPts;
+    if (argc > 3) numSearch = atol(argv[3]);
+    unsigned int dim = m_uiDim;
+
+    _InitializeHcurve(dim);
+
+    std::vector<double> pts;
+    genGauss(0.1, numPts, dim, pts);
+
+    std::vector<ot::TreeNode> nodes;
+    pts2Octants(nodes, &(*(pts.begin())), pts.size(), dim, maxDepth);
+    pts.clear();
+
+    // add some coarser octants (ancestors) to check the ancestor-descendant order.
+    const DendroIntL numLeafs = nodes.size();
+    for (DendroIntL i = 0; i < numLeafs; i += 7)
+        nodes.push_back(nodes[i].getAncestor(nodes[i].getLevel() - 1 - (i % (maxDepth - 1))));
+
+    std::vector<ot::KeyedTreeNode> keyed;
+    double t_key = omp_get_wtime();
+    ot::toKeyedTreeNodes(nodes, keyed);
+    t_key = omp_get_wtime() - t_key;
+
+    std::vector<ot::TreeNode> searchKeys;
+    for (DendroIntL i = 0; i < numSearch; i++)
+        searchKeys.push_back(nodes[(i * 7919) % nodes.size()]);
+    std::vector<ot::KeyedTreeNode> keyedSearchKeys;
+    ot::toKeyedTreeNodes(searchKeys, keyedSearchKeys);
+
+    std::cout << " number of octants: " << nodes.size() << " key computation (s): " << t_key << std::endl;
+
+    // sort
+    double t_sort = omp_get_wtime();
+    std::sort(nodes.begin(), nodes.end());
+    t_sort = omp_get_wtime() - t_sort;
+
+    double t_sortKey = omp_get_wtime();
+    std::sort(keyed.begin(), keyed.end());
+    t_sortKey = omp_get_wtime() - t_sortKey;
+
+    bool state = (nodes.size() == keyed.size());
+    for (DendroIntL i = 0; state && i < nodes.size(); i++)
+        state = (nodes[i] == keyed[i]);
+
+    // consistency of the comparison operators
+    for (DendroIntL i = 0; state && i < searchKeys.size(); i++) {
+        const ot::TreeNode &a = searchKeys[i];
+        const ot::TreeNode &b = searchKeys[(i + 1) % searchKeys.size()];
+        state = ((a < b) == (keyedSearchKeys[i] < keyedSearchKeys[(i + 1) % searchKeys.size()]));
+    }
+
+    if (state)
+        std::cout << GRN << " sort order : PASSED " << NRM;
+    else
+        std::cout << RED << " sort order : FAILED " << NRM;
+    std::cout << " TreeNode (s): " << t_sort << " KeyedTreeNode (s): " << t_sortKey << " speedup: "
+              << (t_sort / t_sortKey) << std::endl;
+
+    // lower_bound
+    DendroIntL sum = 0, sumKey = 0;
+    double t_lb = omp_get_wtime();
+    for (DendroIntL i = 0; i < searchKeys.size(); i++)
+        sum += (std::lower_bound(nodes.begin(), nodes.end(), searchKeys[i]) - nodes.begin());
+    t_lb = omp_get_wtime() - t_lb;
+
+    double t_lbKey = omp_get_wtime();
+    for (DendroIntL i = 0; i < keyedSearchKeys.size(); i++)
+        sumKey += (std::lower_bound(keyed.begin(), keyed.end(), keyedSearchKeys[i]) - keyed.begin());
+    t_lbKey = omp_get_wtime() - t_lbKey;
+
+    state = state && (sum == sumKey);
+    if (sum == sumKey)
+        std::cout << GRN << " lower_bound : PASSED " << NRM;
+    else
+        std::cout << RED << " lower_bound : FAILED " << NRM;
+    std::cout << " TreeNode (s): " << t_lb << " KeyedTreeNode (s): " << t_lbKey << " speedup: " << (t_lb / t_lbKey)
+              << std::endl;
+
+    // maxLowerBound
+    unsigned int idx;
+    sum = 0;
+    sumKey = 0;
+    double t_mlb = omp_get_wtime();
+    for (DendroIntL i = 0; i < searchKeys.size(); i++) {
+        seq::maxLowerBound(nodes, searchKeys[i], idx, NULL, NULL);
+        sum += idx;
+    }
+    t_mlb = omp_get_wtime() - t_mlb;
+
+    double t_mlbKey = omp_get_wtime();
+    for (DendroIntL i = 0; i < keyedSearchKeys.size(); i++) {
+        seq::maxLowerBound(keyed, keyedSearchKeys[i], idx, NULL, NULL);
+        sumKey += idx;
+    }
+    t_mlbKey = omp_get_wtime() - t_mlbKey;
+
+    state = state && (sum == sumKey);
+    if (sum == sumKey)
+        std::cout << GRN << " maxLowerBound : PASSED " << NRM;
+    else
+        std::cout << RED << " maxLowerBound : FAILED " << NRM;
+    std::cout << " TreeNode (s): " << t_mlb << " KeyedTreeNode (s): " << t_mlbKey << " speedup: "
+              << (t_mlb / t_mlbKey) << std::endl;
+
+    MPI_Finalize();
+    return (state) ? 0 : 1;
+
+}
@@ -0,0 +1,139 @@
+/*
+ * @author: Milinda Fernando
+ * School of Computing, University of Utah
+ *
+ * Checks the streaming octree construction from a point file (points2OctreeFromFile). Random points are written
+ * to a file with MPI-IO (the format of writePtsToFile) and the octree is constructed from the file with small
+ * chunks. The result must be the same octree as the one constructed by SFC_treeSort from the points in memory
+ * (same number of octants and the same octants, the partitions may differ).
+ *
+ * usage: tstStreamP2O numPts maxDepth fileName chunkSize
+ *
+ * */
+
+#include "mpi.h"
+#include "petsc.h"
+#include "sys.h"
+#include <iostream>
+#include <vector>
+
+#include "TreeNode.h"
+#include "genPts_par.h"
+#include "sfcSort.h"
+#include "octUtils.h"
+#include "testUtils.h"
+#include "colors.h"
+#include "externVars.h"
+#include "dendro.h"
+
+
+// Order independent checksum of the octants of all the processors of comm.
+unsigned long long checksum(const std::vector<ot::TreeNode> &nodes, MPI_Comm comm)
+{
+    unsigned long long local = 0, global;
+    for (unsigned int i = 0; i < nodes.size(); i++) {
+        unsigned long long h = nodes[i].getX();
+        h = h * 1000003ull + nodes[i].getY();
+        h = h * 1000003ull + nodes[i].getZ();
+        h = h * 1000003ull + nodes[i].getLevel();
+        local += h * 0x9E3779B97F4A7C15ull;
+    }
+    MPI_Allreduce(&local, &global, 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM, comm);
+    return global;
+}
+
+int main(int argc, char **argv) {
+
+    PetscInitialize(&argc, &argv, "options", NULL);
+    ot::RegisterEvents();
+
+    int rank, npes;
+    MPI_Comm comm = MPI_COMM_WORLD;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &npes);
+
+    if (argc < 4) {
+        if (!rank)
+            std::cerr << "Usage: " << argv[0] << " numPts maxDepth fileName chunkSize(optional)" << std::endl;
+        PetscFinalize();
+        return -1;
+    }
+
+    DendroIntL numPts = atol(argv[1]);
+    unsigned int maxDepth = atoi(argv[2]);
+    const char *fileName = argv[3];
+    DendroIntL chunkSize = 1000;
+    if (argc > 4) chunkSize = atol(argv[4]);
+    unsigned int dim = m_uiDim;
+    double gLens[3] = {1.0, 1.0, 1.0};
+
+    _InitializeHcurve(dim);
+
+    std::vector<double> pts;
+    genGauss(0.1, numPts, dim, pts);
+
+    // the point file: the number of points followed by the points of all the processors
+    DendroIntL localPts = pts.size() / dim, offset = 0, globalPts;
+    MPI_Exscan(&localPts, &offset, 1, MPI_LONG_LONG, MPI_SUM, comm);
+    if (!rank) offset = 0;
+    par::Mpi_Allreduce(&localPts, &globalPts, 1, MPI_SUM, comm);
+
+    MPI_File fh;
+    MPI_File_open(comm, const_cast<char *>(fileName), MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &fh);
+    MPI_File_set_size(fh, 0);
+    if (!rank) {
+        unsigned int n = globalPts;
+        MPI_File_write_at(fh, 0, &n, 1, MPI_UNSIGNED, MPI_STATUS_IGNORE);
+    }
+    MPI_File_write_at_all(fh, sizeof(unsigned int) + offset * dim * sizeof(double), &(*(pts.begin())),
+                          static_cast<int>(pts.size()), MPI_DOUBLE, MPI_STATUS_IGNORE);
+    MPI_File_close(&fh);
+
+    // reference: the octants of the points in memory
+    std::vector<ot::TreeNode> tmpNodes;
+    for (DendroIntL i = 0; i < localPts; i++) {
+        unsigned int p_int[3] = {0, 0, 0};
+        bool inside = true;
+        for (unsigned int j = 0; j < dim; j++) {
+            inside = inside && (pts[i * dim + j] >= 0.0) && (pts[i * dim + j] < 1.0);
+            p_int[j] = inside ? ((unsigned int) (pts[i * dim + j] * (double) (1u << maxDepth))) : 0;
+        }
+        if (inside)
+            tmpNodes.push_back(ot::TreeNode(p_int[0], p_int[1], p_int[2], maxDepth, dim, maxDepth));
+    }
+    pts.clear();
+
+    double t[2];
+    std::vector<ot::TreeNode> tmpSorted, refOct, tmpBalanced;
+    ot::TreeNode root(0, 0, 0, 0, dim, maxDepth);
+    MPI_Barrier(comm);
+    t[0] = MPI_Wtime();
+    SFC::parSort::SFC_treeSort(tmpNodes, tmpSorted, refOct, tmpBalanced, 0.1, maxDepth, root, ROOT_ROTATION, 1,
+                               TS_CONSTRUCT_OCTREE, NUM_NPES_THRESHOLD, comm);
+    t[0] = MPI_Wtime() - t[0];
+    tmpNodes.clear();
+    tmpSorted.clear();
+
+    std::vector<ot::TreeNode> streamOct;
+    MPI_Barrier(comm);
+    t[1] = MPI_Wtime();
+    int err = ot::points2OctreeFromFile(fileName, gLens, streamOct, dim, maxDepth, 1, chunkSize,
+                                        TS_CONSTRUCT_OCTREE, comm);
+    t[1] = MPI_Wtime() - t[1];
+
+    DendroIntL sz[2] = {(DendroIntL) refOct.size(), (DendroIntL) streamOct.size()}, sz_g[2];
+    par::Mpi_Allreduce(sz, sz_g, 2, MPI_SUM, comm);
+    const bool sorted = par::test::isUniqueAndSorted(streamOct, comm);
+    const bool state = (!err) && sorted && (sz_g[0] == sz_g[1]) && (checksum(refOct, comm) == checksum(streamOct, comm));
+
+    if (!rank) {
+        std::cout << (state ? GRN : RED) << " points2OctreeFromFile : " << (state ? "PASSED " : "FAILED ") << NRM
+                  << " points: " << globalPts << " octants: " << sz_g[1] << " (reference: " << sz_g[0]
+                  << ") chunkSize: " << chunkSize << " in memory (s): " << t[0] << " from file (s): " << t[1]
+                  << std::endl;
+    }
+
+    PetscFinalize();
+    return (state) ? 0 : 1;
+
+}
@@ -0,0 +1,212 @@
+/*
+ * @author: Milinda Fernando
+ * School of Computing, University of Utah
+ *
+ * Checks the restriction and prolongation of the octree multigrid (restrictMatVecType1 and prolongMatVecType1)
+ * on an aligned coarse/fine pair of DAs. The prolongation must be the transpose of the restriction, i.e.
+ * <R f, c> == <f, P c>. Reports the time of numIter applications of both. With OMP_MG_TRANSFER the printed values
+ * must not depend on OMP_NUM_THREADS. The threaded loops are built by the first application, which is not timed.
+ * The transfer operators do not support HILBERT_ORDERING, the check is then reported as unsupported.
+ *
+ * usage: tstTransferLoop numPts maxDepth dof numIter
+ *
+ * */
+
+#include "mpi.h"
+#include "petsc.h"
+#include "sys.h"
+#include <iostream>
+#include <vector>
+#include <cmath>
+#include <omp.h>
+
+#include "TreeNode.h"
+#include "genPts_par.h"
+#include "sfcSort.h"
+#include "oda.h"
+#include "omg.h"
+#include "colors.h"
+#include "externVars.h"
+#include "dendro.h"
+
+
+double dotLocal(Vec x, Vec y)
+{
+    PetscScalar *xArr, *yArr;
+    PetscInt sz;
+    double res = 0.0;
+    VecGetLocalSize(x, &sz);
+    VecGetArray(x, &xArr);
+    VecGetArray(y, &yArr);
+    for (PetscInt i = 0; i < sz; i++)
+        res += xArr[i] * yArr[i];
+    VecRestoreArray(x, &xArr);
+    VecRestoreArray(y, &yArr);
+    return res;
+}
+
+void setValues(Vec x, double freq, double phase)
+{
+    PetscScalar *arr;
+    PetscInt sz;
+    VecGetLocalSize(x, &sz);
+    VecGetArray(x, &arr);
+    for (PetscInt i = 0; i < sz; i++)
+        arr[i] = sin(freq * i + phase);
+    VecRestoreArray(x, &arr);
+}
+
+int main(int argc, char **argv) {
+
+    PetscInitialize(&argc, &argv, "options", NULL);
+    ot::RegisterEvents();
+    ot::DA_Initialize(MPI_COMM_WORLD);
+    ot::DAMG_Initialize(MPI_COMM_WORLD);
+
+    int rank, npes;
+    MPI_Comm comm = MPI_COMM_WORLD;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &npes);
+
+    if (argc < 3) {
+        if (!rank)
+            std::cerr << "Usage: " << argv[0] << " numPts maxDepth dof(optional) numIter(optional)" << std::endl;
+        ot::DAMG_Finalize();
+        ot::DA_Finalize();
+        PetscFinalize();
+        return -1;
+    }
+
+#ifdef HILBERT_ORDERING
+    // The intergrid transfer loops (dummyRestrictMatVecType1, restrictMatVecType1 and prolongMatVecType1) walk the
+    // fine elements in the Morton order of the children of each coarse element, so they do not support the Hilbert
+    // ordering.
+    if (!rank)
+        std::cout << YLW << " R/P adjoint : UNSUPPORTED " << NRM
+                  << " the multigrid transfer operators are not supported with HILBERT_ORDERING." << std::endl;
+    ot::DAMG_Finalize();
+    ot::DA_Finalize();
+    PetscFinalize();
+    return 0;
+#endif
+
+    DendroIntL numPts = atol(argv[1]);
+    unsigned int maxDepth = atoi(argv[2]);
+    unsigned int dof = 1;
+    unsigned int numIter = 10;
+    if (argc > 3) dof = atoi(argv[3]);
+    if (argc > 4) numIter = atoi(argv[4]);
+    unsigned int dim = m_uiDim;
+
+    _InitializeHcurve(dim);
+
+    std::vector<double> pts;
+    genGauss(0.1, numPts, dim, pts);
+
+    std::vector<ot::TreeNode> tmpNodes;
+    pts2Octants(tmpNodes, &(*(pts.begin())), pts.size(), dim, maxDepth);
+    pts.clear();
+
+    std::vector<ot::TreeNode> tmpSorted, tmpConstruct, fineOct;
+    ot::TreeNode root(0, 0, 0, 0, dim, maxDepth);
+    SFC::parSort::SFC_treeSort(tmpNodes, tmpSorted, tmpConstruct, fineOct, 0.1, maxDepth, root, ROOT_ROTATION, 1,
+                               TS_BALANCE_OCTREE, NUM_NPES_THRESHOLD, comm);
+    tmpNodes.clear();
+    tmpSorted.clear();
+    tmpConstruct.clear();
+
+    std::vector<ot::TreeNode> tmpOct, coarseOct;
+    ot::coarsenOctree(fineOct, tmpOct, dim, maxDepth, comm, false, NULL, NULL);
+    ot::balanceOctree(tmpOct, coarseOct, dim, maxDepth, true, comm, NULL, NULL);
+    tmpOct.clear();
+
+    // the fine DA is aligned with the partition of the coarse DA
+    ot::DA *dac = new ot::DA(coarseOct, comm, comm, 0.1);
+    std::vector<ot::TreeNode> blocks = dac->getBlocks();
+    ot::DA *daf = new ot::DA(fineOct, comm, comm, 0.1, false, &blocks);
+    blocks.clear();
+
+    ot::TransferOpData *data = new ot::TransferOpData;
+    data->dac = dac;
+    data->daf = daf;
+    data->minIndependentSize = 0;
+    data->suppressedDOFc = NULL;
+    data->suppressedDOFf = NULL;
+    data->fineTouchedFlags = new std::vector<ot::FineTouchedStatus>;
+    data->fineTouchedFlagsArr = NULL;
+    data->dof = dof;
+    data->comm = comm;
+    data->tmp = NULL;
+    data->addRtmp = NULL;
+    data->addPtmp = NULL;
+    data->transferLoops = NULL;
+    data->sendSzP = data->sendOffP = data->recvSzP = data->recvOffP = NULL;
+    data->sendSzR = data->sendOffR = data->recvSzR = data->recvOffR = NULL;
+    daf->createVector(*(data->fineTouchedFlags), false, false, 1);
+    ot::dummyRestrictMatVecType1(data);
+
+    Vec f, c, Rf, Pc;
+    daf->createVector(f, false, false, dof);
+    daf->createVector(Pc, false, false, dof);
+    dac->createVector(c, false, false, dof);
+    dac->createVector(Rf, false, false, dof);
+    setValues(f, 0.37, rank);
+    setValues(c, 0.11, 2.0 * rank + 1.0);
+
+    PetscInt cSz, fSz;
+    VecGetLocalSize(c, &cSz);
+    VecGetLocalSize(f, &fSz);
+    Mat R;
+    MatCreateShell(comm, cSz, fSz, PETSC_DETERMINE, PETSC_DETERMINE, data, &R);
+
+    ot::restrictMatVecType1(R, f, Rf);
+    ot::prolongMatVecType1(R, c, Pc);
+
+    MPI_Barrier(comm);
+    double t = MPI_Wtime();
+    for (unsigned int i = 0; i < numIter; i++) {
+        ot::restrictMatVecType1(R, f, Rf);
+        ot::prolongMatVecType1(R, c, Pc);
+    }
+    t = MPI_Wtime() - t;
+
+    double local[2], global[2], tMax;
+    local[0] = dotLocal(Rf, c);
+    local[1] = dotLocal(f, Pc);
+    MPI_Allreduce(local, global, 2, MPI_DOUBLE, MPI_SUM, comm);
+    MPI_Reduce(&t, &tMax, 1, MPI_DOUBLE, MPI_MAX, 0, comm);
+
+    const double err = fabs(global[0] - global[1]) / std::max(1.0, fabs(global[0]));
+    const bool state = (err < 1e-10);
+
+    if (!rank) {
+#ifdef OMP_MG_TRANSFER
+        const int numThreads = omp_get_max_threads();
+#else
+        const int numThreads = 1;
+#endif
+        std::cout << (state ? GRN : RED) << " R/P adjoint : " << (state ? "PASSED " : "FAILED ") << NRM
+                  << " <Rf,c>: " << global[0] << " <f,Pc>: " << global[1] << " threads: " << numThreads
+                  << " R+P x " << numIter << " (s): " << tMax << std::endl;
+    }
+
+    MatDestroy(&R);
+    VecDestroy(&f);
+    VecDestroy(&c);
+    VecDestroy(&Rf);
+    VecDestroy(&Pc);
+    if (data->transferLoops)
+        delete[] data->transferLoops;
+    if (data->fineTouchedFlagsArr)
+        delete[] data->fineTouchedFlagsArr;
+    delete data->fineTouchedFlags;
+    delete data;
+    delete daf;
+    delete dac;
+
+    ot::DAMG_Finalize();
+    ot::DA_Finalize();
+    PetscFinalize();
+    return (state) ? 0 : 1;
+
+}
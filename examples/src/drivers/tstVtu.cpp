@@ -0,0 +1,280 @@
+/*
+ * @author: Milinda Fernando
+ * School of Computing, University of Utah
+ *
+ * Checks the binary VTU writers (treeNodesToVtu, ot::writeVtu). The octree and a DA with the nodal field
+ * u = x + 2y + 3z and the element levels as elemental field are written with collective MPI-IO, then rank 0 reads
+ * the files back and checks the appended arrays: the byte counts, the number of cells, the levels and that the
+ * point values match u at the points (the hanging vertices are interpolated, which is exact for a linear field).
+ *
+ * usage: tstVtu numPts maxDepth fileName
+ *
+ * */
+
+#include "mpi.h"
+#include "petsc.h"
+#include "sys.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <cmath>
+#include <cstring>
+#include <stdint.h>
+
+#include "TreeNode.h"
+#include "genPts_par.h"
+#include "sfcSort.h"
+#include "oda.h"
+#include "odaUtils.h"
+#include "colors.h"
+#include "externVars.h"
+#include "dendro.h"
+#include "treenode2vtk.h"
+
+
+// Nodal coordinates (3 per node of the ghosted buffer) from the anchors of the elements, -1 if the node is not a
+// vertex of any element of the ALL loop.
+void getNodeCoordinates(ot::DA &da, std::vector<double> &X)
+{
+    const unsigned int maxD = da.getMaxDepth();
+    const double xFac = 1.0 / ((double) (1 << (maxD - 1)));
+    const ot::ElementLoop &loop = da.getElementLoop<ot::DA_FLAGS::ALL>();
+
+    X.assign(3 * da.getLocalBufferSize(), -1.0);
+    unsigned int idx[8];
+    for (unsigned int pos = 0; pos < loop.getNumElements(); pos++) {
+        const unsigned int elem = loop.getElement(pos);
+        const unsigned char hnMask = da.getHangingNodeIndex(elem);
+        const double h = xFac * (1 << (maxD - da.getLevel(elem)));
+        Point pt = loop.getAnchor(pos);
+        const unsigned char c = loop.getChildNumber(pos);
+        loop.getNodeIndices(pos, idx);
+        for (unsigned int v = 0; v < 8; v++) {
+            if (!((hnMask >> v) & 1u)) {
+                X[3 * idx[v]] = pt.x() * xFac + ((v & 1u) ? h : 0.0);
+                X[3 * idx[v] + 1] = pt.y() * xFac + ((v & 2u) ? h : 0.0);
+                X[3 * idx[v] + 2] = pt.z() * xFac + ((v & 4u) ? h : 0.0);
+            } else {
+                // the node of a hanging vertex is the vertex v of the parent
+                X[3 * idx[v]] = pt.x() * xFac - ((c & 1u) ? h : 0.0) + ((v & 1u) ? 2.0 * h : 0.0);
+                X[3 * idx[v] + 1] = pt.y() * xFac - ((c & 2u) ? h : 0.0) + ((v & 2u) ? 2.0 * h : 0.0);
+                X[3 * idx[v] + 2] = pt.z() * xFac - ((c & 4u) ? h : 0.0) + ((v & 4u) ? 2.0 * h : 0.0);
+            }
+        }
+    }
+}
+
+// The appended arrays of a VTU file written by cellsToVtu (name -> data without the byte count).
+struct VtuFile {
+    unsigned long long numCells;
+    std::vector<std::string> names;
+    std::vector<std::string> data;
+    bool valid;
+};
+
+std::string getAttribute(const std::string &s, size_t pos, const char *name)
+{
+    const std::string key = std::string(" ") + name + "=\"";
+    size_t b = s.find(key, pos);
+    if (b == std::string::npos) return "";
+    b += key.size();
+    return s.substr(b, s.find('"', b) - b);
+}
+
+VtuFile readVtu(const std::string &fileName)
+{
+    VtuFile f;
+    f.valid = false;
+    std::ifstream in(fileName.c_str(), std::ios::binary);
+    std::stringstream ss;
+    ss << in.rdbuf();
+    const std::string s = ss.str();
+
+    const std::string tag = "<AppendedData encoding=\"raw\">\n_";
+    const size_t appended = s.find(tag);
+    if (appended == std::string::npos) return f;
+    const size_t begin = appended + tag.size();
+    f.numCells = strtoull(getAttribute(s, s.find("<Piece"), "NumberOfCells").c_str(), NULL, 10);
+
+    // the arrays are stored in the order of the header
+    unsigned long long expected = 0;
+    size_t pos = s.find("<DataArray");
+    while (pos != std::string::npos && pos < appended) {
+        const unsigned long long offset = strtoull(getAttribute(s, pos, "offset").c_str(), NULL, 10);
+        if (offset != expected || begin + offset + sizeof(uint64_t) > s.size()) return f;
+        uint64_t numBytes;
+        memcpy(&numBytes, s.data() + begin + offset, sizeof(uint64_t));
+        f.names.push_back(getAttribute(s, pos, "Name"));
+        f.data.push_back(s.substr(begin + offset + sizeof(uint64_t), numBytes));
+        expected = offset + sizeof(uint64_t) + numBytes;
+        pos = s.find("<DataArray", pos + 1);
+    }
+    f.valid = (s.compare(begin + expected, std::string::npos, "\n  </AppendedData>\n</VTKFile>\n") == 0);
+    return f;
+}
+
+const std::string *getArray(const VtuFile &f, const char *name)
+{
+    for (unsigned int i = 0; i < f.names.size(); i++)
+        if (f.names[i] == name) return &(f.data[i]);
+    return NULL;
+}
+
+bool checkVtu(const std::string &fileName, unsigned long long numCells, unsigned long long levelSum, bool hasFields)
+{
+    VtuFile f = readVtu(fileName + ".vtu");
+    std::ifstream pvtu((fileName + ".pvtu").c_str());
+    bool state = f.valid && pvtu.good() && (f.numCells == numCells);
+
+    const std::string *points = getArray(f, "points");
+    const std::string *levels = getArray(f, "cell_level");
+    const std::string *types = getArray(f, "types");
+    state = state && points && levels && types && (points->size() == 24 * sizeof(float) * numCells) &&
+            (levels->size() == numCells) && (types->size() == numCells);
+    if (!state) return false;
+
+    unsigned long long sum = 0;
+    for (unsigned long long i = 0; i < numCells; i++)
+        sum += (unsigned char) (*levels)[i];
+    state = state && (sum == levelSum);
+
+    if (hasFields) {
+        const std::string *nodal = getArray(f, "nodal");
+        const std::string *elemental = getArray(f, "elemental");
+        state = state && nodal && elemental && (nodal->size() == 8 * sizeof(double) * numCells) &&
+                (elemental->size() == sizeof(double) * numCells);
+        if (!state) return false;
+        const float *X = reinterpret_cast<const float *>(points->data());
+        const double *u = reinterpret_cast<const double *>(nodal->data());
+        const double *lev = reinterpret_cast<const double *>(elemental->data());
+        double err = 0.0;
+        for (unsigned long long i = 0; i < 8 * numCells; i++)
+            err = std::max(err, fabs(u[i] - (X[3 * i] + 2.0 * X[3 * i + 1] + 3.0 * X[3 * i + 2])));
+        for (unsigned long long i = 0; i < numCells; i++)
+            state = state && (lev[i] == (unsigned char) (*levels)[i]);
+        state = state && (err < 1e-5);
+    }
+    return state;
+}
+
+int main(int argc, char **argv) {
+
+    PetscInitialize(&argc, &argv, "options", NULL);
+    ot::RegisterEvents();
+    ot::DA_Initialize(MPI_COMM_WORLD);
+
+    int rank, npes;
+    MPI_Comm comm = MPI_COMM_WORLD;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &npes);
+
+    if (argc < 4) {
+        if (!rank)
+            std::cerr << "Usage: " << argv[0] << " numPts maxDepth fileName" << std::endl;
+        ot::DA_Finalize();
+        PetscFinalize();
+        return -1;
+    }
+
+    DendroIntL numPts = atol(argv[1]);
+    unsigned int maxDepth = atoi(argv[2]);
+    std::string fileName = argv[3];
+    unsigned int dim = m_uiDim;
+
+    _InitializeHcurve(dim);
+
+    std::vector<double> pts;
+    genGauss(0.1, numPts, dim, pts);
+
+    std::vector<ot::TreeNode> tmpNodes;
+    pts2Octants(tmpNodes, &(*(pts.begin())), pts.size(), dim, maxDepth);
+    pts.clear();
+
+    std::vector<ot::TreeNode> tmpSorted, tmpConstruct, balOct;
+    ot::TreeNode root(0, 0, 0, 0, dim, maxDepth);
+    SFC::parSort::SFC_treeSort(tmpNodes, tmpSorted, tmpConstruct, balOct, 0.1, maxDepth, root, ROOT_ROTATION, 1,
+                               TS_BALANCE_OCTREE, NUM_NPES_THRESHOLD, comm);
+    tmpNodes.clear();
+    tmpSorted.clear();
+    tmpConstruct.clear();
+
+    // the octree
+    unsigned long long numCells = balOct.size(), levelSum = 0;
+    for (unsigned int i = 0; i < balOct.size(); i++)
+        levelSum += balOct[i].getLevel();
+    unsigned long long counts[2] = {numCells, levelSum}, counts_g[2];
+    MPI_Allreduce(counts, counts_g, 2, MPI_UNSIGNED_LONG_LONG, MPI_SUM, comm);
+
+    double t[2];
+    MPI_Barrier(comm);
+    t[0] = MPI_Wtime();
+    treeNodesToVtu(balOct, fileName + "_octree", comm);
+    t[0] = MPI_Wtime() - t[0];
+
+    bool allPassed = true;
+    if (!rank) {
+        bool state = checkVtu(fileName + "_octree", counts_g[0], counts_g[1], false);
+        std::cout << (state ? GRN : RED) << " treeNodesToVtu : " << (state ? "PASSED " : "FAILED ") << NRM
+                  << " cells: " << counts_g[0] << std::endl;
+        allPassed = state;
+    }
+
+    ot::DA da(balOct, comm, comm, false);
+    balOct.clear();
+
+    if (da.iAmActive()) {
+        MPI_Comm activeComm = da.getCommActive();
+        int activeRank;
+        MPI_Comm_rank(activeComm, &activeRank);
+#ifdef HILBERT_ORDERING
+        da.computeHilbertRotations();
+#endif
+        std::vector<double> X;
+        getNodeCoordinates(da, X);
+
+        Vec u, lev;
+        da.createVector(u, false, false, 1);
+        da.createVector(lev, true, false, 1);
+
+        PetscScalar *uArray, *levArray;
+        da.vecGetBuffer(u, uArray, false, false, false, 1);
+        for (unsigned int i = 0; i < da.getLocalBufferSize(); i++)
+            uArray[i] = (X[3 * i] < 0.0) ? 0.0 : (X[3 * i] + 2.0 * X[3 * i + 1] + 3.0 * X[3 * i + 2]);
+        da.vecRestoreBuffer(u, uArray, false, false, false, 1);
+
+        da.vecGetBuffer(lev, levArray, true, false, false, 1);
+        unsigned long long elemCounts[2] = {0, 0}, elemCounts_g[2];
+        for (da.init<ot::DA_FLAGS::WRITABLE>(); da.curr() < da.end<ot::DA_FLAGS::WRITABLE>();
+             da.next<ot::DA_FLAGS::WRITABLE>()) {
+            levArray[da.curr()] = da.getLevel(da.curr()) - 1;
+            elemCounts[0]++;
+            elemCounts[1] += da.getLevel(da.curr()) - 1;
+        }
+        da.vecRestoreBuffer(lev, levArray, true, false, false, 1);
+        MPI_Allreduce(elemCounts, elemCounts_g, 2, MPI_UNSIGNED_LONG_LONG, MPI_SUM, activeComm);
+
+        MPI_Barrier(activeComm);
+        t[1] = MPI_Wtime();
+        ot::writeVtu(&da, (fileName + "_da").c_str(), u, 1, lev, 1);
+        t[1] = MPI_Wtime() - t[1];
+
+        if (!activeRank) {
+            bool state = checkVtu(fileName + "_da", elemCounts_g[0], elemCounts_g[1], true);
+            std::cout << (state ? GRN : RED) << " writeVtu : " << (state ? "PASSED " : "FAILED ") << NRM
+                      << " elements: " << elemCounts_g[0] << " treeNodesToVtu (s): " << t[0] << " writeVtu (s): "
+                      << t[1] << std::endl;
+            allPassed = allPassed && state;
+        }
+
+        VecDestroy(&u);
+        VecDestroy(&lev);
+    }
+
+    MPI_Bcast(&allPassed, 1, MPI_CXX_BOOL, 0, comm);
+
+    ot::DA_Finalize();
+    PetscFinalize();
+    return (allPassed) ? 0 : 1;
+
+}
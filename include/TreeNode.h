@@ -32,6 +32,14 @@
 static int initialize_count=0;
 namespace ot {
 
+  /**
+    @brief The SFC (Hilbert or Morton) order of two octants given by their anchors and levels. Ancestors are
+    smaller. This is the comparison used by TreeNode::operator< and CompactTreeNode::operator<.
+    */
+  inline bool sfcLess(unsigned int x1, unsigned int y1, unsigned int z1, unsigned int lev1,
+                      unsigned int x2, unsigned int y2, unsigned int z2, unsigned int lev2,
+                      unsigned int dim, unsigned int maxDepth);
+
   /**
     @brief A class to manage octants.
     @author Rahul Sampath
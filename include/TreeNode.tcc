@@ -118,53 +118,32 @@ namespace ot {
     } //end fn.
 
 
-// The MAIN Comparison Function ...
-    inline bool TreeNode::operator<(TreeNode const &other) const {
-#ifdef __DEBUG_TN__
-        if (((this->m_uiDim) != (other.m_uiDim)) || ((this->m_uiMaxDepth) != (other.m_uiMaxDepth))) {
-      std::cout << "Me: " << (*this) << " Other: " << other << std::endl;
-      std::cout << "My Dim: " << m_uiDim << " OthDim: " << other.m_uiDim << " My MaxD: " << m_uiMaxDepth << " othMD: " << other.m_uiMaxDepth << std::endl;
-      assert(false);
-    }
-#endif
+    inline bool sfcLess(unsigned int x1, unsigned int y1, unsigned int z1, unsigned int lev1,
+                        unsigned int x2, unsigned int y2, unsigned int z2, unsigned int lev2,
+                        unsigned int dim, unsigned int maxDepth) {
 
-       if ((this->m_uiX == other.m_uiX) && (this->m_uiY == other.m_uiY) && (this->m_uiZ == other.m_uiZ)) {
-            return ((this->m_uiLevel & ot::TreeNode::MAX_LEVEL) < (other.m_uiLevel & ot::TreeNode::MAX_LEVEL));
+        //Ancestor is smaller.
+        if ((x1 == x2) && (y1 == y2) && (z1 == z2)) {
+            return (lev1 < lev2);
         } //end if
 
 #ifdef HILBERT_ORDERING
         // NOTE: To work the Hilbert Ordering You need the Hilbert Table Initialized.
-        // #pragma message "Hilbert"
-        unsigned int x1 = m_uiX;
-        unsigned int x2 = other.getX();
-
-        unsigned int y1 = m_uiY;
-        unsigned int y2 = other.getY();
-
-        unsigned int z1 = m_uiZ;
-        unsigned int z2 = other.getZ();
-
-        unsigned len;
-        unsigned int maxDepth = m_uiMaxDepth;
+        unsigned int len;
 
-        if(this->getLevel()>other.getLevel())
+        if(lev1>lev2)
         {
-            len=1u<<(this->getMaxDepth()-other.getLevel());
+            len=1u<<(maxDepth-lev2);
             if(!((x1<x2 || x1>=(x2+len)) || (y1<y2 || y1>=(y2+len)) ||(z1<z2 || z1>=(z2+len))))
                 return false;
-
-
-        }else if(this->getLevel()<other.getLevel())
+        }else if(lev1<lev2)
         {
-            len=1u<<(this->getMaxDepth()-this->getLevel());
+            len=1u<<(maxDepth-lev1);
             if(!((x2<x1 || x2>=(x1+len))||(y2<y1 || y2>=(y1+len))||(z2<z1 || z2>=(z1+len))))
                 return true;
-
-
         }
 
         unsigned int maxDiff = (unsigned int)(std::max((std::max((x1^x2),(y1^y2))),(z1^z2)));
-        int dim=m_uiDim;
 
         unsigned int maxDiffBinLen = binOp::binLength(maxDiff);
         //Eliminate the last maxDiffBinLen bits.
@@ -173,70 +152,62 @@ namespace ot {
         unsigned int ncaZ = ((z1>>maxDiffBinLen)<<maxDiffBinLen);
         unsigned int ncaLev = (maxDepth - maxDiffBinLen);
 
-
         unsigned int index1=0;
         unsigned int index2=0;
         unsigned int num_children=1u<<dim; // This is basically the hilbert table offset
         unsigned int rot_offset=num_children<<1;
-        char index_temp=0;
         int current_rot=0;
 
-        //unsigned int b_x,b_y,b_z;
-        //unsigned int a,b,c;
-        unsigned int mid_bit=m_uiMaxDepth;
+        unsigned int mid_bit=maxDepth;
 
-        for(int i=0; i<ncaLev;i++)
+        for(unsigned int i=0; i<ncaLev;i++)
         {
-            mid_bit=m_uiMaxDepth-i-1;
-
-            //b_x=((ncaX&(1<<mid_bit))>>mid_bit);
-            //b_y=((ncaY&(1<<mid_bit))>>mid_bit);
-            //b_z=((ncaZ&(1<<mid_bit))>>mid_bit);
-
-            // index1=(b_z<<2) + ((b_x^b_z)<<1) + (b_x^b_y^b_z);
+            mid_bit=maxDepth-i-1;
             index1= ((((ncaZ & (1u << mid_bit)) >> mid_bit) << 2u) |(((ncaY & (1u << mid_bit)) >> mid_bit) << 1u) | ((ncaX & (1u << mid_bit)) >> mid_bit));
-            //index_temp=rotations[rot_offset*current_rot+num_children+index1]-'0';
             current_rot=HILBERT_TABLE[current_rot*num_children+index1];
-
         }
 
-
         mid_bit--;
         index1= ((((z1 & (1u << mid_bit)) >> mid_bit) << 2u) |(((y1 & (1u << mid_bit)) >> mid_bit) << 1u) | ((x1 & (1u << mid_bit)) >> mid_bit));
         index2= ((((z2 & (1u << mid_bit)) >> mid_bit) << 2u) |(((y2 & (1u << mid_bit)) >> mid_bit) << 1u) | ((x2 & (1u << mid_bit)) >> mid_bit));
 
-
         return rotations[rot_offset*current_rot+num_children+index1] < rotations[rot_offset*current_rot+num_children+index2];
 
 #else
-	      // #pragma message "Morton"
-          // -- original Morton
-          // first compare the x, y, and z to determine which one dominates ...
-          //Ancestor is smaller.
-          if ((this->m_uiX == other.m_uiX) && (this->m_uiY == other.m_uiY) && (this->m_uiZ == other.m_uiZ)) {
-            return ((this->m_uiLevel & ot::TreeNode::MAX_LEVEL) < (other.m_uiLevel & ot::TreeNode::MAX_LEVEL));
-          } //end if
-
-          unsigned int x = (m_uiX ^ other.m_uiX);
-          unsigned int y = (m_uiY ^ other.m_uiY);
-          unsigned int z = (m_uiZ ^ other.m_uiZ);
-
-          //Default pref: z > y > x.
-          unsigned int maxC = z;
-          unsigned int yOrx = y;
-          if (yOrx < x) {if ((x ^ yOrx) >= yOrx) {yOrx = x;}
-          }
-          if (maxC < yOrx) {if ((maxC ^ yOrx) >= maxC) {maxC = yOrx;}
-          }
-
-          if (maxC == z) {return (m_uiZ < other.m_uiZ); } else if (maxC == y) {return (m_uiY < other.m_uiY); } else {return (m_uiX < other.m_uiX); }
         // -- original Morton
+        // first compare the x, y, and z to determine which one dominates ...
+        unsigned int x = (x1 ^ x2);
+        unsigned int y = (y1 ^ y2);
+        unsigned int z = (z1 ^ z2);
+
+        //Default pref: z > y > x.
+        unsigned int maxC = z;
+        unsigned int yOrx = y;
+        if (yOrx < x) {if ((x ^ yOrx) >= yOrx) {yOrx = x;}
+        }
+        if (maxC < yOrx) {if ((maxC ^ yOrx) >= maxC) {maxC = yOrx;}
+        }
 
-    // #endif
+        if (maxC == z) {return (z1 < z2); } else if (maxC == y) {return (y1 < y2); } else {return (x1 < x2); }
+        // -- original Morton
 #endif
 
     } //end function
 
+// The MAIN Comparison Function ...
+    inline bool TreeNode::operator<(TreeNode const &other) const {
+#ifdef __DEBUG_TN__
+        if (((this->m_uiDim) != (other.m_uiDim)) || ((this->m_uiMaxDepth) != (other.m_uiMaxDepth))) {
+      std::cout << "Me: " << (*this) << " Other: " << other << std::endl;
+      std::cout << "My Dim: " << m_uiDim << " OthDim: " << other.m_uiDim << " My MaxD: " << m_uiMaxDepth << " othMD: " << other.m_uiMaxDepth << std::endl;
+      assert(false);
+    }
+#endif
+        return sfcLess(m_uiX, m_uiY, m_uiZ, (m_uiLevel & ot::TreeNode::MAX_LEVEL),
+                       other.m_uiX, other.m_uiY, other.m_uiZ, (other.m_uiLevel & ot::TreeNode::MAX_LEVEL),
+                       m_uiDim, m_uiMaxDepth);
+    } //end function
+
     inline bool TreeNode::operator<=(TreeNode const &other) const {
 #ifdef __DEBUG_TN__
         if (((this->m_uiDim) != (other.m_uiDim)) || ((this->m_uiMaxDepth) != (other.m_uiMaxDepth))) {
@@ -57,6 +57,19 @@ namespace binOp{
     */
   int getPrevHighestPowerOfTwo(unsigned int n);
 
+  /**
+    @brief reverses the byte order of val (conversion between little and big endian)
+    */
+  template<typename T>
+  inline void byteSwap(T & val) {
+    unsigned char* bytes = reinterpret_cast<unsigned char*>(&val);
+    for(unsigned int i = 0; i < sizeof(T)/2; i++) {
+      unsigned char tmp = bytes[i];
+      bytes[i] = bytes[sizeof(T) - 1 - i];
+      bytes[sizeof(T) - 1 - i] = tmp;
+    }
+  }
+
 
 }//end namespace
 
@@ -0,0 +1,283 @@
+/**
+  @file compactTreeNode.h
+  @brief A compact (16 byte) octant for construction, balancing and partitioning.
+  ot::TreeNode stores x, y, z, level, weight, dim and maxDepth (28 bytes). Dim and maxDepth are the same for every
+  octant in a run, so CompactTreeNode stores only x, y, z and level (level is also used as a flag as in TreeNode) and
+  keeps dim and maxDepth as class wide values. The class provides the interface used by the SFC::seqSort and
+  SFC::parSort templates (SFC_treeSort, SFC_PartitionW) and has an MPI_Datatype associated with it.
+  The ordering (Hilbert or Morton) is identical to TreeNode's ordering.
+  CompactTreeNode does not store a weight (there is no getWeight()/setWeight()), so only unweighted partitioning
+  is supported: SFC_PartitionW and par::partitionW treat every compact octant as weight 1. Use TreeNode for
+  weighted partitions.
+  @author Milinda Fernando
+  */
+
+#ifndef _COMPACT_TREENODE_H_
+#define _COMPACT_TREENODE_H_
+
+#include "TreeNode.h"
+#include "hcurvedata.h"
+#include "binUtils.h"
+#include <iostream>
+#include <vector>
+#include <cassert>
+#include <omp.h>
+
+namespace ot {
+
+  /**
+    @brief 16 byte octant. Dim and maxDepth are shared by all the octants and should be set with
+    CompactTreeNode::setDimAndMaxDepth() (or toCompactTreeNodes()) before any octant is created.
+    @author Milinda Fernando
+    */
+  class CompactTreeNode {
+
+    protected:
+      //Level is also used as a flag.
+      unsigned int m_uiX, m_uiY, m_uiZ, m_uiLevel;
+
+      /**@brief class wide storage for dim and maxDepth*/
+      static inline unsigned int & dimRef() { static unsigned int dim=3; return dim; }
+      static inline unsigned int & maxDepthRef() { static unsigned int maxDepth=30; return maxDepth; }
+
+    public:
+
+      /**
+        @brief sets the dimension and the max depth of all the compact octants.
+        @param dim dimension of the tree
+        @param maxDepth max depth of the tree. Must be <= TreeNode::MAX_LEVEL
+        */
+      static inline void setDimAndMaxDepth(unsigned int dim, unsigned int maxDepth) {
+        assert(maxDepth<=ot::TreeNode::MAX_LEVEL);
+        dimRef()=dim;
+        maxDepthRef()=maxDepth;
+      }
+
+      /** @name Constructors */
+      //@{
+      CompactTreeNode() { m_uiX=m_uiY=m_uiZ=m_uiLevel=0; }
+
+      // The (unnamed) dim and maxDepth arguments below are only part of the constructor interface used by the
+      // SFC templates, T root(dim,maxDepth) and T(x,y,z,lev,dim,maxDepth). The class wide values are used.
+
+      /**@brief root octant.*/
+      CompactTreeNode(unsigned int, unsigned int) { m_uiX=m_uiY=m_uiZ=m_uiLevel=0; }
+
+      CompactTreeNode(unsigned int x, unsigned int y, unsigned int z, unsigned int level, unsigned int, unsigned int) {
+        m_uiX=x;
+        m_uiY=(getDim()>1) ? y : 0;
+        m_uiZ=(getDim()>2) ? z : 0;
+        m_uiLevel=level;
+      }
+
+      explicit CompactTreeNode(const TreeNode & other) {
+#ifdef __DEBUG_TN__
+        assert(other.getDim()==getDim() && other.getMaxDepth()==getMaxDepth());
+#endif
+        m_uiX=other.getX();
+        m_uiY=other.getY();
+        m_uiZ=other.getZ();
+        m_uiLevel=other.getLevel()|other.getFlag();
+      }
+      //@}
+
+      /**@return the equivalent TreeNode. (weight is set to 1)*/
+      inline TreeNode toTreeNode() const {
+        TreeNode res(1,m_uiX,m_uiY,m_uiZ,getLevel(),getDim(),getMaxDepth());
+        res.setFlag(m_uiLevel);
+        return res;
+      }
+
+      /** @name Getters and Setters */
+      //@{
+      static inline unsigned int getDim() { return dimRef(); }
+      static inline unsigned int getMaxDepth() { return maxDepthRef(); }
+      inline unsigned int getX() const { return m_uiX; }
+      inline unsigned int getY() const { return m_uiY; }
+      inline unsigned int getZ() const { return m_uiZ; }
+      inline unsigned int getLevel() const { return (m_uiLevel & ot::TreeNode::MAX_LEVEL); }
+      inline unsigned int getFlag() const { return m_uiLevel; }
+      inline int setFlag(unsigned int w) { m_uiLevel=w; return 1; }
+      inline int orFlag(unsigned int w) { m_uiLevel=(m_uiLevel|w); return 1; }
+
+      inline unsigned int minX() const { return m_uiX; }
+      inline unsigned int minY() const { return (getDim()<2) ? 0 : m_uiY; }
+      inline unsigned int minZ() const { return (getDim()<3) ? 0 : m_uiZ; }
+      inline unsigned int maxX() const { return (minX()+(1u<<(getMaxDepth()-getLevel()))); }
+      inline unsigned int maxY() const { return (getDim()<2) ? 1 : (minY()+(1u<<(getMaxDepth()-getLevel()))); }
+      inline unsigned int maxZ() const { return (getDim()<3) ? 1 : (minZ()+(1u<<(getMaxDepth()-getLevel()))); }
+      //@}
+
+      inline bool isRoot() const { return (getLevel()==0); }
+
+      /**@return 'true' if this is an ancestor of 'other'*/
+      inline bool isAncestor(CompactTreeNode const & other) const {
+        return ( (getLevel() < other.getLevel()) && (other.minX() >= minX()) && (other.minY() >= minY()) && (other.minZ() >= minZ())
+                 && (other.maxX() <= maxX()) && (other.maxY() <= maxY()) && (other.maxZ() <= maxZ()) );
+      }
+
+      /**@return the ancestor of this octant at level 'ancLev'*/
+      inline CompactTreeNode getAncestor(unsigned int ancLev) const {
+        const unsigned int shift=getMaxDepth()-ancLev;
+        CompactTreeNode res;
+        res.m_uiX=((m_uiX>>shift)<<shift);
+        res.m_uiY=((m_uiY>>shift)<<shift);
+        res.m_uiZ=((m_uiZ>>shift)<<shift);
+        res.m_uiLevel=ancLev;
+        return res;
+      }
+
+      /**@return the parent of this octant. (root's parent is root)*/
+      inline CompactTreeNode getParent() const {
+        return getAncestor((getLevel()>0) ? (getLevel()-1) : 0);
+      }
+
+      /**
+        @brief returns the neighbour at the same level shifted by (dx,dy,dz) octant lengths. If the neighbour
+        is outside the domain the root is returned (same convention as TreeNode::getLeft() etc).
+        */
+      inline CompactTreeNode getNeighbour(int dx, int dy, int dz) const {
+        const long len=(1l<<(getMaxDepth()-getLevel()));
+        const long domain=(1l<<getMaxDepth());
+        const long x=(long)m_uiX+dx*len;
+        const long y=(long)m_uiY+dy*len;
+        const long z=(long)m_uiZ+dz*len;
+        if( x<0 || x>=domain || ((getDim()>1) && (y<0 || y>=domain)) || ((getDim()>2) && (z<0 || z>=domain)) || (getDim()<2 && dy) || (getDim()<3 && dz) )
+          return CompactTreeNode();
+        CompactTreeNode res;
+        res.m_uiX=x;
+        res.m_uiY=y;
+        res.m_uiZ=z;
+        res.m_uiLevel=getLevel();
+        return res;
+      }
+
+      /** @name Get Neighbours at the same level as the current octant */
+      //@{
+      inline CompactTreeNode getLeft() const { return getNeighbour(-1,0,0); }
+      inline CompactTreeNode getRight() const { return getNeighbour(1,0,0); }
+      inline CompactTreeNode getFront() const { return getNeighbour(0,-1,0); }
+      inline CompactTreeNode getBack() const { return getNeighbour(0,1,0); }
+      inline CompactTreeNode getBottom() const { return getNeighbour(0,0,-1); }
+      inline CompactTreeNode getTop() const { return getNeighbour(0,0,1); }
+      inline CompactTreeNode getLeftBack() const { return getNeighbour(-1,1,0); }
+      inline CompactTreeNode getRightBack() const { return getNeighbour(1,1,0); }
+      inline CompactTreeNode getLeftFront() const { return getNeighbour(-1,-1,0); }
+      inline CompactTreeNode getRightFront() const { return getNeighbour(1,-1,0); }
+      inline CompactTreeNode getBottomLeft() const { return getNeighbour(-1,0,-1); }
+      inline CompactTreeNode getBottomRight() const { return getNeighbour(1,0,-1); }
+      inline CompactTreeNode getBottomBack() const { return getNeighbour(0,1,-1); }
+      inline CompactTreeNode getBottomFront() const { return getNeighbour(0,-1,-1); }
+      inline CompactTreeNode getBottomLeftBack() const { return getNeighbour(-1,1,-1); }
+      inline CompactTreeNode getBottomRightBack() const { return getNeighbour(1,1,-1); }
+      inline CompactTreeNode getBottomLeftFront() const { return getNeighbour(-1,-1,-1); }
+      inline CompactTreeNode getBottomRightFront() const { return getNeighbour(1,-1,-1); }
+      inline CompactTreeNode getTopLeft() const { return getNeighbour(-1,0,1); }
+      inline CompactTreeNode getTopRight() const { return getNeighbour(1,0,1); }
+      inline CompactTreeNode getTopBack() const { return getNeighbour(0,1,1); }
+      inline CompactTreeNode getTopFront() const { return getNeighbour(0,-1,1); }
+      inline CompactTreeNode getTopLeftBack() const { return getNeighbour(-1,1,1); }
+      inline CompactTreeNode getTopRightBack() const { return getNeighbour(1,1,1); }
+      inline CompactTreeNode getTopLeftFront() const { return getNeighbour(-1,-1,1); }
+      inline CompactTreeNode getTopRightFront() const { return getNeighbour(1,-1,1); }
+      //@}
+
+      /** @name Overload operators */
+      //@{
+      inline bool operator == (CompactTreeNode const & other) const {
+        return ((m_uiX==other.m_uiX) && (m_uiY==other.m_uiY) && (m_uiZ==other.m_uiZ) && (getLevel()==other.getLevel()));
+      }
+
+      inline bool operator != (CompactTreeNode const & other) const { return (!((*this)==other)); }
+
+      // same order as TreeNode::operator<
+      inline bool operator < (CompactTreeNode const & other) const {
+        return sfcLess(m_uiX, m_uiY, m_uiZ, getLevel(), other.m_uiX, other.m_uiY, other.m_uiZ, other.getLevel(),
+                       getDim(), getMaxDepth());
+      }
+
+      inline bool operator <= (CompactTreeNode const & other) const { return (((*this) < other) || ((*this) == other)); }
+      inline bool operator > (CompactTreeNode const & other) const { return ((!((*this) < other)) && (!((*this) == other))); }
+      inline bool operator >= (CompactTreeNode const & other) const { return (!((*this) < other)); }
+
+      friend std::ostream & operator << (std::ostream & os, CompactTreeNode const & node) {
+        return (os << node.getX() << " " << node.getY() << " " << node.getZ() << " " << node.getLevel());
+      }
+      //@}
+
+  };//end class definition
+
+
+  /**
+   * @author Milinda Fernando
+   * @breif converts octants to compact octants and sets the class wide dim and maxDepth from the input.
+   * @param[in] in: input octants
+   * @param[out] out: compact octants.
+   * */
+  inline void toCompactTreeNodes(const std::vector<TreeNode> & in, std::vector<CompactTreeNode> & out)
+  {
+    const long n=in.size();
+    if(n) CompactTreeNode::setDimAndMaxDepth(in[0].getDim(),in[0].getMaxDepth());
+    out.resize(n);
+    #pragma omp parallel for
+    for(long i=0;i<n;i++)
+      out[i]=CompactTreeNode(in[i]);
+  }
+
+  /**
+   * @author Milinda Fernando
+   * @breif converts compact octants back to octants.
+   * @param[in] in: compact octants
+   * @param[out] out: octants.
+   * */
+  inline void fromCompactTreeNodes(const std::vector<CompactTreeNode> & in, std::vector<TreeNode> & out)
+  {
+    const long n=in.size();
+    out.resize(n);
+    #pragma omp parallel for
+    for(long i=0;i<n;i++)
+      out[i]=in[i].toTreeNode();
+  }
+
+}//end namespace
+
+namespace par {
+
+  //Forward Declaration
+  template <typename T>
+    class Mpi_datatype;
+
+  /**
+    @author Milinda Fernando
+    @brief A template specialization of the abstract class "Mpi_datatype" for
+    communicating messages of type "ot::CompactTreeNode". (4 unsigned ints)
+    */
+  template <>
+    class Mpi_datatype< ot::CompactTreeNode > {
+
+      public:
+
+        /**
+          @return The MPI_Datatype corresponding to the datatype "ot::CompactTreeNode".
+          */
+        static MPI_Datatype value()
+        {
+          static bool         first = true;
+          static MPI_Datatype datatype;
+
+          if (first)
+          {
+            first = false;
+            MPI_Type_contiguous(4, MPI_UNSIGNED, &datatype);
+            MPI_Type_commit(&datatype);
+          }
+
+          return datatype;
+        }
+
+    };
+
+}//end namespace par
+
+
+#endif
@@ -0,0 +1,98 @@
+/**
+  @file elementBatch.h
+  @brief Batched (structure of arrays) application of an 8x8 elemental stencil.
+  @author Milinda Fernando
+  */
+
+#ifndef _ELEMENT_BATCH_H_
+#define _ELEMENT_BATCH_H_
+
+#if defined(FE_SIMD_KERNELS) && (defined(__AVX512F__) || defined(__AVX2__))
+#include <immintrin.h>
+#endif
+
+namespace ot {
+
+  /**
+    @author Milinda Fernando
+    @brief out += fac[e] * A * in for the elements e < numElems of a batch. The values are stored as structure of
+    arrays, value i (= vertex*dof + component) of element e is at [i*stride + e], so the elements of the batch are
+    the vector lanes. With FE_SIMD_KERNELS the lanes are processed with AVX-512 (8 elements) or AVX2 (4 elements)
+    intrinsics, depending on the target of the compiler. The remaining elements use the scalar loop.
+    @param A the stencil, 8x8 row major
+    @param fac the scaling factor of each element
+    @param in the vertex values of the batch, 8*dof*stride
+    @param out the result, 8*dof*stride
+    @param dof the degrees of freedom per vertex
+    @param numElems the number of elements in the batch (<= stride)
+    @param stride the capacity of the batch
+    */
+  inline void stencilMatVecBatch(const double* A, const double* fac, const double* in, double* out,
+      unsigned int dof, unsigned int numElems, unsigned int stride) {
+    unsigned int e = 0;
+
+#if defined(FE_SIMD_KERNELS) && defined(__AVX512F__)
+    for (; e + 8 <= numElems; e += 8) {
+      const __m512d f = _mm512_loadu_pd(fac + e);
+      for (unsigned int d = 0; d < dof; d++) {
+        __m512d x[8];
+        for (unsigned int j = 0; j < 8; j++) {
+          x[j] = _mm512_loadu_pd(in + (j*dof + d)*stride + e);
+        }
+        for (unsigned int k = 0; k < 8; k++) {
+          __m512d acc = _mm512_mul_pd(_mm512_set1_pd(A[8*k]), x[0]);
+          for (unsigned int j = 1; j < 8; j++) {
+            acc = _mm512_fmadd_pd(_mm512_set1_pd(A[8*k + j]), x[j], acc);
+          }
+          double* o = out + (k*dof + d)*stride + e;
+          _mm512_storeu_pd(o, _mm512_fmadd_pd(f, acc, _mm512_loadu_pd(o)));
+        }
+      }
+    }
+#elif defined(FE_SIMD_KERNELS) && defined(__AVX2__)
+    for (; e + 4 <= numElems; e += 4) {
+      const __m256d f = _mm256_loadu_pd(fac + e);
+      for (unsigned int d = 0; d < dof; d++) {
+        __m256d x[8];
+        for (unsigned int j = 0; j < 8; j++) {
+          x[j] = _mm256_loadu_pd(in + (j*dof + d)*stride + e);
+        }
+        for (unsigned int k = 0; k < 8; k++) {
+          __m256d acc = _mm256_mul_pd(_mm256_set1_pd(A[8*k]), x[0]);
+          for (unsigned int j = 1; j < 8; j++) {
+#ifdef __FMA__
+            acc = _mm256_fmadd_pd(_mm256_set1_pd(A[8*k + j]), x[j], acc);
+#else
+            acc = _mm256_add_pd(acc, _mm256_mul_pd(_mm256_set1_pd(A[8*k + j]), x[j]));
+#endif
+          }
+          double* o = out + (k*dof + d)*stride + e;
+          _mm256_storeu_pd(o, _mm256_add_pd(_mm256_loadu_pd(o), _mm256_mul_pd(f, acc)));
+        }
+      }
+    }
+#endif
+
+    // scalar fallback (and the remainder of the batch), the lanes are the innermost loop so that it vectorizes
+    // for the target of the compiler.
+    const unsigned int vs = dof*stride;
+    for (unsigned int d = 0; d < dof; d++) {
+      const double* x = in + d*stride;
+      for (unsigned int k = 0; k < 8; k++) {
+        const double* a = A + 8*k;
+        double* __restrict o = out + (k*dof + d)*stride;
+#ifdef _OPENMP
+#pragma omp simd
+#endif
+        for (unsigned int l = e; l < numElems; l++) {
+          o[l] += fac[l]*(a[0]*x[l] + a[1]*x[vs + l] + a[2]*x[2*vs + l] + a[3]*x[3*vs + l]
+              + a[4]*x[4*vs + l] + a[5]*x[5*vs + l] + a[6]*x[6*vs + l] + a[7]*x[7*vs + l]);
+        }
+      }
+    }
+  }
+
+} //end namespace
+
+#endif
+
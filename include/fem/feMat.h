@@ -1,8 +1,15 @@
 #ifndef __FE_MAT_H_
 #define __FE_MAT_H_
 
+#include <vector>
+#include <algorithm>
 #include "petscdmda.h"
 #include "oda.h"
+#include "hangingInterp.h"
+
+#ifndef FE_ELEMENT_BATCH_SIZE
+#define FE_ELEMENT_BATCH_SIZE 32
+#endif
 
 #define sh1 0.7886751345948129  //  ( 1 + psi(q1))/2
 #define sh2 0.2113248654051871  //  ( 1 + psi(q2))/2
@@ -65,6 +72,54 @@ class feMat {
     m_dLz = z;
   }
 protected:
+  /**
+   * 	@brief		The gather-compute-scatter over the elements of loop of the octree DA.
+   * 				The values of the 8 vertices of an element are gathered (hanging vertices
+   * 				are interpolated from the parent's nodes) into batches of FE_ELEMENT_BATCH_SIZE
+   * 				elements, kernel(in_local, out_local, coords, numElems) is called once per
+   * 				batch and out_local is scattered into out with the transposed interpolation.
+   * 				out_local is zero when kernel is called. The layout of the batch is described
+   * 				in feMatrix::ElementalMatVecBatch(). With OMP_MATVEC kernel is called from
+   * 				several threads on the chunks of one color, otherwise the chunks are visited
+   * 				in SFC order.
+   * 	@param		dof the degrees of freedom per node of in and out.
+   **/
+  template <typename Kernel>
+  void elementBatchLoop(const ot::ElementLoop & loop, PetscScalar *in, PetscScalar *out, unsigned int dof,
+      const Kernel & kernel);
+
+  /**
+   * 	@brief		Adds the diagonal of the operator applied by elementBatchLoop() with the same kernel to diag,
+   * 				i.e. the diagonal of P^T K P for every element, P is the hanging interpolation. The kernel
+   * 				is applied to the interpolated unit vector of each of the 8*dof nodal values of the batch,
+   * 				so this costs 8*dof kernel calls per batch.
+   **/
+  template <typename Kernel>
+  void elementBatchDiagonal(const ot::ElementLoop & loop, PetscScalar *diag, unsigned int dof,
+      const Kernel & kernel);
+
+  /**
+   * 	@brief		Appends the nonzero entries of the element matrices P^T K P of the operator applied by
+   * 				elementBatchLoop() with the same kernel to records (local node indices, see
+   * 				ot::DA::setValuesInMatrix()). Like elementBatchDiagonal() this costs 8*dof kernel calls
+   * 				per batch, the loop is not threaded.
+   **/
+  template <typename Kernel>
+  void elementBatchMatrix(const ot::ElementLoop & loop, std::vector<ot::MatRecord> & records, unsigned int dof,
+      const Kernel & kernel);
+
+  /**
+   * 	@brief		The size of a unit of the octree (the anchors) in x, y and z, fac[3]. Computed once per loop
+   * 				for getBatchCoords().
+   **/
+  void getBatchCoordFactors(double *fac);
+
+  /**
+   * 	@brief		The coordinates of the 8 vertices of the element at position pos of loop in the batch
+   * 				layout, i.e. coordinate c of vertex v is crd[(3*v + c)*FE_ELEMENT_BATCH_SIZE].
+   * 	@param		fac the factors from getBatchCoordFactors()
+   **/
+  void getBatchCoords(const ot::ElementLoop & loop, unsigned int pos, const double *fac, PetscScalar *crd);
 
   daType          m_daType;
 
@@ -76,4 +131,259 @@ protected:
   double m_dLz;
 };
 
+template <typename Kernel>
+void feMat::elementBatchLoop(const ot::ElementLoop & loop, PetscScalar *in, PetscScalar *out, unsigned int dof,
+    const Kernel & kernel) {
+	const unsigned int nv = 8*dof;
+	double crdFac[3];
+	getBatchCoordFactors(crdFac);
+#ifdef OMP_MATVEC
+	const bool colored = true;
+#else
+	// without threads the chunks are visited in SFC order, the chunks of one color are spread over the whole mesh
+	const bool colored = false;
+#endif
+	const unsigned int numColors = colored ? loop.getNumColors() : 1;
+
+	for (unsigned int color = 0; color < numColors; color++) {
+		const int cBegin = colored ? loop.colorOffsets[color] : 0;
+		const int cEnd = colored ? loop.colorOffsets[color + 1] : loop.getNumChunks();
+#ifdef OMP_MATVEC
+#pragma omp parallel
+#endif
+		{
+			std::vector<PetscScalar> local_in(FE_ELEMENT_BATCH_SIZE*nv);
+			std::vector<PetscScalar> local_out(FE_ELEMENT_BATCH_SIZE*nv);
+			std::vector<PetscScalar> coords(FE_ELEMENT_BATCH_SIZE*24);
+			const ot::HangingInterp* interp[FE_ELEMENT_BATCH_SIZE];
+			unsigned int idx[FE_ELEMENT_BATCH_SIZE][8];
+
+#ifdef OMP_MATVEC
+#pragma omp for schedule(dynamic)
+#endif
+			for (int c = cBegin; c < cEnd; c++) {
+				const unsigned int chunk = colored ? loop.colorChunks[c] : c;
+				for (unsigned int b = loop.chunkBegin(chunk); b < loop.chunkEnd(chunk); b += FE_ELEMENT_BATCH_SIZE) {
+					const unsigned int numElems = std::min<unsigned int>(FE_ELEMENT_BATCH_SIZE, loop.chunkEnd(chunk) - b);
+
+					// gather, the elements of the batch are the fastest index. The hanging vertices are interpolated
+					// from x, x[8] = 0 is the unused source (see ot::HangingInterp) ...
+					for (unsigned int e = 0; e < numElems; e++) {
+						const unsigned int pos = b + e;
+						loop.getNodeIndices(pos, idx[e]);
+						interp[e] = &ot::getHangingInterp(loop.getChildNumber(pos), loop.getHangingNodeIndex(pos));
+						const ot::HangingInterp & hi = *(interp[e]);
+
+						PetscScalar* loc = &(local_in[e]);
+						for (unsigned int i = 0; i < dof; i++) {
+							PetscScalar x[9];
+							for (unsigned int s = 0; s < 8; s++) {
+								x[s] = in[dof*idx[e][s] + i];
+							}
+							x[8] = 0.0;
+							for (unsigned int v = 0; v < 8; v++) {
+								loc[(v*dof + i)*FE_ELEMENT_BATCH_SIZE] = hi.weight[v]*(x[hi.src[v][0]] + x[hi.src[v][1]]
+										+ x[hi.src[v][2]] + x[hi.src[v][3]]);
+							}
+						}
+
+						getBatchCoords(loop, pos, crdFac, &(coords[e]));
+					}
+
+					// compute ...
+					std::fill(local_out.begin(), local_out.end(), 0.0);
+					kernel(&(*(local_in.begin())), &(*(local_out.begin())), &(*(coords.begin())), numElems);
+
+					// scatter with the dense transpose of the interpolation, unlike updates through src the sums are
+					// independent ...
+					for (unsigned int e = 0; e < numElems; e++) {
+						const ot::HangingInterp & hi = *(interp[e]);
+						const PetscScalar* loc = &(local_out[e]);
+						for (unsigned int i = 0; i < dof; i++) {
+							PetscScalar y[8];
+							for (unsigned int v = 0; v < 8; v++) {
+								y[v] = loc[(v*dof + i)*FE_ELEMENT_BATCH_SIZE];
+							}
+							for (unsigned int s = 0; s < 8; s++) {
+								out[dof*idx[e][s] + i] += hi.P[0][s]*y[0] + hi.P[1][s]*y[1] + hi.P[2][s]*y[2] + hi.P[3][s]*y[3]
+									+ hi.P[4][s]*y[4] + hi.P[5][s]*y[5] + hi.P[6][s]*y[6] + hi.P[7][s]*y[7];
+							}
+						}
+					}
+				}//end batch
+			}//end chunk
+		}
+	}//end color
+}//end function
+
+template <typename Kernel>
+void feMat::elementBatchDiagonal(const ot::ElementLoop & loop, PetscScalar *diag, unsigned int dof,
+    const Kernel & kernel) {
+	const unsigned int nv = 8*dof;
+	double crdFac[3];
+	getBatchCoordFactors(crdFac);
+#ifdef OMP_MATVEC
+	const bool colored = true;
+#else
+	// SFC order without threads, see elementBatchLoop()
+	const bool colored = false;
+#endif
+	const unsigned int numColors = colored ? loop.getNumColors() : 1;
+
+	for (unsigned int color = 0; color < numColors; color++) {
+		const int cBegin = colored ? loop.colorOffsets[color] : 0;
+		const int cEnd = colored ? loop.colorOffsets[color + 1] : loop.getNumChunks();
+#ifdef OMP_MATVEC
+#pragma omp parallel
+#endif
+		{
+			std::vector<PetscScalar> local_in(FE_ELEMENT_BATCH_SIZE*nv);
+			std::vector<PetscScalar> local_out(FE_ELEMENT_BATCH_SIZE*nv);
+			std::vector<PetscScalar> coords(FE_ELEMENT_BATCH_SIZE*24);
+			const ot::HangingInterp* interp[FE_ELEMENT_BATCH_SIZE];
+			unsigned int idx[FE_ELEMENT_BATCH_SIZE][8];
+
+#ifdef OMP_MATVEC
+#pragma omp for schedule(dynamic)
+#endif
+			for (int c = cBegin; c < cEnd; c++) {
+				const unsigned int chunk = colored ? loop.colorChunks[c] : c;
+				for (unsigned int b = loop.chunkBegin(chunk); b < loop.chunkEnd(chunk); b += FE_ELEMENT_BATCH_SIZE) {
+					const unsigned int numElems = std::min<unsigned int>(FE_ELEMENT_BATCH_SIZE, loop.chunkEnd(chunk) - b);
+
+					for (unsigned int e = 0; e < numElems; e++) {
+						const unsigned int pos = b + e;
+						loop.getNodeIndices(pos, idx[e]);
+						interp[e] = &ot::getHangingInterp(loop.getChildNumber(pos), loop.getHangingNodeIndex(pos));
+						getBatchCoords(loop, pos, crdFac, &(coords[e]));
+					}
+
+					// one column of P^T K P per node j and component i ...
+					for (unsigned int j = 0; j < 8; j++) {
+						for (unsigned int i = 0; i < dof; i++) {
+							// P e_j, the weight of node j at each vertex ...
+							std::fill(local_in.begin(), local_in.end(), 0.0);
+							for (unsigned int e = 0; e < numElems; e++) {
+								const ot::HangingInterp & hi = *(interp[e]);
+								for (unsigned int v = 0; v < 8; v++) {
+									local_in[(v*dof + i)*FE_ELEMENT_BATCH_SIZE + e] = hi.P[v][j];
+								}
+							}
+
+							std::fill(local_out.begin(), local_out.end(), 0.0);
+							kernel(&(*(local_in.begin())), &(*(local_out.begin())), &(*(coords.begin())), numElems);
+
+							// (P e_j)^T K P e_j ...
+							for (unsigned int e = 0; e < numElems; e++) {
+								PetscScalar val = 0.0;
+								for (unsigned int v = 0; v < 8; v++) {
+									val += local_in[(v*dof + i)*FE_ELEMENT_BATCH_SIZE + e]*
+										local_out[(v*dof + i)*FE_ELEMENT_BATCH_SIZE + e];
+								}
+								diag[dof*idx[e][j] + i] += val;
+							}
+						}//end i
+					}//end j
+				}//end batch
+			}//end chunk
+		}
+	}//end color
+}//end function
+
+template <typename Kernel>
+void feMat::elementBatchMatrix(const ot::ElementLoop & loop, std::vector<ot::MatRecord> & records, unsigned int dof,
+    const Kernel & kernel) {
+	const unsigned int nv = 8*dof;
+	double crdFac[3];
+	getBatchCoordFactors(crdFac);
+
+	std::vector<PetscScalar> local_in(FE_ELEMENT_BATCH_SIZE*nv);
+	std::vector<PetscScalar> local_out(FE_ELEMENT_BATCH_SIZE*nv);
+	std::vector<PetscScalar> coords(FE_ELEMENT_BATCH_SIZE*24);
+	std::vector<PetscScalar> col(nv);
+	const ot::HangingInterp* interp[FE_ELEMENT_BATCH_SIZE];
+	unsigned int idx[FE_ELEMENT_BATCH_SIZE][8];
+
+	ot::MatRecord rec;
+	for (unsigned int chunk = 0; chunk < loop.getNumChunks(); chunk++) {
+		for (unsigned int b = loop.chunkBegin(chunk); b < loop.chunkEnd(chunk); b += FE_ELEMENT_BATCH_SIZE) {
+			const unsigned int numElems = std::min<unsigned int>(FE_ELEMENT_BATCH_SIZE, loop.chunkEnd(chunk) - b);
+
+			for (unsigned int e = 0; e < numElems; e++) {
+				const unsigned int pos = b + e;
+				loop.getNodeIndices(pos, idx[e]);
+				interp[e] = &ot::getHangingInterp(loop.getChildNumber(pos), loop.getHangingNodeIndex(pos));
+				getBatchCoords(loop, pos, crdFac, &(coords[e]));
+			}
+
+			// one column of P^T K P per node j and component i ...
+			for (unsigned int j = 0; j < 8; j++) {
+				for (unsigned int i = 0; i < dof; i++) {
+					// P e_j ...
+					std::fill(local_in.begin(), local_in.end(), 0.0);
+					for (unsigned int e = 0; e < numElems; e++) {
+						const ot::HangingInterp & hi = *(interp[e]);
+						for (unsigned int v = 0; v < 8; v++) {
+							local_in[(v*dof + i)*FE_ELEMENT_BATCH_SIZE + e] = hi.P[v][j];
+						}
+					}
+
+					std::fill(local_out.begin(), local_out.end(), 0.0);
+					kernel(&(*(local_in.begin())), &(*(local_out.begin())), &(*(coords.begin())), numElems);
+
+					// P^T K P e_j, row k of the column gets the outputs of the vertices interpolated from node k ...
+					for (unsigned int e = 0; e < numElems; e++) {
+						const ot::HangingInterp & hi = *(interp[e]);
+						std::fill(col.begin(), col.end(), 0.0);
+						for (unsigned int v = 0; v < 8; v++) {
+							for (unsigned int r = 0; r < dof; r++) {
+								const PetscScalar val = hi.weight[v]*local_out[(v*dof + r)*FE_ELEMENT_BATCH_SIZE + e];
+								for (unsigned int q = 0; q < hi.numSrc[v]; q++) {
+									col[hi.src[v][q]*dof + r] += val;
+								}
+							}
+						}
+
+						rec.colIdx = idx[e][j];
+						rec.colDim = i;
+						for (unsigned int k = 0; k < 8; k++) {
+							for (unsigned int r = 0; r < dof; r++) {
+								if (col[k*dof + r] != 0.0) {
+									rec.rowIdx = idx[e][k];
+									rec.rowDim = r;
+									rec.val = col[k*dof + r];
+									records.push_back(rec);
+								}
+							}
+						}
+					}
+				}//end i
+			}//end j
+		}//end batch
+	}//end chunk
+}//end function
+
+inline void feMat::getBatchCoordFactors(double *fac) {
+	const unsigned int maxD = m_octDA->getMaxDepth();
+	fac[0] = m_dLx/((double)(1<<(maxD-1)));
+	fac[1] = m_dLy/((double)(1<<(maxD-1)));
+	fac[2] = m_dLz/((double)(1<<(maxD-1)));
+}//end function
+
+inline void feMat::getBatchCoords(const ot::ElementLoop & loop, unsigned int pos, const double *fac,
+    PetscScalar *crd) {
+	const double len = (double)(1u<<(m_octDA->getMaxDepth() - m_octDA->getLevel(loop.getElement(pos))));
+	const double x = loop.anchors[3*pos]*fac[0];
+	const double y = loop.anchors[3*pos + 1]*fac[1];
+	const double z = loop.anchors[3*pos + 2]*fac[2];
+	const double hx = len*fac[0];
+	const double hy = len*fac[1];
+	const double hz = len*fac[2];
+	for (unsigned int v = 0; v < 8; v++) {
+		crd[(3*v)*FE_ELEMENT_BATCH_SIZE]     = x + ((v & 1u) ? hx : 0.0);
+		crd[(3*v + 1)*FE_ELEMENT_BATCH_SIZE] = y + ((v & 2u) ? hy : 0.0);
+		crd[(3*v + 2)*FE_ELEMENT_BATCH_SIZE] = z + ((v & 4u) ? hz : 0.0);
+	}
+}//end function
+
 #endif
@@ -4,6 +4,8 @@
 #include <string>
 #include "feMat.h"
 #include "timeInfo.h"
+#include "hangingInterp.h"
+#include "elementBatch.h"
 
 template <typename T>
 class feMatrix : public feMat {
@@ -60,8 +62,30 @@ class feMatrix : public feMat {
    **/
   virtual bool MatVec(Vec _in, Vec _out, double scale=1.0);
 
+  /**
+   * 	@brief		Applies ElementalMatVec() to all the elements of loop using OpenMP
+   * 				threads. The chunks of one color do not share nodes, so they are
+   * 				processed concurrently and scatter into out without races.
+   **/
+  void ElementLoopMatVec(const ot::ElementLoop & loop, PetscScalar *in, PetscScalar *out, double scale);
+
+  /**
+   * 	@brief		Matrix-free matrix-vector multiplication by gather, compute and scatter.
+   * 				For the octree DA the values of the 8 vertices of an element are gathered
+   * 				(hanging vertices are interpolated from the parent's nodes) into contiguous
+   * 				batches of FE_ELEMENT_BATCH_SIZE elements of 8*dof values, the batched
+   * 				elemental kernel ElementalMatVecBatch() is applied and the results are
+   * 				scattered back with the transposed interpolation. The kernel only sees
+   * 				regular elements. The independent elements are processed while the ghost
+   * 				values are communicated.
+   **/
 	virtual bool MatVec_new(Vec _in, Vec _out, double scale=1.0);
 
+  /**
+   * 	@brief		The gather-compute-scatter of MatVec_new() over the elements of loop.
+   **/
+  void ElementBatchMatVec(const ot::ElementLoop & loop, PetscScalar *in, PetscScalar *out, double scale);
+
   virtual bool MatGetDiagonal(Vec _diag, double scale=1.0);
 
   virtual bool GetAssembledMatrix(Mat *J, MatType mtype);
@@ -96,6 +120,49 @@ class feMatrix : public feMat {
 		return asLeaf().ElementalMatVec(in_local, out_local, coords, scale);
 	}
 
+  /**
+   * 	@brief		The batched elemental matrix-vector multiplication used by MatVec_new().
+   * 				The values are stored as structure of arrays with the elements of the
+   * 				batch as the fastest index, value i of element e is at [i*FE_ELEMENT_BATCH_SIZE + e].
+   * 				All the elements are regular (hanging vertices are interpolated by the gather).
+   * 	@param		in_local the vertex values, 8*dof values (vertex*dof + component) per element.
+   * 	@param		out_local the result, 8*dof values per element. The product is added to it, so
+   * 				several kernels can accumulate into the same batch (see feMatrixSum).
+   * 	@param		coords the vertex coordinates, 24 values (3*vertex + dim) per element.
+   * 	@param		numElems the number of elements in the batch (<= FE_ELEMENT_BATCH_SIZE).
+   *
+   *  The default calls ElementalMatVec(in_local, out_local, coords, scale) per element.
+   *  Derived classes can hide it with a vectorized kernel (see ot::stencilMatVecBatch()).
+   **/
+	inline bool ElementalMatVecBatch(PetscScalar* in_local, PetscScalar* out_local, PetscScalar* coords, unsigned int numElems, double scale) {
+		const unsigned int nv = 8*m_uiDof;
+		std::vector<PetscScalar> loc_in(nv), loc_out(nv), loc_coords(24);
+		for (unsigned int e = 0; e < numElems; e++) {
+			for (unsigned int i = 0; i < nv; i++) {
+				loc_in[i] = in_local[i*FE_ELEMENT_BATCH_SIZE + e];
+				loc_out[i] = 0.0;
+			}
+			for (unsigned int i = 0; i < 24; i++) {
+				loc_coords[i] = coords[i*FE_ELEMENT_BATCH_SIZE + e];
+			}
+			asLeaf().ElementalMatVec(&(*(loc_in.begin())), &(*(loc_out.begin())), &(*(loc_coords.begin())), scale);
+			for (unsigned int i = 0; i < nv; i++) {
+				out_local[i*FE_ELEMENT_BATCH_SIZE + e] += loc_out[i];
+			}
+		}
+		return true;
+	}
+
+
+  /**
+   * 	@brief		true if the local kernels (ElementalMatVec(in_local, out_local, coords, scale) and
+   * 				ElementalMatVecBatch()) can apply the operator. MatVec_new() and feMatrixSum raise an error
+   * 				otherwise. The default is true, derived classes whose coefficients are not available to the
+   * 				local kernels hide it (see stiffnessMatrix).
+   **/
+  inline bool localKernelsSupported() {
+    return true;
+  }
 
   /**
    * 	@brief		The elemental matrix-vector multiplication routine that is used
@@ -122,6 +189,16 @@ class feMatrix : public feMat {
     return asLeaf().ElementalMatGetDiagonal(index, diag, scale);
   }
 
+  /**
+   * 	@brief		Thread-safe variant of the elemental matrix-vector multiplication for
+   *				the octree DA. The element is the position pos of the element loop snapshot
+   *				loop, the DA iterator is not used.
+   *  @see		ot::DA::getElementLoop()
+   **/
+  inline bool ElementalMatVec(const ot::ElementLoop & loop, unsigned int pos, PetscScalar *in, PetscScalar *out, double scale) {
+    return asLeaf().ElementalMatVec(loop, pos, in, out, scale);
+  }
+
   // PetscErrorCode matVec(Vec in, Vec out, timeInfo info);
 
   /**
@@ -187,15 +264,52 @@ class feMatrix : public feMat {
   }
 
   inline PetscErrorCode alignElementAndVertices(ot::DA * da, stdElemType & sType, unsigned int* indices);
+  inline PetscErrorCode alignElementAndVertices(ot::DA * da, const ot::ElementLoop & loop, unsigned int pos, stdElemType & sType, unsigned int* indices);
   inline PetscErrorCode mapVtxAndFlagsToOrientation(int childNum, unsigned int* indices, unsigned char & mask);
   inline PetscErrorCode reOrderIndices(unsigned char eType, unsigned int* indices);
 
 	inline PetscErrorCode interp_local_to_global(PetscScalar* __restrict loc, PetscScalar* glo, ot::DA* m_octDA);
   inline PetscErrorCode interp_global_to_local(PetscScalar* glo, PetscScalar* __restrict loc, ot::DA* m_octDA);
 
+  /**
+   * 	@brief		Drops the cached scaled stencils, they are rebuilt by the next preMatVec().
+   * 				Derived classes that fold a coefficient into the cache must call this
+   * 				when the coefficient changes.
+   **/
+  void invalidateStencilCache() { m_dStencilCache.clear(); m_uiStencilCacheDepth = 0; }
+
 protected:
+  /**
+   * 	@brief		true if the cached stencils were built for the max depth of the octree DA.
+   **/
+  bool isStencilCacheValid() {
+    return ( (!m_dStencilCache.empty()) && (m_uiStencilCacheDepth == m_octDA->getMaxDepth()) );
+  }
+
+  /**
+   * 	@brief		Builds the cache of scaled stencils for the octree DA, the stencil of
+   * 				type t for level l is levelFactors[l]*m_stencil[t]. The memory is
+   * 				64*numTypes*(maxDepth+1) doubles.
+   * 	@param		numTypes the number of element types in m_stencil.
+   * 	@param		levelFactors the scale for each level 0 ... maxDepth.
+   **/
+  void initStencilCache(unsigned int numTypes, const std::vector<double> & levelFactors);
+
+  /**
+   * 	@brief		The cached stencil (8x8, row major) of element type type at level lev.
+   * 	@see		initStencilCache()
+   **/
+  inline const double* getCachedStencil(unsigned char type, unsigned int lev) const {
+    return &(m_dStencilCache[((lev*m_uiStencilCacheTypes) + type) << 6]);
+  }
+
   void *          	m_stencil;
 
+  // scaled stencils of the octree DA, indexed by (level, element type)
+  std::vector<double>	m_dStencilCache;
+  unsigned int		m_uiStencilCacheTypes;
+  unsigned int		m_uiStencilCacheDepth;
+
   std::string     	m_strMatrixType;
 
   timeInfo					*m_time;
@@ -8,6 +8,8 @@ feMatrix<T>::feMatrix() {
 	m_stencil = NULL;
 	m_uiDof = 1;
 	m_ucpLut  = NULL;
+	m_uiStencilCacheTypes = 0;
+	m_uiStencilCacheDepth = 0;
 
 	// initialize the stencils ...
 	initStencils();
@@ -23,6 +25,8 @@ feMatrix<T>::feMatrix(daType da) {
 	m_octDA   = NULL;
 	m_stencil = NULL;
 	m_ucpLut  = NULL;
+	m_uiStencilCacheTypes = 0;
+	m_uiStencilCacheDepth = 0;
 
 	// initialize the stencils ...
 	initStencils();
@@ -59,6 +63,25 @@ template <typename T>
 feMatrix<T>::~feMatrix() {
 }
 
+template <typename T>
+void feMatrix<T>::initStencilCache(unsigned int numTypes, const std::vector<double> & levelFactors) {
+	int ***Aijk = (int ***)m_stencil;
+
+	m_uiStencilCacheTypes = numTypes;
+	m_dStencilCache.resize(levelFactors.size()*numTypes*64);
+	for (unsigned int lev = 0; lev < levelFactors.size(); lev++) {
+		for (unsigned int t = 0; t < numTypes; t++) {
+			double* S = &(m_dStencilCache[((lev*numTypes) + t) << 6]);
+			for (int k = 0; k < 8; k++) {
+				for (int j = 0; j < 8; j++) {
+					S[8*k + j] = levelFactors[lev]*Aijk[t][k][j];
+				}
+			}
+		}
+	}
+	m_uiStencilCacheDepth = m_octDA->getMaxDepth();
+}
+
 
 #undef __FUNCT__
 #define __FUNCT__ "feMatrix_MatGetDiagonal"
@@ -281,19 +304,28 @@ bool feMatrix<T>::MatVec(Vec _in, Vec _out, double scale){
 		m_octDA->ReadFromGhostsBegin<PetscScalar>(in, m_uiDof);
 		preMatVec();
 
+#ifdef OMP_MATVEC
+		// Independent loop, threaded over the chunks of the loop snapshot ...
+		ElementLoopMatVec(m_octDA->getElementLoop<ot::DA_FLAGS::INDEPENDENT>(), in, out, scale);
+#else
 		// Independent loop, loop through the nodes this processor owns..
-		for ( m_octDA->init<ot::DA_FLAGS::INDEPENDENT>(), m_octDA->init<ot::DA_FLAGS::WRITABLE>(); m_octDA->curr() < m_octDA->end<ot::DA_FLAGS::INDEPENDENT>(); m_octDA->next<ot::DA_FLAGS::INDEPENDENT>() ) {
+		for ( m_octDA->init<ot::DA_FLAGS::INDEPENDENT>(); m_octDA->curr() < m_octDA->end<ot::DA_FLAGS::INDEPENDENT>(); m_octDA->next<ot::DA_FLAGS::INDEPENDENT>() ) {
 			ElementalMatVec( m_octDA->curr(), in, out, scale);
 		}//end INDEPENDENT
+#endif
 
 		// Wait for communication to end.
 		//m_octDA->updateGhostsEnd<PetscScalar>(in);
 		m_octDA->ReadFromGhostsEnd<PetscScalar>(in);
 
+#ifdef OMP_MATVEC
+		ElementLoopMatVec(m_octDA->getElementLoop<ot::DA_FLAGS::DEPENDENT>(), in, out, scale);
+#else
 		// Dependent loop ...
-		for ( m_octDA->init<ot::DA_FLAGS::DEPENDENT>(), m_octDA->init<ot::DA_FLAGS::WRITABLE>(); m_octDA->curr() < m_octDA->end<ot::DA_FLAGS::DEPENDENT>(); m_octDA->next<ot::DA_FLAGS::DEPENDENT>() ) {
+		for ( m_octDA->init<ot::DA_FLAGS::DEPENDENT>(); m_octDA->curr() < m_octDA->end<ot::DA_FLAGS::DEPENDENT>(); m_octDA->next<ot::DA_FLAGS::DEPENDENT>() ) {
 			ElementalMatVec( m_octDA->curr(), in, out, scale);
 		}//end DEPENDENT
+#endif
 
 		postMatVec();
 
@@ -469,11 +501,54 @@ PetscErrorCode feMatrix<T>::alignElementAndVertices(ot::DA * da, stdElemType & s
 	PetscFunctionReturn(0);
 }//end function.
 
+#undef __FUNCT__
+#define __FUNCT__ "alignElementAndVertices"
+template <typename T>
+PetscErrorCode feMatrix<T>::alignElementAndVertices(ot::DA * da, const ot::ElementLoop & loop, unsigned int pos, stdElemType & sType, unsigned int* indices) {
+	// Thread-safe, only reads the loop snapshot and the per element flags of the DA.
+
+	sType = ST_0;
+	loop.getNodeIndices(pos, indices);
+
+	unsigned int elem = loop.getElement(pos);
+	if (da->isHanging(elem)) {
+
+		int childNum = loop.getChildNumber(pos);
+
+		unsigned char hangingMask = da->getHangingNodeIndex(elem);
+
+		//Change HangingMask and indices based on childNum
+		mapVtxAndFlagsToOrientation(childNum, indices, hangingMask);
+
+		unsigned char eType = ((126 & hangingMask)>>1);
+
+		reOrderIndices(eType, indices);
+	}//end if hangingElem.
+	return 0;
+}//end function.
+
+#undef __FUNCT__
+#define __FUNCT__ "ElementLoopMatVec"
+template <typename T>
+void feMatrix<T>::ElementLoopMatVec(const ot::ElementLoop & loop, PetscScalar *in, PetscScalar *out, double scale) {
+	for (unsigned int color = 0; color < loop.getNumColors(); color++) {
+		const int cBegin = loop.colorOffsets[color];
+		const int cEnd = loop.colorOffsets[color + 1];
+#pragma omp parallel for schedule(dynamic)
+		for (int c = cBegin; c < cEnd; c++) {
+			const unsigned int chunk = loop.colorChunks[c];
+			for (unsigned int pos = loop.chunkBegin(chunk); pos < loop.chunkEnd(chunk); pos++) {
+				ElementalMatVec(loop, pos, in, out, scale);
+			}
+		}
+	}//end color
+}//end function
+
 #undef __FUNCT__
 #define __FUNCT__ "mapVtxAndFlagsToOrientation"
 template <typename T>
 PetscErrorCode feMatrix<T>::mapVtxAndFlagsToOrientation(int childNum, unsigned int* indices, unsigned char & mask) {
-	PetscFunctionBegin;
+	// No PetscFunctionBegin, this is called from the threads of ElementLoopMatVec().
 	unsigned int tmp[8];
 	unsigned char tmpFlags = 0;
 	for (int i=0;i<8;i++) {
@@ -484,7 +559,7 @@ PetscErrorCode feMatrix<T>::mapVtxAndFlagsToOrientation(int childNum, unsigned i
 		indices[i] = tmp[i];
 	}
 	mask = tmpFlags;
-	PetscFunctionReturn(0);
+	return 0;
 }//end function
 
 #undef __FUNCT__
@@ -494,7 +569,7 @@ PetscErrorCode feMatrix<T>::reOrderIndices(unsigned char eType, unsigned int* in
 #ifdef __DEBUG_1
 	std::cout << "Entering " << __func__ << std::endl;
 #endif
-	PetscFunctionBegin;
+	// No PetscFunctionBegin, this is called from the threads of ElementLoopMatVec().
 	unsigned int tmp;
 	switch (eType) {
 	case  ET_N:
@@ -610,7 +685,7 @@ PetscErrorCode feMatrix<T>::reOrderIndices(unsigned char eType, unsigned int* in
 #ifdef __DEBUG_1
 	std::cout << "Leaving " << __func__ << std::endl;
 #endif
-	PetscFunctionReturn(0);
+	return 0;
 }
 
 template <typename T>
@@ -621,15 +696,19 @@ bool feMatrix<T>::MatVec_new(Vec _in, Vec _out, double scale){
 	assert ( ( m_daType == PETSC ) || ( m_daType == OCT ) );
 #endif
 
+	if (!(asLeaf().localKernelsSupported())) {
+		SETERRQ(PETSC_COMM_SELF, PETSC_ERR_SUP, "The local element kernels of MatVec_new() do not support this operator (e.g. a stiffnessMatrix with a variable nu), use MatVec().");
+	}
+
 	int ierr;
 	// PetscScalar zero=0.0;
 
-	// can keep as member variables if required.
-	PetscScalar* local_in = new PetscScalar[m_uiDof*8];
-	PetscScalar* local_out = new PetscScalar[m_uiDof*8];
-	PetscScalar* coords = new PetscScalar[m_uiDof*3];
-
 	if (m_daType == PETSC) {
+		// can keep as member variables if required.
+		PetscScalar* local_in = new PetscScalar[m_uiDof*8];
+		PetscScalar* local_out = new PetscScalar[m_uiDof*8];
+		PetscScalar* coords = new PetscScalar[24];
+
     // m_dLx, m_dLy, m_dLz
 		PetscInt x,y,z,m,n,p;
 		PetscInt mx,my,mz;
@@ -696,6 +775,7 @@ bool feMatrix<T>::MatVec_new(Vec _in, Vec _out, double scale){
 						for (int q=j; q<j+2; ++q) {
 							for (int r=m_uiDof*i; r<m_uiDof*(i+2); ++r,++idx) {
 								local_in[idx] = in[p][q][r];
+								local_out[idx] = 0.0;
 							}
 						}
 
@@ -710,11 +790,11 @@ bool feMatrix<T>::MatVec_new(Vec _in, Vec _out, double scale){
 
 					ElementalMatVec(local_in, local_out, coords, scale);
 
-					// copy data back
-					for (int p=k; p<k+2; ++p)
+					// add data back
+					for (int p=k,idx=0; p<k+2; ++p)
 						for (int q=j; q<j+2; ++q)
-							for (int r=m_uiDof*i,idx=0; r<m_uiDof*(i+2); ++r,++idx) {
-								in[p][q][r] = local_out[idx];
+							for (int r=m_uiDof*i; r<m_uiDof*(i+2); ++r,++idx) {
+								out[p][q][r] += local_out[idx];
 					}
 				} // end i
 			} // end j
@@ -732,6 +812,10 @@ bool feMatrix<T>::MatVec_new(Vec _in, Vec _out, double scale){
 		ierr = DMRestoreLocalVector(m_DA, &outlocal); CHKERRQ(ierr);
 		// ierr = VecDestroy(outlocal); CHKERRQ(ierr);
 
+		delete [] local_in;
+		delete [] local_out;
+		delete [] coords;
+
 	} else {
 		// loop for octree DA.
 
@@ -745,76 +829,47 @@ bool feMatrix<T>::MatVec_new(Vec _in, Vec _out, double scale){
 		m_octDA->vecGetBuffer(_out, out, false, false, false, m_uiDof);
 
 		// start comm for in ...
-		//m_octDA->updateGhostsBegin<PetscScalar>(in, false, m_uiDof);
-		// m_octDA->ReadFromGhostsBegin<PetscScalar>(in, false, m_uiDof);
 		m_octDA->ReadFromGhostsBegin<PetscScalar>(in, m_uiDof);
 		preMatVec();
 
-		unsigned int maxD = m_octDA->getMaxDepth();
-		unsigned int lev;
-		double hx, hy, hz;
-		Point pt;
-
-		double xFac = m_dLx/((double)(1<<(maxD-1)));
-		double yFac = m_dLy/((double)(1<<(maxD-1)));
-		double zFac = m_dLz/((double)(1<<(maxD-1)));
-
-
-
-		// Independent loop, loop through the nodes this processor owns..
-		for ( m_octDA->init<ot::DA_FLAGS::INDEPENDENT>(), m_octDA->init<ot::DA_FLAGS::WRITABLE>(); m_octDA->curr() < m_octDA->end<ot::DA_FLAGS::INDEPENDENT>(); m_octDA->next<ot::DA_FLAGS::INDEPENDENT>() ) {
-			lev = m_octDA->getLevel(m_octDA->curr());
-			hx = xFac*(1<<(maxD - lev));
-			hy = yFac*(1<<(maxD - lev));
-			hz = zFac*(1<<(maxD - lev));
-
-			pt = m_octDA->getCurrentOffset();
-
-			// coords
-			coords[0] = pt.x()*xFac; coords[1] = pt.y()*yFac; coords[2] = pt.z()*zFac;
-			coords[3] = coords[0] + hx; coords[4] = coords[1]; coords[5] = coords[2];
-			coords[6] = coords[0] ; coords[7] = coords[1]+hy; coords[8] = coords[2];
-			coords[9] = coords[0] + hx; coords[10] = coords[1]+hy; coords[11] = coords[2];
-			coords[12] = coords[0] ; coords[13] = coords[1]; coords[14] = coords[2]+hz;
-			coords[15] = coords[0] + hx; coords[16] = coords[1]; coords[17] = coords[2]+hz;
-			coords[18] = coords[0] ; coords[19] = coords[1]+hy; coords[20] = coords[2]+hz;
-			coords[21] = coords[0] + hx; coords[22] = coords[1]+hy; coords[23] = coords[2]+hz;
-
-			// copy and interpolate to local
-      // interp_global_to_local(glo, local_in, ot::DA* m_octDA);
-
-			// ElementalMatVec( local_in, local_out, coords, scale);
-
-		  // copy to global
-      // interp_local_to_global(local_out, glo, ot::DA* m_octDA);
-
-
-		}//end INDEPENDENT
+		// Only the own elements are computed and their contributions to the ghost nodes are added to the owners
+		// below. The pre-ghost elements do not cover all the elements that touch the owned nodes through hanging
+		// vertices (the parent's vertex can be owned by an earlier processor), so the contributions are not
+		// computed on the owner.
+		// Independent elements, only local values are gathered ...
+		ElementBatchMatVec(m_octDA->getElementLoop<ot::DA_FLAGS::INDEPENDENT>(), in, out, scale);
 
 		// Wait for communication to end.
-		//m_octDA->updateGhostsEnd<PetscScalar>(in);
 		m_octDA->ReadFromGhostsEnd<PetscScalar>(in);
 
-		// Dependent loop ...
-		for ( m_octDA->init<ot::DA_FLAGS::DEPENDENT>(), m_octDA->init<ot::DA_FLAGS::WRITABLE>(); m_octDA->curr() < m_octDA->end<ot::DA_FLAGS::DEPENDENT>(); m_octDA->next<ot::DA_FLAGS::DEPENDENT>() ) {
-			ElementalMatVec( m_octDA->curr(), in, out, scale);
-		}//end DEPENDENT
+		// Own elements that touch the ghosts ...
+		ElementBatchMatVec(m_octDA->getElementLoop<ot::DA_FLAGS::W_DEPENDENT>(), in, out, scale);
 
 		postMatVec();
 
+		// Add the ghost contributions to the owners.
+		m_octDA->WriteToGhostsBegin<PetscScalar>(out, m_uiDof);
+		m_octDA->WriteToGhostsEnd<PetscScalar>(out, m_uiDof);
+
 		// Restore Vectors ...
 		m_octDA->vecRestoreBuffer(_in,   in, false, false, true,  m_uiDof);
 		m_octDA->vecRestoreBuffer(_out, out, false, false, false, m_uiDof);
 
 	}
 
-	delete [] local_in;
-	delete [] local_out;
-	delete [] coords;
-
 	PetscFunctionReturn(0);
 }
 
+#undef __FUNCT__
+#define __FUNCT__ "ElementBatchMatVec"
+template <typename T>
+void feMatrix<T>::ElementBatchMatVec(const ot::ElementLoop & loop, PetscScalar *in, PetscScalar *out, double scale) {
+	elementBatchLoop(loop, in, out, m_uiDof,
+			[&](PetscScalar* local_in, PetscScalar* local_out, PetscScalar* coords, unsigned int numElems) {
+				asLeaf().ElementalMatVecBatch(local_in, local_out, coords, numElems, scale);
+			});
+}//end function
+
 
 template <typename T>
 PetscErrorCode feMatrix<T>::interp_global_to_local(PetscScalar* glo, PetscScalar* __restrict loc, ot::DA* m_octDA) {
@@ -0,0 +1,368 @@
+/**
+  @file feMatrixSum.h
+  @brief A matrix-free operator that is a weighted sum of feMatrix operators, e.g. M - dt*K of an implicit time step.
+  @author Milinda Fernando
+  */
+
+#ifndef __FE_MATRIX_SUM_H_
+#define __FE_MATRIX_SUM_H_
+
+#include <vector>
+#include "feMatrix.h"
+
+/**
+  @author Milinda Fernando
+  @brief The operator sum_t( weight_t * A_t ) of several feMatrix objects A_t that live on the same DA with the same
+  number of dof. MatVec() applies all the terms in one element traversal: the input is read (and its ghosts are
+  exchanged) once, the vertex values of each element are gathered once and each term's elemental kernel is
+  applied to the gathered values before the element is scattered. For the octree DA the batched kernels
+  (feMatrix::ElementalMatVecBatch()) of the terms accumulate into the same batch, for the PETSc DA the terms'
+  ElementalMatVec(i, j, k, ...) add into the same local vector.
+
+  The terms are not owned by the sum.
+  */
+class feMatrixSum : public feMat {
+  public:
+
+  feMatrixSum(daType da) : feMat(da) {
+    m_DA = NULL;
+    m_octDA = NULL;
+    m_uiDof = 1;
+  }
+
+  ~feMatrixSum() {
+    for (unsigned int t = 0; t < m_terms.size(); t++) {
+      delete m_terms[t];
+    }
+  }
+
+  /**
+   * 	@brief		Adds weight*mat to the operator. mat must use the DA, the problem dimensions and
+   * 				the dof of the sum.
+   **/
+  template <typename T>
+  void addTerm(feMatrix<T>* mat, double weight=1.0) {
+    m_terms.push_back(new matTerm<T>(mat, weight));
+  }
+
+  unsigned int getNumTerms() { return static_cast<unsigned int>(m_terms.size()); }
+
+  /**
+   * 	@brief		Changes the weight of term t, e.g. when the time step changes.
+   **/
+  void setWeight(unsigned int t, double weight) { m_terms[t]->weight = weight; }
+  double getWeight(unsigned int t) { return m_terms[t]->weight; }
+
+  void setDof(unsigned int dof) { m_uiDof = dof; }
+  unsigned int getDof() { return m_uiDof; }
+
+  /**
+   * 	@brief		_out += scale * sum_t( weight_t * A_t ) * _in in a single traversal of the elements.
+   **/
+  virtual bool MatVec(Vec _in, Vec _out, double scale=1.0);
+
+  /**
+   * 	@brief		Adds scale times the diagonal of the sum to _diag. For the octree DA the diagonal is computed
+   * 				with the batched kernels and the hanging interpolation of MatVec(), so it is the diagonal
+   * 				of the operator applied by MatVec(). For the PETSc DA the diagonals of the terms are added.
+   **/
+  virtual bool MatGetDiagonal(Vec _diag, double scale=1.0);
+
+  /**
+   * 	@brief		Assembles the operator applied by MatVec() for the octree DA, e.g. for the direct solve of the
+   * 				coarsest multigrid level. The matrix lives on the active processors of the DA
+   * 				(ot::DA::createActiveMatrix()) and *J is not set on the inactive ones. Collective on all
+   * 				the processors of the DA.
+   * 	@return		false for the PETSc DA, which is not supported.
+   **/
+  virtual bool GetAssembledMatrix(Mat *J, MatType mtype);
+
+  private:
+
+  /**
+   * 	@brief		The type erased interface of one term.
+   **/
+  class term {
+    public:
+    term(double w) : weight(w) { }
+    virtual ~term() { }
+
+    virtual bool preMatVec() = 0;
+    virtual bool postMatVec() = 0;
+    virtual bool localKernelsSupported() = 0;
+    virtual bool ElementalMatVec(int i, int j, int k, PetscScalar ***in, PetscScalar ***out, double scale) = 0;
+    virtual bool ElementalMatVecBatch(PetscScalar* in_local, PetscScalar* out_local, PetscScalar* coords,
+        unsigned int numElems, double scale) = 0;
+    virtual bool MatGetDiagonal(Vec _diag, double scale) = 0;
+
+    double weight;
+  };
+
+  template <typename T>
+  class matTerm : public term {
+    public:
+    matTerm(feMatrix<T>* mat, double w) : term(w), m_mat(mat) { }
+
+    bool preMatVec() { return m_mat->asLeaf().preMatVec(); }
+    bool postMatVec() { return m_mat->asLeaf().postMatVec(); }
+    bool localKernelsSupported() { return m_mat->asLeaf().localKernelsSupported(); }
+
+    bool ElementalMatVec(int i, int j, int k, PetscScalar ***in, PetscScalar ***out, double scale) {
+      return m_mat->asLeaf().ElementalMatVec(i, j, k, in, out, scale);
+    }
+
+    bool ElementalMatVecBatch(PetscScalar* in_local, PetscScalar* out_local, PetscScalar* coords,
+        unsigned int numElems, double scale) {
+      return m_mat->asLeaf().ElementalMatVecBatch(in_local, out_local, coords, numElems, scale);
+    }
+
+    bool MatGetDiagonal(Vec _diag, double scale) { return m_mat->MatGetDiagonal(_diag, scale); }
+
+    private:
+    feMatrix<T>* m_mat;
+  };
+
+  /**
+   * 	@brief		true if the batched kernels of all the terms can be applied (feMatrix::localKernelsSupported()).
+   * 				The octree DA uses only the batched kernels.
+   **/
+  bool localKernelsSupported() {
+    for (unsigned int t = 0; t < m_terms.size(); t++) {
+      if (!(m_terms[t]->localKernelsSupported())) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  void ElementBatchMatVec(const ot::ElementLoop & loop, PetscScalar *in, PetscScalar *out, double scale);
+  void ElementBatchDiagonal(const ot::ElementLoop & loop, PetscScalar *diag, double scale);
+  void ElementBatchMatrix(const ot::ElementLoop & loop, std::vector<ot::MatRecord> & records);
+
+  std::vector<term*>  m_terms;
+  unsigned int        m_uiDof;
+};
+
+#undef __FUNCT__
+#define __FUNCT__ "feMatrixSum_MatVec"
+inline bool feMatrixSum::MatVec(Vec _in, Vec _out, double scale) {
+	PetscFunctionBegin;
+
+	int ierr;
+
+	if (m_daType == PETSC) {
+
+		PetscInt x,y,z,m,n,p;
+		PetscInt mx,my,mz;
+		int xne,yne,zne;
+
+		PetscScalar ***in, ***out;
+		Vec inlocal, outlocal;
+
+		if (m_DA == NULL)
+			std::cerr << "Da is null" << std::endl;
+		ierr = DMDAGetCorners(m_DA, &x, &y, &z, &m, &n, &p); CHKERRQ(ierr);
+		ierr = DMDAGetInfo(m_DA,0, &mx, &my, &mz, 0,0,0,0,0,0,0,0,0); CHKERRQ(ierr);
+
+		xne = (x+m == mx) ? (m-1) : m;
+		yne = (y+n == my) ? (n-1) : n;
+		zne = (z+p == mz) ? (p-1) : p;
+
+		ierr = DMGetLocalVector(m_DA, &inlocal); CHKERRQ(ierr);
+		ierr = DMGetLocalVector(m_DA, &outlocal); CHKERRQ(ierr);
+
+		ierr = DMGlobalToLocalBegin(m_DA, _in, INSERT_VALUES, inlocal); CHKERRQ(ierr);
+		ierr = DMGlobalToLocalEnd(m_DA, _in, INSERT_VALUES, inlocal); CHKERRQ(ierr);
+
+		ierr = VecZeroEntries(outlocal);
+
+		ierr = DMDAVecGetArray(m_DA, inlocal, &in);
+		ierr = DMDAVecGetArray(m_DA, outlocal, &out);
+
+		for (unsigned int t = 0; t < m_terms.size(); t++) {
+			m_terms[t]->preMatVec();
+		}
+
+		// loop through all elements once, every term adds its contribution ...
+		for (int k=z; k<z+zne; k++) {
+			for (int j=y; j<y+yne; j++) {
+				for (int i=x; i<x+xne; i++) {
+					for (unsigned int t = 0; t < m_terms.size(); t++) {
+						m_terms[t]->ElementalMatVec(i, j, k, in, out, scale*m_terms[t]->weight);
+					}
+				} // end i
+			} // end j
+		} // end k
+
+		for (unsigned int t = 0; t < m_terms.size(); t++) {
+			m_terms[t]->postMatVec();
+		}
+
+		ierr = DMDAVecRestoreArray(m_DA, inlocal, &in); CHKERRQ(ierr);
+		ierr = DMDAVecRestoreArray(m_DA, outlocal, &out); CHKERRQ(ierr);
+
+		ierr = DMLocalToGlobalBegin(m_DA, outlocal, ADD_VALUES, _out); CHKERRQ(ierr);
+		ierr = DMLocalToGlobalEnd(m_DA, outlocal, ADD_VALUES, _out); CHKERRQ(ierr);
+
+		ierr = DMRestoreLocalVector(m_DA, &inlocal); CHKERRQ(ierr);
+		ierr = DMRestoreLocalVector(m_DA, &outlocal); CHKERRQ(ierr);
+
+	} else {
+		// loop for octree DA.
+		if (!localKernelsSupported()) {
+			SETERRQ(PETSC_COMM_SELF, PETSC_ERR_SUP, "The batched element kernels of feMatrixSum do not support one of the terms (e.g. a stiffnessMatrix with a variable nu).");
+		}
+
+		PetscScalar *out=NULL;
+		PetscScalar *in=NULL;
+
+		m_octDA->vecGetBuffer(_in,   in, false, false, true,  m_uiDof);
+		m_octDA->vecGetBuffer(_out, out, false, false, false, m_uiDof);
+
+		// one ghost exchange for all the terms ...
+		m_octDA->ReadFromGhostsBegin<PetscScalar>(in, m_uiDof);
+		for (unsigned int t = 0; t < m_terms.size(); t++) {
+			m_terms[t]->preMatVec();
+		}
+
+		ElementBatchMatVec(m_octDA->getElementLoop<ot::DA_FLAGS::INDEPENDENT>(), in, out, scale);
+
+		m_octDA->ReadFromGhostsEnd<PetscScalar>(in);
+
+		// own elements only, the ghost contributions are added to the owners as in feMatrix::MatVec_new() ...
+		ElementBatchMatVec(m_octDA->getElementLoop<ot::DA_FLAGS::W_DEPENDENT>(), in, out, scale);
+
+		for (unsigned int t = 0; t < m_terms.size(); t++) {
+			m_terms[t]->postMatVec();
+		}
+
+		m_octDA->WriteToGhostsBegin<PetscScalar>(out, m_uiDof);
+		m_octDA->WriteToGhostsEnd<PetscScalar>(out, m_uiDof);
+
+		m_octDA->vecRestoreBuffer(_in,   in, false, false, true,  m_uiDof);
+		m_octDA->vecRestoreBuffer(_out, out, false, false, false, m_uiDof);
+	}
+
+	PetscFunctionReturn(0);
+}
+
+#undef __FUNCT__
+#define __FUNCT__ "feMatrixSum_ElementBatchMatVec"
+inline void feMatrixSum::ElementBatchMatVec(const ot::ElementLoop & loop, PetscScalar *in, PetscScalar *out,
+    double scale) {
+	elementBatchLoop(loop, in, out, m_uiDof,
+			[&](PetscScalar* local_in, PetscScalar* local_out, PetscScalar* coords, unsigned int numElems) {
+				// the batched kernels accumulate, all the terms share the gathered batch.
+				for (unsigned int t = 0; t < m_terms.size(); t++) {
+					m_terms[t]->ElementalMatVecBatch(local_in, local_out, coords, numElems, scale*m_terms[t]->weight);
+				}
+			});
+}
+
+#undef __FUNCT__
+#define __FUNCT__ "feMatrixSum_ElementBatchDiagonal"
+inline void feMatrixSum::ElementBatchDiagonal(const ot::ElementLoop & loop, PetscScalar *diag, double scale) {
+	elementBatchDiagonal(loop, diag, m_uiDof,
+			[&](PetscScalar* local_in, PetscScalar* local_out, PetscScalar* coords, unsigned int numElems) {
+				for (unsigned int t = 0; t < m_terms.size(); t++) {
+					m_terms[t]->ElementalMatVecBatch(local_in, local_out, coords, numElems, scale*m_terms[t]->weight);
+				}
+			});
+}
+
+#undef __FUNCT__
+#define __FUNCT__ "feMatrixSum_ElementBatchMatrix"
+inline void feMatrixSum::ElementBatchMatrix(const ot::ElementLoop & loop, std::vector<ot::MatRecord> & records) {
+	elementBatchMatrix(loop, records, m_uiDof,
+			[&](PetscScalar* local_in, PetscScalar* local_out, PetscScalar* coords, unsigned int numElems) {
+				for (unsigned int t = 0; t < m_terms.size(); t++) {
+					m_terms[t]->ElementalMatVecBatch(local_in, local_out, coords, numElems, m_terms[t]->weight);
+				}
+			});
+}
+
+#undef __FUNCT__
+#define __FUNCT__ "feMatrixSum_MatGetDiagonal"
+inline bool feMatrixSum::MatGetDiagonal(Vec _diag, double scale) {
+	PetscFunctionBegin;
+
+	int ierr;
+
+	if (m_daType == PETSC) {
+		Vec tmp;
+		ierr = VecDuplicate(_diag, &tmp); CHKERRQ(ierr);
+		for (unsigned int t = 0; t < m_terms.size(); t++) {
+			ierr = VecZeroEntries(tmp); CHKERRQ(ierr);
+			m_terms[t]->MatGetDiagonal(tmp, scale*m_terms[t]->weight);
+			ierr = VecAXPY(_diag, 1.0, tmp); CHKERRQ(ierr);
+		}
+		ierr = VecDestroy(&tmp); CHKERRQ(ierr);
+	} else {
+		if (!localKernelsSupported()) {
+			SETERRQ(PETSC_COMM_SELF, PETSC_ERR_SUP, "The batched element kernels of feMatrixSum do not support one of the terms (e.g. a stiffnessMatrix with a variable nu).");
+		}
+
+		PetscScalar *diag=NULL;
+		m_octDA->vecGetBuffer(_diag, diag, false, false, false, m_uiDof);
+
+		for (unsigned int t = 0; t < m_terms.size(); t++) {
+			m_terms[t]->preMatVec();
+		}
+
+		// own elements only, the ghost contributions are added to the owners as in MatVec() ...
+		ElementBatchDiagonal(m_octDA->getElementLoop<ot::DA_FLAGS::WRITABLE>(), diag, scale);
+
+		for (unsigned int t = 0; t < m_terms.size(); t++) {
+			m_terms[t]->postMatVec();
+		}
+
+		m_octDA->WriteToGhostsBegin<PetscScalar>(diag, m_uiDof);
+		m_octDA->WriteToGhostsEnd<PetscScalar>(diag, m_uiDof);
+
+		m_octDA->vecRestoreBuffer(_diag, diag, false, false, false, m_uiDof);
+	}
+
+	PetscFunctionReturn(0);
+}
+
+#undef __FUNCT__
+#define __FUNCT__ "feMatrixSum_GetAssembledMatrix"
+inline bool feMatrixSum::GetAssembledMatrix(Mat *J, MatType mtype) {
+	if (m_daType == PETSC) {
+		return false;
+	}
+
+	if (!localKernelsSupported()) {
+		SETERRQ(PETSC_COMM_SELF, PETSC_ERR_SUP, "The batched element kernels of feMatrixSum do not support one of the terms (e.g. a stiffnessMatrix with a variable nu).");
+	}
+
+	// the terms are prepared on all the processors of the DA, as in MatVec() ...
+	for (unsigned int t = 0; t < m_terms.size(); t++) {
+		m_terms[t]->preMatVec();
+	}
+
+	if (m_octDA->iAmActive()) {
+		if (!(m_octDA->computedLocalToGlobal())) {
+			m_octDA->computeLocalToGlobalMappings();
+		}
+
+		m_octDA->createActiveMatrix(*J, mtype, m_uiDof);
+		MatZeroEntries(*J);
+
+		// own elements only, the rows of the ghost nodes are sent to their owners by the assembly ...
+		std::vector<ot::MatRecord> records;
+		ElementBatchMatrix(m_octDA->getElementLoop<ot::DA_FLAGS::WRITABLE>(), records);
+		m_octDA->setValuesInMatrix(*J, records, m_uiDof, ADD_VALUES);
+
+		MatAssemblyBegin(*J, MAT_FINAL_ASSEMBLY);
+		MatAssemblyEnd(*J, MAT_FINAL_ASSEMBLY);
+	}
+
+	for (unsigned int t = 0; t < m_terms.size(); t++) {
+		m_terms[t]->postMatVec();
+	}
+
+	return true;
+}
+
+#endif
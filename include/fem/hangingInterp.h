@@ -0,0 +1,82 @@
+/**
+  @file hangingInterp.h
+  @brief Interpolation of hanging vertices for the gather/scatter of element values.
+  @author Milinda Fernando
+  */
+
+#ifndef _HANGING_INTERP_H_
+#define _HANGING_INTERP_H_
+
+#include <vector>
+
+namespace ot {
+
+  /**
+    @author Milinda Fernando
+    @brief How the 8 vertex values of an element are obtained from the nodal values at the indices returned by
+    DA::getNodeIndices(). A regular vertex v is its own node. A hanging vertex v of an element with child number
+    c lies at the center of the edge (or face) of the parent spanned by c and v, and the node list holds the
+    parent's vertex v. Its value is the average of the nodes at the vertices c^s for all s contained in c^v
+    (2 for an edge, 4 for a face).
+
+    Vertex v of the element is weight[v] * sum( nodes[src[v][q]] ), q < numSrc[v]. The scatter is the transpose.
+    The unused entries src[v][q], q >= numSrc[v], are 8, so a loop can always sum 4 sources of a 9 entry array
+    whose last entry is 0, without branching on numSrc. P is the same map as a dense 8x8 matrix, vertex v is
+    sum( P[v][s] * nodes[s] ), the scatter with P^T does not need indexed updates.
+    */
+  struct HangingInterp {
+    unsigned char numSrc[8];
+    unsigned char src[8][4];
+    double weight[8];
+    double P[8][8];
+  };
+
+  /**
+    @author Milinda Fernando
+    @param childNum the child number of the element (DA::getChildNumber())
+    @param hnMask the hanging vertices of the element (DA::getHangingNodeIndex())
+    @return the interpolation for (childNum, hnMask). The 8*256 table is built on the first call.
+    */
+  inline const HangingInterp & getHangingInterp(unsigned char childNum, unsigned char hnMask) {
+    struct interpTable {
+      std::vector<HangingInterp> table;
+      interpTable() : table(8*256) {
+        for (unsigned int c = 0; c < 8; c++) {
+          for (unsigned int mask = 0; mask < 256; mask++) {
+            HangingInterp & hi = table[(c << 8) | mask];
+            for (unsigned int v = 0; v < 8; v++) {
+              // vertex c (a vertex of the parent) and vertex 7^c (the center of the parent) are never hanging.
+              unsigned int d = ((mask >> v) & 1u) ? (v ^ c) : 0;
+              if (d == 7) {
+                d = 0;
+              }
+              unsigned int n = 0;
+              for (unsigned int s = 0; s < 8; s++) {
+                if ((s & d) == s) {
+                  hi.src[v][n++] = static_cast<unsigned char>((d ? c : v) ^ s);
+                }
+              }
+              hi.numSrc[v] = static_cast<unsigned char>(n);
+              hi.weight[v] = 1.0/n;
+              for (unsigned int s = 0; s < 8; s++) {
+                hi.P[v][s] = 0.0;
+              }
+              for (unsigned int q = 0; q < n; q++) {
+                hi.P[v][hi.src[v][q]] = hi.weight[v];
+              }
+              for (; n < 4; n++) {
+                hi.src[v][n] = 8;
+              }
+            }
+          }
+        }
+      }
+    };
+    static const interpTable it;
+    return it.table[(static_cast<unsigned int>(childNum) << 8) | hnMask];
+  }
+
+} //end namespace
+
+#endif
+
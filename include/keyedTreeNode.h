@@ -0,0 +1,134 @@
+/**
+  @file keyedTreeNode.h
+  @brief An octant which carries its precomputed SFC key.
+  TreeNode::operator< walks the Hilbert table from the root to the nearest common ancestor on every comparison.
+  KeyedTreeNode computes the SFC key (see SFC_computeKey in sfcSort.h) once at construction so that comparisons,
+  searches (std::lower_bound, seq::maxLowerBound) and sorts are integer compares. The ordering is identical to
+  TreeNode's ordering. The class has an MPI_Datatype associated with it and it can be communicated between processors.
+  @author Milinda Fernando
+  */
+
+#ifndef _KEYED_TREENODE_H_
+#define _KEYED_TREENODE_H_
+
+#include "TreeNode.h"
+#include "sfcSort.h"
+#include <vector>
+#include <omp.h>
+
+namespace ot {
+
+  /**
+    @brief TreeNode with a precomputed SFC key. Opt-in replacement for TreeNode where many comparisons are needed.
+    @author Milinda Fernando
+    */
+  class KeyedTreeNode : public TreeNode {
+
+    protected:
+      uint128_t m_uiKey; /**< SFC key + level of the octant */
+
+    public:
+
+      /** @name Constructors */
+      //@{
+      KeyedTreeNode() : TreeNode() { m_uiKey=SFC_computeKey(*this); }
+
+      KeyedTreeNode(const TreeNode & other) : TreeNode(other) { m_uiKey=SFC_computeKey(*this); }
+
+      KeyedTreeNode(unsigned int x, unsigned int y, unsigned int z, unsigned int level, unsigned int dim, unsigned int maxDepth)
+        : TreeNode(x,y,z,level,dim,maxDepth) { m_uiKey=SFC_computeKey(*this); }
+
+      KeyedTreeNode(unsigned int dim, unsigned int maxDepth) : TreeNode(dim,maxDepth) { m_uiKey=SFC_computeKey(*this); }
+      //@}
+
+      /**@return the precomputed SFC key */
+      inline uint128_t getKey() const { return m_uiKey; }
+
+      /**@brief recomputes the key. Needed only if the octant is modified through the TreeNode interface. */
+      inline void updateKey() { m_uiKey=SFC_computeKey(*this); }
+
+      /** @name Overload operators */
+      //@{
+      inline bool operator == (KeyedTreeNode const & other) const { return (m_uiKey==other.m_uiKey); }
+      inline bool operator != (KeyedTreeNode const & other) const { return (m_uiKey!=other.m_uiKey); }
+      inline bool operator  < (KeyedTreeNode const & other) const { return (m_uiKey<other.m_uiKey); }
+      inline bool operator  > (KeyedTreeNode const & other) const { return (m_uiKey>other.m_uiKey); }
+      inline bool operator <= (KeyedTreeNode const & other) const { return (m_uiKey<=other.m_uiKey); }
+      inline bool operator >= (KeyedTreeNode const & other) const { return (m_uiKey>=other.m_uiKey); }
+      //@}
+
+  };//end class definition
+
+
+  /**
+   * @author Milinda Fernando
+   * @breif converts a vector of octants to keyed octants. (keys are computed in parallel)
+   * @param[in] in: input octants
+   * @param[out] out: keyed octants.
+   * */
+  inline void toKeyedTreeNodes(const std::vector<TreeNode> & in, std::vector<KeyedTreeNode> & out)
+  {
+    const long n=in.size();
+    out.resize(n);
+    #pragma omp parallel for
+    for(long i=0;i<n;i++)
+      out[i]=KeyedTreeNode(in[i]);
+  }
+
+  /**
+   * @author Milinda Fernando
+   * @breif converts a vector of keyed octants back to octants.
+   * @param[in] in: keyed octants
+   * @param[out] out: octants.
+   * */
+  inline void fromKeyedTreeNodes(const std::vector<KeyedTreeNode> & in, std::vector<TreeNode> & out)
+  {
+    const long n=in.size();
+    out.resize(n);
+    #pragma omp parallel for
+    for(long i=0;i<n;i++)
+      out[i]=in[i];
+  }
+
+}//end namespace
+
+namespace par {
+
+  //Forward Declaration
+  template <typename T>
+    class Mpi_datatype;
+
+  /**
+    @author Milinda Fernando
+    @brief A template specialization of the abstract class "Mpi_datatype" for
+    communicating messages of type "ot::KeyedTreeNode".
+    */
+  template <>
+    class Mpi_datatype< ot::KeyedTreeNode > {
+
+      public:
+
+        /**
+          @return The MPI_Datatype corresponding to the datatype "ot::KeyedTreeNode".
+          */
+        static MPI_Datatype value()
+        {
+          static bool         first = true;
+          static MPI_Datatype datatype;
+
+          if (first)
+          {
+            first = false;
+            MPI_Type_contiguous(sizeof(ot::KeyedTreeNode), MPI_BYTE, &datatype);
+            MPI_Type_commit(&datatype);
+          }
+
+          return datatype;
+        }
+
+    };
+
+}//end namespace par
+
+
+#endif
@@ -10,9 +10,14 @@
 #define _OCTUTILS_H_
 
 #include "mpi.h"
+#include "dendro.h"
 #include <vector>
 #include <functional>
 
+#define OCT_CHECKPOINT_MAGIC "DENDROCK"
+#define OCT_CHECKPOINT_VERSION 1
+#define OCT_CHECKPOINT_BYTE_ORDER 0x01020304u
+
 #ifdef PETSC_USE_LOG
 
 #include "petscsys.h"
@@ -380,6 +385,7 @@ PetscFunctionReturn(0);
 #define PROF_MERGE_OCTREES_BEGIN
 #define PROF_RG2O_BEGIN
 #define PROF_P2O_BEGIN
+#define PROF_F2O_BEGIN
 #define PROF_P2O_SEQ_BEGIN
 #define PROF_P2O_LOCAL_BEGIN
 #define PROF_N2O_BEGIN
@@ -422,6 +428,7 @@ PetscFunctionReturn(0);
 #define PROF_MERGE_OCTREES_END return 1;
 #define PROF_RG2O_END return 1; 
 #define PROF_P2O_END return 1; 
+#define PROF_F2O_END return 1;
 #define PROF_P2O_SEQ_END return 1; 
 #define PROF_P2O_LOCAL_END return 1; 
 #define PROF_N2O_END return 1;
@@ -633,6 +640,33 @@ namespace ot {
   int points2Octree(std::vector<double>& points, double * gLens, std::vector<TreeNode> & nodes,
       unsigned int dim, unsigned int maxDepth, unsigned int maxNumPtsPerOctant, MPI_Comm comm,double tol=0.1 ) ;
 
+  /**
+    @author Milinda Fernando
+    @brief Constructs a complete, sorted, linear octree from the points stored in a file (the format of
+    writePtsToFile(), the number of points followed by 3 doubles per point, the first dim are used) without loading
+    all the points. Each processor reads an equal range of the points with collective MPI-IO, chunkSize points at a
+    time. Every chunk is converted to finest-level octants, sorted and merged into the octants of the previous chunks
+    before the next one is read. Equal octants are kept once with their number of points (the weight, capped at
+    maxNumPtsPerOctant+1, which does not change the octree), so the memory is bounded by one chunk of points and the
+    distinct finest-level octants. The octants are then passed to the distributed SFC_treeSort in construct (or
+    balance) mode.
+    Points outside [0, gLens) are skipped.
+    @param filename the file with the points
+    @param gLens the global dimensions
+    @param nodes the output octree
+    @param dim the dimension of the tree
+    @param maxDepth the maximum depth of the octree
+    @param maxNumPtsPerOctant the maximum number of points per octant
+    @param chunkSize the number of points read at a time
+    @param options TS_CONSTRUCT_OCTREE or TS_BALANCE_OCTREE
+    @param comm the communicator, all the processors must call this
+    @param tol load flexibility of SFC_treeSort
+    @return 0 on success, an MPI error code if the file can not be read
+    */
+  int points2OctreeFromFile(const char* filename, double * gLens, std::vector<TreeNode> & nodes,
+      unsigned int dim, unsigned int maxDepth, unsigned int maxNumPtsPerOctant, DendroIntL chunkSize,
+      unsigned int options, MPI_Comm comm, double tol=0.1);
+
   /**
     @author Rahul Sampath
     @brief A function to construct a complete, sorted, linear octree from a
@@ -994,24 +1028,74 @@ namespace ot {
 
   int readNodesFromFile_binary (char* filename, std::vector<TreeNode > & nodes);
 
+  /**
+    @author Milinda Fernando
+    @brief Header of the binary octree checkpoint written by writeNodesToCheckpoint(). The header is followed by
+    the offsets of the writing ranks (numRanks+1 unsigned 64 bit integers, rank r wrote the octants
+    [rankOffsets[r], rankOffsets[r+1])) and the octants, starting at dataOffset. Each octant is stored as 4 unsigned
+    32 bit integers: x, y, z and the level (including the flag bits, see TreeNode::getFlag()). All the values are
+    stored in the byte order of the writer, byteOrder is OCT_CHECKPOINT_BYTE_ORDER in that order.
+    */
+  struct OctreeCheckpointHeader {
+    char          magic[8];
+    unsigned int  version;
+    unsigned int  byteOrder;
+    unsigned int  dim;
+    unsigned int  maxDepth;
+    unsigned int  isHilbert;
+    unsigned int  numRanks;
+    unsigned long long  globalCount;
+    unsigned long long  dataOffset;
+  };
+
+  /**
+    @author Milinda Fernando
+    @brief Writes a distributed, globally sorted octree to one binary checkpoint file with collective MPI-IO (see
+    OctreeCheckpointHeader). The octants are stored in the order of the ranks, so the file holds the octree in SFC
+    order. All the processors of comm must call this.
+    @param filename the file name
+    @param nodes the local octants
+    @param comm the communicator
+    @return 0 on success, an MPI error code otherwise
+    */
+  int writeNodesToCheckpoint(const char* filename, const std::vector<TreeNode> & nodes, MPI_Comm comm);
+
+  /**
+    @author Milinda Fernando
+    @brief Reads a checkpoint written by writeNodesToCheckpoint() with mmap. Each processor maps and reads only its
+    own contiguous slice of the octant array, so the result is globally sorted without a re-sort. If the size of
+    comm matches the number of writing ranks the partition of the writer is restored, otherwise the octants are
+    split evenly among the processors of comm. Checkpoints written with a different byte order are converted.
+    @param filename the file name
+    @param nodes the local octants (output)
+    @param comm the communicator
+    @return 0 on success, -1 if the file can not be read or is not a checkpoint of a supported version
+    */
+  int readNodesFromCheckpoint(const char* filename, std::vector<TreeNode> & nodes, MPI_Comm comm);
+
   unsigned int getNodeWeight(const TreeNode * t);
   
   /**
    * @author  Hari Sundar
    * @brief   Generates an octree based on a function provided by the user.
    * @param   fx        the function that taxes $x,y,z$ coordinates and returns the distance to
-   *                    the surface.
+   *                    the surface. It is evaluated concurrently by the OpenMP threads.
    * @param   maxDepth  The maximum depth that the octree should be refined to.
    * @param   reject_interior if true, then the elements that are completely in the negative
    *                          distance are not retained in the octree. 
    * @param   comm      The MPI communicator to be use for parallel computation.
+   * @param   imbalance the octants that are refined next are repartitioned (SFC_PartitionW) when the maximum
+   *                    number of them on a processor exceeds the average by this fraction.
    * 
    * Generates an octree based on a function provided by the user. The function is expected to return the 
    * signed distance to the surface that needs to be meshed. The coordinates are expected to be in [0,1]^3.
+   * All the processors refine from the first level on, each level is refined in parallel. The function is
+   * evaluated once per distinct octant corner on a processor (shared corners of siblings and neighbours and the
+   * corners inherited from the parent are reused). The output is globally sorted and partitioned.
    */ 
 
   int function2Octree(std::function<double(double,double,double)> fx, std::vector<TreeNode> & nodes, 
-                      unsigned int maxDepth, bool reject_interior, MPI_Comm comm );
+                      unsigned int maxDepth, bool reject_interior, MPI_Comm comm, double imbalance=0.2 );
 
   
 }//end namespace
@@ -0,0 +1,108 @@
+/**
+  @file elementLoop.h
+  @brief A snapshot of an element loop of ot::DA that can be traversed by several threads.
+  @author Milinda Fernando
+  */
+
+#ifndef __ELEMENT_LOOP_H__
+#define __ELEMENT_LOOP_H__
+
+#include <vector>
+#include "Point.h"
+
+namespace ot {
+
+  /**
+    @author Milinda Fernando
+    @brief The elements visited by one loop of ot::DA (INDEPENDENT, DEPENDENT, ...) in loop order, split into chunks
+    of consecutive elements. The per element cursor state of the DA iterator (node indices, child number, hanging
+    mask and anchor) is captured once, so a chunk can be processed by any thread without touching the iterator of
+    the DA. The chunks are colored such that no two chunks of the same color share a node, hence the chunks of one
+    color can be processed concurrently and scatter into a nodal vector without races.
+    @see DA::getElementLoop()
+    */
+  class ElementLoop {
+    public:
+      /** element index (DA::curr()) of each position of the loop */
+      std::vector<unsigned int>   elements;
+      /** DA::getNodeIndices() of each position, 8 per position */
+      std::vector<unsigned int>   nodes;
+      /** DA::getChildNumber() of each position */
+      std::vector<unsigned char>  childNums;
+      /** DA::getHangingNodeIndex() of each position */
+      std::vector<unsigned char>  hnMasks;
+      /** DA::getCurrentOffset() (the anchor of the element) of each position, 3 per position */
+      std::vector<unsigned int>   anchors;
+      /** chunk c covers the positions [chunkOffsets[c], chunkOffsets[c+1]) */
+      std::vector<unsigned int>   chunkOffsets;
+      /** the chunks of color k are colorChunks[colorOffsets[k]] ... colorChunks[colorOffsets[k+1]-1] */
+      std::vector<unsigned int>   colorOffsets;
+      std::vector<unsigned int>   colorChunks;
+      /** number of elements per chunk, 0 if the loop has not been built */
+      unsigned int                chunkSize;
+
+      ElementLoop() : chunkSize(0) { }
+
+      unsigned int getNumElements() const { return static_cast<unsigned int>(elements.size()); }
+
+      unsigned int getNumChunks() const {
+        return (chunkOffsets.empty() ? 0 : static_cast<unsigned int>(chunkOffsets.size() - 1));
+      }
+
+      unsigned int getNumColors() const {
+        return (colorOffsets.empty() ? 0 : static_cast<unsigned int>(colorOffsets.size() - 1));
+      }
+
+      unsigned int chunkBegin(unsigned int chunk) const { return chunkOffsets[chunk]; }
+
+      unsigned int chunkEnd(unsigned int chunk) const { return chunkOffsets[chunk + 1]; }
+
+      unsigned int getElement(unsigned int pos) const { return elements[pos]; }
+
+      unsigned char getChildNumber(unsigned int pos) const { return childNums[pos]; }
+
+      unsigned char getHangingNodeIndex(unsigned int pos) const { return hnMasks[pos]; }
+
+      Point getAnchor(unsigned int pos) const {
+        return Point(anchors[3*pos], anchors[3*pos + 1], anchors[3*pos + 2]);
+      }
+
+      void getNodeIndices(unsigned int pos, unsigned int* idx) const {
+        const unsigned int* src = &(nodes[pos << 3]);
+        for (unsigned int j = 0; j < 8; j++) {
+          idx[j] = src[j];
+        }
+      }
+
+      void clear() {
+        elements.clear();
+        nodes.clear();
+        childNums.clear();
+        hnMasks.clear();
+        anchors.clear();
+        chunkOffsets.clear();
+        colorOffsets.clear();
+        colorChunks.clear();
+        chunkSize = 0;
+      }
+  };
+
+  /**
+    @author Milinda Fernando
+    @brief Colors chunks greedily in chunk order such that two chunks that share a node get different colors.
+    The chunks of each color are listed in increasing order, so the chunks of a color in a range of chunks are
+    contiguous in colorChunks.
+    @param nodes the nodes touched by the chunks. Those of chunk c are nodes[nodeOffsets[c]] ...
+    nodes[nodeOffsets[c+1]-1].
+    @param nodeOffsets the offsets of the chunks in nodes, one more than the number of chunks
+    @param colorOffsets the chunks of color k are colorChunks[colorOffsets[k]] ... colorChunks[colorOffsets[k+1]-1]
+    @param colorChunks the chunks sorted by color
+    @see ElementLoop
+    */
+  void colorChunks(const std::vector<unsigned int>& nodes, const std::vector<unsigned int>& nodeOffsets,
+      std::vector<unsigned int>& colorOffsets, std::vector<unsigned int>& colorChunks);
+
+} //end namespace
+
+#endif
+
@@ -3,6 +3,7 @@
 #define __LOOP_COUNTERS_H__
 
 #include "Point.h"
+#include <vector>
 
 namespace ot {
         struct LoopCounters {
@@ -11,6 +12,17 @@ namespace ot {
           unsigned int qCounter;
           unsigned int pgQcounter;
         };
+
+        /**
+          @brief The complete state of a DA loop: the counters of the current position, the stored position
+          (FROM_STORED) and the Hilbert rotation stack. See DA::saveLoopCursor().
+          */
+        struct LoopCursor {
+          LoopCounters current;
+          LoopCounters stored;
+          std::vector<unsigned int> rotationStack;
+          unsigned int rotationStackPointer;
+        };
 } //end namespace
 
 #endif
@@ -0,0 +1,134 @@
+/**
+  @file octantHash.h
+  @brief An open addressing hash of the octants of a sorted octree, keyed by the anchor and the level.
+  @author Milinda Fernando
+  */
+
+#ifndef __OCTANT_HASH_H__
+#define __OCTANT_HASH_H__
+
+#include <vector>
+#include "TreeNode.h"
+
+namespace ot {
+
+  /**
+    @author Milinda Fernando
+    @brief Maps (x, y, z, level) to the index of the octant in the vector it was built from (linear probing,
+    the table is at most half full). Used by DA::buildNodeList (DA_HASH_NLIST) instead of the binary searches
+    over the local and ghost octants. Read only after build(), so it can be shared by several threads.
+    */
+  class OctantHash {
+    public:
+      static const unsigned int NOT_FOUND = 0xFFFFFFFFu;
+
+      OctantHash() : m_uiMask(0), m_ullLevels(0), m_uiMaxDepth(0) { }
+
+      /** Indexes all the octants of oct, oct must not have duplicates. */
+      void build(const std::vector<ot::TreeNode>& oct) {
+        unsigned int capacity = 16;
+        while (capacity < 2*oct.size()) {
+          capacity <<= 1;
+        }
+        m_uiMask = capacity - 1;
+        m_ullLevels = 0;
+        m_uiMaxDepth = (oct.empty() ? 0 : oct[0].getMaxDepth());
+        Slot empty;
+        empty.idx = NOT_FOUND;
+        m_slots.assign(capacity, empty);
+
+        for (unsigned int i = 0; i < oct.size(); i++) {
+          const unsigned int lev = oct[i].getLevel();
+          unsigned int s = hash(oct[i].getX(), oct[i].getY(), oct[i].getZ(), lev);
+          while (m_slots[s].idx != NOT_FOUND) {
+            s = (s + 1) & m_uiMask;
+          }
+          m_slots[s].x = oct[i].getX();
+          m_slots[s].y = oct[i].getY();
+          m_slots[s].z = oct[i].getZ();
+          m_slots[s].level = lev;
+          m_slots[s].idx = i;
+          m_ullLevels |= (1ull << lev);
+        }
+      }
+
+      /** @return the index of the octant anchored at (x, y, z) with the given level, NOT_FOUND if there is none. */
+      unsigned int find(unsigned int x, unsigned int y, unsigned int z, unsigned int lev) const {
+        if (!(m_ullLevels & (1ull << lev))) {
+          return NOT_FOUND;
+        }
+        unsigned int s = hash(x, y, z, lev);
+        while (m_slots[s].idx != NOT_FOUND) {
+          const Slot& e = m_slots[s];
+          if ((e.x == x) && (e.y == y) && (e.z == z) && (e.level == lev)) {
+            return e.idx;
+          }
+          s = (s + 1) & m_uiMask;
+        }
+        return NOT_FOUND;
+      }
+
+      /**
+        @return the index of the octant that contains the point (x, y, z), NOT_FOUND if there is none. The octree
+        must be linear, so there is at most one. The levels firstLevel, firstLevel+1 and firstLevel-1 are probed
+        first (the neighbours of a balanced octant), then all the other levels present in the octree.
+        */
+      unsigned int findContaining(unsigned int x, unsigned int y, unsigned int z, unsigned int firstLevel) const {
+        unsigned long long probed = 0;
+        const int first[3] = {(int)firstLevel, (int)firstLevel + 1, (int)firstLevel - 1};
+        for (unsigned int k = 0; k < 3; k++) {
+          if ((first[k] >= 0) && (first[k] <= (int)m_uiMaxDepth)) {
+            const unsigned int idx = findAt(x, y, z, first[k]);
+            if (idx != NOT_FOUND) {
+              return idx;
+            }
+            probed |= (1ull << first[k]);
+          }
+        }
+        for (unsigned int lev = 0; lev <= m_uiMaxDepth; lev++) {
+          if ((m_ullLevels & ~probed) & (1ull << lev)) {
+            const unsigned int idx = findAt(x, y, z, lev);
+            if (idx != NOT_FOUND) {
+              return idx;
+            }
+          }
+        }
+        return NOT_FOUND;
+      }
+
+    private:
+      struct Slot {
+        unsigned int x, y, z;
+        unsigned int level;
+        unsigned int idx;
+      };
+
+      /** the octant of level lev that contains (x, y, z) */
+      unsigned int findAt(unsigned int x, unsigned int y, unsigned int z, unsigned int lev) const {
+        const unsigned int len = m_uiMaxDepth - lev;
+        const unsigned int m = (len >= 32) ? 0u : ~((1u << len) - 1u);
+        return find(x & m, y & m, z & m, lev);
+      }
+
+      unsigned int hash(unsigned int x, unsigned int y, unsigned int z, unsigned int lev) const {
+        unsigned long long h = (static_cast<unsigned long long>(x) << 32) | y;
+        h ^= ((static_cast<unsigned long long>(z) << 5) | lev) * 0x9E3779B97F4A7C15ull;
+        h ^= (h >> 33);
+        h *= 0xFF51AFD7ED558CCDull;
+        h ^= (h >> 33);
+        h *= 0xC4CEB9FE1A85EC53ull;
+        h ^= (h >> 33);
+        return static_cast<unsigned int>(h) & m_uiMask;
+      }
+
+      std::vector<Slot>   m_slots;
+      unsigned int        m_uiMask;
+      /** bit l is set if the octree has an octant of level l */
+      unsigned long long  m_ullLevels;
+      unsigned int        m_uiMaxDepth;
+  };
+
+} //end namespace
+
+#endif
+
@@ -14,6 +14,7 @@
 #include "matRecord.h"
 #include "loopCounters.h"
 #include "updateCtx.h"
+#include "elementLoop.h"
 #include "odaUtils.h"
 #include "cnumEtypes.h"
 #include "Point.h"
@@ -28,6 +29,15 @@
 #define iC(fun) {CHKERRQ(fun);}
 #endif
 
+#ifndef DA_ELEMENT_LOOP_CHUNK_SIZE
+#define DA_ELEMENT_LOOP_CHUNK_SIZE 256
+#endif
+
+// number of local buffers of vecGetBuffer() (PETSc Vecs) kept by a DA for reuse after vecRestoreBuffer()
+#ifndef DA_BUFFER_POOL_SIZE
+#define DA_BUFFER_POOL_SIZE 8
+#endif
+
 #ifdef __DEBUG__
 #ifndef __DEBUG_DA__
 #define __DEBUG_DA__
@@ -543,6 +553,63 @@ namespace ot {
         std::vector<updateContext>              m_mpiContexts;
         unsigned int                            m_uiCommTag;
 
+        // persistent ghost exchange (see setPersistentGhostExchange()) ...
+        bool                                    m_bPersistentGhostExchange;
+        std::vector<persistentUpdateContext*>   m_mpiPersistentContexts;
+
+        /**
+          @brief Returns an idle persistent context for (sizeof(T), dof, isWrite). The requests and buffers are
+          created on the first use. Returns NULL if the persistent mode is off or all the matching contexts are
+          in use, in which case the non-persistent exchange is used.
+          */
+        template <typename T>
+          persistentUpdateContext* getPersistentContext(unsigned int dof, bool isWrite);
+
+        /**
+          @brief Returns the in-flight persistent context for arr, NULL if arr is not being updated with a
+          persistent context.
+          */
+        persistentUpdateContext* findPersistentContext(void* arr, bool isWrite);
+
+        /**
+          @brief Frees the persistent requests and buffers.
+          */
+        void destroyPersistentContexts();
+
+        // thread-safe element loops (see getElementLoop()) indexed by the loopType ...
+        std::vector<ElementLoop>                m_vElementLoops;
+
+        /**
+          @brief Splits loop into chunks of chunkSize consecutive elements and colors the chunks greedily such
+          that two chunks sharing a node get different colors.
+          */
+        void colorElementLoop(ElementLoop& loop, unsigned int chunkSize);
+
+        // the positions of the nodes in the local buffer in the order of the non-ghosted and the ghosted nodal
+        // vectors (see getNodeBufferIndices()) ...
+        std::vector<unsigned int>               m_uiNodeBufferIdx;
+        std::vector<unsigned int>               m_uiGhostedNodeBufferIdx;
+
+        // local buffers released by vecRestoreBuffer() and their lengths ...
+        std::vector<std::pair<unsigned int, PetscScalar*> > m_vBufferPool;
+
+        /**
+          @brief Returns the positions in the local buffer of the entries of a nodal vector, i.e. node k of the
+          vector is the local buffer entry getNodeBufferIndices(isGhosted)[k]. Built on the first call.
+          */
+        const std::vector<unsigned int>& getNodeBufferIndices(bool isGhosted);
+
+        /**
+          @brief Returns a local buffer of sz entries, one released by releaseBuffer() if there is one of that
+          length. The entries are not initialized.
+          */
+        PetscScalar* getPooledBuffer(unsigned int sz);
+
+        /**
+          @brief Keeps buf (of sz entries) for the next getPooledBuffer(), up to DA_BUFFER_POOL_SIZE buffers.
+          */
+        void releaseBuffer(PetscScalar* buf, unsigned int sz);
+
       public:
         /**
          *
@@ -937,6 +1004,21 @@ namespace ot {
         template <typename T>
           int WriteToGhostsEnd(T* arr, unsigned int dof=1);
 
+        /**
+          @author Milinda Fernando
+          @brief Enables/disables the persistent ghost exchange for ReadFromGhosts and WriteToGhosts. In the
+          persistent mode the MPI requests (MPI_Send_init/MPI_Recv_init) and the pack buffers are set up once per
+          DA and dof and are reused with MPI_Startall, so the ghost update does not allocate. The default is set by
+          the PERSISTENT_GHOST_EXCHANGE compile flag.
+          @param flag true to use the persistent ghost exchange.
+          */
+        void setPersistentGhostExchange(bool flag);
+
+        /**
+          @return true if the persistent ghost exchange is used.
+          */
+        bool isPersistentGhostExchange() const { return m_bPersistentGhostExchange; }
+
 
         /**
           @author Rahul Sampath
@@ -1128,6 +1210,9 @@ namespace ot {
           The ghosts will have junk value in this case. If isReadOnly is false,
           the buffer will be zeroed out first and then the local values from in
           will be copied. The ghosts will have 0 values in this case.
+          The buffers are owned by the DA: vecRestoreBuffer() keeps them for the
+          next vecGetBuffer() (up to DA_BUFFER_POOL_SIZE), so they must not be
+          freed by the caller.
           */
         int vecGetBuffer(Vec in, PetscScalar* &out, bool isElemental,
             bool isGhosted, bool isReadOnly, unsigned int dof=1); 
@@ -1262,6 +1347,20 @@ namespace ot {
           */
         unsigned int currWithInfo();
 
+        /**
+          @author Milinda Fernando
+          @brief Saves the complete state of the loop in progress (the current position, the position stored by
+          currWithInfo() and the Hilbert rotation stack), so that another pass over the elements of this DA
+          can be made and the loop can be resumed with restoreLoopCursor().
+          */
+        void saveLoopCursor(LoopCursor & cursor);
+
+        /**
+          @author Milinda Fernando
+          @brief Restores the loop state saved by saveLoopCursor().
+          */
+        void restoreLoopCursor(const LoopCursor & cursor);
+
         /**
           @author Rahul Sampath
           @author Hari Sundar
@@ -1310,6 +1409,33 @@ namespace ot {
         template<ot::DA_FLAGS::loopType type>
           unsigned int next();
 
+        /**
+          @author Milinda Fernando
+          @brief Returns a thread-safe snapshot of the loop of type loopType (the elements visited by
+          init<type>(), next<type>() and end<type>()). The snapshot is built with one serial pass over the
+          loop on the first call (and when chunkSize changes) and cached in the DA, so it must be called
+          outside of parallel regions. A loop of this DA that is in progress is not disturbed. The chunks of
+          one color can be processed by different threads at the same time:
+
+          @code
+          const ot::ElementLoop & loop = da->getElementLoop<ot::DA_FLAGS::INDEPENDENT>();
+          for (unsigned int color = 0; color < loop.getNumColors(); color++) {
+          #pragma omp parallel for schedule(dynamic)
+            for (int c = loop.colorOffsets[color]; c < loop.colorOffsets[color+1]; c++) {
+              unsigned int chunk = loop.colorChunks[c];
+              for (unsigned int pos = loop.chunkBegin(chunk); pos < loop.chunkEnd(chunk); pos++) {
+                // process loop.getElement(pos) ...
+              }
+            }
+          }
+          @endcode
+
+          @param chunkSize the number of consecutive elements per chunk.
+          @see ElementLoop
+          */
+        template<ot::DA_FLAGS::loopType type>
+          const ElementLoop& getElementLoop(unsigned int chunkSize = DA_ELEMENT_LOOP_CHUNK_SIZE);
+
         /**
           @author Hari Sundar
           @brief Returns the child number of the current element.
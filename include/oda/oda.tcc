@@ -13,6 +13,7 @@
 #include "parUtils.h"
 #include "cnumEtypes.h"
 #include "dendro.h"
+#include <algorithm>
 
 #ifdef __DEBUG__
 #ifndef __DEBUG_DA__
@@ -41,6 +42,26 @@ namespace ot {
     return m_uiCurrent;
   }
 
+  inline void DA::saveLoopCursor(LoopCursor & cursor) {
+    cursor.current.currentOffset = m_ptCurrentOffset;
+    cursor.current.currentIndex = m_uiCurrent;
+    cursor.current.qCounter = m_uiQuotientCounter;
+    cursor.current.pgQcounter = m_uiPreGhostQuotientCnt;
+    cursor.stored = m_lcLoopInfo;
+    cursor.rotationStack = RotationID_Stack;
+    cursor.rotationStackPointer = rotationStackPointer;
+  }
+
+  inline void DA::restoreLoopCursor(const LoopCursor & cursor) {
+    m_ptCurrentOffset = cursor.current.currentOffset;
+    m_uiCurrent = cursor.current.currentIndex;
+    m_uiQuotientCounter = cursor.current.qCounter;
+    m_uiPreGhostQuotientCnt = cursor.current.pgQcounter;
+    m_lcLoopInfo = cursor.stored;
+    RotationID_Stack = cursor.rotationStack;
+    rotationStackPointer = cursor.rotationStackPointer;
+  }
+
   inline unsigned char DA::getFlag(unsigned int i) {
 #ifdef __DEBUG_DA__
     assert(m_bIamActive);
@@ -592,12 +613,146 @@ namespace ot {
       return m_uiIndependentElementEnd;
     }
 
+  template<ot::DA_FLAGS::loopType type>
+    const ElementLoop& DA::getElementLoop(unsigned int chunkSize) {
+#ifdef __DEBUG_DA__
+      assert(m_bIamActive);
+      assert(chunkSize > 0);
+#endif
+      if(m_vElementLoops.size() < ot::DA_FLAGS::FROM_STORED) {
+        m_vElementLoops.resize(ot::DA_FLAGS::FROM_STORED);
+      }
+
+      ElementLoop & loop = m_vElementLoops[type];
+      if(loop.chunkSize == chunkSize) {
+        return loop;
+      }
+
+      if(loop.chunkOffsets.empty()) {
+        //Save the state of the iterator, the snapshot is taken with the serial loop.
+        LoopCursor cursor;
+        saveLoopCursor(cursor);
+
+        loop.clear();
+        unsigned int indices[8];
+        for(init<type>(); curr() < end<type>(); next<type>()) {
+          loop.elements.push_back(curr());
+          getNodeIndices(indices);
+          loop.nodes.insert(loop.nodes.end(), indices, indices + 8);
+          loop.childNums.push_back(getChildNumber());
+          loop.hnMasks.push_back(getHangingNodeIndex(curr()));
+          loop.anchors.push_back(m_ptCurrentOffset.xint());
+          loop.anchors.push_back(m_ptCurrentOffset.yint());
+          loop.anchors.push_back(m_ptCurrentOffset.zint());
+        }
+
+        restoreLoopCursor(cursor);
+      }
+
+      colorElementLoop(loop, chunkSize);
+      return loop;
+    }//end function
+
   //Functions for communicating ghost nodes...
 
+  template <typename T>
+    persistentUpdateContext* DA::getPersistentContext(unsigned int dof, bool isWrite) {
+      if(!m_bPersistentGhostExchange) {
+        return NULL;
+      }
+
+      for(unsigned int i = 0; i < m_mpiPersistentContexts.size(); i++) {
+        persistentUpdateContext* ctx = m_mpiPersistentContexts[i];
+        if( (ctx->buffer == NULL) && (ctx->typeSize == sizeof(T)) && (ctx->dof == dof) && (ctx->isWrite == isWrite) ) {
+          return ctx;
+        }
+      }
+
+      // Create a new context. Contexts are created in the same order on all the processors, so the context
+      // index is used to get matching tags. The tags are taken from the top of the tag range to keep them apart
+      // from m_uiCommTag which is used by the non-persistent exchanges.
+      int tagUB = 32767;
+      int* tagUBPtr = NULL;
+      int flag = 0;
+      MPI_Comm_get_attr(m_mpiCommActive, MPI_TAG_UB, &tagUBPtr, &flag);
+      if(flag) {
+        tagUB = (*tagUBPtr);
+      }
+      const int tag = tagUB - static_cast<int>(m_mpiPersistentContexts.size());
+
+      persistentUpdateContext* ctx = new persistentUpdateContext();
+      assert(ctx);
+      ctx->typeSize = sizeof(T);
+      ctx->dof = dof;
+      ctx->isWrite = isWrite;
+
+      unsigned int numGhosts = 0;
+      for (unsigned int i = 0; i < m_uipRecvProcs.size(); i++) {
+        numGhosts += m_uipRecvCounts[i];
+      }
+
+      // The ghosts are packed contiguously in the order of m_uipRecvProcs.
+      T* scatterBuf = NULL;
+      T* ghostBuf = NULL;
+      if(isWrite) {
+        ctx->sendBuf.resize(sizeof(T)*dof*numGhosts);
+        ctx->recvBuf.resize(sizeof(T)*dof*m_uipScatterMap.size());
+        ghostBuf = reinterpret_cast<T*>(ctx->sendBuf.data());
+        scatterBuf = reinterpret_cast<T*>(ctx->recvBuf.data());
+      } else {
+        ctx->sendBuf.resize(sizeof(T)*dof*m_uipScatterMap.size());
+        ctx->recvBuf.resize(sizeof(T)*dof*numGhosts);
+        scatterBuf = reinterpret_cast<T*>(ctx->sendBuf.data());
+        ghostBuf = reinterpret_cast<T*>(ctx->recvBuf.data());
+      }
+
+      ctx->requests.resize(m_uipRecvProcs.size() + m_uipSendProcs.size(), MPI_REQUEST_NULL);
+      unsigned int ghostOffset = 0;
+      for (unsigned int i = 0; i < m_uipRecvProcs.size(); i++) {
+        if(isWrite) {
+          MPI_Send_init(ghostBuf + (dof*ghostOffset), (dof*m_uipRecvCounts[i]), par::Mpi_datatype<T>::value(),
+              m_uipRecvProcs[i], tag, m_mpiCommActive, &(ctx->requests[i]));
+        } else {
+          MPI_Recv_init(ghostBuf + (dof*ghostOffset), (dof*m_uipRecvCounts[i]), par::Mpi_datatype<T>::value(),
+              m_uipRecvProcs[i], tag, m_mpiCommActive, &(ctx->requests[i]));
+        }
+        ghostOffset += m_uipRecvCounts[i];
+      }
+
+      for (unsigned int i = 0; i < m_uipSendProcs.size(); i++) {
+        MPI_Request* req = &(ctx->requests[m_uipRecvProcs.size() + i]);
+        if(isWrite) {
+          MPI_Recv_init(scatterBuf + (dof*m_uipSendOffsets[i]), (dof*m_uipSendCounts[i]), par::Mpi_datatype<T>::value(),
+              m_uipSendProcs[i], tag, m_mpiCommActive, req);
+        } else {
+          MPI_Send_init(scatterBuf + (dof*m_uipSendOffsets[i]), (dof*m_uipSendCounts[i]), par::Mpi_datatype<T>::value(),
+              m_uipSendProcs[i], tag, m_mpiCommActive, req);
+        }
+      }
+
+      m_mpiPersistentContexts.push_back(ctx);
+      return ctx;
+    }
+
   template <typename T>
     int DA::ReadFromGhostsBegin ( T* arr, unsigned int dof) {
       PROF_READ_GHOST_NODES_BEGIN_BEGIN
 
+      persistentUpdateContext* pctx = getPersistentContext<T>(dof, false);
+      if(pctx) {
+        T* sendK = reinterpret_cast<T*>(pctx->sendBuf.data());
+        for (unsigned int i = 0; i < m_uipScatterMap.size(); i++ ) {
+          for (unsigned int j = 0; j < dof; j++) {
+            sendK[(dof*i) + j] = arr[(dof*m_uipScatterMap[i]) + j];
+          }
+        }
+        pctx->buffer = arr;
+        if(!(pctx->requests.empty())) {
+          MPI_Startall(static_cast<int>(pctx->requests.size()), &(*(pctx->requests.begin())));
+        }
+        PROF_READ_GHOST_NODES_BEGIN_END
+      }
+
         // first need to create contiguous list of boundaries ...
         T* sendK = NULL;
       if(m_uipScatterMap.size()) {
@@ -646,6 +801,20 @@ namespace ot {
     int DA::ReadFromGhostsEnd(T* arr) {
       PROF_READ_GHOST_NODES_END_BEGIN
 
+      persistentUpdateContext* pctx = findPersistentContext(arr, false);
+      if(pctx) {
+        if(!(pctx->requests.empty())) {
+          MPI_Waitall(static_cast<int>(pctx->requests.size()), &(*(pctx->requests.begin())), MPI_STATUSES_IGNORE);
+        }
+        const T* recvK = reinterpret_cast<const T*>(pctx->recvBuf.data());
+        for (unsigned int i = 0; i < m_uipRecvProcs.size(); i++) {
+          std::copy(recvK, recvK + (pctx->dof*m_uipRecvCounts[i]), arr + (pctx->dof*m_uipRecvOffsets[i]));
+          recvK += (pctx->dof*m_uipRecvCounts[i]);
+        }
+        pctx->buffer = NULL;
+        PROF_READ_GHOST_NODES_END_END
+      }
+
         // find the context ...
         unsigned int ctx;
       for ( ctx = 0; ctx < m_mpiContexts.size(); ctx++) {
@@ -684,6 +853,20 @@ namespace ot {
     int DA::WriteToGhostsBegin ( T* arr, unsigned int dof) {
       PROF_WRITE_GHOST_NODES_BEGIN_BEGIN
 
+      persistentUpdateContext* pctx = getPersistentContext<T>(dof, true);
+      if(pctx) {
+        T* sendK = reinterpret_cast<T*>(pctx->sendBuf.data());
+        for (unsigned int i = 0; i < m_uipRecvProcs.size(); i++) {
+          std::copy(arr + (dof*m_uipRecvOffsets[i]), arr + (dof*(m_uipRecvOffsets[i] + m_uipRecvCounts[i])), sendK);
+          sendK += (dof*m_uipRecvCounts[i]);
+        }
+        pctx->buffer = arr;
+        if(!(pctx->requests.empty())) {
+          MPI_Startall(static_cast<int>(pctx->requests.size()), &(*(pctx->requests.begin())));
+        }
+        PROF_WRITE_GHOST_NODES_BEGIN_END
+      }
+
         // first need to create contiguous list of boundaries ...
         T* recvK = NULL;
       if(m_uipScatterMap.size()) {
@@ -727,6 +910,23 @@ namespace ot {
     int DA::WriteToGhostsEnd(T* arr, unsigned int dof) {
       PROF_WRITE_GHOST_NODES_END_BEGIN
 
+      persistentUpdateContext* pctx = findPersistentContext(arr, true);
+      if(pctx) {
+        assert(pctx->dof == dof);
+        if(!(pctx->requests.empty())) {
+          MPI_Waitall(static_cast<int>(pctx->requests.size()), &(*(pctx->requests.begin())), MPI_STATUSES_IGNORE);
+        }
+        //Add ghost values to the local vector.
+        const T* recvK = reinterpret_cast<const T*>(pctx->recvBuf.data());
+        for (unsigned int i = 0; i < m_uipScatterMap.size(); i++ ) {
+          for (unsigned int j = 0; j < dof; j++) {
+            arr[(dof*m_uipScatterMap[i]) + j] += recvK[(dof*i) + j];
+          }
+        }
+        pctx->buffer = NULL;
+        PROF_WRITE_GHOST_NODES_END_END
+      }
+
         // find the context ...
         unsigned int ctx;
       for ( ctx = 0; ctx < m_mpiContexts.size(); ctx++) {
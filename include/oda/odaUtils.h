@@ -278,6 +278,23 @@ namespace ot {
     */
   void writePartitionVTK(ot::DA* da, const char* outFilename);
 
+  /**
+    @author Milinda Fernando
+    @brief Writes the elements of the DA and (optionally) a nodal and an elemental vector as one binary VTU file
+    outFileName.vtu with a PVTU index outFileName.pvtu, see cellsToVtu(). All the active processors write their own
+    (WRITABLE) elements with collective MPI-IO. The nodal values are interpolated to the hanging vertices. With
+    HILBERT_ORDERING, DA::computeHilbertRotations() must have been called.
+    @param da the DA
+    @param outFileName the file name without extension
+    @param nodal a non-ghosted nodal vector or NULL
+    @param nodalDof the degrees of freedom of nodal
+    @param elemental a non-ghosted elemental vector or NULL
+    @param elemDof the degrees of freedom of elemental
+    @return 0 on success
+    */
+  int writeVtu(ot::DA* da, const char* outFileName, Vec nodal = NULL, unsigned int nodalDof = 1,
+      Vec elemental = NULL, unsigned int elemDof = 1);
+
   //@deprecated
   void pickGhostCandidates(const std::vector<ot::TreeNode> & blocks,
       const std::vector<ot::TreeNode> &nodes, std::vector<ot::TreeNode>& res,
@@ -321,6 +338,19 @@ namespace ot {
     */
   void DA_Finalize();
 
+  /**
+    @author Milinda Fernando
+    @brief Selects the positive search of DA::buildNodeList for the DAs constructed after this call: a hash of the
+    octants searched by OpenMP threads (true) or the binary searches (false). Both give the same element to node
+    map. The default is set by the DA_HASH_NLIST compile flag.
+    */
+  void DA_setHashNodeList(bool flag);
+
+  /**
+    @return true if DA::buildNodeList uses the hash of the octants, see DA_setHashNodeList().
+    */
+  bool DA_isHashNodeList();
+
   int createShapeFnCoeffs_Type1(MPI_Comm comm);
   int createShapeFnCoeffs_Type2(MPI_Comm comm);
   int createShapeFnCoeffs_Type3(MPI_Comm comm);
@@ -0,0 +1,249 @@
+/**
+  @file stencilTable.h
+  @brief Flat, node shared storage for the precomputed stencil tables (shape function coefficients, restriction
+  stencils and vertex maps) and the pointer tree views used to index them.
+  @author Milinda Fernando
+  */
+
+#ifndef __STENCIL_TABLE_H__
+#define __STENCIL_TABLE_H__
+
+#include "mpi.h"
+#include "petscsys.h"
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <cassert>
+#include <sys/stat.h>
+#include "parUtils.h"
+
+namespace ot {
+
+  /**
+    @author Milinda Fernando
+    @brief Pointer tree of depth D over a flat row major table of S. The leaves point into the table, so only D-1
+    arrays of pointers are allocated (one per level) instead of one array per row. E.g.
+    TableView<double,4>::create(data, dims = {18, 8, 8}, 8) gives a double**** v with v[i][j][k][l] ==
+    data[((i*18 + j)*8 + k)*8 + l].
+    */
+  template <typename S, unsigned int D>
+    struct TableView {
+      typedef typename TableView<S, D-1>::type* type;
+
+      /**
+        @param data the flat table
+        @param dims the extents of all but the first index (D-1 values)
+        @param n the extent of the first index
+        */
+      static type create(S* data, const unsigned int* dims, unsigned int n) {
+        typename TableView<S, D-1>::type sub = TableView<S, D-1>::create(data, dims + 1, n*dims[0]);
+        type view = new typename TableView<S, D-1>::type[n];
+        for (unsigned int i = 0; i < n; i++) {
+          view[i] = sub + i*dims[0];
+        }
+        return view;
+      }
+
+      /** Frees the arrays of pointers allocated by create(), not the table. */
+      static void destroy(type& view) {
+        if (view != NULL) {
+          TableView<S, D-1>::destroy(view[0]);
+          delete [] view;
+          view = NULL;
+        }
+      }
+    };
+
+  template <typename S>
+    struct TableView<S, 1> {
+      typedef S* type;
+
+      static type create(S* data, const unsigned int* dims, unsigned int n) {
+        return data;
+      }
+
+      static void destroy(type& view) {
+        view = NULL;
+      }
+    };
+
+  inline int readTextValue(FILE* infile, double* val) {
+    return fscanf(infile, "%lf", val);
+  }
+
+  inline int readTextValue(FILE* infile, unsigned short* val) {
+    return fscanf(infile, "%hu", val);
+  }
+
+  /**
+    @author Milinda Fernando
+    @brief Reads sz values stored in the order of the flat table from a text (.inp) file.
+    */
+  template <typename T>
+    int readTextTable(FILE* infile, T* data, unsigned int sz) {
+      for (unsigned int i = 0; i < sz; i++) {
+        if (readTextValue(infile, data + i) != 1) {
+          return 0;
+        }
+      }
+      return 1;
+    }
+
+  /**
+    Header of the binary (.bin) cache of a stencil table, followed by the raw values of the flat table. The size
+    and the modification time of the text (.inp) file the cache was made from are stored, so that the cache is
+    not used once the text file changes.
+    */
+  struct StencilTableHeader {
+    char magic[8];
+    unsigned int valueSize;
+    unsigned int numValues;
+    long long inpSize;
+    long long inpMtime;
+  };
+
+  /**
+    @author Milinda Fernando
+    @brief Reads the sz values of the table name from the text file name.inp with readText into data. Asserts if
+    it can not be read. If cacheDir is not NULL the binary cache cacheDir/<file name of name>.bin is read instead
+    when it matches the size of the table and the size and modification time of name.inp. Otherwise the text
+    file is read and the cache is written (if it can not be written, the text file is read again next time).
+    */
+  template <typename T>
+    void readStencilTable(const char* name, T* data, unsigned int sz,
+        int (*readText)(FILE*, T*, unsigned int), const char* cacheDir = NULL) {
+      const char magic[8] = {'D', 'E', 'N', 'D', 'R', 'O', 'S', '2'};
+      char fname[260];
+      char binName[PETSC_MAX_PATH_LEN];
+
+      sprintf(fname, "%s.inp", name);
+      struct stat inpStat;
+      if (stat(fname, &inpStat) != 0) {
+        std::cout<<"The file "<<fname<<" is not good for reading."<<std::endl;
+        assert(false);
+      }
+
+      if (cacheDir) {
+        const char* baseName = strrchr(name, '/');
+        snprintf(binName, sizeof(binName), "%s/%s.bin", cacheDir, (baseName ? (baseName + 1) : name));
+        FILE* binFile = fopen(binName, "rb");
+        if (binFile) {
+          StencilTableHeader header;
+          const bool valid = (fread(&header, sizeof(header), 1, binFile) == 1) &&
+            (memcmp(header.magic, magic, 8) == 0) && (header.valueSize == sizeof(T)) && (header.numValues == sz) &&
+            (header.inpSize == static_cast<long long>(inpStat.st_size)) &&
+            (header.inpMtime == static_cast<long long>(inpStat.st_mtime)) &&
+            (fread(data, sizeof(T), sz, binFile) == sz);
+          fclose(binFile);
+          if (valid) {
+            return;
+          }
+        }
+      }
+
+      FILE* infile = fopen(fname, "r");
+      if (!infile) {
+        std::cout<<"The file "<<fname<<" is not good for reading."<<std::endl;
+        assert(false);
+      }
+      const int res = readText(infile, data, sz);
+      fclose(infile);
+      if (!res) {
+        std::cout<<"The file "<<fname<<" has less than "<<sz<<" values."<<std::endl;
+        assert(false);
+      }
+
+      if (cacheDir) {
+        FILE* binFile = fopen(binName, "wb");
+        if (binFile) {
+          StencilTableHeader header;
+          memset(&header, 0, sizeof(header));
+          memcpy(header.magic, magic, 8);
+          header.valueSize = sizeof(T);
+          header.numValues = sz;
+          header.inpSize = static_cast<long long>(inpStat.st_size);
+          header.inpMtime = static_cast<long long>(inpStat.st_mtime);
+          const bool written = (fwrite(&header, sizeof(header), 1, binFile) == 1) &&
+            (fwrite(data, sizeof(T), sz, binFile) == sz);
+          fclose(binFile);
+          if (!written) {
+            remove(binName);
+          }
+        }
+      }
+    }
+
+  /**
+    @author Milinda Fernando
+    @brief Creates a table of sz values that is stored once per shared memory node (MPI-3 shared window) and
+    returns its address on this processor. The lowest rank of each node is the leader of the node. The leaders
+    are grouped by fileId and the lowest one in each group reads name_fileId (just name if fileId < 0) with
+    readStencilTable and broadcasts it to the other leaders of its group, which copy it into their node's table.
+    Collective on comm. The table is read only and must be freed with destroyStencilTable. The binary cache of
+    readStencilTable is only used if the directory is given with the option -stencil_cache_dir <dir>.
+    @param comm the communicator
+    @param name the file name without the extension (and without the _fileId suffix)
+    @param fileId the file read by this processor's group. The leaders with the same fileId form a group, so -1 on
+    all processors reads a single file (name) on the first processor and fileId = rank reads a file per node.
+    @param sz the number of values of the table
+    @param win the shared window of the table
+    @param readText reads the text file, the default reads sz values in the order of the table
+    */
+  template <typename T>
+    T* createStencilTable(MPI_Comm comm, const char* name, int fileId, unsigned int sz, MPI_Win* win,
+        int (*readText)(FILE*, T*, unsigned int) = readTextTable<T>) {
+      int rank, nodeRank;
+      MPI_Comm_rank(comm, &rank);
+
+      MPI_Comm nodeComm;
+      MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, rank, MPI_INFO_NULL, &nodeComm);
+      MPI_Comm_rank(nodeComm, &nodeRank);
+
+      T* table = NULL;
+      MPI_Win_allocate_shared((nodeRank ? 0 : (sz*sizeof(T))), sizeof(T), MPI_INFO_NULL, nodeComm, &table, win);
+      MPI_Aint winSize;
+      int dispUnit;
+      MPI_Win_shared_query(*win, 0, &winSize, &dispUnit, &table);
+
+      MPI_Comm groupComm;
+      MPI_Comm_split(comm, (nodeRank ? MPI_UNDEFINED : ((fileId < 0) ? 0 : fileId)), rank, &groupComm);
+
+      MPI_Win_lock_all(MPI_MODE_NOCHECK, *win);
+      if (!nodeRank) {
+        int groupRank;
+        MPI_Comm_rank(groupComm, &groupRank);
+        if (!groupRank) {
+          char fname[250];
+          if (fileId < 0) {
+            sprintf(fname, "%s", name);
+          } else {
+            sprintf(fname, "%s_%d", name, fileId);
+          }
+          char cacheDir[PETSC_MAX_PATH_LEN];
+          PetscBool cacheDirFound = PETSC_FALSE;
+          PetscOptionsGetString(NULL, PETSC_NULL, "-stencil_cache_dir", cacheDir, sizeof(cacheDir), &cacheDirFound);
+          readStencilTable<T>(fname, table, sz, readText, (cacheDirFound ? cacheDir : NULL));
+        }
+        par::Mpi_Bcast<T>(table, sz, 0, groupComm);
+        MPI_Comm_free(&groupComm);
+      }
+      MPI_Win_sync(*win);
+      MPI_Barrier(nodeComm);
+      MPI_Win_sync(*win);
+      MPI_Win_unlock_all(*win);
+
+      MPI_Comm_free(&nodeComm);
+      return table;
+    }
+
+  /** Frees a table created by createStencilTable. Collective on the communicator of the table. */
+  inline void destroyStencilTable(MPI_Win* win) {
+    if (*win != MPI_WIN_NULL) {
+      MPI_Win_free(win);
+    }
+  }
+
+} //end namespace
+
+#endif
+
@@ -22,6 +22,41 @@ namespace ot {
       }
   }; 
 
+  /**
+    @brief Context for the persistent ghost exchange. The MPI requests (MPI_Send_init/MPI_Recv_init) and the
+    pack buffers are created once per DA, data type size, dof and direction and reused with MPI_Startall.
+    @see DA::setPersistentGhostExchange()
+    */
+  class persistentUpdateContext {
+    public:
+      unsigned int                    typeSize;
+      unsigned int                    dof;
+      bool                            isWrite;   // true for WriteToGhosts, false for ReadFromGhosts
+      void *                          buffer;    // array currently being updated, NULL if the context is idle
+      std::vector<char>               sendBuf;
+      std::vector<char>               recvBuf;
+      std::vector<MPI_Request>        requests;
+
+      persistentUpdateContext() {
+        typeSize = 0;
+        dof = 0;
+        isWrite = false;
+        buffer = NULL;
+      }
+
+      ~persistentUpdateContext() {
+        // A DA may outlive MPI_Finalize (e.g. a DA on the stack of main), the requests are gone with MPI then.
+        int finalized = 0;
+        MPI_Finalized(&finalized);
+        for(unsigned int i = 0; (!finalized) && (i < requests.size()); i++) {
+          if(requests[i] != MPI_REQUEST_NULL) {
+            MPI_Request_free(&(requests[i]));
+          }
+        }
+        requests.clear();
+      }
+  };
+
 } //end namespace
 
 #endif
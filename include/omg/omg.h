@@ -16,6 +16,8 @@
 #include "petscpc.h"
 #include "petscksp.h"
 #include <vector>
+#include <cstdio>
+#include "transferLoop.h"
 
 #ifdef PETSC_USE_LOG
 
@@ -230,6 +232,9 @@ namespace ot {
     @struct	PC_KSP_Shell
     @brief A private preconditioner object used within DAMG at the coarsest grid
     when not all processors are active on the coarsest grid.
+    If more than one processor is active, the private matrices and the rhs are gathered
+    on the first active processor, solved there and the solution is scattered back
+    (-damg_coarseGather, default true). Otherwise ksp_private is on the active processors.
     @author Rahul Sampath
     This must be used with KSPPREONLY only 
     */
@@ -237,9 +242,14 @@ namespace ot {
     bool iAmActive; /**< True if the calling processor is active. */
     MPI_Comm commActive; /**< The active processors */
     PC pc; /**< The PCSHELL itself */
-    KSP ksp_private; /**< Internal KSP */
+    KSP ksp_private; /**< Internal KSP, NULL on the processors that do not solve */
     Vec rhs_private; /**< Internal rhs vector for ksp_private */ 
     Vec sol_private; /**< Internal rhs vector for sol_private */
+    bool gathered; /**< True if the problem is gathered on the first active processor */
+    Mat* amat_gathered; /**< The gathered Amat (first active processor), or NULL */
+    Mat* pmat_gathered; /**< The gathered Pmat if it is not Amat, or NULL */
+    int* gatherSz; /**< The local sizes of the active processors (first active processor) */
+    int* gatherOff; /**< The offsets of gatherSz */
   } PC_KSP_Shell;
 
   PetscErrorCode PC_KSP_Shell_SetUp(PC pc);
@@ -393,11 +403,15 @@ namespace ot {
     unsigned char* suppressedDOFc; /**< Dirichlet nodes on the coarse mesh */
     unsigned char* suppressedDOFf; /**< Dirichlet nodes on the fine mesh */
     std::vector<ot::FineTouchedStatus >* fineTouchedFlags; /**< The masks used for Restriction/Prolongation */
+    ot::FineTouchedStatus* fineTouchedFlagsArr; /**< Ghosted buffer of fineTouchedFlags, with the ghosts
+                                                  synchronized once by dummyRestrictMatVecType1 */
     unsigned int dof; /**< The number of degrees of freedom per node */
     MPI_Comm comm;
     Vec tmp; //For R/P-type2 scatter
     Vec addRtmp;
     Vec addPtmp;
+    ot::TransferLoop* transferLoops; /**< The INDEPENDENT and W_DEPENDENT loops of the threaded R/P, built at
+                                       the first use (OMP_MG_TRANSFER) */
     /** @name Communication Stuff for Scatters */
     //@{
     int * sendSzP; 
@@ -456,6 +470,15 @@ namespace ot {
 
   /** 
     @brief Constructs the Multigrid object.
+    The finer levels are meshed on the partition (blocks) of the coarsest level unless an aux DA is needed, so
+    they are not partitioned again. Every level is still coarsened and balanced from the next finer one, and under
+    HILBERT_ORDERING every DA still sorts its octree again after embedding it (see DA::DA_FactoryPart1). Unless __SILENT_MODE__ is defined, the time and the bytes sent to other
+    processors (par::commBytesSent) of building and meshing each level are printed on processor 0.
+    A level with less than -damg_minGrainSize (default 1000) octants per processor is agglomerated on fewer
+    processors. If that leaves processors idle on the coarsest level, DAMGSetKSP solves it on the active
+    processors only (PC_KSP_Shell), gathered on the first of them if there are several.
+    The restriction and prolongation between the levels assume Morton ordering, with HILBERT_ORDERING only
+    nlevels = 1 is supported and PETSC_ERR_SUP is returned otherwise.
     @param comm The communicator
     @param nlevels maximum number of multigrid levels. This may be reset to something smaller within the function.
     @param user User context
@@ -643,6 +666,13 @@ namespace ot {
   int IreadVtxMaps(unsigned short ****&map1, unsigned short *****&map2,
       unsigned short *****&map3, unsigned short ******&map4, int rank);
 
+  /**
+    @brief Reads vtxMap.inp (the order of readVtxMaps) into the flat table used by DAMG_Initialize:
+    map1[8][8][18][8], map2[8][8][8][18][8], map3[7][2][8][18][8] and map4[7][2][8][8][18][8] one after the other.
+    @return 0 if the file has less than sz = 228096 values.
+    */
+  int readVtxMapsText(FILE* infile, unsigned short* maps, unsigned int sz);
+
 
   //Coarse and fine are aligned. No need to use da_aux
   PetscErrorCode createInterpolationType1(DAMG , DAMG, Mat *);
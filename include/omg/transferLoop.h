@@ -0,0 +1,113 @@
+/**
+  @file transferLoop.h
+  @brief A snapshot of the simultaneous coarse/fine element loops of the inter-grid transfer operators that can be
+  traversed by several threads.
+  @author Milinda Fernando
+  */
+
+#ifndef __TRANSFER_LOOP_H__
+#define __TRANSFER_LOOP_H__
+
+#include <vector>
+#include <algorithm>
+
+#ifndef DA_ELEMENT_LOOP_CHUNK_SIZE
+#define DA_ELEMENT_LOOP_CHUNK_SIZE 256
+#endif
+
+namespace ot {
+
+  class DA;
+
+  /**
+    @author Milinda Fernando
+    @brief The coarse elements visited by one loop (INDEPENDENT or W_DEPENDENT) of the restriction and
+    prolongation in loop order together with the fine elements they are aligned with. The walk of the coarse
+    and the fine DA iterators (including the alignment of the fine iterator with the coarse one) is done once, so
+    a chunk of coarse elements can be processed by any thread without touching the iterators of the DAs.
+    The chunks are colored such that no two chunks of the same color share a coarse or a fine node, hence the
+    chunks of one color can be processed concurrently and scatter into either grid without races.
+    @see buildTransferLoops()
+    */
+  class TransferLoop {
+    public:
+      /** DA::getNodeIndices() of each coarse element, 8 per position */
+      std::vector<unsigned int>   coarseNodes;
+      /** DA::getChildNumber() of each coarse element */
+      std::vector<unsigned char>  coarseChildNums;
+      /** the element type (GET_ETYPE_BLOCK) of each coarse element */
+      std::vector<unsigned char>  coarseTypes;
+      /** the fine elements of position p are [fineOffsets[p], fineOffsets[p+1]), 1 (type-2) or 8 (type-1) */
+      std::vector<unsigned int>   fineOffsets;
+      /** DA::getNodeIndices() of each fine element, 8 per fine element */
+      std::vector<unsigned int>   fineNodes;
+      /** DA::getHangingNodeIndex() of each fine element */
+      std::vector<unsigned char>  fineHnMasks;
+      /** chunk c covers the positions [chunkOffsets[c], chunkOffsets[c+1]) */
+      std::vector<unsigned int>   chunkOffsets;
+      /** the chunks of color k are colorChunks[colorOffsets[k]] ... colorChunks[colorOffsets[k+1]-1] */
+      std::vector<unsigned int>   colorOffsets;
+      std::vector<unsigned int>   colorChunks;
+      /** number of coarse elements per chunk */
+      unsigned int                chunkSize;
+
+      TransferLoop() : chunkSize(0) { }
+
+      unsigned int getNumElements() const { return static_cast<unsigned int>(coarseChildNums.size()); }
+
+      unsigned int getNumChunks() const {
+        return (chunkOffsets.empty() ? 0 : static_cast<unsigned int>(chunkOffsets.size() - 1));
+      }
+
+      unsigned int getNumColors() const {
+        return (colorOffsets.empty() ? 0 : static_cast<unsigned int>(colorOffsets.size() - 1));
+      }
+
+      /** The number of chunks that cover the first numElems positions. */
+      unsigned int getNumChunks(unsigned int numElems) const {
+        return std::min<unsigned int>(getNumChunks(), (numElems + chunkSize - 1)/chunkSize);
+      }
+
+      /**
+        @brief Calls kernel(pos) for the positions of the chunks [chunkBegin, chunkEnd), color by color. With
+        OpenMP the chunks of a color are processed by the threads of a parallel region, so kernel must only
+        scatter into the nodes of its own position.
+        */
+      template <typename Kernel>
+        void apply(unsigned int chunkBegin, unsigned int chunkEnd, const Kernel & kernel) const {
+          for (unsigned int color = 0; color < getNumColors(); color++) {
+            const unsigned int* first = &(*(colorChunks.begin())) + colorOffsets[color];
+            const unsigned int* last = &(*(colorChunks.begin())) + colorOffsets[color + 1];
+            //The chunks of a color are sorted.
+            const int cBegin = static_cast<int>(std::lower_bound(first, last, chunkBegin) - first);
+            const int cEnd = static_cast<int>(std::lower_bound(first, last, chunkEnd) - first);
+#ifdef OMP_MG_TRANSFER
+#pragma omp parallel for schedule(dynamic)
+#endif
+            for (int c = cBegin; c < cEnd; c++) {
+              const unsigned int chunk = first[c];
+              for (unsigned int pos = chunkOffsets[chunk]; pos < chunkOffsets[chunk + 1]; pos++) {
+                kernel(pos);
+              }
+            }
+          }
+        }
+  };
+
+  /**
+    @author Milinda Fernando
+    @brief Builds the INDEPENDENT (loops[0]) and the W_DEPENDENT (loops[1]) transfer loops of an aligned
+    coarse/fine pair of DAs. Must be called on the processors where dac is active, it uses the iterators of both
+    DAs.
+    @param dac the coarse DA
+    @param daf the fine DA
+    @param loops the two loops
+    @param chunkSize the number of coarse elements per chunk
+    */
+  void buildTransferLoops(DA* dac, DA* daf, TransferLoop* loops,
+      unsigned int chunkSize = DA_ELEMENT_LOOP_CHUNK_SIZE);
+
+} //end namespace
+
+#endif
+
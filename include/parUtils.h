@@ -22,8 +22,13 @@
 
 #include "mpi.h"
 #include <vector>
+#include <atomic>
 #include "dendro.h"
 #define TOLLERANCE_OCT 0.1
+// the two tags used by par::Mpi_Alltoallv_NBX (NBX_TAG and NBX_TAG+1)
+#ifndef NBX_TAG
+#define NBX_TAG 12500
+#endif
 //#include "seqUtils.h"
 
 #ifdef PETSC_USE_LOG
@@ -248,7 +253,15 @@ PetscFunctionReturn(0);
 
 namespace par {
 
-
+  /**
+    @author Milinda Fernando
+    @brief The number of bytes this processor has handed to the send side of the point-to-point (Mpi_Isend,
+    Mpi_Issend, Mpi_Sendrecv) and the all-to-all functions below for other processors. It is never reset by par, so
+    the communication volume of a phase is the difference of two reads, e.g. the levels of ot::DAMGCreateAndSetDA.
+    It is atomic, so threads calling these functions concurrently are all counted, but it is shared by all the
+    communicators of the processor, so a phase should not overlap with communication on another communicator.
+    */
+  extern std::atomic<DendroIntL> commBytesSent;
 
   template <typename T>
     int Mpi_Isend(T* buf, int count, int dest, int tag, MPI_Comm comm, MPI_Request* request);
@@ -338,6 +351,30 @@ namespace par {
     int Mpi_Alltoallv_Kway(T* sbuff_, int* s_cnt_, int* sdisp_,
                            T* rbuff_, int* r_cnt_, int* rdisp_, MPI_Comm c);
 
+  /**
+    @author Milinda Fernando
+    @brief Returns the tag of the next Mpi_Alltoallv_NBX on comm. The calls on a communicator alternate between two
+    tags (the call count is cached as an attribute of comm), so the messages of a processor that already started the
+    next exchange are never received by the previous one. Must be called by all processors of comm.
+    */
+  int getNbxTag(MPI_Comm comm);
+
+  /**
+    @author Milinda Fernando
+    @brief Sparse all-to-all with non-blocking consensus (NBX, Hoefler et al.). Only the processors with a non zero
+    sendcnts are sent to (MPI_Issend) and the senders are discovered with MPI_Iprobe, the exchange ends with an
+    MPI_Ibarrier which is entered once all the sends of this processor are matched. No counts are exchanged, so the
+    communication is O(number of neighbours) instead of O(npes). The received data is stored in recvbuf in the order of
+    the source ranks, exactly as Mpi_Alltoallv with the counts of Mpi_Alltoall.
+    @param sendbuf the data to send, the part for processor i is sendcnts[i] elements at sdispls[i]
+    @param recvbuf the received data (resized)
+    @param recvcnts (out) the number of elements received from each processor, npes values
+    @param rdispls (out) the offsets of the data of each processor in recvbuf, npes values
+    */
+  template <typename T>
+    int Mpi_Alltoallv_NBX(T* sendbuf, int* sendcnts, int* sdispls,
+        std::vector<T>& recvbuf, int* recvcnts, int* rdispls, MPI_Comm comm);
+
 
 
     /**
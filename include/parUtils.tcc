@@ -38,6 +38,7 @@ namespace par {
 
     MPI_Isend(buf, count, par::Mpi_datatype<T>::value(),
               dest, tag, comm, request);
+    commBytesSent += (static_cast<DendroIntL>(count)*sizeof(T));
 
     return 1;
 
@@ -49,6 +50,7 @@ namespace par {
 
     MPI_Issend(buf, count, par::Mpi_datatype<T>::value(),
                dest, tag, comm, request);
+    commBytesSent += (static_cast<DendroIntL>(count)*sizeof(T));
 
     return 1;
 
@@ -84,6 +86,9 @@ namespace par {
 
     MPI_Sendrecv(sendBuf, sendCount, par::Mpi_datatype<T>::value(), dest, sendTag,
                  recvBuf, recvCount, par::Mpi_datatype<S>::value(), source, recvTag, comm, status);
+    if(dest != MPI_PROC_NULL) {
+      commBytesSent += (static_cast<DendroIntL>(sendCount)*sizeof(T));
+    }
 
     PROF_PAR_SENDRECV_END
   }
@@ -122,6 +127,10 @@ namespace par {
     MPI_Alltoall(sendbuf, count, par::Mpi_datatype<T>::value(),
                  recvbuf, count, par::Mpi_datatype<T>::value(), comm);
 
+    int npes;
+    MPI_Comm_size(comm, &npes);
+    commBytesSent += (static_cast<DendroIntL>(count)*(npes - 1)*sizeof(T));
+
     PROF_PAR_ALL2ALL_END
   }
 
@@ -137,6 +146,15 @@ namespace par {
         sendbuf, sendcnts, sdispls, par::Mpi_datatype<T>::value(),
         recvbuf, recvcnts, rdispls, par::Mpi_datatype<T>::value(),
         comm);
+
+    int npes, rank;
+    MPI_Comm_size(comm, &npes);
+    MPI_Comm_rank(comm, &rank);
+    for(int i = 0; i < npes; i++) {
+      if(i != rank) {
+        commBytesSent += (static_cast<DendroIntL>(sendcnts[i])*sizeof(T));
+      }
+    }
     return 0;
   }
 
@@ -571,6 +589,9 @@ namespace par {
 //          ttt=omp_get_wtime();
           MPI_Sendrecv(&sbuff[send_dsp], send_cnt, MPI_BYTE, partner, 0,
                        &rbuff[rdisp[new_np  * i ]], r_cnt[new_np  *(i+1)-1]+rdisp[new_np  *(i+1)-1]-rdisp[new_np  * i ], MPI_BYTE, partner, 0, c, &status);
+          if(partner != pid) {
+            commBytesSent += send_cnt;
+          }
 //          tt[200*pid+t_indx]=omp_get_wtime()-ttt;
 //          t_indx++;
 
@@ -749,6 +770,88 @@ namespace par {
     }
 
 
+  template<typename T>
+  int Mpi_Alltoallv_NBX(T *sendbuf, int *sendcnts, int *sdispls,
+                        std::vector<T> &recvbuf, int *recvcnts, int *rdispls, MPI_Comm comm) {
+#ifdef __PROFILE_WITH_BARRIER__
+    MPI_Barrier(comm);
+#endif
+    PROF_PAR_ALL2ALLV_SPARSE_BEGIN
+
+    int npes, rank;
+    MPI_Comm_size(comm, &npes);
+    MPI_Comm_rank(comm, &rank);
+
+    const int tag = getNbxTag(comm);
+
+    std::vector<MPI_Request> sendRequests;
+    for (int i = 0; i < npes; i++) {
+      if ((i != rank) && (sendcnts[i] > 0)) {
+        sendRequests.push_back(MPI_REQUEST_NULL);
+        par::Mpi_Issend<T>(&(sendbuf[sdispls[i]]), sendcnts[i], i, tag, comm, &(sendRequests.back()));
+      }
+    }
+
+    // The messages are received in the order they arrive and copied to recvbuf in the order of the sources.
+    std::vector<int> srcs;
+    std::vector<std::vector<T> > msgs;
+    MPI_Request barrier = MPI_REQUEST_NULL;
+    bool barrierActive = false;
+    bool done = false;
+    while (!done) {
+      int flag = 0;
+      MPI_Status status;
+      MPI_Iprobe(MPI_ANY_SOURCE, tag, comm, &flag, &status);
+      if (flag) {
+        int cnt;
+        MPI_Get_count(&status, par::Mpi_datatype<T>::value(), &cnt);
+        srcs.push_back(status.MPI_SOURCE);
+        msgs.push_back(std::vector<T>(cnt));
+        par::Mpi_Recv<T>((cnt ? (&(*(msgs.back().begin()))) : NULL), cnt, status.MPI_SOURCE, tag, comm,
+                         MPI_STATUS_IGNORE);
+      }
+
+      if (barrierActive) {
+        MPI_Test(&barrier, &flag, MPI_STATUS_IGNORE);
+        done = (flag != 0);
+      } else {
+        // Issend completes only after the message is matched, hence all the messages of this processor are received.
+        MPI_Testall(static_cast<int>(sendRequests.size()), (sendRequests.empty() ? NULL : (&(*(sendRequests.begin())))),
+                    &flag, MPI_STATUSES_IGNORE);
+        if (flag) {
+          MPI_Ibarrier(comm, &barrier);
+          barrierActive = true;
+        }
+      }
+    }
+
+    for (int i = 0; i < npes; i++) {
+      recvcnts[i] = 0;
+    }
+    recvcnts[rank] = sendcnts[rank];
+    std::vector<int> msgOf(npes, -1);
+    for (unsigned int m = 0; m < srcs.size(); m++) {
+      recvcnts[srcs[m]] = static_cast<int>(msgs[m].size());
+      msgOf[srcs[m]] = m;
+    }
+    rdispls[0] = 0;
+    for (int i = 1; i < npes; i++) {
+      rdispls[i] = rdispls[i - 1] + recvcnts[i - 1];
+    }
+
+    recvbuf.resize(rdispls[npes - 1] + recvcnts[npes - 1]);
+    for (int i = 0; i < npes; i++) {
+      if (i == rank) {
+        std::copy(sendbuf + sdispls[rank], sendbuf + sdispls[rank] + sendcnts[rank], recvbuf.begin() + rdispls[rank]);
+      } else if (msgOf[i] >= 0) {
+        std::copy(msgs[msgOf[i]].begin(), msgs[msgOf[i]].end(), recvbuf.begin() + rdispls[i]);
+      }
+    }
+
+    PROF_PAR_ALL2ALLV_SPARSE_END
+  }
+
+
 
   template<typename T>
   unsigned int defaultWeight(const T *a) {
@@ -27,6 +27,7 @@
 #include "dendro.h"
 #include "testUtils.h"
 #include "ompUtils.h"
+#include <omp.h>
 
 #include <mpi.h>
 #include <chrono>
@@ -42,6 +43,17 @@
 
 #define MAXDEAPTH_LEVEL_DIFF 0
 
+// buckets larger than this are sorted as separate OpenMP tasks in SFC::seqSort::SFC_treeSort_omp
+#ifndef OMP_TREE_SORT_TASK_THRESHOLD
+#define OMP_TREE_SORT_TASK_THRESHOLD 8192
+#endif
+
+// SFC::parSort::SFC_treeSort exchanges the octants with par::Mpi_Alltoallv_NBX if no processor sends to more than this
+// many others, with par::Mpi_Alltoallv_Kway otherwise
+#ifndef NBX_MAX_NEIGHBOURS
+#define NBX_MAX_NEIGHBOURS 32
+#endif
+
 #ifdef PROFILE_TREE_SORT
 #include <chrono>
 // for timer
@@ -56,6 +68,7 @@ std::vector<double> stats; // contains the last run of the SFC::parSort::SFC_Tre
  *  all2all1_time (min mean max)
  *  all2all2_time (min mean max)
  *  localSort_time (min mean max)
+ *  localSort_speedup (min mean max) (only with OMP_TREE_SORT)
  *  remove_duplicates_seq (min mean max)
  *  remove duplicates_par (min mean max)
  *  auxBalOct (min mean max)
@@ -73,6 +86,7 @@ double all2all1_time=0;
 double all2all2_time=0;
 
 double localSort_time=0;
+double localSort_work_time=0; // accumulated (per thread) time spent in the local sort, used to report the OpenMP speedup.
 double remove_duplicates_seq=0;
 double remove_duplicates_par=0;
 
@@ -240,6 +254,53 @@ struct OctreeHash{
 };
 
 
+/**
+ * @author Milinda Fernando
+ * @breif computes the SFC key of an octant. The key stores the SFC child index (Hilbert or Morton, depending on
+ * HILBERT_ORDERING) at each level from the root to the octant's level, padded with zeros up to maxDepth, followed by
+ * 5 bits of level. Comparing two keys as integers gives the same order as TreeNode::operator< (ancestors come before
+ * their descendants), so the key need to be computed only once per octant. Requires maxDepth*dim+5 <= 128.
+ * Note that the Hilbert table needs to be initialized (_InitializeHcurve) before calling this function.
+ * @param[in] pNode: input octant
+ * @return the SFC key of pNode.
+ * */
+template<typename T>
+inline uint128_t SFC_computeKey(const T & pNode)
+{
+    const unsigned int dim=pNode.getDim();
+    const unsigned int maxDepth=pNode.getMaxDepth();
+    const unsigned int lev=pNode.getLevel();
+    const unsigned int x=pNode.getX();
+    const unsigned int y=pNode.getY();
+    const unsigned int z=pNode.getZ();
+
+    uint128_t key=0;
+    unsigned int mid_bit;
+    unsigned int index;
+#ifdef HILBERT_ORDERING
+    const unsigned int num_children=1u<<dim;
+    const unsigned int rot_offset=num_children<<1u;
+    unsigned int current_rot=0;
+#endif
+
+    for(unsigned int l=0;l<lev;l++)
+    {
+        mid_bit=maxDepth-l-1;
+        index=((((z & (1u << mid_bit)) >> mid_bit) << 2u) |(((y & (1u << mid_bit)) >> mid_bit) << 1u) | ((x & (1u << mid_bit)) >> mid_bit));
+#ifdef HILBERT_ORDERING
+        key=(key<<dim) | (uint128_t)(rotations[rot_offset*current_rot+num_children+index]-'0');
+        current_rot=HILBERT_TABLE[current_rot*num_children+index];
+#else
+        key=(key<<dim) | (uint128_t)index;
+#endif
+    }
+
+    key<<=(dim*(maxDepth-lev));
+    return ((key<<5u) | (uint128_t)lev);
+
+}
+
+
 
 
 namespace SFC {
@@ -259,6 +320,9 @@ namespace SFC {
         /**
          * @author Milinda Fernando
          * @breif Bottom up construction of the auxilary octants which will be needed in the balancing stage.
+         * The octants are processed level by level from the finest level. The neighbours of the parents of each level
+         * are generated in thread local buffers and deduplicated by sorting (against the input octants of the coarser level),
+         * the new ones are appended to pNodes.
          * * Assumes that ,
          * 1) input is sorted and complete.
          * */
@@ -266,6 +330,35 @@ namespace SFC {
         inline void SFC_bottomUpBalOctantCreation(std::vector<T> & pNodes);
 
 
+        /**
+         * @author Milinda Fernando
+         * @breif The level walk of SFC_bottomUpBalOctantCreation. The new auxiliary octants are appended to pAux and
+         * the (sorted and unique) parents of the octants of level l+1, i.e. the octants of level l that are refined in
+         * the balanced octree, are stored in (*pRefined)[l]. pAux or pRefined can be NULL.
+         * * Assumes that ,
+         * 1) input is sorted and complete.
+         * */
+        template<typename T>
+        inline void SFC_bottomUpBalLevels(const std::vector<T> & pNodes, std::vector<T>* pAux, std::vector<std::vector<T> >* pRefined);
+
+
+        /**
+         * @author Milinda Fernando
+         * @breif The 2:1 balanced octree of the sorted and complete octree pNodes in SFC order. The refined octants of
+         * every level are found by SFC_bottomUpBalLevels and the leaves are emitted by a depth first traversal from
+         * the root in the SFC order, so the balanced octree is neither deduplicated nor sorted afterwards.
+         * */
+        template<typename T>
+        inline void SFC_bottomUpBalance(const std::vector<T> & pNodes, std::vector<T> & pOutBalanced);
+
+
+        /**
+         * @breif Depth first traversal of SFC_bottomUpBalance, oct is refined if it is in refined[level of oct].
+         * */
+        template<typename T>
+        void SFC_balancedLeaves(const T & oct, unsigned int rot_id, const std::vector<std::vector<T> > & refined, std::vector<T> & pOutBalanced);
+
+
         /**
          * @author Milinda Fernando
          * @breif Sequential version of the tree sort algorithm.
@@ -282,6 +375,32 @@ namespace SFC {
         void SFC_treeSort(T* pNodes , DendroIntL n ,std::vector<T>& pOutSorted,std::vector<T>& pOutConstruct,std::vector<T>& pOutBalanced, unsigned int pMaxDepthBit,unsigned int pMaxDepth, T& parent, unsigned int rot_id,unsigned int k, unsigned int options);
 
 
+        /**
+         * @breif Final stage of the sequential tree sort (executed once at the root level). Performs the remove duplicates
+         * and the balancing (SFC_bottomUpBalance) depending on the options.
+         * */
+        template<typename T>
+        void SFC_treeSortFinalize(T* pNodes , DendroIntL n ,std::vector<T>& pOutSorted,std::vector<T>& pOutBalanced,unsigned int options);
+
+
+        /**
+         * @breif OpenMP task parallel version of the sequential tree sort. Buckets larger than taskThreshold are sorted in
+         * separate tasks, each writing to its own construct/balance output which are merged in the SFC order. Produces the
+         * same output as SFC_treeSort.
+         * @param[in] taskThreshold: buckets with more than taskThreshold elements are spawned as tasks.
+         * */
+        template<typename T>
+        void SFC_treeSort_omp(T* pNodes , DendroIntL n ,std::vector<T>& pOutSorted,std::vector<T>& pOutConstruct,std::vector<T>& pOutBalanced, unsigned int pMaxDepthBit,unsigned int pMaxDepth, T& parent, unsigned int rot_id,unsigned int k, unsigned int options,DendroIntL taskThreshold=OMP_TREE_SORT_TASK_THRESHOLD);
+
+
+        /**
+         * @breif Recursive worker of SFC_treeSort_omp. Only the construct and balance outputs are generated here, the final
+         * stage is done by SFC_treeSort_omp.
+         * */
+        template<typename T>
+        void SFC_treeSortTask(T* pNodes , DendroIntL n ,std::vector<T>& pOutConstruct,std::vector<T>& pOutBalanced, unsigned int pMaxDepthBit,unsigned int pMaxDepth, T& parent, unsigned int rot_id,unsigned int k, unsigned int options,DendroIntL taskThreshold);
+
+
         /**
        * @author Milinda Fernando
        * @breif Sequential Bucketing function which will be needed in adaptive load balancing and parallel tree sort implmentation.
@@ -312,106 +431,187 @@ namespace SFC {
 
         template<typename T>
         inline void SFC_bottomUpBalOctantCreation(std::vector<T> & pNodes)
-        {//$
+        {
+            std::vector<T> aux;
+            SFC_bottomUpBalLevels(pNodes,&aux,(std::vector<std::vector<T> >*)NULL);
+            pNodes.insert(pNodes.end(),aux.begin(),aux.end());
+        }
+
 
+        template<typename T>
+        inline void SFC_bottomUpBalance(const std::vector<T> & pNodes, std::vector<T> & pOutBalanced)
+        {
+            pOutBalanced.clear();
             if(pNodes.empty()){ return; }
 
-            T tmpParent;
-            /*std::vector<T> tmpSorted;*/
-            unsigned int m_uiMaxDepth=pNodes.front().getMaxDepth();
-            T root(m_uiDim,m_uiMaxDepth);
-            std::set<T,OctreeComp<T> > auxOct(pNodes.begin(),pNodes.end());
-            std::set<T,OctreeComp<T> > parentAux;
-            unsigned int neighbourCount=0;
+            const unsigned int m_uiMaxDepth=pNodes.front().getMaxDepth();
+            std::vector<std::vector<T> > refined(m_uiMaxDepth+1);
+            SFC_bottomUpBalLevels(pNodes,(std::vector<T>*)NULL,&refined);
 
-            unsigned int newCount=0;
-            unsigned int preSz=0;
-            unsigned int curr=0;
-            unsigned int d_max=(1u<<m_uiMaxDepth);
+            pOutBalanced.reserve(pNodes.size());
+            const T root(0,0,0,0,m_uiDim,m_uiMaxDepth);
+            SFC_balancedLeaves(root,0,refined,pOutBalanced);
+        }
+
+
+        template<typename T>
+        void SFC_balancedLeaves(const T & oct, unsigned int rot_id, const std::vector<std::vector<T> > & refined, std::vector<T> & pOutBalanced)
+        {
+            OctreeComp<T> comp;
+            const unsigned int lev=oct.getLevel();
+            if(!std::binary_search(refined[lev].begin(),refined[lev].end(),oct,comp)) {
+                pOutBalanced.push_back(oct);
+                return;
+            }
+
+            // the children in the SFC order, as in SFC_treeSort.
+            const unsigned int maxDepth=oct.getMaxDepth();
+            const unsigned int len=1u<<(maxDepth-lev-1);
+            unsigned int cnum;
+            for (unsigned int i=1; i<(NUM_CHILDREN+1); i++) {
+                cnum=(rotations[ROTATION_OFFSET*rot_id+i-1]-'0');
+                const T child(oct.getX()+((cnum & 1u)? len : 0u),oct.getY()+((cnum & 2u)? len : 0u),oct.getZ()+((cnum & 4u)? len : 0u),(lev+1),oct.getDim(),maxDepth);
+                SFC_balancedLeaves(child,HILBERT_TABLE[NUM_CHILDREN*rot_id+cnum],refined,pOutBalanced);
+            }
+        }
+
+
+        template<typename T>
+        inline void SFC_bottomUpBalLevels(const std::vector<T> & pNodes, std::vector<T>* pAux, std::vector<std::vector<T> >* pRefined)
+        {//$
+
+            if(pNodes.empty()){ return; }
+
+            const unsigned int m_uiMaxDepth=pNodes.front().getMaxDepth();
+            const T root(m_uiDim,m_uiMaxDepth);
+            OctreeComp<T> comp;
 
 #ifdef DIM_2
-            neighbourCount=8;
+            const unsigned int neighbourCount=8;
 #else
-            neighbourCount=26;
+            const unsigned int neighbourCount=26;
 #endif
 
-            std::pair<typename std::set<T,OctreeComp<T>>::iterator,bool> hint[neighbourCount];
-            std::pair<typename std::set<T,OctreeComp<T>>::iterator,bool> hintParent;
+            // levOct[l] holds the input octants of level l followed by the candidate auxiliary octants of level l.
+            std::vector<std::vector<T> > levOct(m_uiMaxDepth+1);
+            std::vector<DendroIntL> numInput(m_uiMaxDepth+1,0);
 
-           /* std::unordered_set<T,OctreeHash<T>> auxOct(pNodes.begin(),pNodes.end());
-            std::pair<typename std::unordered_set<T,OctreeHash<T>>::iterator,bool> hint;*/
+            for(DendroIntL w=0;w<pNodes.size();++w)
+                levOct[pNodes[w].getLevel()].push_back(pNodes[w]);
 
+            for(unsigned int l=0;l<=m_uiMaxDepth;l++) {
+                numInput[l]=levOct[l].size();
+                omp_par::merge_sort(levOct[l].begin(),levOct[l].end(),comp);
+            }
 
-            for(unsigned int w=0;w<pNodes.size();++w){
-                hintParent=parentAux.emplace(pNodes[w].getParent());
-                if(hintParent.second) {
-                    tmpParent=*(hintParent.first);
+            // Neighbours of the parents which are outside the domain are returned as the root.
+            bool foundRoot=false;
+            int numThreads=omp_get_max_threads();
+            std::vector<std::vector<T> > threadNeighbours(numThreads);
+            std::vector<T> candidates;
+            std::vector<T> parents;
+
+            for(int l=m_uiMaxDepth;l>=0;l--) {
+
+                std::vector<T> & octants=levOct[l];
+                candidates.assign(octants.begin()+numInput[l],octants.end());
+                octants.resize(numInput[l]);
+                if(l==0 && foundRoot) candidates.push_back(root);
+
+                omp_par::merge_sort(candidates.begin(),candidates.end(),comp);
+
+                // Keeps the unique candidates which are not an input octant of this level. Both are sorted.
+                DendroIntL numNew=0;
+                DendroIntL i=0;
+                for(DendroIntL c=0;c<candidates.size();c++) {
+                    if(numNew && !comp(candidates[numNew-1],candidates[c])) continue;
+                    while(i<numInput[l] && comp(octants[i],candidates[c])) i++;
+                    if(i<numInput[l] && !comp(candidates[c],octants[i])) continue;
+                    candidates[numNew++]=candidates[c];
+                }
+                candidates.resize(numNew);
 
-#ifdef DIM_2
+                octants.insert(octants.end(),candidates.begin(),candidates.end());
+                if(pAux) pAux->insert(pAux->end(),candidates.begin(),candidates.end());
 
-                auxOct.emplace(tmpParent.getLeft());
-                auxOct.emplace(tmpParent.getRight());
-                auxOct.emplace(tmpParent.getFront());
-                auxOct.emplace(tmpParent.getBack());
-                auxOct.emplace(tmpParent.getLeftBack());
-                auxOct.emplace(tmpParent.getRightBack());
-                auxOct.emplace(tmpParent.getLeftFront());
-                auxOct.emplace(tmpParent.getRightFront());
+                if(l==0) break;
 
-#else
+                // The input octants and the new auxiliary octants of this level are disjoint, the parents of both are needed.
+                parents.resize(octants.size());
+                #pragma omp parallel for
+                for(DendroIntL w=0;w<octants.size();w++)
+                    parents[w]=octants[w].getParent();
 
+                std::vector<T>().swap(octants);
+                omp_par::merge_sort(parents.begin(),parents.end(),comp);
+                parents.erase(std::unique(parents.begin(),parents.end()),parents.end());
+                if(pRefined) (*pRefined)[l-1]=parents;
 
-                    preSz=auxOct.size();
-                    hint[0] = auxOct.emplace(tmpParent.getLeft());
-                    hint[1] = auxOct.emplace(tmpParent.getLeftBack());
-                    hint[2] = auxOct.emplace(tmpParent.getLeftFront());
-                    hint[3] = auxOct.emplace(tmpParent.getRight());
-                    hint[4] = auxOct.emplace(tmpParent.getRightBack());
-                    hint[5] = auxOct.emplace(tmpParent.getRightFront());
-                    hint[6] = auxOct.emplace(tmpParent.getBack());
-                    hint[7] = auxOct.emplace(tmpParent.getFront());
-                    hint[8] = auxOct.emplace(tmpParent.getBottom());
-                    hint[9] = auxOct.emplace(tmpParent.getBottomLeft());
-                    hint[10] = auxOct.emplace(tmpParent.getBottomLeftBack());
-                    hint[11] = auxOct.emplace(tmpParent.getBottomLeftFront());
-                    hint[12] = auxOct.emplace(tmpParent.getBottomRight());
-                    hint[13] = auxOct.emplace(tmpParent.getBottomRightBack());
-                    hint[14] = auxOct.emplace(tmpParent.getBottomRightFront());
-                    hint[15] = auxOct.emplace(tmpParent.getBottomBack());
-                    hint[16] = auxOct.emplace(tmpParent.getBottomFront());
-                    hint[17] = auxOct.emplace(tmpParent.getTop());
-                    hint[18] = auxOct.emplace(tmpParent.getTopLeft());
-                    hint[19] = auxOct.emplace(tmpParent.getTopLeftBack());
-                    hint[20] = auxOct.emplace(tmpParent.getTopLeftFront());
-                    hint[21] = auxOct.emplace(tmpParent.getTopRight());
-                    hint[22] = auxOct.emplace(tmpParent.getTopRightBack());
-                    hint[23] = auxOct.emplace(tmpParent.getTopRightFront());
-                    hint[24] = auxOct.emplace(tmpParent.getTopBack());
-                    hint[25] = auxOct.emplace(tmpParent.getTopFront());
-#endif
-
-                    if(auxOct.size()>preSz)
-                    {
-                        curr=0;
-                        pNodes.resize(pNodes.size()+auxOct.size()-preSz);
-                        for(unsigned int kk=0;kk<neighbourCount;kk++)
-                        {
-                            if(hint[kk].second) {
-                                pNodes[preSz + curr] = *(hint[kk].first);
-                                //pNodes.push_back(*(hint[kk].first));
-                                curr++;
-                            }
+                #pragma omp parallel reduction(|:foundRoot)
+                {
+                    std::vector<T> & myNeighbours=threadNeighbours[omp_get_thread_num()];
+                    myNeighbours.clear();
+                    T nb[26];
+
+                    #pragma omp for schedule(static)
+                    for(DendroIntL w=0;w<parents.size();w++) {
 
+                        const T & tmpParent=parents[w];
+#ifdef DIM_2
+                        nb[0]=tmpParent.getLeft();
+                        nb[1]=tmpParent.getRight();
+                        nb[2]=tmpParent.getFront();
+                        nb[3]=tmpParent.getBack();
+                        nb[4]=tmpParent.getLeftBack();
+                        nb[5]=tmpParent.getRightBack();
+                        nb[6]=tmpParent.getLeftFront();
+                        nb[7]=tmpParent.getRightFront();
+#else
+                        nb[0]=tmpParent.getLeft();
+                        nb[1]=tmpParent.getLeftBack();
+                        nb[2]=tmpParent.getLeftFront();
+                        nb[3]=tmpParent.getRight();
+                        nb[4]=tmpParent.getRightBack();
+                        nb[5]=tmpParent.getRightFront();
+                        nb[6]=tmpParent.getBack();
+                        nb[7]=tmpParent.getFront();
+                        nb[8]=tmpParent.getBottom();
+                        nb[9]=tmpParent.getBottomLeft();
+                        nb[10]=tmpParent.getBottomLeftBack();
+                        nb[11]=tmpParent.getBottomLeftFront();
+                        nb[12]=tmpParent.getBottomRight();
+                        nb[13]=tmpParent.getBottomRightBack();
+                        nb[14]=tmpParent.getBottomRightFront();
+                        nb[15]=tmpParent.getBottomBack();
+                        nb[16]=tmpParent.getBottomFront();
+                        nb[17]=tmpParent.getTop();
+                        nb[18]=tmpParent.getTopLeft();
+                        nb[19]=tmpParent.getTopLeftBack();
+                        nb[20]=tmpParent.getTopLeftFront();
+                        nb[21]=tmpParent.getTopRight();
+                        nb[22]=tmpParent.getTopRightBack();
+                        nb[23]=tmpParent.getTopRightFront();
+                        nb[24]=tmpParent.getTopBack();
+                        nb[25]=tmpParent.getTopFront();
+#endif
+                        for(unsigned int kk=0;kk<neighbourCount;kk++) {
+                            if(nb[kk].getLevel()==tmpParent.getLevel())
+                                myNeighbours.push_back(nb[kk]);
+                            else
+                                foundRoot=true;
                         }
                     }
-                    //std::cout<<"aux Size: "<<auxOct.size()<<" pNodes size: "<<pNodes.size()<<std::endl;
                 }
 
+                // The neighbours are the candidates of level l-1, they are deduplicated against the input octants there.
+                std::vector<T> & coarser=levOct[l-1];
+                for(int t=0;t<numThreads;t++) {
+                    coarser.insert(coarser.end(),threadNeighbours[t].begin(),threadNeighbours[t].end());
+                    std::vector<T>().swap(threadNeighbours[t]);
+                }
 
             }
 
-
-
         }
 
 
@@ -528,95 +728,288 @@ namespace SFC {
             {
 
                 // !!!! Note: Please note that all the code here executed only once. In the final stage of the recursion.
+                SFC::seqSort::SFC_treeSortFinalize(pNodes,n,pOutSorted,pOutBalanced,options);
 
-                if((options & TS_REMOVE_DUPLICATES)) {
+            }
+
+        } // end of function SFC_treeSort
+
+
+        template<typename T>
+        void SFC_treeSortFinalize(T* pNodes , DendroIntL n ,std::vector<T>& pOutSorted,std::vector<T>& pOutBalanced,unsigned int options)
+        {
+
+            if((options & TS_REMOVE_DUPLICATES)) {
 
 #ifdef PROFILE_TREE_SORT
-                    t1=std::chrono::high_resolution_clock::now();//MPI_Wtime();
+                t1=std::chrono::high_resolution_clock::now();//MPI_Wtime();
 #endif
 
-                    // Note: This is executed only once. In the final stage of the recursion.
-                    // Do the remove duplicates here.
-                    if (n >= 2) {
-                        std::vector<T> tmp(n);
-                        T *tmpPtr = (&(*(tmp.begin())));
+                // Note: This is executed only once. In the final stage of the recursion.
+                // Do the remove duplicates here.
+                if (n >= 2) {
+                    std::vector<T> tmp(n);
+                    T *tmpPtr = (&(*(tmp.begin())));
 
-                        tmpPtr[0] = pNodes[0];
+                    tmpPtr[0] = pNodes[0];
 
-                        unsigned int tmpSize = 1;
-                        unsigned int vecTsz = static_cast<unsigned int>(n);
-
-                        for (unsigned int i = 1; i < n; i++) {
-                            if ( /*(!tmpPtr[tmpSize-1].isAncestor(pNodes[i])) &*/  (tmpPtr[tmpSize - 1] != pNodes[i])) { // It is efficient to do this rather than marking all the elements in sorting. (Which will cause a performance degradation. )
-                                tmpPtr[tmpSize] = pNodes[i];
-                                tmpSize++;
-                            }
-                        }//end for
+                    unsigned int tmpSize = 1;
+                    unsigned int vecTsz = static_cast<unsigned int>(n);
 
+                    for (unsigned int i = 1; i < n; i++) {
+                        if ( /*(!tmpPtr[tmpSize-1].isAncestor(pNodes[i])) &*/  (tmpPtr[tmpSize - 1] != pNodes[i])) { // It is efficient to do this rather than marking all the elements in sorting. (Which will cause a performance degradation. )
+                            tmpPtr[tmpSize] = pNodes[i];
+                            tmpSize++;
+                        }
+                    }//end for
 
-                        // Remove ancestor loop for removing local ancestors.
-                        // Assumes that we have removed all the duplicates after the first iteration.
 
-                        tmp.resize(tmpSize);
-                        std::vector<T> tmp_rmvAncestors(tmp.size());
-                        tmpPtr = (&(*(tmp_rmvAncestors.begin())));
-                        tmpPtr[0]=tmp[0];
-                        tmpSize=0;
+                    // Remove ancestor loop for removing local ancestors.
+                    // Assumes that we have removed all the duplicates after the first iteration.
 
-                        for(unsigned int i=1;i<tmp.size();i++)
-                        {
-                            if(tmpPtr[tmpSize].isAncestor(tmp[i]))
-                                tmpPtr[tmpSize]=tmp[i];
-                            else {
-                                tmpPtr[tmpSize+1]=tmp[i];
-                                tmpSize++;
-                            }
+                    tmp.resize(tmpSize);
+                    std::vector<T> tmp_rmvAncestors(tmp.size());
+                    tmpPtr = (&(*(tmp_rmvAncestors.begin())));
+                    tmpPtr[0]=tmp[0];
+                    tmpSize=0;
 
+                    for(unsigned int i=1;i<tmp.size();i++)
+                    {
+                        if(tmpPtr[tmpSize].isAncestor(tmp[i]))
+                            tmpPtr[tmpSize]=tmp[i];
+                        else {
+                            tmpPtr[tmpSize+1]=tmp[i];
+                            tmpSize++;
                         }
-                        tmp_rmvAncestors.resize(tmpSize+1);
-                        std::swap(pOutSorted, tmp_rmvAncestors);
 
-                        tmp_rmvAncestors.clear();
-                        tmp.clear();
                     }
+                    tmp_rmvAncestors.resize(tmpSize+1);
+                    std::swap(pOutSorted, tmp_rmvAncestors);
+
+                    tmp_rmvAncestors.clear();
+                    tmp.clear();
+                }
 
 #ifdef PROFILE_TREE_SORT
-                    remove_duplicates_seq=std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - t1).count();
+                remove_duplicates_seq=std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - t1).count();
 
 #endif
 
-                }
+            }
 
-                if(options & TS_BALANCE_OCTREE)
-                {
-                    // Bottom up balancing octant creation.
-                    //std::cout<<"balOCt: before Aux octants: "<<pOutBalanced.size()<<std::endl;
+            if(options & TS_BALANCE_OCTREE)
+            {
+                // Bottom up balancing octant creation.
+                //std::cout<<"balOCt: before Aux octants: "<<pOutBalanced.size()<<std::endl;
 #ifdef PROFILE_TREE_SORT
-                    t1=std::chrono::high_resolution_clock::now();//MPI_Wtime();
+                t1=std::chrono::high_resolution_clock::now();//MPI_Wtime();
 #endif
-                    /*int rank;
-                    MPI_Comm_rank(MPI_COMM_WORLD,&rank);*/
+                /*int rank;
+                MPI_Comm_rank(MPI_COMM_WORLD,&rank);*/
 
-                    SFC::seqSort::SFC_bottomUpBalOctantCreation(pOutBalanced);
+                std::vector<T> tmpBalanced;
+                SFC::seqSort::SFC_bottomUpBalance(pOutBalanced,tmpBalanced);
+                std::swap(tmpBalanced,pOutBalanced);
+
+#ifdef PROFILE_TREE_SORT
+                auxBalOCt_time=std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - t1).count();
+
+#endif
+            }
+
+        } // end of function SFC_treeSortFinalize
+
+
+        template<typename T>
+        void SFC_treeSortTask(T* pNodes , DendroIntL n ,std::vector<T>& pOutConstruct,std::vector<T>& pOutBalanced, unsigned int pMaxDepthBit,unsigned int pMaxDepth, T& parent, unsigned int rot_id,unsigned int k, unsigned int options,DendroIntL taskThreshold)
+        {
+
+            if(n==0) return;
 
 #ifdef PROFILE_TREE_SORT
-                    auxBalOCt_time=std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - t1).count();
+            auto tw=std::chrono::high_resolution_clock::now();
+#endif
 
+            if(n<=taskThreshold)
+            {
+                // small buckets are sorted by the sequential version. (lev > 0 here so the final stage is not executed. )
+                std::vector<T> tmpSorted;
+                SFC::seqSort::SFC_treeSort(pNodes,n,tmpSorted,pOutConstruct,pOutBalanced,pMaxDepthBit,pMaxDepth,parent,rot_id,k,options);
+#ifdef PROFILE_TREE_SORT
+                double tw_elapsed=std::chrono::duration<double,std::milli>(std::chrono::high_resolution_clock::now() - tw).count();
+                #pragma omp atomic
+                localSort_work_time+=tw_elapsed;
 #endif
-                    std::vector<T> tmpSorted;
-                    std::vector<T> tmpConstruct;
-                    std::vector<T> tmpBalanced;
-                    T root =T(0,0,0,0,m_uiDim,pMaxDepth);
-                    //std::cout<<"bal with aux octants: "<<pOutBalanced.size()<<std::endl;
-                    SFC::seqSort::SFC_treeSort(&(*(pOutBalanced.begin())),pOutBalanced.size(),tmpSorted,tmpConstruct,tmpBalanced,pMaxDepth,pMaxDepth,root,0,k,2);
-                    std::swap(tmpConstruct,pOutBalanced);
-                    tmpConstruct.clear();
+                return;
+            }
+
+            register unsigned int cnum;
+            register unsigned int cnum_prev=0;
+            unsigned int rotation=0;
+            DendroIntL count[(NUM_CHILDREN+2)]={};
+            unsigned int lev=pMaxDepth-pMaxDepthBit;
+            pMaxDepthBit--;
+            unsigned int x,y,z;
+            count[0]=0;
+
+            for (DendroIntL i=0; i< n; ++i) {
+
+                cnum = (lev < pNodes[i].getLevel())? 1 +( (((pNodes[i].getZ() >> pMaxDepthBit) & 1u) << 2u) | (((pNodes[i].getY() >> pMaxDepthBit) & 1u) << 1u) | ((pNodes[i].getX() >>pMaxDepthBit) & 1u)):0;
+                count[cnum+1]++;
+
+            }
+
+            DendroIntL loc[NUM_CHILDREN+1];
+            T unsorted[NUM_CHILDREN+1];
+            unsigned int live = 0;
+
+            for (unsigned int i=0; i<(NUM_CHILDREN+1); ++i) {
+                if(i==0)
+                {
+                    loc[0]=count[0];
+                    count[1]+=count[0];
+                    unsorted[live] = pNodes[loc[0]];
+                    if (loc[0] < count[1]) {live++;}
+                }else
+                {
+                    cnum=(rotations[ROTATION_OFFSET * rot_id+ i-1] - '0');
+                    (i>1) ? cnum_prev = ((rotations[ROTATION_OFFSET * rot_id+i-2] - '0')+2): cnum_prev=1;
+                    loc[cnum+1]=count[cnum_prev];
+                    count[cnum+2] += count[cnum_prev];
+                    (loc[cnum+1]==n) ? unsorted[live] = pNodes[loc[cnum+1]-1]: unsorted[live] = pNodes[loc[cnum+1]];
+                    if (loc[cnum+1] < count[cnum+2]) {live++;}
                 }
 
+            }
 
+            if(live>0)
+            {
+
+                live--;
+
+                for (DendroIntL i=0; i < n ; ++i) {
+
+                    cnum = (lev < unsorted[live].getLevel()) ? ((((unsorted[live].getZ() >> pMaxDepthBit) & 1u) << 2u) | (((unsorted[live].getY() >> pMaxDepthBit) & 1u) << 1u) | ((unsorted[live].getX() >> pMaxDepthBit) & 1u))+ 1: 0 ;
+
+                    pNodes[loc[(cnum )]++] = unsorted[live];
+                    (loc[cnum]==n) ? unsorted[live] = pNodes[loc[cnum]-1] : unsorted[live] = pNodes[loc[cnum]];
+                    if ((loc[cnum] == count[cnum + 1])) {
+                        live--;
+                    }
+
+                }
             }
 
-        } // end of function SFC_treeSort
+#ifdef PROFILE_TREE_SORT
+            double tw_elapsed=std::chrono::duration<double,std::milli>(std::chrono::high_resolution_clock::now() - tw).count();
+            #pragma omp atomic
+            localSort_work_time+=tw_elapsed;
+#endif
+
+            if (pMaxDepthBit > MAXDEAPTH_LEVEL_DIFF) {
+
+                // Each child bucket writes to its own output so that the tasks can run in any order. These are merged
+                // in the SFC order once all the children are done.
+                std::vector<T> childConstruct[NUM_CHILDREN];
+                std::vector<T> childBalanced[NUM_CHILDREN];
+                T childParent[NUM_CHILDREN];
+
+                DendroIntL numElements=0;
+                for (unsigned int i=1; i<(NUM_CHILDREN+1); i++) {
+                    cnum=(rotations[ROTATION_OFFSET*rot_id+i-1]-'0');
+                    (i>1)? cnum_prev = ((rotations[ROTATION_OFFSET * rot_id+i-2] - '0')+2) : cnum_prev=1;
+                    numElements = count[cnum+2] - count[cnum_prev];
+                    if((options & TS_CONSTRUCT_OCTREE) | (options & TS_BALANCE_OCTREE))
+                    {
+                        x=parent.getX() +(((int)((bool)(cnum & 1u)))<<(pMaxDepthBit));
+                        y=parent.getY() +(((int)((bool)(cnum & 2u)))<<(pMaxDepthBit));
+                        z=parent.getZ() +(((int)((bool)(cnum & 4u)))<<(pMaxDepthBit));
+                        childParent[i-1]=T(x,y,z,(lev+1),parent.getDim(),pMaxDepth);
+
+                    }
+                    if (numElements > k) {
+                        rotation=HILBERT_TABLE[NUM_CHILDREN * rot_id + cnum];
+                        T* childNodes=pNodes+count[cnum_prev];
+                        #pragma omp task firstprivate(childNodes,numElements,rotation,i) shared(childConstruct,childBalanced,childParent) if(numElements>taskThreshold)
+                        SFC::seqSort::SFC_treeSortTask(childNodes,numElements,childConstruct[i-1],childBalanced[i-1],pMaxDepthBit,pMaxDepth,childParent[i-1],rotation,k,options,taskThreshold);
+
+                    }else if((options & TS_CONSTRUCT_OCTREE) | (options & TS_BALANCE_OCTREE))
+                    {
+                        if(options & TS_CONSTRUCT_OCTREE)
+                            childConstruct[i-1].push_back(childParent[i-1]);
+
+                        if (options & TS_BALANCE_OCTREE)
+                            childBalanced[i-1].push_back(childParent[i-1]);
+
+                    }
+
+                }
+
+                #pragma omp taskwait
+
+                if((options & TS_CONSTRUCT_OCTREE) | (options & TS_BALANCE_OCTREE))
+                {
+                    DendroIntL constructSz=pOutConstruct.size();
+                    DendroIntL balancedSz=pOutBalanced.size();
+                    for(unsigned int i=0;i<NUM_CHILDREN;i++)
+                    {
+                        constructSz+=childConstruct[i].size();
+                        balancedSz+=childBalanced[i].size();
+                    }
+
+                    pOutConstruct.reserve(constructSz);
+                    pOutBalanced.reserve(balancedSz);
+
+                    for(unsigned int i=0;i<NUM_CHILDREN;i++)
+                    {
+                        pOutConstruct.insert(pOutConstruct.end(),childConstruct[i].begin(),childConstruct[i].end());
+                        pOutBalanced.insert(pOutBalanced.end(),childBalanced[i].begin(),childBalanced[i].end());
+                        childConstruct[i].clear();
+                        childBalanced[i].clear();
+                    }
+                }
+
+            }
+
+        } // end of function SFC_treeSortTask
+
+
+        template<typename T>
+        void SFC_treeSort_omp(T* pNodes , DendroIntL n ,std::vector<T>& pOutSorted,std::vector<T>& pOutConstruct,std::vector<T>& pOutBalanced, unsigned int pMaxDepthBit,unsigned int pMaxDepth, T& parent, unsigned int rot_id,unsigned int k, unsigned int options,DendroIntL taskThreshold)
+        {
+
+            if(n==0) return;
+
+#ifdef PROFILE_TREE_SORT
+            auto tw=std::chrono::high_resolution_clock::now();
+#endif
+
+            if((n<=taskThreshold) || (omp_get_max_threads()==1) || omp_in_parallel())
+            {
+                // nothing to gain from the tasks.
+                SFC::seqSort::SFC_treeSort(pNodes,n,pOutSorted,pOutConstruct,pOutBalanced,pMaxDepthBit,pMaxDepth,parent,rot_id,k,options);
+#ifdef PROFILE_TREE_SORT
+                localSort_work_time+=std::chrono::duration<double,std::milli>(std::chrono::high_resolution_clock::now() - tw).count();
+#endif
+                return;
+            }
+
+            #pragma omp parallel
+            {
+                #pragma omp single
+                SFC::seqSort::SFC_treeSortTask(pNodes,n,pOutConstruct,pOutBalanced,pMaxDepthBit,pMaxDepth,parent,rot_id,k,options,taskThreshold);
+            }
+
+            if((pMaxDepth-pMaxDepthBit)==0) {
+                SFC::seqSort::SFC_treeSortFinalize(pNodes, n, pOutSorted, pOutBalanced, options);
+#ifdef PROFILE_TREE_SORT
+                // serial parts of the final stage. (the balancing re-sort accounts for its own work)
+                if(options & TS_REMOVE_DUPLICATES) localSort_work_time+=remove_duplicates_seq;
+                if(options & TS_BALANCE_OCTREE) localSort_work_time+=auxBalOCt_time;
+#endif
+            }
+
+        } // end of function SFC_treeSort_omp
 
 
         template<typename T>
@@ -1424,7 +1817,11 @@ namespace SFC
             if(npes==1)
             {
                 //call the sequential case
+#ifdef OMP_TREE_SORT
+                SFC::seqSort::SFC_treeSort_omp(&(*(pNodes.begin())),pNodes.size(),pOutSorted,pOutConstruct,pOutBalanced,pMaxDepth,pMaxDepth,parent,rot_id,k,options);
+#else
                 SFC::seqSort::SFC_treeSort(&(*(pNodes.begin())),pNodes.size(),pOutSorted,pOutConstruct,pOutBalanced,pMaxDepth,pMaxDepth,parent,rot_id,k,options);
+#endif
                 return ;
 
             }
@@ -1933,41 +2330,50 @@ namespace SFC
 
 
 
-            par::Mpi_Alltoall(sendCounts,recvCounts,1,comm);
-            //MPI_Alltoall(sendCounts, 1, MPI_INT,recvCounts,1,MPI_INT,comm);
-            //std::cout<<"rank "<<rank<<" MPI_ALL TO ALL END"<<std::endl;
-
             int * sendDispl =new  int [npes];
             int * recvDispl =new  int [npes];
 
-
             sendDispl[0] = 0;
-            recvDispl[0] = 0;
-
             for(int i=1;i<npes;i++)
-            {
                 sendDispl[i] = sendCounts[i-1] + sendDispl[i - 1];
-                recvDispl[i] =recvCounts[i-1] +recvDispl[i-1];
-            }
 
+            // If the input is already (nearly) partitioned the processors send to a few neighbours only, then the
+            // senders are discovered by the sparse (NBX) exchange instead of the all to all of the counts.
+            int numDest=0;
+            for(int i=0;i<npes;i++)
+                if((i!=rank) && sendCounts[i]) numDest++;
 
-#ifdef DEBUG_TREE_SORT
-            /*if (!rank)*/ std::cout << rank << " : send = " << sendCounts[0] << ", " << sendCounts[1] << std::endl;
-             /*if (!rank)*/ std::cout << rank << " : recv = " << recvCounts[0] << ", " << recvCounts[1] << std::endl;
+            int maxDest;
+            par::Mpi_Allreduce(&numDest,&maxDest,1,MPI_MAX,comm);
 
-             /* if (!rank) std::cout << rank << " : send offset  = " << sendDispl[0] << ", " << sendDispl[1] << std::endl;
-              if (!rank) std::cout << rank << " : recv offset  = " << recvDispl[0] << ", " << recvDispl[1] << std::endl;*/
-#endif
+            std::vector<T> pNodesRecv;
+            T* sendPtr=(pNodes.empty()) ? NULL : (&(*(pNodes.begin())));
 
+            if(maxDest<=NBX_MAX_NEIGHBOURS)
+            {
+                par::Mpi_Alltoallv_NBX(sendPtr,sendCounts,sendDispl,pNodesRecv,recvCounts,recvDispl,comm);
 
+            }else
+            {
+                par::Mpi_Alltoall(sendCounts,recvCounts,1,comm);
+                //MPI_Alltoall(sendCounts, 1, MPI_INT,recvCounts,1,MPI_INT,comm);
 
-            std::vector<T> pNodesRecv;
-            DendroIntL recvTotalCnt=recvDispl[npes-1]+recvCounts[npes-1];
-            if(recvTotalCnt) pNodesRecv.resize(recvTotalCnt);
+                recvDispl[0] = 0;
+                for(int i=1;i<npes;i++)
+                    recvDispl[i] =recvCounts[i-1] +recvDispl[i-1];
 
-            //par::Mpi_Alltoallv(&pNodes[0],sendCounts,sendDispl,&pNodesRecv[0],recvCounts,recvDispl,comm);
-            // MPI_Alltoallv(&pNodes[0],sendCounts,sendDispl,MPI_TREENODE,&pNodesRecv[0],recvCounts,recvDispl,MPI_TREENODE,comm);
-            par::Mpi_Alltoallv_Kway(&pNodes[0],sendCounts,sendDispl,&pNodesRecv[0],recvCounts,recvDispl,comm);
+                DendroIntL recvTotalCnt=recvDispl[npes-1]+recvCounts[npes-1];
+                if(recvTotalCnt) pNodesRecv.resize(recvTotalCnt);
+
+                //par::Mpi_Alltoallv(&pNodes[0],sendCounts,sendDispl,&pNodesRecv[0],recvCounts,recvDispl,comm);
+                // MPI_Alltoallv(&pNodes[0],sendCounts,sendDispl,MPI_TREENODE,&pNodesRecv[0],recvCounts,recvDispl,MPI_TREENODE,comm);
+                par::Mpi_Alltoallv_Kway(sendPtr,sendCounts,sendDispl,&pNodesRecv[0],recvCounts,recvDispl,comm);
+            }
+
+#ifdef DEBUG_TREE_SORT
+            /*if (!rank)*/ std::cout << rank << " : send = " << sendCounts[0] << ", " << sendCounts[1] << std::endl;
+             /*if (!rank)*/ std::cout << rank << " : recv = " << recvCounts[0] << ", " << recvCounts[1] << std::endl;
+#endif
 
 #ifdef PROFILE_TREE_SORT
             all2all2_time=std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - t2).count();
@@ -1997,8 +2403,13 @@ namespace SFC
 #ifdef PROFILE_TREE_SORT
             //MPI_Barrier(pcomm);
             t2=std::chrono::high_resolution_clock::now();//MPI_Wtime();
+            localSort_work_time=0;
 #endif
+#ifdef OMP_TREE_SORT
+            SFC::seqSort::SFC_treeSort_omp(&(*(pNodes.begin())),pNodes.size(),pOutSorted,pOutConstruct,pOutBalanced,pMaxDepth,pMaxDepth,parent,rot_id,k,options);
+#else
             SFC::seqSort::SFC_treeSort(&(*(pNodes.begin())),pNodes.size(),pOutSorted,pOutConstruct,pOutBalanced,pMaxDepth,pMaxDepth,parent,rot_id,k,options);
+#endif
 
 #ifdef PROFILE_TREE_SORT
             localSort_time=std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - t2).count();//MPI_Wtime()-t2;
@@ -2182,6 +2593,24 @@ namespace SFC
 
             }
 
+#ifdef OMP_TREE_SORT
+            // speedup of the task parallel local sort. (sum of the time spent by all the threads over the wall time)
+            double localSort_speedup=(localSort_time>0) ? (localSort_work_time/localSort_time) : 1.0;
+            par::Mpi_Reduce(&localSort_speedup,&stat_property[0],1,MPI_MIN,0,pcomm);
+            par::Mpi_Reduce(&localSort_speedup,&stat_property[1],1,MPI_SUM,0,pcomm);
+            par::Mpi_Reduce(&localSort_speedup,&stat_property[2],1,MPI_MAX,0,pcomm);
+
+            if(!rank_g)
+            {
+                stat_property[1] = stat_property[1] / (double) npes_g;
+
+                stats.push_back(stat_property[0]);
+                stats.push_back(stat_property[1]);
+                stats.push_back(stat_property[2]);
+
+            }
+#endif
+
 
             par::Mpi_Reduce(&remove_duplicates_seq,&stat_property[0],1,MPI_MIN,0,pcomm);
             par::Mpi_Reduce(&remove_duplicates_seq,&stat_property[1],1,MPI_SUM,0,pcomm);
@@ -1,6 +1,7 @@
 #ifndef TREENODE22VTK
 #define TREENODE22VTK
 
+#include "mpi.h"
 #include "TreeNode.h"
 #include "Point.h"
 #include "nodeAndValues.h"
@@ -12,9 +13,48 @@
 #include <sstream>
 
 #define VTK_HEXAHEDRON 12
+#define VTK_VOXEL 11
 
 // convert one treenode to vtk file compatibel string
 //std::string treeNodeTovtk(const TreeNode& T,int mpi_rank,int hindex);
 
 void treeNodesTovtk(std::vector<ot::TreeNode>& nodes,int mpi_rank,std::string vtk_file_name,bool hsorted=false);
+
+/**
+  @author Milinda Fernando
+  @brief A data array written by treeNodesToVtu() and cellsToVtu(). Point data has numComponents values for each of
+  the 8 vertices of a cell (vertex j of cell i starts at values[(8*i + j)*numComponents], vertices in Morton order),
+  cell data has numComponents values per cell.
+  */
+struct VtuField {
+  std::string   name;
+  unsigned int  numComponents;
+  bool          isPointData;
+  const double* values;
+};
+
+/**
+  @author Milinda Fernando
+  @brief Writes the cells of all the processors of comm into one binary VTU file (raw appended data) fileName.vtu
+  with collective MPI-IO, and a PVTU index fileName.pvtu that references it. Every processor writes its cells at
+  the offset given by the cells of the lower ranks, in the given order. The cells are voxels with 8 points each,
+  the cell data "cell_level" and "mpi_rank" is always written.
+  @param cells x, y, z and the size of each cell (4 values per cell)
+  @param levels the level of each cell
+  @param numCells the number of local cells
+  @param fileName the file name without extension
+  @param comm the communicator, all processors must call this
+  @param fields additional point or cell data
+  @return 0 on success, an MPI error code otherwise. The return value is the same on all the processors of comm.
+  */
+int cellsToVtu(const float* cells, const unsigned char* levels, unsigned int numCells, const std::string& fileName,
+               MPI_Comm comm, const std::vector<VtuField>& fields = std::vector<VtuField>());
+
+/**
+  @author Milinda Fernando
+  @brief Writes the distributed octree as one binary VTU file with a PVTU index (see cellsToVtu()). The coordinates
+  are scaled to the unit cube. The nodes are written in the given order, they are not sorted.
+  */
+int treeNodesToVtu(const std::vector<ot::TreeNode>& nodes, const std::string& fileName, MPI_Comm comm,
+                   const std::vector<VtuField>& fields = std::vector<VtuField>());
 #endif
@@ -10,6 +10,8 @@
 #include <cassert>
 #include <list>
 #include <bits/algorithmfwd.h>
+#include <algorithm>
+#include <iterator>
 #include "nodeAndValues.h"
 #include "binUtils.h"
 #include "dendro.h"
@@ -907,6 +909,127 @@ namespace ot {
 
   } //end function
 
+  int points2OctreeFromFile(const char* filename, double * gLens, std::vector<TreeNode> & nodes,
+      unsigned int dim, unsigned int maxDepth, unsigned int maxNumPts, DendroIntL chunkSize,
+      unsigned int options, MPI_Comm comm, double tol) {
+
+    int rank, npes;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &npes);
+
+    nodes.clear();
+
+    MPI_File fh;
+    int err = MPI_File_open(comm, const_cast<char*>(filename), MPI_MODE_RDONLY, MPI_INFO_NULL, &fh);
+    if (err != MPI_SUCCESS) {
+      if (!rank) {
+        std::cout << "points2OctreeFromFile: unable to open " << filename << std::endl;
+      }
+      return err;
+    }
+
+    unsigned int numPts;
+    MPI_File_read_at_all(fh, 0, &numPts, 1, MPI_UNSIGNED, MPI_STATUS_IGNORE);
+
+    //the points of this processor
+    const DendroIntL begin = (((DendroIntL) numPts) * rank) / npes;
+    const DendroIntL end = (((DendroIntL) numPts) * (rank + 1)) / npes;
+
+    if (chunkSize <= 0) {
+      chunkSize = 1;
+    }
+    //read_at_all is collective, all the processors read the same number of chunks
+    DendroIntL numChunks = ((end - begin) + chunkSize - 1) / chunkSize;
+    DendroIntL maxChunks;
+    par::Mpi_Allreduce<DendroIntL>(&numChunks, &maxChunks, 1, MPI_MAX, comm);
+
+    double scale[3] = {0, 0, 0};
+    for (unsigned int i = 0; i < dim; i++) scale[i] = ((double) (1u << maxDepth)) / (gLens[i]);
+
+    //An octant is split iff it has more than maxNumPts points, so a finest-level octant is kept with its number of
+    //points (m_uiWeight) capped at maxNumPts+1. nodes is kept sorted and unique, so it is bounded by the number of
+    //distinct finest-level octants and not by the number of points. The octants of the chunks are merged into nodes
+    //once there are as many as in nodes (or a chunk), so every point is merged O(log) times.
+    const unsigned int maxWeight = maxNumPts + 1;
+    std::vector<double> pts(3 * std::min<DendroIntL>(chunkSize, end - begin));
+    std::vector<TreeNode> chunkNodes, tmpNodes;
+    for (DendroIntL c = 0; c < maxChunks; c++) {
+      const DendroIntL cBegin = std::min<DendroIntL>(begin + c * chunkSize, end);
+      const DendroIntL cEnd = std::min<DendroIntL>(cBegin + chunkSize, end);
+      //writePtsToFile always writes 3 doubles per point
+      const MPI_Offset pos = sizeof(unsigned int) + cBegin * 3 * sizeof(double);
+      MPI_File_read_at_all(fh, pos, (pts.empty() ? NULL : &(*(pts.begin()))), static_cast<int>(3 * (cEnd - cBegin)),
+                           MPI_DOUBLE, MPI_STATUS_IGNORE);
+
+      for (DendroIntL i = 0; i < (cEnd - cBegin); i++) {
+        unsigned int p_int[3] = {0, 0, 0};
+        bool inside = true;
+        for (unsigned int j = 0; j < dim; j++) {
+          const double x = pts[i * 3 + j];
+          inside = inside && (x >= 0.0) && (x < gLens[j]);
+          p_int[j] = inside ? ((unsigned int) (x * scale[j])) : 0;
+          inside = inside && (p_int[j] < (1u << maxDepth));
+        }
+        if (inside) {
+          chunkNodes.push_back(TreeNode(p_int[0], p_int[1], p_int[2], maxDepth, dim, maxDepth));
+        }
+      }
+      if ((c < (maxChunks - 1)) && (chunkNodes.size() < std::max<size_t>(chunkSize, nodes.size()))) {
+        continue;
+      }
+      std::sort(chunkNodes.begin(), chunkNodes.end());
+
+      //merge the chunks into nodes, equal octants are combined
+      tmpNodes.clear();
+      tmpNodes.reserve(nodes.size() + chunkNodes.size());
+      std::merge(nodes.begin(), nodes.end(), chunkNodes.begin(), chunkNodes.end(), std::back_inserter(tmpNodes));
+      nodes.clear();
+      for (unsigned int i = 0; i < tmpNodes.size(); i++) {
+        if ((!nodes.empty()) && (nodes.back() == tmpNodes[i])) {
+          nodes.back().setWeight(std::min(nodes.back().getWeight() + tmpNodes[i].getWeight(), maxWeight));
+        } else {
+          nodes.push_back(tmpNodes[i]);
+          nodes.back().setWeight(std::min(nodes.back().getWeight(), maxWeight));
+        }
+      }
+      chunkNodes.clear();
+      if (tmpNodes.capacity() > (2 * nodes.size())) {
+        std::vector<TreeNode>().swap(tmpNodes);
+      }
+    }
+    MPI_File_close(&fh);
+    std::vector<double>().swap(pts);
+    std::vector<TreeNode>().swap(chunkNodes);
+    std::vector<TreeNode>().swap(tmpNodes);
+
+    //SFC_treeSort counts octants, so every octant is repeated by its (capped) weight.
+    DendroIntL numNodes = 0;
+    for (unsigned int i = 0; i < nodes.size(); i++) {
+      numNodes += nodes[i].getWeight();
+    }
+    tmpNodes.reserve(numNodes);
+    for (unsigned int i = 0; i < nodes.size(); i++) {
+      const unsigned int w = nodes[i].getWeight();
+      nodes[i].setWeight(1);
+      tmpNodes.insert(tmpNodes.end(), w, nodes[i]);
+    }
+    std::swap(nodes, tmpNodes);
+    std::vector<TreeNode>().swap(tmpNodes);
+
+    TreeNode root(dim, maxDepth);
+    std::vector<TreeNode> tmpSorted, tmpConstruct, tmpBalanced;
+    SFC::parSort::SFC_treeSort(nodes, tmpSorted, tmpConstruct, tmpBalanced, tol, maxDepth, root, ROOT_ROTATION,
+                               maxNumPts, options, NUM_NPES_THRESHOLD, comm);
+    std::vector<TreeNode>().swap(tmpSorted);
+    if (options & TS_BALANCE_OCTREE) {
+      std::swap(nodes, tmpBalanced);
+    } else {
+      std::swap(nodes, tmpConstruct);
+    }
+
+    return 0;
+  } //end function
+
 //Added on April 19, 2008
   int points2OctreeSeq(std::vector<double> &pts, double *gLens, std::vector<TreeNode> &nodes,
                        unsigned int dim, unsigned int maxDepth, unsigned int maxNumPts) {
@@ -1286,8 +1409,28 @@ PROF_COMPLETE_REGION_END
 */
 
 
+namespace {
+
+  // a corner of an octant, in the integer coordinates of the octree
+  struct OctCorner {
+    unsigned int x, y, z;
+    unsigned int idx;
+
+    bool operator < (const OctCorner & other) const {
+      if (x != other.x) return (x < other.x);
+      if (y != other.y) return (y < other.y);
+      return (z < other.z);
+    }
+
+    bool operator == (const OctCorner & other) const {
+      return ((x == other.x) && (y == other.y) && (z == other.z));
+    }
+  };
+
+} //end anonymous namespace
+
 int function2Octree(std::function<double(double,double,double)> fx, std::vector<TreeNode> & nodes, 
-                      unsigned int d_max, bool reject_interior, MPI_Comm comm ) 
+                      unsigned int d_max, bool reject_interior, MPI_Comm comm, double imbalance ) 
 {
   PROF_F2O_BEGIN
   int size, rank;
@@ -1298,127 +1441,123 @@ int function2Octree(std::function<double(double,double,double)> fx, std::vector<
   MPI_Comm_rank(comm, &rank);
   
   nodes.clear();
-  std::vector<ot::TreeNode> nodes_new;
 
-  unsigned int depth = 1;
-  unsigned int num_intersected=1;
-  
-  double h, h1;
-  std::array<double, 8> dist;
-  Point pt;
-  
-  h = 1.0/(1<<(maxDepth));
-  
-  if (!rank) {
-    // root does the initial refinement
-    ot::TreeNode root = ot::TreeNode(dim, maxDepth);
-    root.addChildren(nodes);
+  const double h = 1.0/(1<<(maxDepth));
   
-  while ( (num_intersected > 0 ) && (num_intersected < size*size ) && (depth < d_max) ) {
-    std::cout << "Depth: " << depth << " n = " << nodes.size() << std::endl;
-    num_intersected = 0;
-    for (auto elem: nodes ){
-        if ( elem.getLevel() != depth ) {
-          nodes_new.push_back(elem);
-          continue;
-        } 
-        
-        h1 = h * ( 1 << (maxDepth - elem.getLevel())); 
-        
-        // check and split
-        pt = elem.getAnchor();
-        pt *= h ;
-        
-        dist[0] = fx(pt.x(), pt.y(), pt.z());
-        dist[1] = fx(pt.x()+h1, pt.y(), pt.z());
-        dist[2] = fx(pt.x(), pt.y()+h1, pt.z());
-        dist[3] = fx(pt.x()+h1, pt.y()+h1, pt.z());
-
-        dist[4] = fx(pt.x(), pt.y(), pt.z()+h1);
-        dist[5] = fx(pt.x()+h1, pt.y(), pt.z()+h1);
-        dist[6] = fx(pt.x(), pt.y()+h1, pt.z()+h1);
-        dist[7] = fx(pt.x()+h1, pt.y()+h1, pt.z() +h1);
-        
-        auto inside = [](double d){ return d < 0.0; };
-        
-        if ( std::none_of(dist.begin(), dist.end(), inside )) {
-          // outside, retain but do not refine 
-          nodes_new.push_back(elem);
-        } else if ( std::all_of(dist.begin(), dist.end(), inside ) ) {
-          if (!reject_interior)
-            nodes_new.push_back(elem);
-        } else {
-          // intersection.
-          elem.addChildren(nodes_new);
-          num_intersected++;
-        }
+  // all the processors start with a slice of the children of the root, in SFC order.
+  std::vector<ot::TreeNode> front, children, siblings;
+  ot::TreeNode root = ot::TreeNode(dim, maxDepth);
+  root.addChildren(children);
+  std::sort(children.begin(), children.end());
+  for (unsigned int i = (children.size()*rank)/size; i < (children.size()*(rank + 1))/size; i++) {
+    front.push_back(children[i]);
+  }
+  children.clear();
+
+  // corners (sorted) and the values of fx at the corners of the previous level
+  std::vector<OctCorner> corners, prevCorners;
+  std::vector<double> values, prevValues;
+
+  unsigned int depth = 1;
+  DendroIntL num_intersected = 1;
+
+  while ( (num_intersected > 0) && (depth < d_max) ) {
+
+    // repartition the octants of this level if they are not balanced
+    DendroIntL frontSz = front.size(), frontSz_g, frontSz_max;
+    par::Mpi_Allreduce<DendroIntL>(&frontSz, &frontSz_g, 1, MPI_SUM, comm);
+    par::Mpi_Allreduce<DendroIntL>(&frontSz, &frontSz_max, 1, MPI_MAX, comm);
+    if ( (frontSz_g >= size) && (frontSz_max > (1.0 + imbalance)*((double)frontSz_g/size)) ) {
+      SFC::parSort::SFC_PartitionW<ot::TreeNode>(front, 0.1, maxDepth, comm);
+      // the corners of the previous level belong to other octants now
+      prevCorners.clear();
+      prevValues.clear();
+    }
+
+    // the distinct corners of the octants of this level
+    const unsigned int len = 1u << (maxDepth - depth);
+    corners.resize(8*front.size());
+    for (unsigned int i = 0; i < front.size(); i++) {
+      for (unsigned int j = 0; j < 8; j++) {
+        OctCorner & c = corners[8*i + j];
+        c.x = front[i].getX() + ((j & 1u) ? len : 0);
+        c.y = front[i].getY() + ((j & 2u) ? len : 0);
+        c.z = front[i].getZ() + ((j & 4u) ? len : 0);
+        c.idx = 8*i + j;
+      }
+    }
+    std::sort(corners.begin(), corners.end());
+
+    // unique corners, cornerId maps the corner j of octant i to its unique corner
+    std::vector<unsigned int> cornerId(corners.size());
+    unsigned int numUnique = 0;
+    for (unsigned int i = 0; i < corners.size(); i++) {
+      if ( (i == 0) || !(corners[i] == corners[numUnique - 1]) ) {
+        corners[numUnique++] = corners[i];
+      }
+      cornerId[corners[i].idx] = numUnique - 1;
+    }
+    corners.resize(numUnique);
+
+    // reuse the values at the corners of the parents, evaluate the others in parallel
+    values.resize(numUnique);
+    std::vector<unsigned int> toEval;
+    for (unsigned int i = 0; i < numUnique; i++) {
+      std::vector<OctCorner>::const_iterator it = std::lower_bound(prevCorners.begin(), prevCorners.end(), corners[i]);
+      if ( (it != prevCorners.end()) && ((*it) == corners[i]) ) {
+        values[i] = prevValues[it - prevCorners.begin()];
+      } else {
+        toEval.push_back(i);
       }
-      depth++;
-      
-      std::swap(nodes, nodes_new);
-      nodes_new.clear();
     }
-  } // !rank
 
-  // now scatter the elements.
-  DendroIntL totalNumOcts = nodes.size(), numOcts;
-  
-  par::Mpi_Bcast<DendroIntL>(&totalNumOcts, 1, 0, comm);
-  
-  // TODO do proper load balancing.
-  numOcts = totalNumOcts/size + (rank < totalNumOcts%size);
-  par::scatterValues<ot::TreeNode>(nodes, nodes_new, numOcts, comm);
-  std::swap(nodes, nodes_new);
-  nodes_new.clear();
-  
-  // now refine in parallel.
-  par::Mpi_Bcast(&depth, 1, 0, comm);
-  num_intersected=1;
-  
-  while ( (num_intersected > 0 ) && (depth < d_max) ) {
-    // std::cout << "Depth: " << depth << " n = " << nodes.size() << std::endl;
+    const int numEval = toEval.size();
+#pragma omp parallel for schedule(static)
+    for (int k = 0; k < numEval; k++) {
+      const OctCorner & c = corners[toEval[k]];
+      values[toEval[k]] = fx(c.x*h, c.y*h, c.z*h);
+    }
+
+    // check and split
     num_intersected = 0;
-    for (auto elem: nodes ){
-        if ( elem.getLevel() != depth ) {
-          nodes_new.push_back(elem);
-          continue;
-        } 
-        
-        h1 = h * ( 1 << (maxDepth - elem.getLevel())); 
-        
-        // check and split
-        pt = elem.getAnchor();
-        pt *= h ;
-        
-        dist[0] = fx(pt.x(), pt.y(), pt.z());
-        dist[1] = fx(pt.x()+h1, pt.y(), pt.z());
-        dist[2] = fx(pt.x(), pt.y()+h1, pt.z());
-        dist[3] = fx(pt.x()+h1, pt.y()+h1, pt.z());
-
-        dist[4] = fx(pt.x(), pt.y(), pt.z()+h1);
-        dist[5] = fx(pt.x()+h1, pt.y(), pt.z()+h1);
-        dist[6] = fx(pt.x(), pt.y()+h1, pt.z()+h1);
-        dist[7] = fx(pt.x()+h1, pt.y()+h1, pt.z() +h1);
-        
-        auto inside = [](double d){ return d < 0.0; };
-        
-        if ( std::none_of(dist.begin(), dist.end(), inside )) {
-          // outside, retain but do not refine 
-          nodes_new.push_back(elem);
-        } else if ( std::all_of(dist.begin(), dist.end(), inside ) ) {
-          if (!reject_interior)
-            nodes_new.push_back(elem);
-        } else {
-          // intersection.
-          elem.addChildren(nodes_new);
-          num_intersected++;
-        }
+    children.clear();
+    for (unsigned int i = 0; i < front.size(); i++) {
+      unsigned int numInside = 0;
+      for (unsigned int j = 0; j < 8; j++) {
+        numInside += (values[cornerId[8*i + j]] < 0.0);
+      }
+
+      if (numInside == 0) {
+        // outside, retain but do not refine 
+        nodes.push_back(front[i]);
+      } else if (numInside == 8) {
+        if (!reject_interior)
+          nodes.push_back(front[i]);
+      } else {
+        // intersection. (addChildren sorts the whole vector with HILBERT_ORDERING, so the children are added to a
+        // small vector first)
+        siblings.clear();
+        front[i].addChildren(siblings);
+        children.insert(children.end(), siblings.begin(), siblings.end());
+        num_intersected++;
       }
-      depth++;
-      
-      std::swap(nodes, nodes_new);
-      nodes_new.clear();
     }
+    depth++;
+
+    std::swap(front, children);
+    std::swap(corners, prevCorners);
+    std::swap(values, prevValues);
+
+    DendroIntL num_intersected_g;
+    par::Mpi_Allreduce<DendroIntL>(&num_intersected, &num_intersected_g, 1, MPI_SUM, comm);
+    num_intersected = num_intersected_g;
+  }
+
+  nodes.insert(nodes.end(), front.begin(), front.end());
+  front.clear();
+
+  // sort and partition the leaves
+  SFC::parSort::SFC_PartitionW<ot::TreeNode>(nodes, 0.1, maxDepth, comm);
   
   PROF_F2O_END
 } // end function2Octree
@@ -11,7 +11,12 @@ Nearest Common Ancestor, adding positive boundaries, marking hanging nodes
 #include "TreeNode.h"
 #include "parUtils.h"
 #include "seqUtils.h"
+#include "binUtils.h"
 #include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #ifdef __DEBUG__
 #ifndef __DEBUG_OCT__
@@ -323,25 +328,13 @@ namespace ot {
     unsigned int temp;
     res = fread(&temp,sizeof(unsigned int),1,infile);
 
-    double* ptsTemp = NULL;
-
+    //read directly into pts, without a temporary copy
+    pts.resize(3*temp);
     if(temp) {
-      ptsTemp = new double[3*temp];
-      assert(ptsTemp);
-      res = fread(ptsTemp, sizeof(double),3*temp,infile);
+      res = fread(&(*(pts.begin())), sizeof(double),3*temp,infile);
     }
 
     fclose(infile);
-    pts.resize(3*temp);
-
-    for (int i=0; i < (3*temp); i++) {
-      pts[i] = ptsTemp[i];
-    }//end for
-
-    if(ptsTemp) {
-      delete [] ptsTemp;
-      ptsTemp = NULL;
-    }
 
     // std::cout << __func__ << ": size " << temp << ", " << pts.size() << std::endl;
     return 1;
@@ -414,23 +407,21 @@ namespace ot {
 
    int readNodesFromFile_binary (char* filename, std::vector<TreeNode > & nodes) {
 
-     int res;
-     FILE* infile = fopen(filename,"r");
+     FILE* infile = fopen(filename,"rb");
+     if(infile == NULL) {
+       return -1;
+     }
 
      ot::TreeNode tmp;
-     do
+     while(fread(&tmp,sizeof(ot::TreeNode),1,infile) == 1)
      {
-       fread(&tmp,sizeof(ot::TreeNode),1,infile);
        if(tmp.getDim()!=3)
          std::cout<<"Dim error:"<<tmp<<std::endl;
        nodes.push_back(tmp);
+     }
 
-     }while(!feof(infile));
-
-
-
-
-
+     fclose(infile);
+     return 0;
     }
 
   int readNodesFromFile (char* filename, std::vector<TreeNode > & nodes) {
@@ -457,7 +448,7 @@ namespace ot {
 
   int writeNodesToFile_binary(char * filename,const std::vector<TreeNode> & nodes)
   {
-    FILE* outfile = fopen(filename,"w");
+    FILE* outfile = fopen(filename,"wb");
 
     for(int i=0;i<nodes.size();i++)
     {
@@ -469,6 +460,199 @@ namespace ot {
     return 0;
   }
 
+  int writeNodesToCheckpoint(const char* filename, const std::vector<TreeNode> & nodes, MPI_Comm comm) {
+
+    int rank, npes;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &npes);
+
+    //dim and maxDepth from any processor with octants
+    unsigned int localDims[2] = {0, 0};
+    unsigned int dims[2];
+    if(!nodes.empty()) {
+      localDims[0] = nodes[0].getDim();
+      localDims[1] = nodes[0].getMaxDepth();
+    }
+    par::Mpi_Allreduce<unsigned int>(localDims, dims, 2, MPI_MAX, comm);
+
+    unsigned long long localCount = nodes.size();
+    unsigned long long offset = 0;
+    unsigned long long globalCount = 0;
+    MPI_Exscan(&localCount, &offset, 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM, comm);
+    if(!rank) {
+      offset = 0;
+    }
+    MPI_Allreduce(&localCount, &globalCount, 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM, comm);
+
+    std::vector<unsigned long long> rankOffsets;
+    if(!rank) {
+      rankOffsets.resize(npes + 1);
+    }
+    MPI_Gather(&offset, 1, MPI_UNSIGNED_LONG_LONG, (rank ? NULL : rankOffsets.data()), 1,
+        MPI_UNSIGNED_LONG_LONG, 0, comm);
+
+    OctreeCheckpointHeader header;
+    memcpy(header.magic, OCT_CHECKPOINT_MAGIC, sizeof(header.magic));
+    header.version = OCT_CHECKPOINT_VERSION;
+    header.byteOrder = OCT_CHECKPOINT_BYTE_ORDER;
+    header.dim = dims[0];
+    header.maxDepth = dims[1];
+#ifdef HILBERT_ORDERING
+    header.isHilbert = 1;
+#else
+    header.isHilbert = 0;
+#endif
+    header.numRanks = npes;
+    header.globalCount = globalCount;
+    header.dataOffset = sizeof(OctreeCheckpointHeader) + (npes + 1)*sizeof(unsigned long long);
+
+    std::vector<unsigned int> octants(4*nodes.size());
+    for(unsigned int i = 0; i < nodes.size(); i++) {
+      octants[4*i] = nodes[i].getX();
+      octants[4*i + 1] = nodes[i].getY();
+      octants[4*i + 2] = nodes[i].getZ();
+      octants[4*i + 3] = nodes[i].getFlag();
+    }
+
+    MPI_File fh;
+    int err = MPI_File_open(comm, const_cast<char*>(filename), MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &fh);
+    if(err != MPI_SUCCESS) {
+      if(!rank) {
+        std::cout<<"writeNodesToCheckpoint: unable to open "<<filename<<std::endl;
+      }
+      return err;
+    }
+    MPI_File_set_size(fh, 0);
+
+    if(!rank) {
+      rankOffsets[npes] = globalCount;
+      MPI_File_write_at(fh, 0, &header, sizeof(OctreeCheckpointHeader), MPI_BYTE, MPI_STATUS_IGNORE);
+      MPI_File_write_at(fh, sizeof(OctreeCheckpointHeader), rankOffsets.data(), npes + 1, MPI_UNSIGNED_LONG_LONG,
+          MPI_STATUS_IGNORE);
+    }
+
+    const MPI_Offset pos = header.dataOffset + offset*4*sizeof(unsigned int);
+    err = MPI_File_write_at_all(fh, pos, octants.data(), static_cast<int>(octants.size()), MPI_UNSIGNED,
+        MPI_STATUS_IGNORE);
+    MPI_File_close(&fh);
+
+    return err;
+  }//end function
+
+  int readNodesFromCheckpoint(const char* filename, std::vector<TreeNode> & nodes, MPI_Comm comm) {
+
+    int rank, npes;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &npes);
+
+    nodes.clear();
+
+    int fd = open(filename, O_RDONLY);
+    struct stat fileStat;
+    OctreeCheckpointHeader header;
+    bool swap = false;
+    int state = 0;
+
+    if( (fd < 0) || (fstat(fd, &fileStat) != 0) || (fileStat.st_size < (off_t)sizeof(OctreeCheckpointHeader)) ||
+        (pread(fd, &header, sizeof(OctreeCheckpointHeader), 0) != (ssize_t)sizeof(OctreeCheckpointHeader)) ||
+        (memcmp(header.magic, OCT_CHECKPOINT_MAGIC, sizeof(header.magic)) != 0) ) {
+      state = -1;
+    }
+
+    if(!state) {
+      swap = (header.byteOrder != OCT_CHECKPOINT_BYTE_ORDER);
+      if(swap) {
+        binOp::byteSwap(header.version);
+        binOp::byteSwap(header.byteOrder);
+        binOp::byteSwap(header.dim);
+        binOp::byteSwap(header.maxDepth);
+        binOp::byteSwap(header.isHilbert);
+        binOp::byteSwap(header.numRanks);
+        binOp::byteSwap(header.globalCount);
+        binOp::byteSwap(header.dataOffset);
+      }
+#ifdef HILBERT_ORDERING
+      const unsigned int isHilbert = 1;
+#else
+      const unsigned int isHilbert = 0;
+#endif
+      //a checkpoint in the other SFC order would have to be re-sorted
+      if( (header.byteOrder != OCT_CHECKPOINT_BYTE_ORDER) || (header.version > OCT_CHECKPOINT_VERSION) ||
+          (header.isHilbert != isHilbert) ||
+          ((unsigned long long)fileStat.st_size < header.dataOffset + 4*sizeof(unsigned int)*header.globalCount) ) {
+        state = -1;
+      }
+    }
+
+    //the slice of this processor, the partition of the writer is kept if the number of processors did not change
+    unsigned long long begin = 0, end = 0;
+    if(!state) {
+      if(header.numRanks == (unsigned int)npes) {
+        unsigned long long range[2];
+        if(pread(fd, range, sizeof(range), sizeof(OctreeCheckpointHeader) + rank*sizeof(unsigned long long))
+            != (ssize_t)sizeof(range)) {
+          state = -1;
+        }
+        if(swap) {
+          binOp::byteSwap(range[0]);
+          binOp::byteSwap(range[1]);
+        }
+        begin = range[0];
+        end = range[1];
+      } else {
+        begin = (header.globalCount*rank)/npes;
+        end = (header.globalCount*(rank + 1))/npes;
+      }
+      if( (begin > end) || (end > header.globalCount) ) {
+        state = -1;
+      }
+    }
+
+    if( (!state) && (end > begin) ) {
+      //mmap needs a page aligned offset
+      const off_t pageSize = sysconf(_SC_PAGESIZE);
+      const off_t sliceBegin = header.dataOffset + begin*4*sizeof(unsigned int);
+      const off_t mapBegin = (sliceBegin/pageSize)*pageSize;
+      const size_t mapLen = (sliceBegin - mapBegin) + (end - begin)*4*sizeof(unsigned int);
+      void* map = mmap(NULL, mapLen, PROT_READ, MAP_PRIVATE, fd, mapBegin);
+      if(map == MAP_FAILED) {
+        state = -1;
+      } else {
+        madvise(map, mapLen, MADV_SEQUENTIAL);
+        const unsigned int* octants = reinterpret_cast<const unsigned int*>(static_cast<const char*>(map) +
+            (sliceBegin - mapBegin));
+        nodes.resize(end - begin);
+        for(unsigned long long i = 0; i < (end - begin); i++) {
+          unsigned int v[4] = {octants[4*i], octants[4*i + 1], octants[4*i + 2], octants[4*i + 3]};
+          if(swap) {
+            for(unsigned int j = 0; j < 4; j++) {
+              binOp::byteSwap(v[j]);
+            }
+          }
+          nodes[i] = TreeNode(1, v[0], v[1], v[2], (v[3] & TreeNode::MAX_LEVEL), header.dim, header.maxDepth);
+          nodes[i].setFlag(v[3]);
+        }
+        munmap(map, mapLen);
+      }
+    }
+
+    if(fd >= 0) {
+      close(fd);
+    }
+
+    //all the processors fail if one of them fails
+    int globalState;
+    par::Mpi_Allreduce<int>(&state, &globalState, 1, MPI_MIN, comm);
+    if(globalState) {
+      nodes.clear();
+      if(!rank) {
+        std::cout<<"readNodesFromCheckpoint: "<<filename<<" is not a readable octree checkpoint"<<std::endl;
+      }
+    }
+
+    return globalState;
+  }//end function
+
   int writeNodesToFile (char* filename, const std::vector<TreeNode> & nodes) {
     FILE* outfile = fopen(filename,"w");
     if (!nodes.empty()) {
@@ -1565,7 +1749,7 @@ namespace ot {
     std::vector<ot::TreeNode > keys;
 
     assert(!in.empty());
-    assert(par::test::isUniqueAndSorted(in,MPI_COMM_WORLD));
+    assert(par::test::isUniqueAndSorted(in,comm));
     unsigned int maxD = in[0].getMaxDepth();
     unsigned int dim  = in[0].getDim();
     ot::TreeNode* inPtr = (&(*(in.begin())));
@@ -1896,7 +2080,7 @@ namespace ot {
       resRecv = new bool[keysSz];
     }
 
-    assert(par::test::isUniqueAndSorted(in,MPI_COMM_WORLD));
+    assert(par::test::isUniqueAndSorted(in,comm));
 
     for (unsigned int i = sendOffsets[rank];
         i < (sendOffsets[rank] + numKeysSend[rank]); i++) {
@@ -286,6 +286,117 @@ namespace ot {
     m_ucpLutMasks.clear();
     m_ucpSortOrders.clear();
     m_uiNlist.clear();
+    destroyPersistentContexts();
+    m_vElementLoops.clear();
+    for (unsigned int i = 0; i < m_vBufferPool.size(); i++) {
+      delete [] m_vBufferPool[i].second;
+    }
+    m_vBufferPool.clear();
+  }
+
+  void DA::setPersistentGhostExchange(bool flag) {
+    if(!flag) {
+      destroyPersistentContexts();
+    }
+    m_bPersistentGhostExchange = flag;
+  }
+
+  persistentUpdateContext* DA::findPersistentContext(void* arr, bool isWrite) {
+    for(unsigned int i = 0; i < m_mpiPersistentContexts.size(); i++) {
+      if((m_mpiPersistentContexts[i]->buffer == arr) && (m_mpiPersistentContexts[i]->isWrite == isWrite)) {
+        return m_mpiPersistentContexts[i];
+      }
+    }
+    return NULL;
+  }
+
+  void DA::destroyPersistentContexts() {
+    for(unsigned int i = 0; i < m_mpiPersistentContexts.size(); i++) {
+      //The context must not be in use.
+      assert(m_mpiPersistentContexts[i]->buffer == NULL);
+      delete m_mpiPersistentContexts[i];
+      m_mpiPersistentContexts[i] = NULL;
+    }
+    m_mpiPersistentContexts.clear();
+  }
+
+  void DA::colorElementLoop(ElementLoop& loop, unsigned int chunkSize) {
+    const unsigned int numElems = loop.getNumElements();
+    const unsigned int numChunks = ((numElems + chunkSize - 1)/chunkSize);
+
+    loop.chunkSize = chunkSize;
+    loop.chunkOffsets.resize(numChunks + 1);
+    for(unsigned int c = 0; c < numChunks; c++) {
+      loop.chunkOffsets[c] = c*chunkSize;
+    }
+    loop.chunkOffsets[numChunks] = numElems;
+
+    std::vector<unsigned int> nodeOffsets(numChunks + 1);
+    for(unsigned int c = 0; c <= numChunks; c++) {
+      nodeOffsets[c] = (loop.chunkOffsets[c] << 3);
+    }
+    colorChunks(loop.nodes, nodeOffsets, loop.colorOffsets, loop.colorChunks);
+  }
+
+  void colorChunks(const std::vector<unsigned int>& nodes, const std::vector<unsigned int>& nodeOffsets,
+      std::vector<unsigned int>& colorOffsets, std::vector<unsigned int>& colorChunks) {
+    const unsigned int numChunks = (nodeOffsets.empty() ? 0 : static_cast<unsigned int>(nodeOffsets.size() - 1));
+
+    //(node, chunk) pairs. Chunks that share a node are neighbours.
+    std::vector<std::pair<unsigned int, unsigned int> > nodeChunks;
+    nodeChunks.reserve(numChunks ? nodeOffsets[numChunks] : 0);
+    for(unsigned int c = 0; c < numChunks; c++) {
+      for(unsigned int i = nodeOffsets[c]; i < nodeOffsets[c + 1]; i++) {
+        nodeChunks.push_back(std::make_pair(nodes[i], c));
+      }
+    }
+    std::sort(nodeChunks.begin(), nodeChunks.end());
+    nodeChunks.erase(std::unique(nodeChunks.begin(), nodeChunks.end()), nodeChunks.end());
+
+    //(chunk, lower neighbour) pairs.
+    std::vector<std::pair<unsigned int, unsigned int> > edges;
+    for(unsigned int b = 0, e = 0; b < nodeChunks.size(); b = e) {
+      for(e = b + 1; (e < nodeChunks.size()) && (nodeChunks[e].first == nodeChunks[b].first); e++) {
+        for(unsigned int p = b; p < e; p++) {
+          edges.push_back(std::make_pair(nodeChunks[e].second, nodeChunks[p].second));
+        }
+      }
+    }
+    nodeChunks.clear();
+    std::sort(edges.begin(), edges.end());
+    edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+    //Greedy coloring in chunk order.
+    std::vector<unsigned int> colors(numChunks);
+    std::vector<bool> used;
+    unsigned int numColors = 0;
+    for(unsigned int c = 0, e = 0; c < numChunks; c++) {
+      used.assign(numColors + 1, false);
+      for(; (e < edges.size()) && (edges[e].first == c); e++) {
+        used[colors[edges[e].second]] = true;
+      }
+      unsigned int color = 0;
+      while(used[color]) {
+        color++;
+      }
+      colors[c] = color;
+      if(color == numColors) {
+        numColors++;
+      }
+    }
+
+    colorOffsets.assign(numColors + 1, 0);
+    for(unsigned int c = 0; c < numChunks; c++) {
+      colorOffsets[colors[c] + 1]++;
+    }
+    for(unsigned int k = 0; k < numColors; k++) {
+      colorOffsets[k + 1] += colorOffsets[k];
+    }
+    colorChunks.resize(numChunks);
+    std::vector<unsigned int> colorCounts(colorOffsets.begin(), colorOffsets.end() - 1);
+    for(unsigned int c = 0; c < numChunks; c++) {
+      colorChunks[colorCounts[colors[c]]++] = c;
+    }
   }
 
   /************** Domain Access ****************/
@@ -741,87 +852,42 @@ inline Point DA::getNextOffset(Point p, unsigned char d) {
     PetscScalar *array = NULL;
     VecGetArray(in, &array);
 
-    // allocate except for the case of ghosted-elemental vectors...
     if(isGhosted && isElemental) {
       //simply copy the pointer
       //This is the only case where the buffer will not be the size of the
       //fullLocalBufferSize. 
       out = array;
-    }else {
-      // First let us allocate for the buffer ... the local buffer will be of full
-      // length.
-      sz = dof*m_uiLocalBufferSize;
-
-      if(sz) {
-        out = new PetscScalar[sz];
-        assert(out);
-      }else {
-        out = NULL;
-      }
+      return 0;
+    }
 
-      //Zero Entries first if you plan to modify the buffer 
-      if(!isReadOnly) {
-        for(unsigned int i = 0; i < sz; i++) {
-          out[i] = 0.0;
-        }
-      }
+    // The local buffer will be of full length. It is reused from an earlier
+    // vecRestoreBuffer() if possible.
+    sz = dof*m_uiLocalBufferSize;
+    out = getPooledBuffer(sz);
+
+    //Zero Entries first. A reused buffer holds the values of its previous
+    //vector, so this is done for read only buffers as well. 
+    for(unsigned int i = 0; i < sz; i++) {
+      out[i] = 0.0;
     }
 
-    unsigned int vecCnt=0;
-    // Now we can populate the out buffer ... and that needs a loop through the
-    // elements ...
-    if (isGhosted) {
-      if (isElemental) {
-        //Nothing to be done here.
-      } else {
-        // now copy ...
-        for (unsigned int i=0; i<m_uiLocalBufferSize; i++) {
-          // skip the ones that are not nodes ...
-          if ( ! (m_ucpOctLevels[i] & ot::TreeNode::NODE ) ) {
-            continue;
-          }
-          for (unsigned int j=0; j<dof; j++) {
-            out[dof*i+j] = array[dof*vecCnt + j];
-          }
-          vecCnt++;
-        }//end for i
-      }//end if elemental
+    // Now we can populate the out buffer ...
+    if (isElemental) {
+      // is a simple copy ...
+      for (unsigned int i = dof*m_uiElementBegin; i < dof*m_uiElementEnd; i++) {
+        out[i] = array[i - dof*m_uiElementBegin];
+      }
     } else {
-      if (isElemental) {
-        // is a simple copy ...
-        for (unsigned int i = m_uiElementBegin; i < m_uiElementEnd; i++) {
-          for (unsigned int j = 0; j < dof; j++) {
-            out[dof*i+j] = array[dof*vecCnt + j];
-          }
-          vecCnt++;
-        }//end for i
-      } else {
-        for (unsigned int i = m_uiElementBegin; i < m_uiElementEnd; i++) {
-          if ( ! (m_ucpOctLevels[i] & ot::TreeNode::NODE ) ) {
-            continue;
-          }
-          for (unsigned int j=0; j<dof; j++) {
-            out[dof*i+j] = array[dof*vecCnt + j];
-          }
-          vecCnt++;
-        }//end for i
-        for (unsigned int i = m_uiElementEnd; i < m_uiPostGhostBegin; i++) {
-          // add the remaining boundary nodes ...
-          if ( ! ( (m_ucpOctLevels[i] & ot::TreeNode::NODE ) &&
-                (m_ucpOctLevels[i] & ot::TreeNode::BOUNDARY ) ) ) {
-            continue;
-          }
-          for (unsigned int j=0; j<dof; j++) {
-            out[dof*i+j] = array[dof*vecCnt + j];
-          }
-          vecCnt++;
-        }//end for i
+      const std::vector<unsigned int>& idx = getNodeBufferIndices(isGhosted);
+      const unsigned int numNodes = static_cast<unsigned int>(idx.size());
+      for (unsigned int k = 0; k < numNodes; k++) {
+        for (unsigned int j=0; j<dof; j++) {
+          out[dof*idx[k]+j] = array[dof*k + j];
+        }
       }
     }
 
-    if(!(isGhosted && isElemental)) {
-      VecRestoreArray(in, &array);
-    }
+    VecRestoreArray(in, &array);
 
     return 0;
   }
@@ -864,23 +930,16 @@ inline Point DA::getNextOffset(Point p, unsigned char d) {
       assert(m_uiPostGhostBegin == 0);
     }
 
-    unsigned int vecCnt=0;
-
     if(isGhosted && isElemental) {
       //If it is ghosted and elemental, simply restore the array.
       //out was not allocated expicitly in this case. It was just a copy of the
       //array's pointer. The readOnly flag is immaterial for this case.
       VecRestoreArray(in, &out);
       out = NULL;
-    }  else if ( isReadOnly ) {
-      // no need to write back ... simply clean up and return
-      //Since this is not an elemental and ghosted vector, out was allocated
-      //explicitly 
-      if(out) {
-        delete [] out;
-        out = NULL;
-      }
-    } else {
+      return 0;
+    }
+
+    if ( !isReadOnly ) {
       //ghosted and elemental is already taken care of. So only need to tackle
       //the other 3 cases.
       // need to write back ...
@@ -890,59 +949,86 @@ inline Point DA::getNextOffset(Point p, unsigned char d) {
 
       if ( isElemental ) {
         //non-ghosted, elemental
-        for (unsigned int i = m_uiElementBegin; i < m_uiElementEnd; i++) {
-          for (unsigned int j=0; j<dof; j++) {
-            array[dof*vecCnt + j] = out[dof*i+j];
-          }
-          vecCnt++;
-        }
-      } else if ( isGhosted ) {
-        // nodal and ghosted ...
-        for (unsigned int i=0; i<sz; i++) {
-          // skip the ones that are not nodes ...
-          if ( ! (m_ucpOctLevels[i] & ot::TreeNode::NODE ) ) {
-            continue;
-          }
-          for (unsigned int j=0; j<dof; j++) {
-            array[dof*vecCnt + j] = out[dof*i+j];
-          }
-          vecCnt++;
+        for (unsigned int i = dof*m_uiElementBegin; i < dof*m_uiElementEnd; i++) {
+          array[i - dof*m_uiElementBegin] = out[i];
         }
       } else {
-        // nodal non ghosted ...
-        for (unsigned int i = m_uiElementBegin; i < m_uiElementEnd; i++) {
-          if ( ! (m_ucpOctLevels[i] & ot::TreeNode::NODE ) ) {
-            continue;
-          }
-          for (unsigned int j=0; j<dof; j++) {
-            array[dof*vecCnt + j] = out[dof*i+j];
-          }
-          vecCnt++;
-        }
-        for (unsigned int i = m_uiElementEnd; i < m_uiPostGhostBegin; i++) {
-          // add the remaining boundary nodes ...
-          if ( ! ( (m_ucpOctLevels[i] & ot::TreeNode::NODE ) &&
-                (m_ucpOctLevels[i] & ot::TreeNode::BOUNDARY ) ) ) {
-            continue;
-          }
+        // nodal, ghosted or non ghosted ...
+        const std::vector<unsigned int>& idx = getNodeBufferIndices(isGhosted);
+        const unsigned int numNodes = static_cast<unsigned int>(idx.size());
+        for (unsigned int k = 0; k < numNodes; k++) {
           for (unsigned int j=0; j<dof; j++) {
-            array[dof*vecCnt + j] = out[dof*i+j];
+            array[dof*k + j] = out[dof*idx[k]+j];
           }
-          vecCnt++;
         }
       }
 
       VecRestoreArray(in, &array);
-      //Since this is not an elemental and ghosted vector, out was allocated
-      //explicitly 
-      if(out) {
-        delete [] out;
-        out = NULL;
-      }
     }
+
+    //Since this is not an elemental and ghosted vector, out was taken from
+    //the pool of the DA. 
+    releaseBuffer(out, dof*m_uiLocalBufferSize);
     return 0;
   }
 
+  const std::vector<unsigned int>& DA::getNodeBufferIndices(bool isGhosted) {
+    std::vector<unsigned int>& idx = (isGhosted ? m_uiGhostedNodeBufferIdx : m_uiNodeBufferIdx);
+    if(!idx.empty()) {
+      return idx;
+    }
+
+    if (isGhosted) {
+      for (unsigned int i = 0; i < m_uiLocalBufferSize; i++) {
+        if ( m_ucpOctLevels[i] & ot::TreeNode::NODE ) {
+          idx.push_back(i);
+        }
+      }
+    } else {
+      for (unsigned int i = m_uiElementBegin; i < m_uiElementEnd; i++) {
+        if ( m_ucpOctLevels[i] & ot::TreeNode::NODE ) {
+          idx.push_back(i);
+        }
+      }
+      for (unsigned int i = m_uiElementEnd; i < m_uiPostGhostBegin; i++) {
+        // add the remaining boundary nodes ...
+        if ( (m_ucpOctLevels[i] & ot::TreeNode::NODE ) &&
+            (m_ucpOctLevels[i] & ot::TreeNode::BOUNDARY ) ) {
+          idx.push_back(i);
+        }
+      }
+    }
+    return idx;
+  }
+
+  PetscScalar* DA::getPooledBuffer(unsigned int sz) {
+    if(!sz) {
+      return NULL;
+    }
+    for (unsigned int i = 0; i < m_vBufferPool.size(); i++) {
+      if (m_vBufferPool[i].first == sz) {
+        PetscScalar* buf = m_vBufferPool[i].second;
+        m_vBufferPool[i] = m_vBufferPool.back();
+        m_vBufferPool.pop_back();
+        return buf;
+      }
+    }
+    PetscScalar* buf = new PetscScalar[sz];
+    assert(buf);
+    return buf;
+  }
+
+  void DA::releaseBuffer(PetscScalar* buf, unsigned int sz) {
+    if(buf == NULL) {
+      return;
+    }
+    if (m_vBufferPool.size() < DA_BUFFER_POOL_SIZE) {
+      m_vBufferPool.push_back(std::make_pair(sz, buf));
+    } else {
+      delete [] buf;
+    }
+  }
+
   void DA::updateQuotientCounter() {
 #ifdef __DEBUG_DA_PUBLIC__
     assert(m_bIamActive);
@@ -443,7 +443,7 @@ namespace ot {
       //singular Block's parent and the singular Block to 0. So that the global
       //scan of all these elements in partW is the same and hence they will be
       //sent to the same processor...
-      assert(par::test::isUniqueAndSorted(globalCoarse,MPI_COMM_WORLD));
+      assert(par::test::isUniqueAndSorted(globalCoarse, commActive));
 
       unsigned int lastIdxFound = (globalCoarse.size() -1);
 
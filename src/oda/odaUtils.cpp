@@ -13,9 +13,14 @@
 #include <iostream>
 #include <cassert>
 #include <iomanip>
+#include <algorithm>
+#include <array>
 #include "oda.h"
 #include "parUtils.h"
 #include "seqUtils.h"
+#include "treenode2vtk.h"
+#include "hangingInterp.h"
+#include "stencilTable.h"
 
 
 #ifdef __DEBUG__
@@ -34,6 +39,9 @@ namespace ot {
 
   extern double**** ShapeFnCoeffs; 
 
+  //The shared window of the flat ShapeFnCoeffs[8][18][8][8] table.
+  static MPI_Win shapeFnCoeffsWin = MPI_WIN_NULL;
+
   void interpolateData(ot::DA* da, Vec in, Vec out, Vec* gradOut,
       unsigned int dof, std::vector<double>& pts) {
 
@@ -859,6 +867,91 @@ namespace ot {
     }//end if p0
   }//end function
 
+  int writeVtu(ot::DA* da, const char* outFileName, Vec nodal, unsigned int nodalDof,
+      Vec elemental, unsigned int elemDof) {
+    //Only the active processors hold elements
+    if(!(da->iAmActive())) {
+      return 0;
+    }
+
+    const ot::ElementLoop & loop = da->getElementLoop<ot::DA_FLAGS::WRITABLE>();
+    const unsigned int numCells = loop.getNumElements();
+    const unsigned int maxD = da->getMaxDepth();
+    const float xFac = 1.0f/((float)(1u << (maxD - 1)));
+
+    PetscScalar* nodalArr = NULL;
+    PetscScalar* elemArr = NULL;
+    if(nodal != NULL) {
+      da->vecGetBuffer(nodal, nodalArr, false, false, true, nodalDof);
+      da->ReadFromGhostsBegin<PetscScalar>(nodalArr, nodalDof);
+      da->ReadFromGhostsEnd<PetscScalar>(nodalArr);
+    }
+    if(elemental != NULL) {
+      da->vecGetBuffer(elemental, elemArr, true, false, true, elemDof);
+    }
+
+    std::vector<float> cells(4*numCells);
+    std::vector<unsigned char> levels(numCells);
+    std::vector<double> pointValues((nodal != NULL) ? (8*nodalDof*numCells) : 0);
+    std::vector<double> cellValues((elemental != NULL) ? (elemDof*numCells) : 0);
+
+    unsigned int idx[8];
+    for(unsigned int pos = 0; pos < numCells; pos++) {
+      const unsigned int elem = loop.getElement(pos);
+      const unsigned char lev = da->getLevel(elem);
+      Point pt = loop.getAnchor(pos);
+      cells[4*pos] = xFac*pt.x();
+      cells[4*pos + 1] = xFac*pt.y();
+      cells[4*pos + 2] = xFac*pt.z();
+      cells[4*pos + 3] = xFac*((float)(1u << (maxD - lev)));
+      //DA levels include the extra level of the boundary nodes
+      levels[pos] = lev - 1;
+
+      if(nodal != NULL) {
+        loop.getNodeIndices(pos, idx);
+        const ot::HangingInterp & hi = ot::getHangingInterp(loop.getChildNumber(pos),
+            loop.getHangingNodeIndex(pos));
+        for(unsigned int v = 0; v < 8; v++) {
+          for(unsigned int d = 0; d < nodalDof; d++) {
+            double val = 0.0;
+            for(unsigned int q = 0; q < hi.numSrc[v]; q++) {
+              val += nodalArr[nodalDof*idx[hi.src[v][q]] + d];
+            }
+            pointValues[(8*pos + v)*nodalDof + d] = hi.weight[v]*val;
+          }
+        }
+      }
+
+      if(elemental != NULL) {
+        for(unsigned int d = 0; d < elemDof; d++) {
+          cellValues[elemDof*pos + d] = elemArr[elemDof*elem + d];
+        }
+      }
+    }
+
+    std::vector<VtuField> fields;
+    if(nodal != NULL) {
+      VtuField f;
+      f.name = "nodal";
+      f.numComponents = nodalDof;
+      f.isPointData = true;
+      f.values = pointValues.data();
+      fields.push_back(f);
+      da->vecRestoreBuffer(nodal, nodalArr, false, false, true, nodalDof);
+    }
+    if(elemental != NULL) {
+      VtuField f;
+      f.name = "elemental";
+      f.numComponents = elemDof;
+      f.isPointData = false;
+      f.values = cellValues.data();
+      fields.push_back(f);
+      da->vecRestoreBuffer(elemental, elemArr, true, false, true, elemDof);
+    }
+
+    return cellsToVtu(cells.data(), levels.data(), numCells, outFileName, da->getCommActive(), fields);
+  }//end function
+
   unsigned int getGlobalMinLevel(ot::DA* da) {
 
     unsigned int myMinLev = ot::TreeNode::MAX_LEVEL;
@@ -1774,241 +1867,53 @@ namespace ot {
   void DA_Finalize() {
     PROF_DA_FINAL_BEGIN 
 
-      for(unsigned int cNum = 0; cNum < 8; cNum++) {
-        for(unsigned int eType = 0; eType < 18; eType++) {
-          for(unsigned int i = 0; i < 8; i++) {
-            delete [] (ShapeFnCoeffs[cNum][eType][i]);
-            ShapeFnCoeffs[cNum][eType][i] = NULL;
-          }
-          delete [] (ShapeFnCoeffs[cNum][eType]);
-          ShapeFnCoeffs[cNum][eType] = NULL;
-        }
-        delete [] (ShapeFnCoeffs[cNum]);
-        ShapeFnCoeffs[cNum] = NULL;
-      }
-
-    delete [] ShapeFnCoeffs;
-    ShapeFnCoeffs = NULL;
+    TableView<double, 4>::destroy(ShapeFnCoeffs);
+    destroyStencilTable(&shapeFnCoeffsWin);
 
+    PROF_DA_FINAL_END 
+  }
 
+#ifdef DA_HASH_NLIST
+  static bool hashNodeList = true;
+#else
+  static bool hashNodeList = false;
+#endif
 
-    PROF_DA_FINAL_END 
+  void DA_setHashNodeList(bool flag) {
+    hashNodeList = flag;
   }
 
-  int createShapeFnCoeffs_Type3(MPI_Comm comm) {
-    FILE* infile;
-    int rank, res;
-    MPI_Comm_rank(comm, &rank); 
-    char fname[250];
-    sprintf(fname,"ShapeFnCoeffs_%d.inp", rank);
-    infile = fopen(fname,"r");
-    if(!infile) {
-      std::cout<<"The file "<<fname<<" is not good for reading."<<std::endl;
-      assert(false);
-    }
+  bool DA_isHashNodeList() {
+    return hashNodeList;
+  }
 
-    typedef double* doublePtr;
-    typedef doublePtr* double2Ptr;
-    typedef double2Ptr* double3Ptr;
-
-    ShapeFnCoeffs = new double3Ptr[8];
-    for(unsigned int cNum = 0; cNum < 8; cNum++) {
-      ShapeFnCoeffs[cNum] = new double2Ptr[18];
-      for(unsigned int eType = 0; eType < 18; eType++) {
-        ShapeFnCoeffs[cNum][eType] = new doublePtr[8];
-        for(unsigned int i = 0; i < 8; i++) {
-          ShapeFnCoeffs[cNum][eType][i] = new double[8];
-          for(unsigned int j = 0; j < 8; j++) {
-            res = fscanf(infile,"%lf",&(ShapeFnCoeffs[cNum][eType][i][j]));
-          }
-        }
-      }
-    }
+  //ShapeFnCoeffs[cNum][eType][i][j]: 8 x 18 x 8 x 8 = 9216 values, stored once per node.
+  static void createShapeFnCoeffs(MPI_Comm comm, int fileId) {
+    const unsigned int dims[3] = {18, 8, 8};
+    double* coeffs = createStencilTable<double>(comm, "ShapeFnCoeffs", fileId, 9216, &shapeFnCoeffsWin);
+    ShapeFnCoeffs = TableView<double, 4>::create(coeffs, dims, 8);
+  }
 
-    fclose(infile);
+  int createShapeFnCoeffs_Type3(MPI_Comm comm) {
+    //Every node reads ShapeFnCoeffs_<rank of its first processor>.
+    int rank;
+    MPI_Comm_rank(comm, &rank);
+    createShapeFnCoeffs(comm, rank);
     return 1;
   }
 
   int createShapeFnCoeffs_Type2(MPI_Comm comm) {
-    FILE* infile;
-
-    int rank, npes, res;
+    //The nodes are grouped by the rank of their first processor / 1000, each group reads
+    //ShapeFnCoeffs_<group>.
+    int rank;
     MPI_Comm_rank(comm, &rank);
-    MPI_Comm_size(comm, &npes);
-
-    const int THOUSAND = 1000;
-    int numGroups = (npes/THOUSAND);
-    if( (numGroups*THOUSAND) < npes) {
-      numGroups++;
-    }
-
-    MPI_Comm newComm;
-
-    bool* isEmptyList = new bool[npes];
-    assert(isEmptyList);
-    for(int i = 0; i < numGroups; i++) {
-      for(int j = 0; (j < (i*THOUSAND)) && (j < npes); j++) {
-        isEmptyList[j] = true;
-      }
-      for(int j = (i*THOUSAND); (j < ((i+1)*THOUSAND)) && (j < npes); j++) {
-        isEmptyList[j] = false;
-      }
-      for(int j = ((i + 1)*THOUSAND); j < npes; j++) {
-        isEmptyList[j] = true;
-      }
-      MPI_Comm tmpComm;
-      par::splitComm2way(isEmptyList, &tmpComm, comm);
-      if(!(isEmptyList[rank])) {
-        newComm = tmpComm;
-      }
-    }//end for i
-    delete [] isEmptyList;
-
-    if((rank % THOUSAND) == 0) {
-      char fname[250];
-      sprintf(fname,"ShapeFnCoeffs_%d.inp", (rank/THOUSAND));
-      infile = fopen(fname,"r");
-      if(!infile) {
-        std::cout<<"The file "<<fname<<" is not good for reading."<<std::endl;
-        assert(false);
-      }
-    }
-
-    typedef double* doublePtr;
-    typedef doublePtr* double2Ptr;
-    typedef double2Ptr* double3Ptr;
-
-    ShapeFnCoeffs = new double3Ptr[8];
-    for(unsigned int cNum = 0; cNum < 8; cNum++) {
-      ShapeFnCoeffs[cNum] = new double2Ptr[18];
-      for(unsigned int eType = 0; eType < 18; eType++) {
-        ShapeFnCoeffs[cNum][eType] = new doublePtr[8];
-        for(unsigned int i = 0; i < 8; i++) {
-          ShapeFnCoeffs[cNum][eType][i] = new double[8];
-          if((rank % THOUSAND) == 0){
-            for(unsigned int j = 0; j < 8; j++) {
-              res = fscanf(infile,"%lf",&(ShapeFnCoeffs[cNum][eType][i][j]));
-            }
-          }
-        }
-      }
-    }
-
-    if((rank % THOUSAND) == 0){
-      fclose(infile);
-    }
-
-    double * tmpMat = new double[9216];
-    assert(tmpMat);
-
-    if((rank % THOUSAND) == 0) {
-      unsigned int ctr = 0;
-      for(unsigned int cNum = 0; cNum < 8; cNum++) {
-        for(unsigned int eType = 0; eType < 18; eType++) {
-          for(unsigned int i = 0; i < 8; i++) {
-            for(unsigned int j = 0; j < 8; j++) {
-              tmpMat[ctr] = ShapeFnCoeffs[cNum][eType][i][j];
-              ctr++;
-            }
-          }
-        }
-      }
-    }
-
-    par::Mpi_Bcast<double>(tmpMat,9216, 0, newComm);
-
-    if((rank % THOUSAND) != 0) {
-      unsigned int ctr = 0;
-      for(unsigned int cNum = 0; cNum < 8; cNum++) {
-        for(unsigned int eType = 0; eType < 18; eType++) {
-          for(unsigned int i = 0; i < 8; i++) {
-            for(unsigned int j = 0; j < 8; j++) {
-              ShapeFnCoeffs[cNum][eType][i][j] = tmpMat[ctr];
-              ctr++;
-            }
-          }
-        }
-      }
-    }
-
-    delete [] tmpMat;
-
+    createShapeFnCoeffs(comm, (rank/1000));
     return 1;
-  }//end of function
+  }
 
   int createShapeFnCoeffs_Type1(MPI_Comm comm) {
-    FILE* infile;
-    int rank, res;
-    MPI_Comm_rank(comm, &rank);
-    if(!rank) {
-      char fname[250];
-      sprintf(fname,"ShapeFnCoeffs.inp");
-      infile = fopen(fname,"r");
-      if(!infile) {
-        std::cout<<"The file "<<fname<<" is not good for reading."<<std::endl;
-        assert(false);
-      }
-    }
-
-    typedef double* doublePtr;
-    typedef doublePtr* double2Ptr;
-    typedef double2Ptr* double3Ptr;
-
-    ShapeFnCoeffs = new double3Ptr[8];
-    for(unsigned int cNum = 0; cNum < 8; cNum++) {
-      ShapeFnCoeffs[cNum] = new double2Ptr[18];
-      for(unsigned int eType = 0; eType < 18; eType++) {
-        ShapeFnCoeffs[cNum][eType] = new doublePtr[8];
-        for(unsigned int i = 0; i < 8; i++) {
-          ShapeFnCoeffs[cNum][eType][i] = new double[8];
-          if(!rank){
-            for(unsigned int j = 0; j < 8; j++) {
-              res = fscanf(infile,"%lf",&(ShapeFnCoeffs[cNum][eType][i][j]));
-            }
-          }
-        }
-      }
-    }
-
-    if(!rank){
-      fclose(infile);
-    }
-
-    double * tmpMat = new double[9216];
-    assert(tmpMat);
-
-    if(!rank) {
-      unsigned int ctr = 0;
-      for(unsigned int cNum = 0; cNum < 8; cNum++) {
-        for(unsigned int eType = 0; eType < 18; eType++) {
-          for(unsigned int i = 0; i < 8; i++) {
-            for(unsigned int j = 0; j < 8; j++) {
-              tmpMat[ctr] = ShapeFnCoeffs[cNum][eType][i][j];
-              ctr++;
-            }
-          }
-        }
-      }
-    }
-
-    par::Mpi_Bcast<double>(tmpMat,9216, 0, comm);
-
-    if(rank) {
-      unsigned int ctr = 0;
-      for(unsigned int cNum = 0; cNum < 8; cNum++) {
-        for(unsigned int eType = 0; eType < 18; eType++) {
-          for(unsigned int i = 0; i < 8; i++) {
-            for(unsigned int j = 0; j < 8; j++) {
-              ShapeFnCoeffs[cNum][eType][i][j] = tmpMat[ctr];
-              ctr++;
-            }
-          }
-        }
-      }
-    }
-
-    delete [] tmpMat;
-
+    //Processor 0 reads ShapeFnCoeffs and broadcasts it to the other nodes.
+    createShapeFnCoeffs(comm, -1);
     return 1;
   }//end of function
 
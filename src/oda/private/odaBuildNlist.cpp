@@ -12,6 +12,7 @@
 #include "colors.h"
 #include "nodeAndRanks.h"
 #include "testUtils.h"
+#include "octantHash.h"
 
 #ifdef __DEBUG__
 #ifndef __DEBUG_DA_NLIST__
@@ -43,6 +44,88 @@ namespace ot {
   assert(tmpMlbIdx == fastIdx);\
 }
 
+/**
+  @brief The positive search of DA::buildNodeList for the elements [iLoopSt, iLoopEnd) of in, with hash lookups
+  instead of binary searches. The result is the same as the one of POS_SEARCH_BLOCK: the binary search for a vertex
+  returns the octant that contains it (in is linear) and the scan for a hanging ghost returns the first child of
+  the key (in the order of in) that is not a node and comes after the vertex. The elements are independent, so
+  they are processed by OpenMP threads.
+  */
+static void hashedPositiveSearch(const std::vector<ot::TreeNode>& in, const ot::OctantHash& hash,
+    std::vector<unsigned int>& nlist, unsigned int iLoopSt, unsigned int iLoopEnd, unsigned int elementBegin,
+    unsigned int localBufferSize, unsigned int maxDepth, unsigned int dim) {
+
+  // the index of the node anchored at (x,y,z), NOT_FOUND if the octant containing (x,y,z) is not such a node.
+  auto nodeAt = [&](unsigned int x, unsigned int y, unsigned int z, unsigned int lev, bool& contained) {
+    const unsigned int idx = hash.findContaining(x, y, z, lev);
+    contained = (idx != ot::OctantHash::NOT_FOUND);
+    if (contained && (in[idx].getX() == x) && (in[idx].getY() == y) && (in[idx].getZ() == z) &&
+        (in[idx].getFlag() & ot::TreeNode::NODE)) {
+      return idx;
+    }
+    return ot::OctantHash::NOT_FOUND;
+  };
+
+  // the first child of the octant (x,y,z,lev) that is not a node and comes after (x,y,z,maxDepth).
+  auto findGhost = [&](unsigned int x, unsigned int y, unsigned int z, unsigned int lev) {
+    const ot::TreeNode key(x, y, z, maxDepth, dim, maxDepth);
+    const unsigned int half = 1u << (maxDepth - lev - 1);
+    unsigned int best = localBufferSize;
+    for (unsigned int c = 0; c < 8; c++) {
+      const unsigned int idx = hash.find(x + ((c & 1u) ? half : 0), y + ((c & 2u) ? half : 0),
+          z + ((c & 4u) ? half : 0), lev + 1);
+      // maxLowerBound returns 0 if in[0] > key, so the scan never visits in[0].
+      if ((idx != ot::OctantHash::NOT_FOUND) && idx && (idx < best) &&
+          !(in[idx].getFlag() & ot::TreeNode::NODE) && (in[idx] > key)) {
+        best = idx;
+      }
+    }
+    return best;
+  };
+
+#pragma omp parallel for schedule(dynamic, 1024)
+  for (unsigned int i = iLoopSt; i < iLoopEnd; i++) {
+    const unsigned int d = in[i].getLevel();
+    const unsigned int x = in[i].getX();
+    const unsigned int y = in[i].getY();
+    const unsigned int z = in[i].getZ();
+    const unsigned int parX = ((x >> (maxDepth - d + 1)) << (maxDepth - d + 1));
+    const unsigned int parY = ((y >> (maxDepth - d + 1)) << (maxDepth - d + 1));
+    const unsigned int parZ = ((z >> (maxDepth - d + 1)) << (maxDepth - d + 1));
+    const unsigned int sz = 1u << (maxDepth - d);
+    bool contained;
+
+    // vertex 0 is i itself or the anchor of the parent.
+    nlist[8*i] = i;
+    if (!(in[i].getFlag() & ot::TreeNode::NODE)) {
+      const unsigned int idx = nodeAt(parX, parY, parZ, d - 1, contained);
+      if (idx != ot::OctantHash::NOT_FOUND) {
+        nlist[8*i] = idx;
+      }
+    }
+
+    for (unsigned int j = 1; j < 8; j++) {
+      const unsigned int vx = x + ((j & 1u) ? sz : 0);
+      const unsigned int vy = y + ((j & 2u) ? sz : 0);
+      const unsigned int vz = z + ((j & 4u) ? sz : 0);
+      unsigned int idx = nodeAt(vx, vy, vz, d, contained);
+      if (idx != ot::OctantHash::NOT_FOUND) {
+        nlist[8*i + j] = idx;
+      } else if (contained || (i >= elementBegin)) {
+        // hanging, the node is the vertex j of the parent.
+        const unsigned int px = parX + ((j & 1u) ? (sz << 1u) : 0);
+        const unsigned int py = parY + ((j & 2u) ? (sz << 1u) : 0);
+        const unsigned int pz = parZ + ((j & 4u) ? (sz << 1u) : 0);
+        idx = nodeAt(px, py, pz, d - 1, contained);
+        nlist[8*i + j] = (idx != ot::OctantHash::NOT_FOUND) ? idx : findGhost(px, py, pz, d - 1);
+      } else {
+        // a pre-ghost whose vertex is not in in.
+        nlist[8*i + j] = findGhost(vx, vy, vz, d);
+      }
+    }
+  }
+}
+
 //Build Node list using 4-way searches...
 void DA::buildNodeList(std::vector<ot::TreeNode> &in) {
 
@@ -61,6 +144,9 @@ void DA::buildNodeList(std::vector<ot::TreeNode> &in) {
     // compute number of elements.
     unsigned int nelem = m_uiPreGhostElementSize + m_uiElementSize;
 
+  // the positive search with the hash of the octants (see DA_setHashNodeList) ...
+  const bool useHashNlist = DA_isHashNodeList();
+
   std::vector<unsigned int> nlist;
 //
 //  std::vector<ot::TreeNode> debugKeys;
@@ -132,6 +218,14 @@ void DA::buildNodeList(std::vector<ot::TreeNode> &in) {
       m_ucpLutMasks.resize(2*iLoopEnd);
     }
 
+    // in changes between the two sets, so it is indexed again.
+    if (useHashNlist) {
+      ot::OctantHash octHash;
+      octHash.build(in);
+      hashedPositiveSearch(in, octHash, nlist, iLoopSt, iLoopEnd, m_uiElementBegin, m_uiLocalBufferSize,
+          m_uiMaxDepth, m_uiDimension);
+    }
+
     //Loop through all the elements in this set and set LUTs.
     for (unsigned int i = iLoopSt; i < iLoopEnd; i++) {
 
@@ -175,11 +269,32 @@ void DA::buildNodeList(std::vector<ot::TreeNode> &in) {
 #endif
 
       bool found[8];
-      // haven't found anything yet. Set Default values.
-      for (unsigned int k = 0; k < 8; k++) {
-        nlist[8*i + k] = m_uiLocalBufferSize;
-        found[k] = false;
-      }//end for k
+#ifdef __DEBUG_DA_NLIST__
+      unsigned int hashedNlist[8];
+#endif
+      if (useHashNlist) {
+        // The positive search was done by hashedPositiveSearch, only the keys are needed for the vertices that are
+        // not found. The debug build repeats the binary searches and compares.
+        for (unsigned int k = 0; k < 8; k++) {
+          nodeLocations[k] = ot::TreeNode(x + ((k & 1u) ? sz : 0), y + ((k & 2u) ? sz : 0),
+              z + ((k & 4u) ? sz : 0), m_uiMaxDepth, m_uiDimension, m_uiMaxDepth);
+          parNodeLocations[k] = ot::TreeNode(parX + ((k & 1u) ? (sz << 1u) : 0), parY + ((k & 2u) ? (sz << 1u) : 0),
+              parZ + ((k & 4u) ? (sz << 1u) : 0), m_uiMaxDepth, m_uiDimension, m_uiMaxDepth);
+#ifdef __DEBUG_DA_NLIST__
+          hashedNlist[k] = nlist[8*i + k];
+          nlist[8*i + k] = m_uiLocalBufferSize;
+          found[k] = false;
+#else
+          found[k] = true;
+#endif
+        }//end for k
+      } else {
+        // haven't found anything yet. Set Default values.
+        for (unsigned int k = 0; k < 8; k++) {
+          nlist[8*i + k] = m_uiLocalBufferSize;
+          found[k] = false;
+        }//end for k
+      }
 
       //~~~~~~~~~~~~~~~~~~~~~~~NEGATIVE SEARCH~~~~~~~~~~~~~~~~~~~~~~~~~~~~
  /*     if(numFullLoopCtr == 1) {
@@ -732,6 +847,15 @@ for (unsigned int j = 0; j < 8; j++) {
 #undef POS_SEARCH_DEBUG_BLOCK2
 #undef POS_SEARCH_DEBUG_BLOCK3
 
+#ifdef __DEBUG_DA_NLIST__
+for (unsigned int k = 0; useHashNlist && (k < 8); k++) {
+  if (nlist[8*i + k] != hashedNlist[k]) {
+    std::cout << m_iRankActive << " hashed search differs for i = " << i << " j = " << k << ": " << hashedNlist[k]
+      << " binary search: " << nlist[8*i + k] << std::endl;
+    assert(false);
+  }
+}
+#endif
 
 // FINISHED Searching for Node Indices ...
 
@@ -29,6 +29,12 @@
 #endif
 #endif
 
+#ifdef PERSISTENT_GHOST_EXCHANGE
+#define DA_PERSISTENT_GHOST_EXCHANGE_DEFAULT true
+#else
+#define DA_PERSISTENT_GHOST_EXCHANGE_DEFAULT false
+#endif
+
 namespace ot {
 
 #define RESET_DA_BLOCK {\
@@ -93,6 +99,12 @@ namespace ot {
   m_mpiContexts.clear();\
   m_bCompressLut = compressLut;\
   m_uiCommTag = 1;\
+  m_bPersistentGhostExchange = DA_PERSISTENT_GHOST_EXCHANGE_DEFAULT;\
+  m_mpiPersistentContexts.clear();\
+  m_vElementLoops.clear();\
+  m_uiNodeBufferIdx.clear();\
+  m_uiGhostedNodeBufferIdx.clear();\
+  m_vBufferPool.clear();\
   m_mpiCommAll = comm;\
   MPI_Comm_size(m_mpiCommAll,&m_iNpesAll);\
   MPI_Comm_rank(m_mpiCommAll,&m_iRankAll);\
@@ -166,11 +178,17 @@ void DA::DA_FactoryPart1(std::vector<ot::TreeNode>& in) {
   assert(par::test::isUniqueAndSorted(in,m_mpiCommActive));
   addBoundaryNodesType1(in, positiveBoundaryOctants, m_uiDimension, m_uiMaxDepth);
 
-  in.insert(in.end(),positiveBoundaryOctants.begin(),positiveBoundaryOctants.end());
   m_uiMaxDepth=m_uiMaxDepth+1;
 
-  std::vector<ot::TreeNode> tmp;
+#ifdef HILBERT_ORDERING
+  //Embedding the octree in the first child of a larger root rotates the
+  //Hilbert curve inside that child, so in must be sorted again. The rotated
+  //order is not a local permutation of the old one, so this is a full
+  //parallel sort on every DA (and every DAMG level) in the Hilbert build.
+  in.insert(in.end(),positiveBoundaryOctants.begin(),positiveBoundaryOctants.end());
+  positiveBoundaryOctants.clear();
 
+  std::vector<ot::TreeNode> tmp;
 
 #ifdef TREE_SORT
   ot::TreeNode root=ot::TreeNode(m_uiDim,m_uiMaxDepth);
@@ -180,9 +198,25 @@ void DA::DA_FactoryPart1(std::vector<ot::TreeNode>& in) {
   std::swap(in,tmp);
   tmp.clear();
 #endif
+#else
+  //In the Morton order the embedded octree is the first child of the new root
+  //and keeps its order, so every positive boundary octant comes after all of
+  //in. Only the (few) positive boundary octants are sorted, on the processors
+  //that have any, and are then appended to in. in keeps its partition.
+  MPI_Comm bdyComm;
+  par::splitComm2way(positiveBoundaryOctants.empty(), &bdyComm, m_mpiCommActive);
 
+  if(!(positiveBoundaryOctants.empty())) {
+    std::vector<ot::TreeNode> tmp;
+    par::sampleSort(positiveBoundaryOctants,tmp,bdyComm);
+    std::swap(positiveBoundaryOctants,tmp);
+    tmp.clear();
+  }
+  MPI_Comm_free(&bdyComm);
 
-
+  par::concatenate<ot::TreeNode>(in, positiveBoundaryOctants, m_mpiCommActive);
+  positiveBoundaryOctants.clear();
+#endif
 
 
   PROF_BUILD_DA_STAGE1_END
@@ -458,34 +492,22 @@ void DA::DA_FactoryPart3(std::vector<ot::TreeNode>& in, MPI_Comm comm, bool comp
 
   // 5. Actual send/recv. to exchange nodes.
   //
-  // 5a.
-  // Now do an All2All to get numKeysRecv
-  par::Mpi_Alltoall<int>( sendCnt, recvCnt, 1, m_mpiCommActive);
-
-  // 5b. Concatenate all nodes into one single Carray ...
+  // 5a. Concatenate all nodes into one single Carray ...
   unsigned int totalSend=0;
-  unsigned int totalRecv=0;
   for (unsigned int i=0; i < m_iNpesActive; i++) {
     totalSend+= sendCnt[i];
-    totalRecv+= recvCnt[i];
   }
 
-  // create the send and recv buffers ...
+  // create the send buffer ...
   std::vector<ot::TreeNode> sendK (totalSend);
-  std::vector<ot::TreeNode> recvK (totalRecv);
+  std::vector<ot::TreeNode> recvK;
 
   // Now create sendK
   sendOffsets[0] = 0;
-  recvOffsets[0] = 0;   
-
-  // compute offsets ...
   for (int i=1; i < m_iNpesActive; i++) {
     sendOffsets[i] = sendOffsets[i-1] + sendCnt[i-1];
-    recvOffsets[i] = recvOffsets[i-1] + recvCnt[i-1];
   }
 
-  int myOff = recvOffsets[m_iRankActive];
-
 #ifdef __DEBUG_DA_PUBLIC__
   assert(sendCnt[m_iRankActive] == 0);
 #endif
@@ -493,6 +515,27 @@ void DA::DA_FactoryPart3(std::vector<ot::TreeNode>& in, MPI_Comm comm, bool comp
   for (int i=0; i < m_iNpesActive; i++) {
     for (unsigned int j=0; j<sendCnt[i]; j++) {
       sendK[sendOffsets[i] + j] = in[sendNodes[i][j]];
+    }
+  }
+
+  // 5b. Send and receive all keys. The boundary octants only go to the
+  // neighbouring processors, so the senders (recvCnt) are discovered by the
+  // sparse exchange instead of an All2All of the counts.
+
+  ot::TreeNode* sendKptr = NULL;
+  if(!sendK.empty()) {
+    sendKptr = &(*(sendK.begin()));
+  }
+
+  par::Mpi_Alltoallv_NBX<ot::TreeNode>( sendKptr, sendCnt, sendOffsets, 
+      recvK, recvCnt, recvOffsets, m_mpiCommActive);
+
+  // 5c. The primary ScatterMap, the local nodes start after the nodes
+  // received from the lower ranks.
+  int myOff = recvOffsets[m_iRankActive];
+
+  for (int i=0; i < m_iNpesActive; i++) {
+    for (unsigned int j=0; j<sendCnt[i]; j++) {
       m_uipScatterMap.push_back(sendNodes[i][j] + myOff);
     }
   }
@@ -505,20 +548,6 @@ void DA::DA_FactoryPart3(std::vector<ot::TreeNode>& in, MPI_Comm comm, bool comp
   MPI_Barrier(m_mpiCommActive);
 #endif
 
-  // 5c. Perform SendRecv to send and receive all keys ...
-
-  ot::TreeNode* sendKptr = NULL;
-  ot::TreeNode* recvKptr = NULL;
-  if(!sendK.empty()) {
-    sendKptr = &(*(sendK.begin()));
-  }
-  if(!recvK.empty()) {
-    recvKptr = &(*(recvK.begin()));
-  }
-
-  par::Mpi_Alltoallv_sparse<ot::TreeNode>( sendKptr, sendCnt, sendOffsets, 
-      recvKptr, recvCnt, recvOffsets, m_mpiCommActive);
-
   sendK.clear();
   for (unsigned int i=0; i < m_iNpesActive; i++) {
     sendNodes[i].clear();
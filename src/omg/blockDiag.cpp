@@ -14,6 +14,7 @@
 #include "omg.h"
 #include "oda.h"
 #include "odaUtils.h" 
+#include "stencilTable.h"
 #include "parUtils.h"
 #include <iostream>
 #include <sfcSort.h>
@@ -82,593 +83,58 @@ namespace ot {
     PROF_MG_INIT_END  
   }
 
-  void DAMG_InitPrivateType3(MPI_Comm comm) {
-
-    int rank;
-    MPI_Comm_rank(comm, &rank);
-
-    IreadRmatType1Stencil(RmatType1Stencil, rank);
-    IreadRmatType2Stencil(RmatType2Stencil, rank);
-    IreadVtxMaps(VtxMap1, VtxMap2, VtxMap3, VtxMap4, rank);
-
-  }
-
-  void DAMG_InitPrivateType2(MPI_Comm comm) {
-
-    int rank, npes;
-    MPI_Comm_rank(comm, &rank);
-    MPI_Comm_size(comm, &npes);
-
-    const int THOUSAND = 1000;
-    int numGroups = (npes/THOUSAND);
-    if( (numGroups*THOUSAND) < npes) {
-      numGroups++;
-    }
-
-    MPI_Comm newComm;
-
-    bool* isEmptyList = new bool[npes];
-    assert(isEmptyList);
-    for(int i = 0; i < numGroups; i++) {
-      for(int j = 0; (j < (i*THOUSAND)) && (j < npes); j++) {
-        isEmptyList[j] = true;
-      }
-      for(int j = (i*THOUSAND); (j < ((i+1)*THOUSAND)) && (j < npes); j++) {
-        isEmptyList[j] = false;
-      }
-      for(int j = ((i + 1)*THOUSAND); j < npes; j++) {
-        isEmptyList[j] = true;
-      }
-      MPI_Comm tmpComm;
-      par::splitComm2way(isEmptyList, &tmpComm, comm);
-      if(!(isEmptyList[rank])) {
-        newComm = tmpComm;
-      }
-    }//end for i
-    delete [] isEmptyList;
+  //The shared windows of the flat stencil tables.
+  static MPI_Win rmatType1StencilWin = MPI_WIN_NULL;
+  static MPI_Win rmatType2StencilWin = MPI_WIN_NULL;
+  static MPI_Win vtxMapsWin = MPI_WIN_NULL;
 
-    if( (rank % THOUSAND) == 0) {
-      IreadRmatType1Stencil(RmatType1Stencil, (rank/THOUSAND));
-      IreadRmatType2Stencil(RmatType2Stencil, (rank/THOUSAND));
-      IreadVtxMaps(VtxMap1, VtxMap2, VtxMap3, VtxMap4, (rank/THOUSAND));
-    } else {
-      //Other processors simply allocate the required amount of memory
-      typedef double**** double4Ptr;
-      typedef double*** double3Ptr;
-      typedef double** double2Ptr;
-      typedef double* doublePtr;
-
-      RmatType1Stencil = new double4Ptr[8];
-      for(int i = 0; i < 8; i++) {
-        RmatType1Stencil[i] = new double3Ptr[8];
-        for(int j = 0; j < 8; j++) {
-          RmatType1Stencil[i][j] = new double2Ptr[18];
-          for(int k = 0; k < 18; k++) {
-            RmatType1Stencil[i][j][k] = new doublePtr[8];
-            for(int l = 0; l < 8; l++) {
-              RmatType1Stencil[i][j][k][l] = new double[8];
-            }//end for l
-          }//end for k
-        }//end for j
-      }//end for i
-
-      RmatType2Stencil  = new double3Ptr[8];
-      for(int j = 0; j < 8; j++) {
-        RmatType2Stencil[j] = new double2Ptr[18];
-        for(int k = 0; k < 18; k++) {
-          RmatType2Stencil[j][k] = new doublePtr[8];
-          for(int l = 0; l < 8; l++) {
-            RmatType2Stencil[j][k][l] = new double[8];
-          }//end for l
-        }//end for k
-      }//end for j
-
-      typedef unsigned short***** us5Ptr;
-      typedef unsigned short**** us4Ptr;
-      typedef unsigned short*** us3Ptr;
-      typedef unsigned short** us2Ptr;
-      typedef unsigned short* usPtr;
-
-      VtxMap1 = new us3Ptr[8];
-      VtxMap2 = new us4Ptr[8];
-      VtxMap3 = new us4Ptr[7];
-      VtxMap4 = new us5Ptr[7];
-      for(int i = 0; i < 8; i++) {
-        VtxMap1[i] = new us2Ptr[8];
-        VtxMap2[i] = new us3Ptr[8];
-        for(int j = 0; j < 8; j++) {
-          VtxMap1[i][j] = new usPtr[18];
-          VtxMap2[i][j] = new us2Ptr[8];
-          for(int k = 0; k < 18; k++) {
-            VtxMap1[i][j][k] = new unsigned short[8];
-          }
-          for(int k = 0; k < 8; k++) {
-            VtxMap2[i][j][k] = new usPtr[18];
-            for(int l = 0; l < 18; l++) {
-              VtxMap2[i][j][k][l] = new unsigned short[8];
-            }//end for l
-          }//end for k
-        }//end for j
-      }//end for i
-
-      for(int i = 0; i < 7; i++) {
-        VtxMap3[i] = new us3Ptr[2];
-        VtxMap4[i] = new us4Ptr[2];
-        for(int j = 0; j < 2; j++) {
-          VtxMap3[i][j] = new us2Ptr[8];
-          VtxMap4[i][j] = new us3Ptr[8]; 
-          for(int k = 0; k < 8; k++) {
-            VtxMap3[i][j][k] = new usPtr[18];
-            VtxMap4[i][j][k] = new us2Ptr[8];
-            for(int l = 0; l < 18; l++) {
-              VtxMap3[i][j][k][l] =new unsigned short[8];
-            }
-            for(int l = 0; l < 8; l++) {
-              VtxMap4[i][j][k][l] = new usPtr[18];
-              for(int m = 0; m < 18; m++) {
-                VtxMap4[i][j][k][l][m] = new unsigned short[8];
-              }
-            }//end for l
-          }//end for k
-        }//end for j
-      }//end for i
-
-    }//end if processor reads
-
-    //Processor 0 in each comm  Broadcasts to other processors in the comm
-    //doubles ...
+  //Creates the restriction stencils and the vertex maps, stored once per node. The leaders of the nodes with
+  //the same fileId read the files <name>_<fileId> (<name> if fileId < 0) once and share them (see
+  //createStencilTable).
+  static void DAMG_InitPrivate(MPI_Comm comm, int fileId) {
     //RmatType1[8][8][18][8][8]: 73728
-    //RmatType2[8][18][8][8]: 9216
-    double * tmpRmats = new double [82944];
-    assert(tmpRmats);
-
-    if((rank % THOUSAND) == 0) {
-      unsigned int ctr = 0;
-      for(int i = 0; i < 8; i++) {
-        for(int j = 0; j < 8; j++) {
-          for(int k = 0; k < 18; k++) {
-            for(int l = 0; l < 8; l++) {
-              for(int m = 0; m < 8; m++) {
-                tmpRmats[ctr] = RmatType1Stencil[i][j][k][l][m];
-                ctr++;
-              }//end for m
-            }//end for l
-          }//end for k
-        }//end for j
-      }//end for i
-      for(int j = 0; j < 8; j++) {
-        for(int k = 0; k < 18; k++) {
-          for(int l = 0; l < 8; l++) {
-            for(int m = 0; m < 8; m++) {
-              tmpRmats[ctr] = RmatType2Stencil[j][k][l][m];
-              ctr++;
-            }//end for m
-          }//end for l
-        }//end for k
-      }//end for j
-    }
+    const unsigned int rmat1Dims[4] = {8, 18, 8, 8};
+    double* rmat1 = createStencilTable<double>(comm, "RmatType1Stencils", fileId, 73728, &rmatType1StencilWin);
+    RmatType1Stencil = TableView<double, 5>::create(rmat1, rmat1Dims, 8);
 
-    par::Mpi_Bcast<double>(tmpRmats, 82944, 0, newComm);
-
-    if((rank % THOUSAND) != 0) {
-      unsigned int ctr = 0;
-      for(int i = 0; i < 8; i++) {
-        for(int j = 0; j < 8; j++) {
-          for(int k = 0; k < 18; k++) {
-            for(int l = 0; l < 8; l++) {
-              for(int m = 0; m < 8; m++) {
-                RmatType1Stencil[i][j][k][l][m] = tmpRmats[ctr];
-                ctr++;
-              }//end for m
-            }//end for l
-          }//end for k
-        }//end for j
-      }//end for i
-      for(int j = 0; j < 8; j++) {
-        for(int k = 0; k < 18; k++) {
-          for(int l = 0; l < 8; l++) {
-            for(int m = 0; m < 8; m++) {
-              RmatType2Stencil[j][k][l][m] = tmpRmats[ctr];
-              ctr++;
-            }//end for m
-          }//end for l
-        }//end for k
-      }//end for j
-    }
-
-    delete [] tmpRmats;
+    //RmatType2[8][18][8][8]: 9216
+    const unsigned int rmat2Dims[3] = {18, 8, 8};
+    double* rmat2 = createStencilTable<double>(comm, "RmatType2Stencils", fileId, 9216, &rmatType2StencilWin);
+    RmatType2Stencil = TableView<double, 4>::create(rmat2, rmat2Dims, 8);
 
-    //unsigned shorts...
     //map1[8][8][18][8]: 9216
     //map2[8][8][8][18][8]: 73728
     //map3[7][2][8][18][8]: 16128
     //map4[7][2][8][8][18][8]: 129024
-    unsigned short * tmpVtxMaps = new unsigned short[228096];
-    assert(tmpVtxMaps);
-
-    if((rank % THOUSAND) == 0) {
-      unsigned int ctr = 0;
-      for(int i = 0; i < 8; i++) {
-        for(int j = 0; j < 8; j++) {
-          for(int k = 0; k < 18; k++) {
-            for(int l = 0; l < 8; l++) {
-              tmpVtxMaps[ctr] = VtxMap1[i][j][k][l]; 
-              ctr++;
-            }//end for l
-          }//end for k
-        }//end for j
-      }//end for i
-      for(int i = 0; i < 8; i++) {
-        for(int j = 0; j < 8; j++) {
-          for(int k = 0; k < 8; k++) {
-            for(int l = 0; l < 18; l++) {
-              for(int m = 0; m < 8; m++) {
-                tmpVtxMaps[ctr] = VtxMap2[i][j][k][l][m]; 
-                ctr++;
-              }//end for m
-            }//end for l
-          }//end for k
-        }//end for j
-      }//end for i
-      for(int i = 0; i < 7; i++) {
-        for(int j = 0; j < 2; j++) {
-          for(int k = 0; k < 8; k++) {
-            for(int l = 0; l < 18; l++) {
-              for(int m = 0; m < 8; m++) {
-                tmpVtxMaps[ctr] = VtxMap3[i][j][k][l][m]; 
-                ctr++;
-              }//end for m
-            }//end for l
-          }//end for k
-        }//end for j
-      }//end for i
-      for(int i = 0; i < 7; i++) {
-        for(int j = 0; j < 2; j++) {
-          for(int k = 0; k < 8; k++) {
-            for(int l = 0; l < 8; l++) {
-              for(int m = 0; m < 18; m++) {
-                for(int n = 0; n < 8; n++) {
-                  tmpVtxMaps[ctr] = VtxMap4[i][j][k][l][m][n]; 
-                  ctr++;
-                }//end for n
-              }//end for m
-            }//end for l
-          }//end for k
-        }//end for j
-      }//end for i
-    }
-
-    par::Mpi_Bcast<unsigned short>(tmpVtxMaps, 228096, 0, newComm);
-
-    if((rank % THOUSAND) != 0) {
-      unsigned int ctr = 0;
-      for(int i = 0; i < 8; i++) {
-        for(int j = 0; j < 8; j++) {
-          for(int k = 0; k < 18; k++) {
-            for(int l = 0; l < 8; l++) {
-              VtxMap1[i][j][k][l] = tmpVtxMaps[ctr]; 
-              ctr++;
-            }//end for l
-          }//end for k
-        }//end for j
-      }//end for i
-      for(int i = 0; i < 8; i++) {
-        for(int j = 0; j < 8; j++) {
-          for(int k = 0; k < 8; k++) {
-            for(int l = 0; l < 18; l++) {
-              for(int m = 0; m < 8; m++) {
-                VtxMap2[i][j][k][l][m] = tmpVtxMaps[ctr]; 
-                ctr++;
-              }//end for m
-            }//end for l
-          }//end for k
-        }//end for j
-      }//end for i
-      for(int i = 0; i < 7; i++) {
-        for(int j = 0; j < 2; j++) {
-          for(int k = 0; k < 8; k++) {
-            for(int l = 0; l < 18; l++) {
-              for(int m = 0; m < 8; m++) {
-                VtxMap3[i][j][k][l][m] = tmpVtxMaps[ctr]; 
-                ctr++;
-              }//end for m
-            }//end for l
-          }//end for k
-        }//end for j
-      }//end for i
-      for(int i = 0; i < 7; i++) {
-        for(int j = 0; j < 2; j++) {
-          for(int k = 0; k < 8; k++) {
-            for(int l = 0; l < 8; l++) {
-              for(int m = 0; m < 18; m++) {
-                for(int n = 0; n < 8; n++) {
-                  VtxMap4[i][j][k][l][m][n] = tmpVtxMaps[ctr]; 
-                  ctr++;
-                }//end for n
-              }//end for m
-            }//end for l
-          }//end for k
-        }//end for j
-      }//end for i
-    }
-
-    delete [] tmpVtxMaps;
-
+    unsigned short* maps = createStencilTable<unsigned short>(comm, "vtxMap", fileId, 228096, &vtxMapsWin,
+        readVtxMapsText);
+    const unsigned int map1Dims[3] = {8, 18, 8};
+    const unsigned int map2Dims[4] = {8, 8, 18, 8};
+    const unsigned int map3Dims[4] = {2, 8, 18, 8};
+    const unsigned int map4Dims[5] = {2, 8, 8, 18, 8};
+    VtxMap1 = TableView<unsigned short, 4>::create(maps, map1Dims, 8);
+    VtxMap2 = TableView<unsigned short, 5>::create(maps + 9216, map2Dims, 8);
+    VtxMap3 = TableView<unsigned short, 5>::create(maps + 82944, map3Dims, 7);
+    VtxMap4 = TableView<unsigned short, 6>::create(maps + 99072, map4Dims, 7);
   }
 
-  void DAMG_InitPrivateType1(MPI_Comm comm) {
-
+  void DAMG_InitPrivateType3(MPI_Comm comm) {
+    //Every node reads the files of the rank of its first processor.
     int rank;
     MPI_Comm_rank(comm, &rank);
+    DAMG_InitPrivate(comm, rank);
+  }
 
-    if(!rank) {
-      //Processor 0 reads the stencils
-      readRmatType1Stencil(RmatType1Stencil);
-      readRmatType2Stencil(RmatType2Stencil);
-      readVtxMaps(VtxMap1, VtxMap2, VtxMap3, VtxMap4);
-    } else {
-      //Other processors simply allocate the required amount of memory
-      typedef double**** double4Ptr;
-      typedef double*** double3Ptr;
-      typedef double** double2Ptr;
-      typedef double* doublePtr;
-
-      RmatType1Stencil = new double4Ptr[8];
-      for(int i = 0; i < 8; i++) {
-        RmatType1Stencil[i] = new double3Ptr[8];
-        for(int j = 0; j < 8; j++) {
-          RmatType1Stencil[i][j] = new double2Ptr[18];
-          for(int k = 0; k < 18; k++) {
-            RmatType1Stencil[i][j][k] = new doublePtr[8];
-            for(int l = 0; l < 8; l++) {
-              RmatType1Stencil[i][j][k][l] = new double[8];
-            }
-          }
-        }
-      }
-
-      RmatType2Stencil  = new double3Ptr[8];
-      for(int j = 0; j < 8; j++) {
-        RmatType2Stencil[j] = new double2Ptr[18];
-        for(int k = 0; k < 18; k++) {
-          RmatType2Stencil[j][k] = new doublePtr[8];
-          for(int l = 0; l < 8; l++) {
-            RmatType2Stencil[j][k][l] = new double[8];
-          }
-        }
-      }
-
-      typedef unsigned short***** us5Ptr;
-      typedef unsigned short**** us4Ptr;
-      typedef unsigned short*** us3Ptr;
-      typedef unsigned short** us2Ptr;
-      typedef unsigned short* usPtr;
-
-      VtxMap1 = new us3Ptr[8];
-      VtxMap2 = new us4Ptr[8];
-      VtxMap3 = new us4Ptr[7];
-      VtxMap4 = new us5Ptr[7];
-      for(int i = 0; i < 8; i++) {
-        VtxMap1[i] = new us2Ptr[8];
-        VtxMap2[i] = new us3Ptr[8];
-        for(int j = 0; j < 8; j++) {
-          VtxMap1[i][j] = new usPtr[18];
-          VtxMap2[i][j] = new us2Ptr[8];
-          for(int k = 0; k < 18; k++) {
-            VtxMap1[i][j][k] = new unsigned short[8];
-          }
-          for(int k = 0; k < 8; k++) {
-            VtxMap2[i][j][k] = new usPtr[18];
-            for(int l = 0; l < 18; l++) {
-              VtxMap2[i][j][k][l] = new unsigned short[8];
-            }
-          }
-        }
-      }//end for i
-
-      for(int i = 0; i < 7; i++) {
-        VtxMap3[i] = new us3Ptr[2];
-        VtxMap4[i] = new us4Ptr[2];
-        for(int j = 0; j < 2; j++) {
-          VtxMap3[i][j] = new us2Ptr[8];
-          VtxMap4[i][j] = new us3Ptr[8]; 
-          for(int k = 0; k < 8; k++) {
-            VtxMap3[i][j][k] = new usPtr[18];
-            VtxMap4[i][j][k] = new us2Ptr[8];
-            for(int l = 0; l < 18; l++) {
-              VtxMap3[i][j][k][l] =new unsigned short[8];
-            }
-            for(int l = 0; l < 8; l++) {
-              VtxMap4[i][j][k][l] = new usPtr[18];
-              for(int m = 0; m < 18; m++) {
-                VtxMap4[i][j][k][l][m] = new unsigned short[8];
-              }
-            }
-          }
-        }
-      }//end for i
-
-    }//end if p0
-
-    //Processor 0 Broadcasts to other processors
-    //doubles ...
-    //RmatType1[8][8][18][8][8]: 73728
-    //RmatType2[8][18][8][8]: 9216
-    double * tmpRmats = new double [82944];
-    assert(tmpRmats);
-
-    if(!rank) {
-      unsigned int ctr = 0;
-      for(int i = 0; i < 8; i++) {
-        for(int j = 0; j < 8; j++) {
-          for(int k = 0; k < 18; k++) {
-            for(int l = 0; l < 8; l++) {
-              for(int m = 0; m < 8; m++) {
-                tmpRmats[ctr] = RmatType1Stencil[i][j][k][l][m];
-                ctr++;
-              }//end for m
-            }//end for l
-          }//end for k
-        }//end for j
-      }//end for i
-      for(int j = 0; j < 8; j++) {
-        for(int k = 0; k < 18; k++) {
-          for(int l = 0; l < 8; l++) {
-            for(int m = 0; m < 8; m++) {
-              tmpRmats[ctr] = RmatType2Stencil[j][k][l][m];
-              ctr++;
-            }//end for m
-          }//end for l
-        }//end for k
-      }//end for j
-    }
-
-    par::Mpi_Bcast<double>(tmpRmats, 82944, 0, comm);
-
-    if(rank) {
-      unsigned int ctr = 0;
-      for(int i = 0; i < 8; i++) {
-        for(int j = 0; j < 8; j++) {
-          for(int k = 0; k < 18; k++) {
-            for(int l = 0; l < 8; l++) {
-              for(int m = 0; m < 8; m++) {
-                RmatType1Stencil[i][j][k][l][m] = tmpRmats[ctr];
-                ctr++;
-              }//end for m
-            }//end for l
-          }//end for k
-        }//end for j
-      }//end for i
-      for(int j = 0; j < 8; j++) {
-        for(int k = 0; k < 18; k++) {
-          for(int l = 0; l < 8; l++) {
-            for(int m = 0; m < 8; m++) {
-              RmatType2Stencil[j][k][l][m] = tmpRmats[ctr];
-              ctr++;
-            }//end for m
-          }//end for l
-        }//end for k
-      }//end for j
-    }
-
-    delete [] tmpRmats;
-
-    //unsigned shorts...
-    //map1[8][8][18][8]: 9216
-    //map2[8][8][8][18][8]: 73728
-    //map3[7][2][8][18][8]: 16128
-    //map4[7][2][8][8][18][8]: 129024
-    unsigned short * tmpVtxMaps = new unsigned short[228096];
-    assert(tmpVtxMaps);
-
-    if(!rank) {
-      unsigned int ctr = 0;
-      for(int i = 0; i < 8; i++) {
-        for(int j = 0; j < 8; j++) {
-          for(int k = 0; k < 18; k++) {
-            for(int l = 0; l < 8; l++) {
-              tmpVtxMaps[ctr] = VtxMap1[i][j][k][l]; 
-              ctr++;
-            }//end for l
-          }//end for k
-        }//end for j
-      }//end for i
-      for(int i = 0; i < 8; i++) {
-        for(int j = 0; j < 8; j++) {
-          for(int k = 0; k < 8; k++) {
-            for(int l = 0; l < 18; l++) {
-              for(int m = 0; m < 8; m++) {
-                tmpVtxMaps[ctr] = VtxMap2[i][j][k][l][m]; 
-                ctr++;
-              }//end for m
-            }//end for l
-          }//end for k
-        }//end for j
-      }//end for i
-      for(int i = 0; i < 7; i++) {
-        for(int j = 0; j < 2; j++) {
-          for(int k = 0; k < 8; k++) {
-            for(int l = 0; l < 18; l++) {
-              for(int m = 0; m < 8; m++) {
-                tmpVtxMaps[ctr] = VtxMap3[i][j][k][l][m]; 
-                ctr++;
-              }//end for m
-            }//end for l
-          }//end for k
-        }//end for j
-      }//end for i
-      for(int i = 0; i < 7; i++) {
-        for(int j = 0; j < 2; j++) {
-          for(int k = 0; k < 8; k++) {
-            for(int l = 0; l < 8; l++) {
-              for(int m = 0; m < 18; m++) {
-                for(int n = 0; n < 8; n++) {
-                  tmpVtxMaps[ctr] = VtxMap4[i][j][k][l][m][n]; 
-                  ctr++;
-                }//end for n
-              }//end for m
-            }//end for l
-          }//end for k
-        }//end for j
-      }//end for i
-    }
-
-    par::Mpi_Bcast<unsigned short>(tmpVtxMaps, 228096, 0, comm);
-
-    if(rank) {
-      unsigned int ctr = 0;
-      for(int i = 0; i < 8; i++) {
-        for(int j = 0; j < 8; j++) {
-          for(int k = 0; k < 18; k++) {
-            for(int l = 0; l < 8; l++) {
-              VtxMap1[i][j][k][l] = tmpVtxMaps[ctr]; 
-              ctr++;
-            }//end for l
-          }//end for k
-        }//end for j
-      }//end for i
-      for(int i = 0; i < 8; i++) {
-        for(int j = 0; j < 8; j++) {
-          for(int k = 0; k < 8; k++) {
-            for(int l = 0; l < 18; l++) {
-              for(int m = 0; m < 8; m++) {
-                VtxMap2[i][j][k][l][m] = tmpVtxMaps[ctr]; 
-                ctr++;
-              }//end for m
-            }//end for l
-          }//end for k
-        }//end for j
-      }//end for i
-      for(int i = 0; i < 7; i++) {
-        for(int j = 0; j < 2; j++) {
-          for(int k = 0; k < 8; k++) {
-            for(int l = 0; l < 18; l++) {
-              for(int m = 0; m < 8; m++) {
-                VtxMap3[i][j][k][l][m] = tmpVtxMaps[ctr]; 
-                ctr++;
-              }//end for m
-            }//end for l
-          }//end for k
-        }//end for j
-      }//end for i
-      for(int i = 0; i < 7; i++) {
-        for(int j = 0; j < 2; j++) {
-          for(int k = 0; k < 8; k++) {
-            for(int l = 0; l < 8; l++) {
-              for(int m = 0; m < 18; m++) {
-                for(int n = 0; n < 8; n++) {
-                  VtxMap4[i][j][k][l][m][n] = tmpVtxMaps[ctr]; 
-                  ctr++;
-                }//end for n
-              }//end for m
-            }//end for l
-          }//end for k
-        }//end for j
-      }//end for i
-    }
-
-    delete [] tmpVtxMaps;
+  void DAMG_InitPrivateType2(MPI_Comm comm) {
+    //The nodes are grouped by the rank of their first processor / 1000, each group reads its own files.
+    int rank;
+    MPI_Comm_rank(comm, &rank);
+    DAMG_InitPrivate(comm, (rank/1000));
+  }
 
+  void DAMG_InitPrivateType1(MPI_Comm comm) {
+    //Processor 0 reads the stencils and broadcasts them to the other nodes.
+    DAMG_InitPrivate(comm, -1);
   }
 
   PetscErrorCode DAMG_Finalize() {
@@ -676,9 +142,15 @@ namespace ot {
 
       ot::DA_Finalize();
 
-    destroyRmatType1Stencil(RmatType1Stencil);
-    destroyRmatType2Stencil(RmatType2Stencil);
-    destroyVtxMaps(VtxMap1, VtxMap2, VtxMap3, VtxMap4);
+    TableView<double, 5>::destroy(RmatType1Stencil);
+    TableView<double, 4>::destroy(RmatType2Stencil);
+    TableView<unsigned short, 4>::destroy(VtxMap1);
+    TableView<unsigned short, 5>::destroy(VtxMap2);
+    TableView<unsigned short, 5>::destroy(VtxMap3);
+    TableView<unsigned short, 6>::destroy(VtxMap4);
+    destroyStencilTable(&rmatType1StencilWin);
+    destroyStencilTable(&rmatType2StencilWin);
+    destroyStencilTable(&vtxMapsWin);
 
     PROF_MG_FINAL_END  
   }
@@ -896,6 +368,11 @@ namespace ot {
             pcShellContext->sol_private = NULL;
             pcShellContext->rhs_private = NULL;
             pcShellContext->ksp_private = NULL;
+            pcShellContext->gathered = false;
+            pcShellContext->amat_gathered = NULL;
+            pcShellContext->pmat_gathered = NULL;
+            pcShellContext->gatherSz = NULL;
+            pcShellContext->gatherOff = NULL;
             pcShellContext->pc = pc;
             pcShellContext->iAmActive = damg[0]->da->iAmActive();
             pcShellContext->commActive = damg[0]->da->getCommActive();
@@ -984,6 +461,11 @@ namespace ot {
             pcShellContext->sol_private = NULL;
             pcShellContext->rhs_private = NULL;
             pcShellContext->ksp_private = NULL;
+            pcShellContext->gathered = false;
+            pcShellContext->amat_gathered = NULL;
+            pcShellContext->pmat_gathered = NULL;
+            pcShellContext->gatherSz = NULL;
+            pcShellContext->gatherOff = NULL;
             pcShellContext->pc = pc;
             pcShellContext->iAmActive = damg[0]->da->iAmActive();
             pcShellContext->commActive = damg[0]->da->getCommActive();
@@ -1306,6 +788,38 @@ namespace ot {
     PetscFunctionReturn(0);
   }//end fn.
 
+  /**
+    @author Milinda Fernando
+    @brief Prints the per level setup cost of DAMGCreateAndSetDA on processor 0: the time (max over comm) and the
+    bytes sent to other processors (sum over comm) of building the octree (partition for the finest level,
+    coarsening and balancing for the others) and of meshing it (the DA and the aux DA if any). Level 0 is the finest.
+    Collective on comm.
+    */
+  static void printDAMGSetupStats(MPI_Comm comm, int nlevels, const double* octTime, const DendroIntL* octBytes,
+      const double* meshTime, const DendroIntL* meshBytes) {
+    int rank;
+    MPI_Comm_rank(comm, &rank);
+
+    std::vector<double> localTime(2*nlevels), globalTime(2*nlevels);
+    std::vector<DendroIntL> localBytes(2*nlevels), globalBytes(2*nlevels);
+    for(int lev = 0; lev < nlevels; lev++) {
+      localTime[2*lev] = octTime[lev];
+      localTime[2*lev + 1] = meshTime[lev];
+      localBytes[2*lev] = octBytes[lev];
+      localBytes[2*lev + 1] = meshBytes[lev];
+    }
+    par::Mpi_Reduce<double>(&(*(localTime.begin())), &(*(globalTime.begin())), 2*nlevels, MPI_MAX, 0, comm);
+    par::Mpi_Reduce<DendroIntL>(&(*(localBytes.begin())), &(*(globalBytes.begin())), 2*nlevels, MPI_SUM, 0, comm);
+
+    if(!rank) {
+      for(int lev = 0; lev < nlevels; lev++) {
+        std::cout<<" lev "<<lev<<" octree (s): "<<globalTime[2*lev]<<" bytes: "<<globalBytes[2*lev]
+          <<" mesh (s): "<<globalTime[2*lev + 1]<<" bytes: "<<globalBytes[2*lev + 1]<<std::endl;
+      }
+      fflush(stdout);
+    }
+  }
+
   //level = 0 is the coarsest, level = (nlevels-1) is the finest.
   //nlevels for each level is the number of levels finer than this level.
   //New implementation. Written on April 24, 2008
@@ -1323,6 +837,14 @@ namespace ot {
     MPI_Comm_rank(comm, &rank);
     MPI_Comm_size(comm, &npes);
 
+#ifdef HILBERT_ORDERING
+    //The intergrid transfers (restrictMatVecType*, prolongMatVecType*) walk the coarse and the fine DA in Morton
+    //order. A single level has no transfers.
+    if(nlevels > 1) {
+      SETERRQ(comm, PETSC_ERR_SUP, "DAMGCreateAndSetDA: the multigrid transfers do not support HILBERT_ORDERING, use nlevels = 1 or a Morton build.");
+    }
+#endif
+
 #ifndef __SILENT_MODE__
     if(!rank) {
       std::cout<<"MG-Load Fac: "<<loadFac<<std::endl;
@@ -1330,9 +852,18 @@ namespace ot {
     }
 #endif
 
+    //The setup cost of each level, 0 is the finest. See printDAMGSetupStats.
+    assert(nlevels > 0);
+    std::vector<double> octTime(nlevels, 0.0), meshTime(nlevels, 0.0);
+    std::vector<DendroIntL> octBytes(nlevels, 0), meshBytes(nlevels, 0);
+    double setupTime = MPI_Wtime();
+    DendroIntL setupBytes = par::commBytesSent;
+
     par::partitionW<ot::TreeNode>(finestOctree, NULL, comm);
 
-    assert(nlevels > 0);
+    octTime[0] = (MPI_Wtime() - setupTime);
+    octBytes[0] = (par::commBytesSent - setupBytes);
+
     if(finestOctree.empty()) {
       std::cout<<"Processor "<<rank<<
         " called DAMGCreateAndSetDA with an empty finest octree."<<std::endl;
@@ -1383,6 +914,8 @@ namespace ot {
       bool repeatLoop = true;
       while( (idxOfCoarsestLev < (nlevels-2)) && (repeatLoop) ) {
         std::vector<ot::TreeNode> tmpOctree;      
+        setupTime = MPI_Wtime();
+        setupBytes = par::commBytesSent;
         //First coarsen
         if (idxOfCoarsestLev == -1) {
           //We can skip Partition for the first call to coarsen since
@@ -1407,6 +940,9 @@ namespace ot {
         }
         tmpOctree.clear();
 
+        octTime[idxOfCoarsestLev + 1] = (MPI_Wtime() - setupTime);
+        octBytes[idxOfCoarsestLev + 1] = (par::commBytesSent - setupBytes);
+
         //All active processors for this level will have the correct comm set
         //and that's all we care. We do not care about the comms for inactive
         //processors
@@ -1564,10 +1100,24 @@ namespace ot {
     int *maxProcsForThisLevel = new int [nlevels];
     assert(maxProcsForThisLevel);
 
+    //A level with less than minGrainSize octants per processor is agglomerated
+    //on fewer processors, so its mat-vecs and reductions only involve those. If
+    //the coarsest level is not on all processors, it is solved on its active
+    //processors alone using PC_KSP_Shell (see DAMGSetKSP), which gathers it on
+    //the first active processor for the default private direct (LU) solve. Its
+    //communication is then bounded by the coarsest octree / minGrainSize
+    //processors, whatever the size of comm.
+    PetscInt minGrainSize = 1000;
+    PetscBool minGrainSizeFound;
+    ierr = PetscOptionsGetInt(NULL, PETSC_NULL, "-damg_minGrainSize", &minGrainSize,
+        &minGrainSizeFound); CHKERRQ(ierr);
+    if(minGrainSize < 1) {
+      minGrainSize = 1;
+    }
+
     for(int i = 0; i < nlevels; i++) {
-      const DendroIntL THOUSAND = 1000;
-      if(globalOctreeSizeForThisLevel[i] < (THOUSAND*npes)) {
-        int maxProcsToUse = (globalOctreeSizeForThisLevel[i]/THOUSAND);
+      if(globalOctreeSizeForThisLevel[i] < (static_cast<DendroIntL>(minGrainSize)*npes)) {
+        int maxProcsToUse = (globalOctreeSizeForThisLevel[i]/minGrainSize);
         if(maxProcsToUse == 0) {
           maxProcsToUse = 1;
         }
@@ -1871,11 +1421,15 @@ namespace ot {
       if(nlevels == 1) {
         //Single level only
 
+        setupTime = MPI_Wtime();
+        setupBytes = par::commBytesSent;
 #ifndef __USE_PVT_DA_IN_MG__
-        tmpDAMG[0]->da = new DA(finestOctree, comm, activeComms[0], compressLut, NULL, NULL);
+        tmpDAMG[0]->da = new DA(finestOctree, comm, activeComms[0], TOLLERANCE_OCT, compressLut, NULL, NULL);
 #else
         tmpDAMG[0]->da = new DA(1, finestOctree, comm, activeComms[0], compressLut, NULL, NULL);
 #endif
+        meshTime[0] = (MPI_Wtime() - setupTime);
+        meshBytes[0] = (par::commBytesSent - setupBytes);
 
         if(!rank) {
           int activeNpes = tmpDAMG[0]->da->getNpesActive();
@@ -1907,6 +1461,11 @@ namespace ot {
           coarserOctrees = NULL;
         }
 
+#ifndef __SILENT_MODE__
+        printDAMGSetupStats(comm, nlevels, &(*(octTime.begin())), &(*(octBytes.begin())),
+            &(*(meshTime.begin())), &(*(meshBytes.begin())));
+#endif
+
         PROF_SET_DA_STAGE6_END
 
           ierr = DAMGSetUp(tmpDAMG);CHKERRQ(ierr); 
@@ -1928,15 +1487,19 @@ namespace ot {
 #endif
 
       if(newDa == NULL) {
+        setupTime = MPI_Wtime();
+        setupBytes = par::commBytesSent;
 #ifndef __USE_PVT_DA_IN_MG__
         newDa = new DA(coarserOctrees[idxOfCoarsestLev], comm, 
-            activeComms[idxOfCoarsestLev + 1], compressLut,
+            activeComms[idxOfCoarsestLev + 1], TOLLERANCE_OCT, compressLut,
             blocksPtr, NULL);
 #else
         newDa = new DA(1, coarserOctrees[idxOfCoarsestLev], comm, 
             activeComms[idxOfCoarsestLev + 1], compressLut,
             blocksPtr, NULL);
 #endif
+        meshTime[idxOfCoarsestLev + 1] += (MPI_Wtime() - setupTime);
+        meshBytes[idxOfCoarsestLev + 1] += (par::commBytesSent - setupBytes);
       }
 
       //The constructor will modify the input octree. So it's useless
@@ -2062,11 +1625,15 @@ namespace ot {
 #endif
 
         //This DA is aligned with the coarser grid
+        setupTime = MPI_Wtime();
+        setupBytes = par::commBytesSent;
 #ifndef __USE_PVT_DA_IN_MG__
-        newDa = new DA(fineOctAfterPart, comm, newComm, compressLut, blocksPtr, NULL);
+        newDa = new DA(fineOctAfterPart, comm, newComm, TOLLERANCE_OCT, compressLut, blocksPtr, NULL);
 #else
         newDa = new DA(1, fineOctAfterPart, comm, newComm, compressLut, blocksPtr, NULL);
 #endif
+        meshTime[idxOfCoarsestLev] += (MPI_Wtime() - setupTime);
+        meshBytes[idxOfCoarsestLev] += (par::commBytesSent - setupBytes);
 
         fineOctAfterPart.clear();
 
@@ -2142,11 +1709,15 @@ namespace ot {
 
     //mesh finest level here
     if(newDa == NULL) {
+      setupTime = MPI_Wtime();
+      setupBytes = par::commBytesSent;
 #ifndef __USE_PVT_DA_IN_MG__
-      newDa = new DA(finestOctree, comm, activeComms[0], compressLut, blocksPtr, NULL);
+      newDa = new DA(finestOctree, comm, activeComms[0], TOLLERANCE_OCT, compressLut, blocksPtr, NULL);
 #else
       newDa = new DA(1, finestOctree, comm, activeComms[0], compressLut, blocksPtr, NULL);
 #endif
+      meshTime[0] += (MPI_Wtime() - setupTime);
+      meshBytes[0] += (par::commBytesSent - setupBytes);
     }
 
 #ifdef __DEBUG_MG__
@@ -2182,6 +1753,11 @@ namespace ot {
       blocksPtr = NULL;
     }
 
+#ifndef __SILENT_MODE__
+    printDAMGSetupStats(comm, nlevels, &(*(octTime.begin())), &(*(octBytes.begin())),
+        &(*(meshTime.begin())), &(*(meshBytes.begin())));
+#endif
+
     PROF_SET_DA_STAGE6_END
 
     ierr = DAMGSetUp(tmpDAMG); CHKERRQ(ierr);
@@ -2281,10 +1857,12 @@ Type2: Use Aux. Coarse and Fine are not aligned.
     data->comm = comm;
     data->dof = dof;
     data->fineTouchedFlags = new std::vector<ot::FineTouchedStatus>;
+    data->fineTouchedFlagsArr = NULL;
 
     data->tmp = NULL;
     data->addRtmp = NULL;
     data->addPtmp = NULL;
+    data->transferLoops = NULL;
 
     data->sendSzP = NULL;
     data->sendOffP = NULL;
@@ -2340,9 +1918,11 @@ Type2: Use Aux. Coarse and Fine are not aligned.
     data->comm = comm;
     data->dof = dof;
     data->fineTouchedFlags = new std::vector<ot::FineTouchedStatus>;
+    data->fineTouchedFlagsArr = NULL;
     daf_aux->createVector(data->tmp, false, false, dof);
     data->addRtmp = NULL;
     data->addPtmp = NULL;
+    data->transferLoops = NULL;
 
     data->sendSzP = NULL;
     data->sendOffP = NULL;
@@ -2380,6 +1960,10 @@ Type2: Use Aux. Coarse and Fine are not aligned.
         delete data->fineTouchedFlags;
         data->fineTouchedFlags = NULL;
       }
+      if(data->fineTouchedFlagsArr) {
+        delete [] data->fineTouchedFlagsArr;
+        data->fineTouchedFlagsArr = NULL;
+      }
       if(data->tmp) { 
         iC(VecDestroy(&(data->tmp)));
         data->tmp = NULL;
@@ -2392,6 +1976,10 @@ Type2: Use Aux. Coarse and Fine are not aligned.
         VecDestroy(&(data->addPtmp));
         data->addPtmp = NULL;
       }
+      if(data->transferLoops) {
+        delete [] data->transferLoops;
+        data->transferLoops = NULL;
+      }
       if(data->sendSzP) {
         delete [] data->sendSzP;
         data->sendSzP = NULL;
@@ -2698,14 +2286,69 @@ Type2: Use Aux. Coarse and Fine are not aligned.
         assert(data->ksp_private == NULL);
         assert(data->rhs_private == NULL);
         assert(data->sol_private == NULL);
-      } else {
+      } else if(!(data->gathered)) {
         assert(data->ksp_private != NULL);
         assert(data->rhs_private != NULL);
         assert(data->sol_private != NULL);
       }
 
+      int npesActive, rankActive;
+      MPI_Comm_size(commActive, &npesActive);
+      MPI_Comm_rank(commActive, &rankActive);
+
       if(pc->setupcalled == 0) {
-        KSPCreate(commActive, &(data->ksp_private));
+        //With several active processors a (distributed) direct solve would still
+        //communicate across all of them, so the whole problem is moved to the
+        //first one.
+        PetscBool gather = PETSC_TRUE;
+        PetscOptionsGetBool(NULL, PETSC_NULL, "-damg_coarseGather", &gather, PETSC_NULL);
+        data->gathered = ( (npesActive > 1) && gather );
+
+        if(data->gathered) {
+          int localSz = static_cast<int>(localRowSize);
+          if(!rankActive) {
+            data->gatherSz = new int[npesActive];
+            data->gatherOff = new int[npesActive];
+          }
+          MPI_Gather(&localSz, 1, MPI_INT, data->gatherSz, 1, MPI_INT, 0, commActive);
+          if(!rankActive) {
+            data->gatherOff[0] = 0;
+            for(int i = 1; i < npesActive; i++) {
+              data->gatherOff[i] = data->gatherOff[i - 1] + data->gatherSz[i - 1];
+            }
+          }
+        }
+      }
+
+      Mat Amat_solve = Amat_private;
+      Mat Pmat_solve = Pmat_private;
+      if(data->gathered) {
+        //The values may have changed, the matrices are gathered again on every set up.
+        if(data->amat_gathered) {
+          MatDestroySubMatrices(1, &(data->amat_gathered));
+        }
+        if(data->pmat_gathered) {
+          MatDestroySubMatrices(1, &(data->pmat_gathered));
+        }
+
+        //All the rows and columns on the first active processor, none on the others.
+        IS isAll;
+        ISCreateStride(PETSC_COMM_SELF, (rankActive ? 0 : globalRowSize), 0, 1, &isAll);
+        MatCreateSubMatrices(Amat_private, 1, &isAll, &isAll, MAT_INITIAL_MATRIX, &(data->amat_gathered));
+        if(Pmat_private != Amat_private) {
+          MatCreateSubMatrices(Pmat_private, 1, &isAll, &isAll, MAT_INITIAL_MATRIX, &(data->pmat_gathered));
+        }
+        ISDestroy(&isAll);
+
+        Amat_solve = data->amat_gathered[0];
+        Pmat_solve = (data->pmat_gathered ? data->pmat_gathered[0] : Amat_solve);
+      }
+
+      //Only the first active processor solves a gathered problem.
+      bool iSolve = ( (!data->gathered) || (!rankActive) );
+
+      if( (pc->setupcalled == 0) && iSolve ) {
+        KSPCreate((data->gathered ? PETSC_COMM_SELF : commActive), &(data->ksp_private));
 
         const char *prefix;
         PCGetOptionsPrefix(pc, &prefix);
@@ -2726,10 +2369,12 @@ Type2: Use Aux. Coarse and Fine are not aligned.
         KSPSetFromOptions(data->ksp_private);  
 
         // MatGetVecs(Amat_private, &(data->sol_private), &(data->rhs_private));
-        MatCreateVecs(Amat_private, &(data->sol_private), &(data->rhs_private));
+        MatCreateVecs(Amat_solve, &(data->sol_private), &(data->rhs_private));
       }
 
-      KSPSetOperators(data->ksp_private, Amat_private, Pmat_private); // , pFlag);
+      if(iSolve) {
+        KSPSetOperators(data->ksp_private, Amat_solve, Pmat_solve); // , pFlag);
+      }
 
     } else {
       data->sol_private = NULL;
@@ -2766,6 +2411,24 @@ Type2: Use Aux. Coarse and Fine are not aligned.
         data->sol_private = NULL;
       }
 
+      if(data->amat_gathered) {
+        MatDestroySubMatrices(1, &(data->amat_gathered));
+      }
+
+      if(data->pmat_gathered) {
+        MatDestroySubMatrices(1, &(data->pmat_gathered));
+      }
+
+      if(data->gatherSz) {
+        delete [] data->gatherSz;
+        data->gatherSz = NULL;
+      }
+
+      if(data->gatherOff) {
+        delete [] data->gatherOff;
+        data->gatherOff = NULL;
+      }
+
       delete data;
       data = NULL;
     }
@@ -2781,7 +2444,40 @@ Type2: Use Aux. Coarse and Fine are not aligned.
     PCShellGetContext(pc, (void**)&data);    
     // --old  PC_KSP_Shell* data = static_cast<PC_KSP_Shell*>(ctx); 
 
-    if(data->iAmActive) {      
+    if(data->iAmActive && data->gathered) {
+      PetscScalar* rhsArray;
+      PetscScalar* solArray;
+      PetscScalar* rhsAll = NULL;
+      PetscScalar* solAll = NULL;
+      PetscInt localSz;
+
+      VecGetLocalSize(rhs, &localSz);
+      VecGetArray(rhs, &rhsArray);
+      VecGetArray(sol, &solArray);
+
+      //gather the rhs, solve on the first active processor and scatter the
+      //solution back ...
+      if(data->ksp_private) {
+        VecGetArray(data->rhs_private, &rhsAll);
+      }
+      MPI_Gatherv(rhsArray, static_cast<int>(localSz), par::Mpi_datatype<PetscScalar>::value(),
+          rhsAll, data->gatherSz, data->gatherOff, par::Mpi_datatype<PetscScalar>::value(),
+          0, data->commActive);
+      if(data->ksp_private) {
+        VecRestoreArray(data->rhs_private, &rhsAll);
+        KSPSolve(data->ksp_private, data->rhs_private, data->sol_private);
+        VecGetArray(data->sol_private, &solAll);
+      }
+      MPI_Scatterv(solAll, data->gatherSz, data->gatherOff, par::Mpi_datatype<PetscScalar>::value(),
+          solArray, static_cast<int>(localSz), par::Mpi_datatype<PetscScalar>::value(),
+          0, data->commActive);
+      if(data->ksp_private) {
+        VecRestoreArray(data->sol_private, &solAll);
+      }
+
+      VecRestoreArray(rhs, &rhsArray);
+      VecRestoreArray(sol, &solArray);
+    } else if(data->iAmActive) {      
       PetscScalar* rhsArray;
       PetscScalar* solArray;
 
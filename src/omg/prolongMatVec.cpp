@@ -151,6 +151,86 @@ namespace ot {
   }\
 }
 
+#ifdef OMP_MG_TRANSFER
+/**
+  @brief The body of INTERGRID_TRANSFER_LOOP_BLOCK for one position of a TransferLoop. Only the fine nodes of
+  the position are written, so positions in chunks of the same color can be processed concurrently.
+  */
+template <bool suppressed>
+struct ProlongKernel {
+  const ot::TransferLoop & loop;
+  const ot::FineTouchedStatus* fineTouchedFlagsArr;
+  const PetscScalar* carr;
+  PetscScalar* farr;
+  const unsigned char* suppressedDOFc;
+  const unsigned char* suppressedDOFf;
+  const unsigned int dof;
+
+  ProlongKernel(const ot::TransferLoop & l, const ot::FineTouchedStatus* flags, const PetscScalar* c,
+      PetscScalar* f, const unsigned char* sc, const unsigned char* sf, unsigned int d) : loop(l),
+  fineTouchedFlagsArr(flags), carr(c), farr(f), suppressedDOFc(sc), suppressedDOFf(sf), dof(d) { }
+
+  void operator()(unsigned int pos) const {
+    const unsigned int* cIndices = &(loop.coarseNodes[pos << 3]);
+    const unsigned char cNumCoarse = loop.coarseChildNums[pos];
+    const unsigned char ctype = loop.coarseTypes[pos];
+    const unsigned int fBegin = loop.fineOffsets[pos];
+    const unsigned int fEnd = loop.fineOffsets[pos + 1];
+    for(unsigned int f = fBegin; f < fEnd; f++) {
+      //Type-2 if the coarse and fine elements are the same, else type-1 for each of the 8 children.
+      double** rmatPtr = ((fEnd - fBegin) == 1) ? RmatType2Stencil[cNumCoarse][ctype] :
+        RmatType1Stencil[cNumCoarse][f - fBegin][ctype];
+      const unsigned char fhnMask = loop.fineHnMasks[f];
+      const unsigned int* fIndices = &(loop.fineNodes[f << 3]);
+      for(unsigned int fCtr = 0; fCtr < 8; fCtr++) {
+        if(!(fhnMask & (1 << fCtr))) {
+          const unsigned char touched = fineTouchedFlagsArr[fIndices[fCtr]].flags[fCtr];
+          const unsigned int fidx = fIndices[fCtr]*dof;
+          PetscScalar* fout = farr + fidx;
+          for(unsigned int cCtr = 0; cCtr < 8; cCtr++) {
+            if(touched & (1 << cCtr)) {
+              const unsigned int cidx = cIndices[cCtr]*dof;
+              const double Rval = rmatPtr[cCtr][fCtr];
+              const PetscScalar* cin = carr + cidx;
+              if(suppressed) {
+                for(unsigned int l = 0; l < dof; l++) {
+                  if(!( (suppressedDOFc && suppressedDOFc[cidx+l]) ||
+                        (suppressedDOFf && suppressedDOFf[fidx+l]) )) {
+                    fout[l] += (Rval*cin[l]);
+                  }
+                }
+              } else {
+                for(unsigned int l = 0; l < dof; l++) {
+                  fout[l] += (Rval*cin[l]);
+                }
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+};
+
+template <bool suppressed>
+void prolongTransferLoop(const ot::TransferLoop & loop, unsigned int chunkBegin, unsigned int chunkEnd,
+    const ot::FineTouchedStatus* fineTouchedFlagsArr, const PetscScalar* carr, PetscScalar* farr,
+    const unsigned char* suppressedDOFc, const unsigned char* suppressedDOFf, unsigned int dof) {
+  loop.apply(chunkBegin, chunkEnd, ProlongKernel<suppressed>(loop, fineTouchedFlagsArr, carr, farr,
+        suppressedDOFc, suppressedDOFf, dof));
+}
+
+#define PROLONG_TRANSFER_LOOP(loop, chunkBegin, chunkEnd) {\
+  if(suppressedDOFc || suppressedDOFf) {\
+    prolongTransferLoop<true>(loop, chunkBegin, chunkEnd, fineTouchedFlagsArr, carr, farr,\
+        suppressedDOFc, suppressedDOFf, dof);\
+  } else {\
+    prolongTransferLoop<false>(loop, chunkBegin, chunkEnd, fineTouchedFlagsArr, carr, farr,\
+        suppressedDOFc, suppressedDOFf, dof);\
+  }\
+}
+#endif
+
 PetscErrorCode prolongMatVecType1(Mat R, Vec c, Vec f) {
 
   PROF_MG_PROLONG_BEGIN 
@@ -183,21 +263,15 @@ PetscErrorCode prolongMatVecType1(Mat R, Vec c, Vec f) {
   PetscScalar *farr = NULL;
   PetscScalar *carr = NULL;
 
-  std::vector<ot::FineTouchedStatus >* fineTouchedFlags = data->fineTouchedFlags;
-  ot::FineTouchedStatus* fineTouchedFlagsArr;
+  //Ghosted and synchronized by dummyRestrictMatVecType1
+  ot::FineTouchedStatus* fineTouchedFlagsArr = data->fineTouchedFlagsArr;
 
   dac->vecGetBuffer(c, carr, false, false, true, dof);//Read-only
-  daf->vecGetBuffer<ot::FineTouchedStatus >(*fineTouchedFlags,
-      fineTouchedFlagsArr, false, false, true, 1);//read-only 
 
   if(dac->iAmActive()) {
     dac->ReadFromGhostsBegin<PetscScalar>(carr, dof);		
   }
 
-  if(daf->iAmActive()) {
-    daf->ReadFromGhostsBegin<ot::FineTouchedStatus>(fineTouchedFlagsArr, 1);
-  }
-
   VecZeroEntries(f);
   daf->vecGetBuffer(f, farr, false, false, false, dof);//Writable
 
@@ -206,6 +280,18 @@ PetscErrorCode prolongMatVecType1(Mat R, Vec c, Vec f) {
   //Order of the test condition is important. We want to store
   //the info before checking loopCtr.	
 
+#ifdef OMP_MG_TRANSFER
+  //The loops are walked once (serially) and reused by all the later R/P MatVecs.
+  if(dac->iAmActive() && (data->transferLoops == NULL)) {
+    data->transferLoops = new ot::TransferLoop[2];
+    ot::buildTransferLoops(dac, daf, data->transferLoops);
+  }
+  const unsigned int headChunks = (dac->iAmActive() ? data->transferLoops[0].getNumChunks(fopCnt) : 0);
+
+  if(dac->iAmActive()) {
+    PROLONG_TRANSFER_LOOP(data->transferLoops[0], 0, headChunks)
+  }
+#else
   if(dac->iAmActive()) {
     unsigned int loopCtr = 0;
     if(suppressedDOFc || suppressedDOFf) {
@@ -226,15 +312,17 @@ PetscErrorCode prolongMatVecType1(Mat R, Vec c, Vec f) {
       }//end Independent loop (overlapping with read from coarse ghosts)
     }
   }
+#endif
 
   if(dac->iAmActive()) {
     dac->ReadFromGhostsEnd<PetscScalar>(carr);
   }
 
-  if(daf->iAmActive()) {
-    daf->ReadFromGhostsEnd<ot::FineTouchedStatus>(fineTouchedFlagsArr);
+#ifdef OMP_MG_TRANSFER
+  if(dac->iAmActive()) {
+    PROLONG_TRANSFER_LOOP(data->transferLoops[1], 0, data->transferLoops[1].getNumChunks())
   }
-
+#else
   if(dac->iAmActive()) {
     if(suppressedDOFc || suppressedDOFf) {
       for(dac->init<ot::DA_FLAGS::W_DEPENDENT>(), daf->init<ot::DA_FLAGS::WRITABLE>();
@@ -248,11 +336,18 @@ PetscErrorCode prolongMatVecType1(Mat R, Vec c, Vec f) {
       }//end dependent loop
     }
   }
+#endif
 
   if(daf->iAmActive()) {
     daf->WriteToGhostsBegin<PetscScalar>(farr, dof);
   }
 
+#ifdef OMP_MG_TRANSFER
+  if(dac->iAmActive()) {
+    //Continue Independent loop from where we left off.
+    PROLONG_TRANSFER_LOOP(data->transferLoops[0], headChunks, data->transferLoops[0].getNumChunks())
+  }
+#else
   if(dac->iAmActive()) {
     //Continue Independent loop from where we left off.
     if(suppressedDOFc || suppressedDOFf) {
@@ -267,6 +362,7 @@ PetscErrorCode prolongMatVecType1(Mat R, Vec c, Vec f) {
       }//end Independent loop (overlapping with write to fine ghosts) 
     }
   }
+#endif
 
   if(daf->iAmActive()) {
     daf->WriteToGhostsEnd<PetscScalar>(farr, dof);
@@ -274,7 +370,6 @@ PetscErrorCode prolongMatVecType1(Mat R, Vec c, Vec f) {
 
   daf->vecRestoreBuffer(f, farr, false, false, false, dof);//Writable 
   dac->vecRestoreBuffer(c, carr, false, false, true, dof);//Read-only
-  daf->vecRestoreBuffer<ot::FineTouchedStatus >(*fineTouchedFlags, fineTouchedFlagsArr, false, false, true, 1);//read-only 
 
 #ifdef PETSC_USE_LOG
   PetscLogFlops(128*dof*(daf->getElementSize()));
@@ -286,6 +381,9 @@ PetscErrorCode prolongMatVecType1(Mat R, Vec c, Vec f) {
 #undef ITLB_SET_VALUE_NO_SUPPRESSED_DOFS
 #undef ITLB_SET_VALUE_SUPPRESSED_DOFS
 #undef INTERGRID_TRANSFER_LOOP_BLOCK
+#ifdef OMP_MG_TRANSFER
+#undef PROLONG_TRANSFER_LOOP
+#endif
 
 }//end namespace
 
@@ -472,6 +472,20 @@ PetscErrorCode dummyRestrictMatVecType1(TransferOpData *data) {
   daf->vecRestoreBuffer<ot::FineTouchedStatus >(*fineTouchedFlags, fineTouchedFlagsArr, 
       false, false, false, 1);//writable 
 
+  //The masks do not change for a given pair of meshes. So the ghosted buffer
+  //is built and synchronized only once here and the R/P MatVecs use it
+  //directly, without getting the buffer and exchanging the ghosts again.
+  if(data->fineTouchedFlagsArr) {
+    delete [] data->fineTouchedFlagsArr;
+    data->fineTouchedFlagsArr = NULL;
+  }
+  daf->vecGetBuffer<ot::FineTouchedStatus >(*fineTouchedFlags, data->fineTouchedFlagsArr,
+      false, false, true, 1);//read-only 
+  if(daf->iAmActive()) {
+    daf->ReadFromGhostsBegin<ot::FineTouchedStatus>(data->fineTouchedFlagsArr, 1);
+    daf->ReadFromGhostsEnd<ot::FineTouchedStatus>(data->fineTouchedFlagsArr);
+  }
+
   //THIS IS A HACK FOR EFFICIENCY PURPOSES. Although, the buffer was modified
   //there is no need to write the changes back to the vector. This is because
   //the dummy vector is only temporary.   
@@ -483,6 +497,86 @@ PetscErrorCode dummyRestrictMatVecType1(TransferOpData *data) {
   PROF_MG_RESTRICT_DUMMY_END
 }//restrict-3
 
+#ifdef OMP_MG_TRANSFER
+/**
+  @brief The body of INTERGRID_TRANSFER_LOOP_BLOCK for one position of a TransferLoop. Only the coarse nodes of
+  the position are written, so positions in chunks of the same color can be processed concurrently.
+  */
+template <bool suppressed>
+struct RestrictKernel {
+  const ot::TransferLoop & loop;
+  const ot::FineTouchedStatus* fineTouchedFlagsArr;
+  const PetscScalar* farr;
+  PetscScalar* carr;
+  const unsigned char* suppressedDOFc;
+  const unsigned char* suppressedDOFf;
+  const unsigned int dof;
+
+  RestrictKernel(const ot::TransferLoop & l, const ot::FineTouchedStatus* flags, const PetscScalar* f,
+      PetscScalar* c, const unsigned char* sc, const unsigned char* sf, unsigned int d) : loop(l),
+  fineTouchedFlagsArr(flags), farr(f), carr(c), suppressedDOFc(sc), suppressedDOFf(sf), dof(d) { }
+
+  void operator()(unsigned int pos) const {
+    const unsigned int* cIndices = &(loop.coarseNodes[pos << 3]);
+    const unsigned char cNumCoarse = loop.coarseChildNums[pos];
+    const unsigned char ctype = loop.coarseTypes[pos];
+    const unsigned int fBegin = loop.fineOffsets[pos];
+    const unsigned int fEnd = loop.fineOffsets[pos + 1];
+    for(unsigned int f = fBegin; f < fEnd; f++) {
+      //Type-2 if the coarse and fine elements are the same, else type-1 for each of the 8 children.
+      double** rmatPtr = ((fEnd - fBegin) == 1) ? RmatType2Stencil[cNumCoarse][ctype] :
+        RmatType1Stencil[cNumCoarse][f - fBegin][ctype];
+      const unsigned char fhnMask = loop.fineHnMasks[f];
+      const unsigned int* fIndices = &(loop.fineNodes[f << 3]);
+      for(unsigned int fCtr = 0; fCtr < 8; fCtr++) {
+        if(!(fhnMask & (1 << fCtr))) {
+          const unsigned char touched = fineTouchedFlagsArr[fIndices[fCtr]].flags[fCtr];
+          const unsigned int fidx = fIndices[fCtr]*dof;
+          const PetscScalar* fin = farr + fidx;
+          for(unsigned int cCtr = 0; cCtr < 8; cCtr++) {
+            if(touched & (1 << cCtr)) {
+              const unsigned int cidx = cIndices[cCtr]*dof;
+              const double Rval = rmatPtr[cCtr][fCtr];
+              PetscScalar* cout = carr + cidx;
+              if(suppressed) {
+                for(unsigned int l = 0; l < dof; l++) {
+                  if(!( (suppressedDOFf && suppressedDOFf[fidx+l]) ||
+                        (suppressedDOFc && suppressedDOFc[cidx+l]) )) {
+                    cout[l] += (Rval*fin[l]);
+                  }
+                }
+              } else {
+                for(unsigned int l = 0; l < dof; l++) {
+                  cout[l] += (Rval*fin[l]);
+                }
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+};
+
+template <bool suppressed>
+void restrictTransferLoop(const ot::TransferLoop & loop, unsigned int chunkBegin, unsigned int chunkEnd,
+    const ot::FineTouchedStatus* fineTouchedFlagsArr, const PetscScalar* farr, PetscScalar* carr,
+    const unsigned char* suppressedDOFc, const unsigned char* suppressedDOFf, unsigned int dof) {
+  loop.apply(chunkBegin, chunkEnd, RestrictKernel<suppressed>(loop, fineTouchedFlagsArr, farr, carr,
+        suppressedDOFc, suppressedDOFf, dof));
+}
+
+#define RESTRICT_TRANSFER_LOOP(loop, chunkBegin, chunkEnd) {\
+  if(suppressedDOFc || suppressedDOFf) {\
+    restrictTransferLoop<true>(loop, chunkBegin, chunkEnd, fineTouchedFlagsArr, farr, carr,\
+        suppressedDOFc, suppressedDOFf, dof);\
+  } else {\
+    restrictTransferLoop<false>(loop, chunkBegin, chunkEnd, fineTouchedFlagsArr, farr, carr,\
+        suppressedDOFc, suppressedDOFf, dof);\
+  }\
+}
+#endif
+
 PetscErrorCode restrictMatVecType1(Mat R, Vec f, Vec c) {
 
   PROF_MG_RESTRICT_BEGIN
@@ -510,25 +604,35 @@ PetscErrorCode restrictMatVecType1(Mat R, Vec f, Vec c) {
 
   unsigned int fopCnt = (fop*cSz)/(100*dof);
 
-  std::vector<ot::FineTouchedStatus >* fineTouchedFlags = data->fineTouchedFlags;
-  ot::FineTouchedStatus* fineTouchedFlagsArr;
+  //Ghosted and synchronized by dummyRestrictMatVecType1
+  ot::FineTouchedStatus* fineTouchedFlagsArr = data->fineTouchedFlagsArr;
 
   PetscScalar *farr = NULL;
   PetscScalar *carr = NULL;
 
   daf->vecGetBuffer(f, farr, false, false, true, dof);//Read-only
-  daf->vecGetBuffer<ot::FineTouchedStatus >(*fineTouchedFlags, 
-      fineTouchedFlagsArr, false, false, true, 1);//read-only 
 
   if(daf->iAmActive()) {
     daf->ReadFromGhostsBegin<PetscScalar>(farr, dof);
-    //This communication can be avoided if we store it
-    daf->ReadFromGhostsBegin<ot::FineTouchedStatus>(fineTouchedFlagsArr, 1);
   }
 
   VecZeroEntries(c);
   dac->vecGetBuffer(c, carr, false, false, false, dof);//Writable
 
+#ifdef OMP_MG_TRANSFER
+  //The loops are walked once (serially) and reused by all the later R/P MatVecs.
+  if(dac->iAmActive() && (data->transferLoops == NULL)) {
+    data->transferLoops = new ot::TransferLoop[2];
+    ot::buildTransferLoops(dac, daf, data->transferLoops);
+  }
+  const unsigned int headChunks = (dac->iAmActive() ? data->transferLoops[0].getNumChunks(fopCnt) : 0);
+
+  if(dac->iAmActive()) {
+    //Note: If Coarse is Independent, then the corresponding Fine is also independent.
+    //Hence, overlapping comm with comp is possible.		
+    RESTRICT_TRANSFER_LOOP(data->transferLoops[0], 0, headChunks)
+  }
+#else
   if(dac->iAmActive()) {
     //Note: If Coarse is Independent, then the corresponding Fine is also independent.
     //Hence, overlapping comm with comp is possible.		
@@ -550,12 +654,17 @@ PetscErrorCode restrictMatVecType1(Mat R, Vec f, Vec c) {
       }//end Independent loop (overlapping with read from fine ghosts)
     }
   }
+#endif
 
   if(daf->iAmActive()) {
     daf->ReadFromGhostsEnd<PetscScalar>(farr);
-    daf->ReadFromGhostsEnd<ot::FineTouchedStatus>(fineTouchedFlagsArr);
   }
 
+#ifdef OMP_MG_TRANSFER
+  if(dac->iAmActive()) {
+    RESTRICT_TRANSFER_LOOP(data->transferLoops[1], 0, data->transferLoops[1].getNumChunks())
+  }
+#else
   if(dac->iAmActive()) {
     if(suppressedDOFc || suppressedDOFf) {
       for(dac->init<ot::DA_FLAGS::W_DEPENDENT>(), daf->init<ot::DA_FLAGS::WRITABLE>();
@@ -569,11 +678,18 @@ PetscErrorCode restrictMatVecType1(Mat R, Vec f, Vec c) {
       }//end dependent loop
     }
   }
+#endif
 
   if(dac->iAmActive()) {
     dac->WriteToGhostsBegin<PetscScalar>(carr,  dof);
   }
 
+#ifdef OMP_MG_TRANSFER
+  if(dac->iAmActive()) {
+    //Continue Independent loop from where we left off.
+    RESTRICT_TRANSFER_LOOP(data->transferLoops[0], headChunks, data->transferLoops[0].getNumChunks())
+  }
+#else
   if(dac->iAmActive()) {
     //Continue Independent loop from where we left off.
     if(suppressedDOFc || suppressedDOFf) {
@@ -588,6 +704,7 @@ PetscErrorCode restrictMatVecType1(Mat R, Vec f, Vec c) {
       }//end Independent loop (overlapping with write to coarse ghosts) 
     }
   }
+#endif
 
   if(dac->iAmActive()) {
     dac->WriteToGhostsEnd<PetscScalar>(carr, dof);
@@ -595,8 +712,6 @@ PetscErrorCode restrictMatVecType1(Mat R, Vec f, Vec c) {
 
   daf->vecRestoreBuffer(f, farr, false, false, true, dof);//Read-only
   dac->vecRestoreBuffer(c, carr, false, false, false, dof);//Writable  
-  daf->vecRestoreBuffer<ot::FineTouchedStatus >(*fineTouchedFlags, 
-      fineTouchedFlagsArr, false, false, true, 1);//read-only 
 
 #ifdef PETSC_USE_LOG
   PetscLogFlops(128*dof*(daf->getElementSize()));
@@ -614,6 +729,9 @@ PetscErrorCode restrictMatVecType1(Mat R, Vec f, Vec c) {
 #undef ITLB_DUMMY_FINAL_SET_VALUE 
 #undef INTERGRID_TRANSFER_LOOP_BLOCK_DUMMY_FINAL_W
 #undef INTERGRID_TRANSFER_LOOP_BLOCK_DUMMY_FINAL_A
+#ifdef OMP_MG_TRANSFER
+#undef RESTRICT_TRANSFER_LOOP
+#endif
 
 }//end namespace
 
@@ -0,0 +1,89 @@
+/**
+  @file transferLoop.cpp
+  @brief Construction of the coarse/fine transfer loop snapshots used by the threaded restriction and prolongation.
+  @author Milinda Fernando
+  */
+
+#include "transferLoop.h"
+#include "oda.h"
+#include "odaUtils.h"
+
+namespace ot {
+
+  template <ot::DA_FLAGS::loopType type>
+    void buildTransferLoop(DA* dac, DA* daf, TransferLoop & loop, unsigned int chunkSize) {
+      loop = TransferLoop();
+      loop.fineOffsets.push_back(0);
+
+      //Loops of dac or daf that are in progress are not disturbed.
+      LoopCursor cCursor, fCursor;
+      dac->saveLoopCursor(cCursor);
+      daf->saveLoopCursor(fCursor);
+
+      unsigned int indices[8];
+      for(dac->init<type>(), daf->init<ot::DA_FLAGS::WRITABLE>();
+          dac->curr() < dac->end<type>(); dac->next<type>()) {
+        //Align the fine loop with the coarse loop, exactly as INTERGRID_TRANSFER_LOOP_BLOCK does.
+        Point Cpt = dac->getCurrentOffset();
+        while(daf->getCurrentOffset() != Cpt) {
+          if(daf->isLUTcompressed()) {
+            daf->updateQuotientCounter();
+          }
+          daf->next<ot::DA_FLAGS::WRITABLE>();
+        }
+        unsigned char chnMask = dac->getHangingNodeIndex(dac->curr());
+        unsigned char cNumCoarse = dac->getChildNumber();
+        unsigned char ctype = 0;
+        GET_ETYPE_BLOCK(ctype,chnMask,cNumCoarse)
+        dac->getNodeIndices(indices);
+        loop.coarseNodes.insert(loop.coarseNodes.end(), indices, indices + 8);
+        loop.coarseChildNums.push_back(cNumCoarse);
+        loop.coarseTypes.push_back(ctype);
+
+        //Type-2: the coarse and fine elements are the same. Type-1: the 8 children of the coarse element.
+        const unsigned int numFine = ((daf->getLevel(daf->curr()) == dac->getLevel(dac->curr())) ? 1 : 8);
+        for(unsigned int i = 0; i < numFine; i++) {
+          daf->getNodeIndices(indices);
+          loop.fineNodes.insert(loop.fineNodes.end(), indices, indices + 8);
+          loop.fineHnMasks.push_back(daf->getHangingNodeIndex(daf->curr()));
+          daf->next<ot::DA_FLAGS::WRITABLE>();
+        }
+        loop.fineOffsets.push_back(loop.fineOffsets.back() + numFine);
+      }
+
+      dac->restoreLoopCursor(cCursor);
+      daf->restoreLoopCursor(fCursor);
+
+      const unsigned int numElems = loop.getNumElements();
+      const unsigned int numChunks = ((numElems + chunkSize - 1)/chunkSize);
+      loop.chunkSize = chunkSize;
+      loop.chunkOffsets.resize(numChunks + 1);
+      for(unsigned int c = 0; c < numChunks; c++) {
+        loop.chunkOffsets[c] = c*chunkSize;
+      }
+      loop.chunkOffsets[numChunks] = numElems;
+
+      //Chunks conflict if they share a coarse node (restriction) or a fine node (prolongation). The fine node
+      //ids are shifted past the coarse ones.
+      const unsigned int fineShift = dac->getLocalBufferSize();
+      std::vector<unsigned int> nodes;
+      std::vector<unsigned int> nodeOffsets(numChunks + 1, 0);
+      for(unsigned int c = 0; c < numChunks; c++) {
+        const unsigned int pBegin = loop.chunkOffsets[c];
+        const unsigned int pEnd = loop.chunkOffsets[c + 1];
+        nodes.insert(nodes.end(), loop.coarseNodes.begin() + 8*pBegin, loop.coarseNodes.begin() + 8*pEnd);
+        for(unsigned int i = 8*loop.fineOffsets[pBegin]; i < 8*loop.fineOffsets[pEnd]; i++) {
+          nodes.push_back(fineShift + loop.fineNodes[i]);
+        }
+        nodeOffsets[c + 1] = static_cast<unsigned int>(nodes.size());
+      }
+      colorChunks(nodes, nodeOffsets, loop.colorOffsets, loop.colorChunks);
+    }
+
+  void buildTransferLoops(DA* dac, DA* daf, TransferLoop* loops, unsigned int chunkSize) {
+    buildTransferLoop<ot::DA_FLAGS::INDEPENDENT>(dac, daf, loops[0], chunkSize);
+    buildTransferLoop<ot::DA_FLAGS::W_DEPENDENT>(dac, daf, loops[1], chunkSize);
+  }
+
+}//end namespace
+
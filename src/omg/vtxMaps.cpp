@@ -8,6 +8,7 @@
 #include <cstdio>
 #include <iostream>
 #include <cassert>
+#include "stencilTable.h"
 
 namespace ot {
 
@@ -267,6 +268,29 @@ namespace ot {
     return 1;
   }//end of function
 
+  int readVtxMapsText(FILE* infile, unsigned short* maps, unsigned int sz) {
+    //The file stores map1[f] and map2[f] for each fineElemNum f and then map3[f][s] and map4[f][s] for each
+    //fineElemNum f and scalingCtr s. The flat table stores map1, map2, map3 and map4 one after the other.
+    assert(sz == 228096);
+    unsigned short* map1 = maps;
+    unsigned short* map2 = (map1 + 9216);
+    unsigned short* map3 = (map2 + 73728);
+    unsigned short* map4 = (map3 + 16128);
+    for(int fineElemNum = 0; fineElemNum < 8; fineElemNum++) {
+      if( (!readTextTable<unsigned short>(infile, map1 + (fineElemNum*1152), 1152)) ||
+          (!readTextTable<unsigned short>(infile, map2 + (fineElemNum*9216), 9216)) ) {
+        return 0;
+      }
+    }
+    for(int i = 0; i < 14; i++) {
+      if( (!readTextTable<unsigned short>(infile, map3 + (i*1152), 1152)) ||
+          (!readTextTable<unsigned short>(infile, map4 + (i*9216), 9216)) ) {
+        return 0;
+      }
+    }
+    return 1;
+  }//end of function
+
 }//end namespace
 
 
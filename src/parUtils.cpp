@@ -19,6 +19,33 @@
 
 namespace par {
 
+  std::atomic<DendroIntL> commBytesSent(0);
+
+  static int nbxKeyval = MPI_KEYVAL_INVALID;
+
+  static int freeNbxCount(MPI_Comm comm, int keyval, void* attr, void* extra) {
+    delete static_cast<unsigned int*>(attr);
+    return MPI_SUCCESS;
+  }
+
+  int getNbxTag(MPI_Comm comm) {
+    if(nbxKeyval == MPI_KEYVAL_INVALID) {
+      MPI_Comm_create_keyval(MPI_COMM_NULL_COPY_FN, freeNbxCount, &nbxKeyval, NULL);
+    }
+
+    unsigned int* count = NULL;
+    int found = 0;
+    MPI_Comm_get_attr(comm, nbxKeyval, &count, &found);
+    if(!found) {
+      count = new unsigned int(0);
+      MPI_Comm_set_attr(comm, nbxKeyval, count);
+    }
+
+    const int tag = NBX_TAG + static_cast<int>((*count) & 1u);
+    (*count)++;
+    return tag;
+  }
+
   unsigned int splitCommBinary( MPI_Comm orig_comm, MPI_Comm *new_comm) {
     int npes, rank;
 
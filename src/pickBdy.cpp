@@ -95,32 +95,29 @@ int pickInterProcessorBoundaryNodes(const std::vector<ot::TreeNode> & nodes,
 #ifdef HILBERT_ORDERING
 
 
+  // An octant is not a boundary octant iff all its neighbours (except the root, which stands for a neighbour
+  // outside the domain) lie in [firstBlock, lastBlock.getDLD()], i.e. the smallest one is >= firstBlock and the
+  // largest one is <= lastBlock.getDLD(). Testing the neighbours one by one avoids sorting them and stops at the
+  // first one that is outside.
+  const ot::TreeNode lastDLD = lastBlock.getDLD();
   std::vector<ot::TreeNode> neighbourOct;
 
   for(int i=0;i<nodes.size();i++)
   {
-
-
     neighbourOct=nodes[i].getAllNeighbours();
-    //sort the neighbour octants
-    seq::makeVectorUnique(neighbourOct,false);
-    ot::TreeNode negCorner;
-    if(!neighbourOct[0].isRoot())
-      negCorner=neighbourOct[0];
-    else
-      negCorner=neighbourOct[1];
-
-    ot::TreeNode posCorner=neighbourOct[neighbourOct.size()-1];
-    bool add = true;
-    if( (negCorner>= firstBlock) && ( posCorner <= lastBlock.getDLD()) ) {\
-      add = false;
+    bool add = false;
+    for(unsigned int k=0;k<neighbourOct.size();k++)
+    {
+      if(neighbourOct[k].isRoot())
+        continue;
+      if( (neighbourOct[k] < firstBlock) || (neighbourOct[k] > lastDLD) ) {
+        add = true;
+        break;
+      }
     }
     if (add) {
       res.push_back(nodes[i]);
     }
-    neighbourOct.clear();
-
-
   }
 #else
   unsigned int dim = firstBlock.getDim();
@@ -1,9 +1,11 @@
 #include "treenode2vtk.h"
+#include <algorithm>
+#include <cstdio>
+#include <stdint.h>
 
 
 void treeNodesTovtk(std::vector<ot::TreeNode> &nodes, int mpi_rank, std::string vtk_file_name, bool hsorted) {
 
-  std::sort(nodes.begin(), nodes.end());
   if (!mpi_rank) std::cout << "writing mesh to VTK file: " << vtk_file_name << std::endl;
   std::ostringstream convert;
 
@@ -118,3 +120,237 @@ void treeNodesTovtk(std::vector<ot::TreeNode> &nodes, int mpi_rank, std::string
 }
 
 
+namespace {
+
+  // One appended data array of the VTU file. All the arrays have a fixed number of bytes per cell.
+  struct VtuArray {
+    std::string   name;
+    const char*   type;
+    unsigned int  numComponents;
+    unsigned int  bytesPerCell;
+    const void*   data;
+  };
+
+  void vtuDataArray(std::ostringstream& xml, const VtuArray& a, unsigned long long offset) {
+    xml << "        <DataArray type=\"" << a.type << "\" Name=\"" << a.name << "\" NumberOfComponents=\""
+        << a.numComponents << "\" format=\"appended\" offset=\"" << offset << "\"/>\n";
+  }
+
+  void vtuPDataArray(std::ostringstream& xml, const VtuArray& a) {
+    xml << "      <PDataArray type=\"" << a.type << "\" Name=\"" << a.name << "\" NumberOfComponents=\""
+        << a.numComponents << "\"/>\n";
+  }
+
+}
+
+
+int cellsToVtu(const float* cells, const unsigned char* levels, unsigned int numCells, const std::string& fileName,
+               MPI_Comm comm, const std::vector<VtuField>& fields) {
+
+  int rank, npes;
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &npes);
+
+  // offset of the local cells and the total number of cells
+  unsigned long long localCells = numCells;
+  unsigned long long cellOffset = 0;
+  unsigned long long totalCells = 0;
+  MPI_Exscan(&localCells, &cellOffset, 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM, comm);
+  if (!rank) cellOffset = 0;
+  MPI_Allreduce(&localCells, &totalCells, 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM, comm);
+
+  // local data, the points of a cell are not shared
+  std::vector<float> points(24 * numCells);
+  std::vector<int64_t> connectivity(8 * numCells);
+  std::vector<int64_t> offsets(numCells);
+  std::vector<unsigned char> types(numCells, VTK_VOXEL);
+  std::vector<int32_t> ranks(numCells, rank);
+
+  for (unsigned int i = 0; i < numCells; i++) {
+    const float* c = cells + 4 * i;
+    for (unsigned int j = 0; j < 8; j++) {
+      points[24 * i + 3 * j] = c[0] + ((j & 1u) ? c[3] : 0.0f);
+      points[24 * i + 3 * j + 1] = c[1] + ((j & 2u) ? c[3] : 0.0f);
+      points[24 * i + 3 * j + 2] = c[2] + ((j & 4u) ? c[3] : 0.0f);
+      connectivity[8 * i + j] = 8 * (cellOffset + i) + j;
+    }
+    offsets[i] = 8 * (cellOffset + i + 1);
+  }
+
+  VtuArray a;
+  std::vector<VtuArray> pointArrays, cellArrays, pointData, cellData;
+
+  a.name = "points"; a.type = "Float32"; a.numComponents = 3; a.bytesPerCell = 24 * sizeof(float); a.data = points.data();
+  pointArrays.push_back(a);
+
+  a.name = "connectivity"; a.type = "Int64"; a.numComponents = 1; a.bytesPerCell = 8 * sizeof(int64_t); a.data = connectivity.data();
+  cellArrays.push_back(a);
+  a.name = "offsets"; a.type = "Int64"; a.numComponents = 1; a.bytesPerCell = sizeof(int64_t); a.data = offsets.data();
+  cellArrays.push_back(a);
+  a.name = "types"; a.type = "UInt8"; a.numComponents = 1; a.bytesPerCell = 1; a.data = types.data();
+  cellArrays.push_back(a);
+
+  a.name = "cell_level"; a.type = "UInt8"; a.numComponents = 1; a.bytesPerCell = 1; a.data = levels;
+  cellData.push_back(a);
+  a.name = "mpi_rank"; a.type = "Int32"; a.numComponents = 1; a.bytesPerCell = sizeof(int32_t); a.data = ranks.data();
+  cellData.push_back(a);
+
+  for (unsigned int f = 0; f < fields.size(); f++) {
+    a.name = fields[f].name;
+    a.type = "Float64";
+    a.numComponents = fields[f].numComponents;
+    a.bytesPerCell = (fields[f].isPointData ? 8 : 1) * fields[f].numComponents * sizeof(double);
+    a.data = fields[f].values;
+    if (fields[f].isPointData) {
+      pointData.push_back(a);
+    } else {
+      cellData.push_back(a);
+    }
+  }
+
+  // the appended arrays in file order: a UInt64 byte count followed by the data of all the processors
+  std::vector<VtuArray> all;
+  all.insert(all.end(), pointData.begin(), pointData.end());
+  all.insert(all.end(), cellData.begin(), cellData.end());
+  all.insert(all.end(), pointArrays.begin(), pointArrays.end());
+  all.insert(all.end(), cellArrays.begin(), cellArrays.end());
+
+  std::vector<unsigned long long> appendedOffsets(all.size());
+  unsigned long long appendedSize = 0;
+  for (unsigned int i = 0; i < all.size(); i++) {
+    appendedOffsets[i] = appendedSize;
+    appendedSize += sizeof(uint64_t) + totalCells * all[i].bytesPerCell;
+  }
+
+  const uint16_t endianTest = 1;
+  const bool isLittleEndian = (*(reinterpret_cast<const unsigned char*>(&endianTest)) == 1);
+
+  // the header is the same on all processors, only rank 0 writes it
+  std::ostringstream xml;
+  unsigned int k = 0;
+  xml << "<?xml version=\"1.0\"?>\n";
+  xml << "<VTKFile type=\"UnstructuredGrid\" version=\"1.0\" byte_order=\""
+      << (isLittleEndian ? "LittleEndian" : "BigEndian") << "\" header_type=\"UInt64\">\n";
+  xml << "  <UnstructuredGrid>\n";
+  xml << "    <Piece NumberOfPoints=\"" << (8 * totalCells) << "\" NumberOfCells=\"" << totalCells << "\">\n";
+  xml << "      <PointData>\n";
+  for (unsigned int i = 0; i < pointData.size(); i++, k++) vtuDataArray(xml, all[k], appendedOffsets[k]);
+  xml << "      </PointData>\n";
+  xml << "      <CellData>\n";
+  for (unsigned int i = 0; i < cellData.size(); i++, k++) vtuDataArray(xml, all[k], appendedOffsets[k]);
+  xml << "      </CellData>\n";
+  xml << "      <Points>\n";
+  for (unsigned int i = 0; i < pointArrays.size(); i++, k++) vtuDataArray(xml, all[k], appendedOffsets[k]);
+  xml << "      </Points>\n";
+  xml << "      <Cells>\n";
+  for (unsigned int i = 0; i < cellArrays.size(); i++, k++) vtuDataArray(xml, all[k], appendedOffsets[k]);
+  xml << "      </Cells>\n";
+  xml << "    </Piece>\n";
+  xml << "  </UnstructuredGrid>\n";
+  xml << "  <AppendedData encoding=\"raw\">\n_";
+  const std::string header = xml.str();
+  const std::string footer = "\n  </AppendedData>\n</VTKFile>\n";
+
+  const std::string vtuName = fileName + ".vtu";
+  MPI_File fh;
+  int err = MPI_File_open(comm, const_cast<char*>(vtuName.c_str()), MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &fh);
+  if (err != MPI_SUCCESS) {
+    if (!rank) std::cerr << "cellsToVtu: unable to open " << vtuName << std::endl;
+    return err;
+  }
+  MPI_File_set_size(fh, 0);
+
+  const MPI_Offset appendedBegin = header.size();
+  if (!rank) {
+    err = MPI_File_write_at(fh, 0, const_cast<char*>(header.c_str()), header.size(), MPI_CHAR, MPI_STATUS_IGNORE);
+    for (unsigned int i = 0; (err == MPI_SUCCESS) && (i < all.size()); i++) {
+      uint64_t numBytes = totalCells * all[i].bytesPerCell;
+      err = MPI_File_write_at(fh, appendedBegin + appendedOffsets[i], &numBytes, sizeof(uint64_t), MPI_BYTE,
+                              MPI_STATUS_IGNORE);
+    }
+    if (err == MPI_SUCCESS) {
+      err = MPI_File_write_at(fh, appendedBegin + appendedSize, const_cast<char*>(footer.c_str()), footer.size(),
+                              MPI_CHAR, MPI_STATUS_IGNORE);
+    }
+  }
+
+  // every array is proportional to the cells, so the offset of a processor is cellOffset*bytesPerCell. The count
+  // of MPI_File_write_at_all is an int, so an array is written in rounds of at most maxChunkBytes per processor.
+  // All the processors make the same number of rounds (from the largest piece) and keep calling the collective
+  // after an error, the error is reduced over comm at the end.
+  const unsigned long long maxChunkBytes = (1ull << 30);
+  unsigned long long maxLocalCells = 0;
+  MPI_Allreduce(&localCells, &maxLocalCells, 1, MPI_UNSIGNED_LONG_LONG, MPI_MAX, comm);
+
+  int localErr = err;
+  for (unsigned int i = 0; i < all.size(); i++) {
+    const MPI_Offset pos = appendedBegin + appendedOffsets[i] + sizeof(uint64_t) + cellOffset * all[i].bytesPerCell;
+    const unsigned long long localBytes = localCells * all[i].bytesPerCell;
+    const unsigned long long numRounds = (maxLocalCells * all[i].bytesPerCell + maxChunkBytes - 1) / maxChunkBytes;
+    const char* data = static_cast<const char*>(all[i].data);
+    for (unsigned long long r = 0; r < numRounds; r++) {
+      const unsigned long long begin = std::min(r * maxChunkBytes, localBytes);
+      const unsigned long long end = std::min(begin + maxChunkBytes, localBytes);
+      err = MPI_File_write_at_all(fh, pos + begin, const_cast<char*>(data + begin), static_cast<int>(end - begin),
+                                  MPI_BYTE, MPI_STATUS_IGNORE);
+      if (err != MPI_SUCCESS) localErr = err;
+    }
+  }
+  MPI_File_close(&fh);
+  MPI_Allreduce(&localErr, &err, 1, MPI_INT, MPI_MAX, comm);
+  if ((err != MPI_SUCCESS) && (!rank)) std::cerr << "cellsToVtu: unable to write " << vtuName << std::endl;
+
+  // the index, the vtu file is referenced relative to the pvtu file
+  if (!rank) {
+    std::string source = vtuName;
+    size_t slash = source.find_last_of('/');
+    if (slash != std::string::npos) source = source.substr(slash + 1);
+
+    std::ostringstream pxml;
+    pxml << "<?xml version=\"1.0\"?>\n";
+    pxml << "<VTKFile type=\"PUnstructuredGrid\" version=\"1.0\" byte_order=\""
+         << (isLittleEndian ? "LittleEndian" : "BigEndian") << "\" header_type=\"UInt64\">\n";
+    pxml << "  <PUnstructuredGrid GhostLevel=\"0\">\n";
+    pxml << "    <PPointData>\n";
+    for (unsigned int i = 0; i < pointData.size(); i++) vtuPDataArray(pxml, pointData[i]);
+    pxml << "    </PPointData>\n";
+    pxml << "    <PCellData>\n";
+    for (unsigned int i = 0; i < cellData.size(); i++) vtuPDataArray(pxml, cellData[i]);
+    pxml << "    </PCellData>\n";
+    pxml << "    <PPoints>\n";
+    vtuPDataArray(pxml, pointArrays[0]);
+    pxml << "    </PPoints>\n";
+    pxml << "    <Piece Source=\"" << source << "\"/>\n";
+    pxml << "  </PUnstructuredGrid>\n";
+    pxml << "</VTKFile>\n";
+
+    const std::string pvtuName = fileName + ".pvtu";
+    FILE* outfile = fopen(pvtuName.c_str(), "w");
+    if (outfile) {
+      fputs(pxml.str().c_str(), outfile);
+      fclose(outfile);
+    } else {
+      std::cerr << "cellsToVtu: unable to open " << pvtuName << std::endl;
+    }
+  }
+
+  return err;
+}
+
+
+int treeNodesToVtu(const std::vector<ot::TreeNode>& nodes, const std::string& fileName, MPI_Comm comm,
+                   const std::vector<VtuField>& fields) {
+
+  std::vector<float> cells(4 * nodes.size());
+  std::vector<unsigned char> levels(nodes.size());
+  for (unsigned int i = 0; i < nodes.size(); i++) {
+    const float domain = (float) (1u << nodes[i].getMaxDepth());
+    cells[4 * i] = nodes[i].getX() / domain;
+    cells[4 * i + 1] = nodes[i].getY() / domain;
+    cells[4 * i + 2] = nodes[i].getZ() / domain;
+    cells[4 * i + 3] = (1u << (nodes[i].getMaxDepth() - nodes[i].getLevel())) / domain;
+    levels[i] = nodes[i].getLevel();
+  }
+
+  return cellsToVtu(cells.data(), levels.data(), nodes.size(), fileName, comm, fields);
+}